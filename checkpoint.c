@@ -0,0 +1,710 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       checkpoint.c
+
+   Version:    V1.29
+   Date:       14.10.26
+   Function:   Resumable mean for trajectories which are being appended
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   With --checkpoint, the state of the mean pass is kept in a file
+   between runs: the frame index, the Kahan sums of the coordinates
+   (with their compensations) and the sums of squares for the RMSFs.
+   A later run of a trajectory which has only been appended to indexes
+   and reads just the new frames, adds them to the sums and saves the
+   checkpoint again. Only the closest frame and RMSD passes then read
+   the whole trajectory, through the index.
+
+   The frames are added serially in file order, so the mean is the
+   same however many runs it took to build up, and the same as a
+   single run with --checkpoint from a fresh start.
+
+   A checkpoint is only used if the selection is the same and the
+   trajectory still has the same header line at the offset of the last
+   frame, with the next frame (or the end of file) straight after it.
+   Otherwise it is ignored with a warning and the whole trajectory is
+   read again. A final frame with too few lines, or which does not end
+   in a newline, is taken to be still being written and is left for
+   the next run.
+
+   The layout, in native byte order, is:
+
+      char     magic[8]     "FCCKPT01"
+      uint32_t realSize     sizeof(REAL)
+      uint64_t end          offset just after the last frame used
+      uint64_t nFrames
+      uint64_t nAtoms       selected atoms in each frame
+      uint64_t nMask, allFrom
+      char     mask[nMask]  the selection
+      uint32_t length       length of the last frame's header
+      char     header[length]
+      uint64_t offset, nAtoms        (repeated nFrames times)
+      REAL     x[nAtoms], y[nAtoms], z[nAtoms]       the sums
+      REAL     x[nAtoms], y[nAtoms], z[nAtoms]       compensations
+      REAL     sumSq[nAtoms]
+
+   It is written to a temporary file which is then renamed, so an
+   interrupted run leaves the previous checkpoint in place.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.18  14.10.26 Original
+   V1.23  14.10.26 The sums are kept in the COORDS sums so they stay
+                   in REAL with SINGLE_COORDS
+   V1.25  14.10.26 The RMSFs are those of the TRAJ rather than gRMSF.
+                   Uses the frames' kernels
+   V1.29  14.10.26 Bad frames are reported with their byte offsets
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "flexcalc.h"
+
+/***********************************************************************/
+/* Defines and macros
+ */
+#define CHECKPOINT_MAGIC    "FCCKPT01"
+#define CHECKPOINT_MAGICLEN 8
+#define CHECKPOINT_TMPEXT   ".tmp"
+
+typedef struct
+{
+   FRAMEINDEX *index;     /* Every frame added so far                   */
+   COORDS     *sum,       /* Sums of the selected coordinates and       */
+              *comp;      /* their Kahan compensations                  */
+   RMSF       *rmsf;      /* Sums of squares                            */
+   off_t      end;        /* Offset just after the last frame added     */
+   char       header[MAXBUFF];  /* Header of the last frame added       */
+}  CHECKPOINT;
+
+/***********************************************************************/
+/* Prototypes
+ -  14.10.26 Uses the COORDS sums
+-  14.10.26 Uses the COORDS sums
+*/
+static CHECKPOINT *AllocCheckpoint(void);
+static void FreeCheckpoint(CHECKPOINT *ckpt);
+static BOOL SizeCheckpoint(CHECKPOINT *ckpt, ULONG nAtoms);
+static BOOL ReadCheckpoint(CHECKPOINT *ckpt, char *filename,
+                           SELECTION *select);
+static BOOL WriteCheckpoint(CHECKPOINT *ckpt, char *filename,
+                            SELECTION *select);
+static BOOL MatchCheckpoint(CHECKPOINT *ckpt, char *trajFile);
+static BOOL IndexNewFrames(CHECKPOINT *ckpt, char *trajFile,
+                           off_t limit);
+static BOOL AddNewFrames(CHECKPOINT *ckpt, TRAJ *in, ULONG firstNew);
+
+
+/***********************************************************************/
+/*>static CHECKPOINT *AllocCheckpoint(void)
+   ----------------------------------------
+*//**
+   \return                     an empty checkpoint (NULL if no memory)
+
+-  14.10.26 Original   By: ACRM
+*/
+static CHECKPOINT *AllocCheckpoint(void)
+{
+   CHECKPOINT *ckpt;
+
+   if((ckpt = (CHECKPOINT *)CountedMalloc(sizeof(CHECKPOINT)))==NULL)
+      return(NULL);
+
+   ckpt->sum       = ckpt->comp = NULL;
+   ckpt->rmsf      = NULL;
+   ckpt->end       = 0;
+   ckpt->header[0] = '\0';
+   if(((ckpt->index = AllocFrameIndex())==NULL) ||
+      ((ckpt->rmsf  = AllocRMSF())==NULL))
+   {
+      FreeCheckpoint(ckpt);
+      return(NULL);
+   }
+   return(ckpt);
+}
+
+
+/***********************************************************************/
+/*>static void FreeCheckpoint(CHECKPOINT *ckpt)
+   --------------------------------------------
+*//**
+   \param[in]  *ckpt           a checkpoint (may be NULL)
+
+-  14.10.26 Original   By: ACRM
+*/
+static void FreeCheckpoint(CHECKPOINT *ckpt)
+{
+   if(ckpt != NULL)
+   {
+      FreeFrameIndex(ckpt->index);
+      FreeCoords(ckpt->sum);
+      FreeCoords(ckpt->comp);
+      FreeRMSF(ckpt->rmsf);
+      free(ckpt);
+   }
+}
+
+
+/***********************************************************************/
+/*>static BOOL SizeCheckpoint(CHECKPOINT *ckpt, ULONG nAtoms)
+   ----------------------------------------------------------
+*//**
+   \param[in,out] *ckpt        a checkpoint with no frames
+   \param[in]     nAtoms       selected atoms in each frame
+   \return                     FALSE if no memory
+
+   Allocates and zeroes the sums
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Checks ZeroCoords()
+*/
+static BOOL SizeCheckpoint(CHECKPOINT *ckpt, ULONG nAtoms)
+{
+   RMSF *rmsf = ckpt->rmsf;
+
+   if(((ckpt->sum  = AllocCoords(nAtoms))==NULL) ||
+      ((ckpt->comp = AllocCoords(nAtoms))==NULL) ||
+      !ZeroCoords(ckpt->sum,  nAtoms) ||
+      !ZeroCoords(ckpt->comp, nAtoms))
+      return(FALSE);
+
+   if((rmsf->sumSq = (REAL *)CountedCalloc((nAtoms > 0) ? nAtoms : 1,
+                                           sizeof(REAL)))==NULL)
+      return(FALSE);
+   rmsf->nAtoms   = nAtoms;
+   rmsf->maxAtoms = nAtoms;
+   rmsf->nFrames  = 0;
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>static BOOL ReadCheckpoint(CHECKPOINT *ckpt, char *filename,
+                              SELECTION *select)
+   ------------------------------------------------------------
+*//**
+   \param[out] *ckpt           an empty checkpoint
+   \param[in]  *filename       the checkpoint file
+   \param[in]  *select         the atom selection (NULL for all)
+   \return                     Was a checkpoint for this selection
+                               read?
+
+   Reads a checkpoint. If it was saved with a different selection, or
+   can't be read, ckpt is left empty.
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL ReadCheckpoint(CHECKPOINT *ckpt, char *filename,
+                           SELECTION *select)
+{
+   FILE     *fp;
+   char     magic[CHECKPOINT_MAGICLEN],
+            *mask = NULL;
+   uint32_t realSize, length;
+   uint64_t end, nFrames, nAtoms, nMask, allFrom, values[2];
+   ULONG    i;
+   BOOL     ok;
+
+   if((fp = fopen(filename, "rb"))==NULL)
+      return(FALSE);
+
+   ok = ((fread(magic, 1, CHECKPOINT_MAGICLEN, fp) ==
+          CHECKPOINT_MAGICLEN)                                       &&
+         !strncmp(magic, CHECKPOINT_MAGIC, CHECKPOINT_MAGICLEN)      &&
+         (fread(&realSize, sizeof(uint32_t), 1, fp) == 1)            &&
+         (realSize == sizeof(REAL))                                  &&
+         (fread(&end,      sizeof(uint64_t), 1, fp) == 1)            &&
+         (fread(&nFrames,  sizeof(uint64_t), 1, fp) == 1)            &&
+         (fread(&nAtoms,   sizeof(uint64_t), 1, fp) == 1)            &&
+         (fread(&nMask,    sizeof(uint64_t), 1, fp) == 1)            &&
+         (fread(&allFrom,  sizeof(uint64_t), 1, fp) == 1)            &&
+         (nFrames > 0));
+
+   /* The selection must be the same                                   */
+   if(ok)
+   {
+      ULONG wantMask    = (select == NULL) ? 0 : select->nMask,
+            wantAllFrom = (select == NULL) ? 0 : select->allFrom;
+
+      ok = ((nMask == wantMask) && (allFrom == (uint64_t)wantAllFrom) &&
+            ((nMask == 0) ||
+             (((mask = (char *)CountedMalloc(nMask))!=NULL) &&
+              (fread(mask, 1, nMask, fp) == nMask) &&
+              !memcmp(mask, select->mask, nMask))));
+      free(mask);
+   }
+
+   ok = (ok &&
+         (fread(&length, sizeof(uint32_t), 1, fp) == 1) &&
+         (length < MAXBUFF) &&
+         (fread(ckpt->header, 1, length, fp) == length));
+   if(ok)
+      ckpt->header[length] = '\0';
+
+   for(i=0; ok && (i<nFrames); i++)
+   {
+      if((ok = (fread(values, sizeof(uint64_t), 2, fp) == 2)) &&
+         (ok = AddIndexFrame(ckpt->index, (off_t)values[0])))
+      {
+         ckpt->index->nAtoms[i] = (ULONG)values[1];
+      }
+   }
+
+   if(ok && (ok = SizeCheckpoint(ckpt, (ULONG)nAtoms)))
+   {
+      ok = ((fread(SUMX(ckpt->sum),  sizeof(REAL), nAtoms, fp) == nAtoms) &&
+            (fread(SUMY(ckpt->sum),  sizeof(REAL), nAtoms, fp) == nAtoms) &&
+            (fread(SUMZ(ckpt->sum),  sizeof(REAL), nAtoms, fp) == nAtoms) &&
+            (fread(SUMX(ckpt->comp), sizeof(REAL), nAtoms, fp) == nAtoms) &&
+            (fread(SUMY(ckpt->comp), sizeof(REAL), nAtoms, fp) == nAtoms) &&
+            (fread(SUMZ(ckpt->comp), sizeof(REAL), nAtoms, fp) == nAtoms) &&
+            (fread(ckpt->rmsf->sumSq, sizeof(REAL), nAtoms, fp)
+             == nAtoms));
+      ckpt->rmsf->nFrames = (ULONG)nFrames;
+   }
+   fclose(fp);
+
+   ckpt->end = (off_t)end;
+   if(!ok)
+   {
+      ckpt->index->nFrames = 0;
+      ckpt->end            = 0;
+      ckpt->header[0]      = '\0';
+      FreeCoords(ckpt->sum);
+      FreeCoords(ckpt->comp);
+      ckpt->sum = ckpt->comp = NULL;
+      free(ckpt->rmsf->sumSq);
+      ckpt->rmsf->sumSq    = NULL;
+      ckpt->rmsf->nFrames  = 0;
+   }
+   return(ok);
+}
+
+
+/***********************************************************************/
+/*>static BOOL WriteCheckpoint(CHECKPOINT *ckpt, char *filename,
+                               SELECTION *select)
+   -------------------------------------------------------------
+*//**
+   \param[in]  *ckpt           a checkpoint with at least one frame
+   \param[in]  *filename       the checkpoint file
+   \param[in]  *select         the atom selection (NULL for all)
+   \return                     Was the checkpoint saved?
+
+   Saves a checkpoint through a temporary file so that the old one is
+   only replaced once the new one is complete
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL WriteCheckpoint(CHECKPOINT *ckpt, char *filename,
+                            SELECTION *select)
+{
+   char     tmpFile[MAXFNM+8];
+   FILE     *fp;
+   uint32_t realSize = sizeof(REAL),
+            length   = strlen(ckpt->header);
+   uint64_t values[5];
+   ULONG    i,
+            nAtoms   = ckpt->sum->nAtoms;
+   BOOL     ok;
+
+   snprintf(tmpFile, sizeof(tmpFile), "%s%s", filename,
+            CHECKPOINT_TMPEXT);
+   if((fp = fopen(tmpFile, "wb"))==NULL)
+      return(FALSE);
+
+   values[0] = (uint64_t)ckpt->end;
+   values[1] = (uint64_t)ckpt->index->nFrames;
+   values[2] = (uint64_t)nAtoms;
+   values[3] = (select == NULL) ? 0 : (uint64_t)select->nMask;
+   values[4] = (select == NULL) ? 0 : (uint64_t)select->allFrom;
+   ok = ((fwrite(CHECKPOINT_MAGIC, 1, CHECKPOINT_MAGICLEN, fp) ==
+          CHECKPOINT_MAGICLEN)                                        &&
+         (fwrite(&realSize, sizeof(uint32_t), 1, fp) == 1)            &&
+         (fwrite(values, sizeof(uint64_t), 5, fp) == 5)               &&
+         ((values[3] == 0) ||
+          (fwrite(select->mask, 1, select->nMask, fp) == select->nMask)) &&
+         (fwrite(&length, sizeof(uint32_t), 1, fp) == 1)              &&
+         (fwrite(ckpt->header, 1, length, fp) == length));
+
+   for(i=0; ok && (i<ckpt->index->nFrames); i++)
+   {
+      values[0] = (uint64_t)ckpt->index->offset[i];
+      values[1] = (uint64_t)ckpt->index->nAtoms[i];
+      ok = (fwrite(values, sizeof(uint64_t), 2, fp) == 2);
+   }
+
+   ok = (ok &&
+         (fwrite(SUMX(ckpt->sum),  sizeof(REAL), nAtoms, fp) == nAtoms) &&
+         (fwrite(SUMY(ckpt->sum),  sizeof(REAL), nAtoms, fp) == nAtoms) &&
+         (fwrite(SUMZ(ckpt->sum),  sizeof(REAL), nAtoms, fp) == nAtoms) &&
+         (fwrite(SUMX(ckpt->comp), sizeof(REAL), nAtoms, fp) == nAtoms) &&
+         (fwrite(SUMY(ckpt->comp), sizeof(REAL), nAtoms, fp) == nAtoms) &&
+         (fwrite(SUMZ(ckpt->comp), sizeof(REAL), nAtoms, fp) == nAtoms) &&
+         (fwrite(ckpt->rmsf->sumSq, sizeof(REAL), nAtoms, fp) == nAtoms));
+
+   if(fclose(fp) != 0)
+      ok = FALSE;
+   if(ok && (rename(tmpFile, filename) != 0))
+      ok = FALSE;
+   if(!ok)
+      remove(tmpFile);
+   return(ok);
+}
+
+
+/***********************************************************************/
+/*>static BOOL MatchCheckpoint(CHECKPOINT *ckpt, char *trajFile)
+   -------------------------------------------------------------
+*//**
+   \param[in]  *ckpt           a checkpoint read from file
+   \param[in]  *trajFile       the trajectory
+   \return                     Does the trajectory still start with the
+                               frames in the checkpoint?
+
+   Checks that the trajectory has only been appended to since the
+   checkpoint was saved. The last frame in the checkpoint must still
+   have the same header and be followed by another header or the end
+   of the file.
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL MatchCheckpoint(CHECKPOINT *ckpt, char *trajFile)
+{
+   FILE *fp;
+   char buffer[MAXBUFF];
+   int  next;
+   BOOL ok;
+
+   if((fp = fopen(trajFile, "r"))==NULL)
+      return(FALSE);
+
+   ok = ((fseeko(fp, ckpt->index->offset[ckpt->index->nFrames-1],
+                 SEEK_SET) == 0) &&
+         (fgets(buffer, MAXBUFF-1, fp) != NULL));
+   if(ok)
+   {
+      TERMINATE(buffer);
+      ok = (!strcmp(buffer, ckpt->header) &&
+            (fseeko(fp, ckpt->end, SEEK_SET) == 0) &&
+            (((next = getc(fp)) == '>') || (next == EOF)));
+   }
+   fclose(fp);
+   return(ok);
+}
+
+
+/***********************************************************************/
+/*>static BOOL IndexNewFrames(CHECKPOINT *ckpt, char *trajFile,
+                              off_t limit)
+   ------------------------------------------------------------
+*//**
+   \param[in,out] *ckpt        the checkpoint
+   \param[in]     *trajFile    the trajectory
+   \param[in]     limit        size of the trajectory as opened
+   \return                     FALSE if the trajectory couldn't be read
+                               or there was no memory
+
+   Adds the frames after the checkpoint's end to its index. A last
+   frame which is incomplete is dropped and end is left at its header
+   so it is indexed again by the next run.
+
+   As with CountFrames(), the coordinate lines are only counted. Any
+   lines before the first header are indexed as a frame with no atoms
+   so CheckFrameIndex() reports them.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Indexes lines before the first header as a frame
+-  14.10.26 Reads whole lines with ReadTrajLine()
+*/
+static BOOL IndexNewFrames(CHECKPOINT *ckpt, char *trajFile, off_t limit)
+{
+   FRAMEINDEX *index = ckpt->index;
+   FILE       *fp;
+   char       buffer[MAXBUFF];
+   off_t      offset = ckpt->end;
+   ULONG      firstNew = index->nFrames;
+   BOOL       complete = TRUE,
+              counting = TRUE;
+   size_t     length;
+
+   if((fp = fopen(trajFile, "r"))==NULL)
+      return(FALSE);
+   if(fseeko(fp, offset, SEEK_SET) != 0)
+   {
+      fclose(fp);
+      return(FALSE);
+   }
+
+   while((offset < limit) && ((length = ReadTrajLine(fp, buffer)) != 0))
+   {
+      if((offset + (off_t)length > limit) || (buffer[length-1] != '\n'))
+      {
+         complete = FALSE;
+         break;
+      }
+
+      if((buffer[0] == '>') || (index->nFrames == 0))
+      {
+         if(!AddIndexFrame(index, offset))
+         {
+            fclose(fp);
+            Msg(MSG_NOMEM, " (frame index)");
+            return(FALSE);
+         }
+         counting = (buffer[0] == '>');
+         if(!counting)
+            index->noHeader = TRUE;
+      }
+      else if(counting)
+      {
+         index->nAtoms[index->nFrames-1]++;
+      }
+      offset += (off_t)length;
+   }
+   fclose(fp);
+   CountRead((ULONG)(offset - ckpt->end), 0, 0);
+
+   /* Leave a frame which is still being written for next time. The
+      lines before the first header are bad rather than incomplete
+   */
+   if((index->nFrames > firstNew) &&
+      (!complete ||
+       (counting && (index->nAtoms[index->nFrames-1] < index->nAtoms[0]))))
+   {
+      index->nFrames--;
+      offset = index->offset[index->nFrames];
+   }
+   ckpt->end = offset;
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>static BOOL AddNewFrames(CHECKPOINT *ckpt, TRAJ *in, ULONG firstNew)
+   --------------------------------------------------------------------
+*//**
+   \param[in,out] *ckpt        the checkpoint with its index extended
+   \param[in]     *in          the open trajectory
+   \param[in]     firstNew     the first frame not yet in the sums
+   \return                     FALSE if a frame couldn't be read, the
+                               atoms don't match or there was no memory
+
+   Reads the new frames and adds them to the sums
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Reports a bad frame with MsgBadFrame()
+-  14.10.26 Uses the frame's kernels
+*/
+static BOOL AddNewFrames(CHECKPOINT *ckpt, TRAJ *in, ULONG firstNew)
+{
+   FRAMEINDEX *index = ckpt->index;
+   COORDS     *frame;
+   char       header[MAXBUFF];
+   ULONG      i;
+   BOOL       ok = TRUE;
+
+   if(firstNew == index->nFrames)
+      return(TRUE);
+   if((ckpt->sum == NULL) &&
+      !SizeCheckpoint(ckpt, CountSelected(in->select, index->nAtoms[0])))
+   {
+      Msg(MSG_NOMEM, "");
+      return(FALSE);
+   }
+   if((frame = AllocCoords(index->nAtoms[0]))==NULL)
+   {
+      Msg(MSG_NOMEM, "");
+      return(FALSE);
+   }
+
+   header[0] = '\0';
+   for(i=firstNew; ok && (i<index->nFrames); i++)
+   {
+      if(!ReadIndexedFrame(in, index, i, header, frame) ||
+         !AddFrameKahan(ckpt->sum, ckpt->comp, frame))
+      {
+         MsgBadFrame(in, i, header, FALSE);
+         ok = FALSE;
+      }
+      else
+      {
+         frame->kernels->addSquares(ckpt->rmsf->sumSq, frame->x,
+                                    frame->y, frame->z, frame->nAtoms);
+         ckpt->rmsf->nFrames++;
+      }
+   }
+   if(ok)
+      strcpy(ckpt->header, header);
+
+   FreeCoords(frame);
+   return(ok);
+}
+
+
+/***********************************************************************/
+/*>COORDS *UpdateCheckpoint(TRAJ *in, char *filename,
+                            FRAMEINDEX **index)
+   ---------------------------------------------------
+*//**
+   \param[in]  *in             the open text trajectory
+   \param[in]  *filename       the checkpoint file
+   \param[out] **index         the index of every frame used, which the
+                               caller must free
+   \return                     the mean coordinates (NULL on failure)
+
+   Resumes the mean from a checkpoint, if there is a valid one, adds
+   any frames appended since and saves the checkpoint again. The
+   trajectory's window is set to the frames used so that the later
+   passes don't read a frame still being written. With --rmsf, the
+   trajectory's RMSFs are filled in from the saved squares.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Uses the COORDS sums
+-  14.10.26 Reports a bad frame with MsgBadFrame()
+-  14.10.26 Fills in the TRAJ's RMSFs
+*/
+COORDS *UpdateCheckpoint(TRAJ *in, char *filename, FRAMEINDEX **index)
+{
+   CHECKPOINT  *ckpt;
+   COORDS      *meanFrame = NULL;
+   struct stat st;
+   off_t       limit;
+   ULONG       i,
+               firstNew,
+               nFrames = 0;
+   BOOL        ok = TRUE;
+
+   *index = NULL;
+   if((ckpt = AllocCheckpoint())==NULL)
+   {
+      Msg(MSG_NOMEM, "");
+      return(NULL);
+   }
+
+   if(ReadCheckpoint(ckpt, filename, in->select))
+   {
+      if(!MatchCheckpoint(ckpt, in->filename))
+      {
+         fprintf(stderr, "%s warning: Checkpoint %s does not match the \
+trajectory;\n   starting again\n", PROGNAME, filename);
+         FreeCheckpoint(ckpt);
+         if((ckpt = AllocCheckpoint())==NULL)
+         {
+            Msg(MSG_NOMEM, "");
+            return(NULL);
+         }
+      }
+   }
+   else if(access(filename, F_OK) == 0)
+   {
+      fprintf(stderr, "%s warning: Checkpoint %s is for another atom \
+selection or\n   can't be read; starting again\n", PROGNAME, filename);
+   }
+
+   /* Only index what was there when the trajectory was opened         */
+   if(in->mapped)
+      limit = (off_t)in->size;
+   else if(fstat(fileno(in->fp), &st) == 0)
+      limit = st.st_size;
+   else
+      limit = 0;
+
+   firstNew = ckpt->index->nFrames;
+   if(!IndexNewFrames(ckpt, in->filename, limit))
+   {
+      Msg("Unable to read trajectory: ", in->filename);
+      ok = FALSE;
+   }
+   else if((nFrames = ckpt->index->nFrames) < 1)
+   {
+      Msg("No frames in trajectory", "");
+      ok = FALSE;
+   }
+   else if((i = CheckFrameIndex(in, ckpt->index)) < nFrames)
+   {
+      /* The index gives the frame's offset                            */
+      in->index = ckpt->index;
+      MsgBadFrame(in, i, NULL, FALSE);
+      in->index = NULL;
+      ok = FALSE;
+   }
+   else if(!AddNewFrames(ckpt, in, firstNew))
+   {
+      ok = FALSE;
+   }
+
+   if(ok && (ckpt->index->nFrames > firstNew) &&
+      !WriteCheckpoint(ckpt, filename, in->select))
+   {
+      fprintf(stderr, "%s warning: Unable to save checkpoint %s\n",
+              PROGNAME, filename);
+   }
+
+   /* The mean is the compensated sum over the frames                  */
+   if(ok && (((meanFrame = AllocCoords(ckpt->sum->nAtoms))==NULL) ||
+             !ZeroCoords(meanFrame, ckpt->sum->nAtoms)))
+   {
+      Msg(MSG_NOMEM, "");
+      FreeCoords(meanFrame);
+      meanFrame = NULL;
+      ok = FALSE;
+   }
+   if(ok)
+   {
+      COORDS *sum  = ckpt->sum,
+             *comp = ckpt->comp;
+
+      for(i=0; i<meanFrame->nAtoms; i++)
+      {
+         SUMX(meanFrame)[i] = (SUMX(sum)[i] - SUMX(comp)[i]) / nFrames;
+         SUMY(meanFrame)[i] = (SUMY(sum)[i] - SUMY(comp)[i]) / nFrames;
+         SUMZ(meanFrame)[i] = (SUMZ(sum)[i] - SUMZ(comp)[i]) / nFrames;
+      }
+      StoreSums(meanFrame);
+
+      if(in->rmsf != NULL)
+      {
+         ResetRMSF(in->rmsf);
+         if(!MergeRMSF(in->rmsf, ckpt->rmsf))
+         {
+            Msg(MSG_NOMEM, "");
+            FreeCoords(meanFrame);
+            meanFrame = NULL;
+            ok        = FALSE;
+         }
+      }
+   }
+
+   if(ok)
+   {
+      SetTrajWindow(in, 0, nFrames-1, 1);
+      in->index    = ckpt->index;
+      *index       = ckpt->index;
+      ckpt->index  = NULL;
+   }
+   FreeCheckpoint(ckpt);
+
+#ifdef DEBUG
+   if(meanFrame != NULL)
+      PrintFrame("average", meanFrame);
+#endif
+   return(meanFrame);
+}
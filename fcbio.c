@@ -0,0 +1,750 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       fcbio.c
+
+   Version:    V1.29
+   Date:       14.10.26
+   Function:   Binary trajectory format
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   Reads and writes the compact binary trajectory format (.fcb) created
+   by 'flexcalc convert'. Every frame is a fixed-size block of
+   coordinates so a frame is read with a single fread() (or straight
+   from the mapping) and no parsing. OpenTraj() recognises the format
+   from its magic number, so it can be used anywhere a text trajectory
+   can.
+
+   The coordinates are stored either as 32-bit fixed point in units of
+   0.001 (FCB_INT32), as 32-bit floats (FCB_FLOAT32) or as doubles
+   (FCB_FLOAT64). Fixed point is exact for trajectories written with
+   "%.3f" and gives the same values as parsing the text since
+   value/1000.0 is correctly rounded in the same way as strtod().
+   Doubles are always exact and are used for the temporary copy of a
+   stream (SpillTraj()).
+
+   The layout, in native byte order, is:
+
+      char     magic[8]     "FCBTRAJ1"
+      uint32_t encoding     FCB_INT32, FCB_FLOAT32 or FCB_FLOAT64
+      uint32_t reserved
+      uint64_t nAtoms
+      uint64_t nFrames
+      uint64_t frameTable   offset of uint64_t frameOffset[nFrames]
+      uint64_t headerTable  offset of uint64_t headerOffset[nFrames]
+      uint64_t stringTable  offset of the frame headers
+      uint64_t stringSize   size of the frame headers
+      (padded to FCB_HEADERSIZE bytes)
+
+   followed by the frames, each being nAtoms x values then nAtoms y
+   values then nAtoms z values, and then the three tables. The headers
+   are stored as NUL-terminated strings and headerOffset[] is relative
+   to the start of the string table.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.8   14.10.26 Original
+   V1.11  14.10.26 Counts the bytes read and allocations for --stats
+   V1.13  14.10.26 Only the selected atoms are decoded. convert with
+                   --atoms writes just the selected atoms
+   V1.23  14.10.26 Frames are decoded into and encoded from COORD
+   V1.29  14.10.26 convert can leave out frames that don't match
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdint.h>
+#include "flexcalc.h"
+
+/***********************************************************************/
+/* Defines and macros
+ */
+#define FCB_MAGIC      "FCBTRAJ1"
+#define FCB_MAGICLEN   8
+#define FCB_HEADERSIZE 64
+#define FCB_SCALE      1000.0
+#define FCB_MAXFIXED   2147483647.0
+#define FCB_VALUESIZE(e) (((e) == FCB_FLOAT64) ? sizeof(double) : \
+                          sizeof(int32_t))
+
+/***********************************************************************/
+/* Prototypes
+ */
+static BOOL ReadFcbBytes(TRAJ *traj, off_t offset, void *buffer,
+                         size_t size);
+static BOOL ReadFcbTable(TRAJ *traj, uint64_t offset, ULONG nFrames,
+                         uint64_t *table);
+static BOOL WriteFcbHeader(FILE *fp, int encoding, ULONG nAtoms,
+                           ULONG nFrames, uint64_t *tables);
+static BOOL EncodeFcbFrame(COORDS *frame, int encoding, void *buffer,
+                           ULONG *nRounded);
+
+
+/***********************************************************************/
+/*>static BOOL ReadFcbBytes(TRAJ *traj, off_t offset, void *buffer,
+                            size_t size)
+   ----------------------------------------------------------------
+*//**
+   \param[in]  *traj           an open trajectory
+   \param[in]  offset          byte offset in the file
+   \param[out] *buffer         buffer to read into
+   \param[in]  size            number of bytes to read
+   \return                     Were the bytes read?
+
+   Reads part of a trajectory whether it is mapped or not
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL ReadFcbBytes(TRAJ *traj, off_t offset, void *buffer,
+                         size_t size)
+{
+   if(traj->mapped)
+   {
+      if((offset < 0) || ((size_t)offset > traj->size) ||
+         (size > traj->size - (size_t)offset))
+         return(FALSE);
+      memcpy(buffer, traj->data + offset, size);
+      return(TRUE);
+   }
+
+   if((ftello(traj->fp) != offset) &&
+      (fseeko(traj->fp, offset, SEEK_SET) != 0))
+      return(FALSE);
+   return(fread(buffer, 1, size, traj->fp) == size);
+}
+
+
+/***********************************************************************/
+/*>static BOOL ReadFcbTable(TRAJ *traj, uint64_t offset, ULONG nFrames,
+                            uint64_t *table)
+   --------------------------------------------------------------------
+*//**
+   \param[in]  *traj           an open trajectory
+   \param[in]  offset          byte offset of the table
+   \param[in]  nFrames         number of entries
+   \param[out] *table          the table
+   \return                     Was the table read?
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL ReadFcbTable(TRAJ *traj, uint64_t offset, ULONG nFrames,
+                         uint64_t *table)
+{
+   return(ReadFcbBytes(traj, (off_t)offset, table,
+                       nFrames * sizeof(uint64_t)));
+}
+
+
+/***********************************************************************/
+/*>BOOL IsFcbTraj(TRAJ *traj)
+   --------------------------
+*//**
+   \param[in]  *traj           a newly opened trajectory
+   \return                     Is it a binary trajectory?
+
+   Checks for the binary format's magic number. A stdio trajectory is
+   left at the start of the file.
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL IsFcbTraj(TRAJ *traj)
+{
+   char magic[FCB_MAGICLEN];
+   BOOL found;
+
+   found = (ReadFcbBytes(traj, 0, magic, FCB_MAGICLEN) &&
+            !strncmp(magic, FCB_MAGIC, FCB_MAGICLEN));
+   if(!traj->mapped)
+      rewind(traj->fp);
+   return(found);
+}
+
+
+/***********************************************************************/
+/*>BOOL OpenFcb(TRAJ *traj)
+   ------------------------
+*//**
+   \param[in,out] *traj        a newly opened binary trajectory
+   \return                     Was the header valid?
+
+   Reads the header and tables of a binary trajectory and checks that
+   every frame lies within the file
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Accepts FCB_FLOAT64
+*/
+BOOL OpenFcb(TRAJ *traj)
+{
+   char     header[FCB_HEADERSIZE];
+   uint32_t encoding;
+   uint64_t values[6],
+            *table;
+   off_t    fileSize;
+   ULONG    i;
+   BOOL     ok;
+
+   if(!ReadFcbBytes(traj, 0, header, FCB_HEADERSIZE))
+      return(FALSE);
+   memcpy(&encoding, header + FCB_MAGICLEN, sizeof(uint32_t));
+   memcpy(values, header + FCB_MAGICLEN + 2 * sizeof(uint32_t),
+          sizeof(values));
+
+   if((encoding != FCB_INT32) && (encoding != FCB_FLOAT32) &&
+      (encoding != FCB_FLOAT64))
+      return(FALSE);
+
+   if(traj->mapped)
+   {
+      fileSize = (off_t)traj->size;
+   }
+   else
+   {
+      if(fseeko(traj->fp, 0, SEEK_END) != 0)
+         return(FALSE);
+      fileSize = ftello(traj->fp);
+   }
+
+   traj->binary    = TRUE;
+   traj->encoding  = (int)encoding;
+   traj->nAtoms    = (ULONG)values[0];
+   traj->nFrames   = (ULONG)values[1];
+   traj->frameNum  = 0;
+   traj->frameSize = 3 * traj->nAtoms * FCB_VALUESIZE(encoding);
+
+   /* Sanity check the sizes before allocating anything               */
+   if((values[0] > (uint64_t)fileSize) ||
+      (values[1] > (uint64_t)fileSize / sizeof(uint64_t)) ||
+      (values[4] > (uint64_t)fileSize) ||
+      (values[5] > (uint64_t)fileSize - values[4]))
+      return(FALSE);
+
+   /* The frame offsets and headers                                    */
+   if(((table = (uint64_t *)CountedMalloc((traj->nFrames + 1) *
+                                          sizeof(uint64_t)))==NULL) ||
+      ((traj->frameOffset = (off_t *)CountedMalloc((traj->nFrames + 1) *
+                                                   sizeof(off_t)))==NULL) ||
+      ((traj->headerOffset = (ULONG *)CountedMalloc((traj->nFrames + 1) *
+                                                    sizeof(ULONG)))==NULL) ||
+      ((traj->headers = (char *)CountedMalloc(values[5] + 1))==NULL))
+   {
+      free(table);
+      return(FALSE);
+   }
+
+   ok = ReadFcbTable(traj, values[2], traj->nFrames, table);
+   for(i=0; ok && (i<traj->nFrames); i++)
+   {
+      traj->frameOffset[i] = (off_t)table[i];
+      ok = ((table[i] >= FCB_HEADERSIZE) &&
+            ((table[i] % FCB_VALUESIZE(encoding)) == 0) &&
+            (table[i] <= (uint64_t)fileSize) &&
+            (traj->frameSize <= (uint64_t)fileSize - table[i]));
+   }
+
+   if(ok)
+      ok = ReadFcbTable(traj, values[3], traj->nFrames, table);
+   for(i=0; ok && (i<traj->nFrames); i++)
+   {
+      traj->headerOffset[i] = (ULONG)table[i];
+      ok = (table[i] < values[5]);
+   }
+   free(table);
+
+   if(ok)
+      ok = ReadFcbBytes(traj, (off_t)values[4], traj->headers,
+                        (size_t)values[5]);
+   traj->headers[values[5]] = '\0';
+
+   /* A stdio trajectory reads each frame into this buffer             */
+   if(ok && !traj->mapped)
+      ok = ((traj->buffer = CountedMalloc(traj->frameSize ?
+                                          traj->frameSize : 1)) != NULL);
+
+   return(ok);
+}
+
+
+/***********************************************************************/
+/*>void CloseFcb(TRAJ *traj)
+   -------------------------
+*//**
+   \param[in,out] *traj        an open trajectory
+
+   Frees the tables for a binary trajectory
+
+-  14.10.26 Original   By: ACRM
+*/
+void CloseFcb(TRAJ *traj)
+{
+   if(!traj->shared)
+   {
+      free(traj->frameOffset);
+      free(traj->headerOffset);
+      free(traj->headers);
+   }
+   free(traj->buffer);
+   traj->frameOffset  = NULL;
+   traj->headerOffset = NULL;
+   traj->headers      = NULL;
+   traj->buffer       = NULL;
+}
+
+
+/***********************************************************************/
+/*>BOOL ReadFcbFrame(TRAJ *traj, char *header, COORDS *frame)
+   ----------------------------------------------------------
+*//**
+   \param[in]  *traj           an open binary trajectory
+   \param[out] *header         the frame header
+   \param[out] *frame          the frame to read into
+   \return                     Was a frame read?
+
+   Reads the next frame of a binary trajectory. A mapped file is decoded
+   in place; otherwise the whole frame is read with one fread(). Only
+   the selected atoms are decoded.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Added atom selection
+-  14.10.26 Decodes into COORD
+-  14.10.26 Decodes FCB_FLOAT64
+*/
+BOOL ReadFcbFrame(TRAJ *traj, char *header, COORDS *frame)
+{
+   ULONG i,
+         k      = 0,          /* Atoms decoded with a selection         */
+         nAtoms = traj->nAtoms,
+         n      = 3 * nAtoms;
+   void  *block;
+   COORD *out;
+
+   if(traj->frameNum >= traj->nFrames)
+      return(FALSE);
+
+   if(traj->mapped)
+   {
+      block = traj->data + traj->frameOffset[traj->frameNum];
+   }
+   else
+   {
+      if(!ReadFcbBytes(traj, traj->frameOffset[traj->frameNum],
+                       traj->buffer, traj->frameSize))
+         return(FALSE);
+      block = traj->buffer;
+   }
+
+   strncpy(header, traj->headers + traj->headerOffset[traj->frameNum],
+           MAXBUFF-1);
+   header[MAXBUFF-1] = '\0';
+   traj->frameNum++;
+
+   if(!GrowCoords(frame, CountSelected(traj->select, nAtoms)))
+      return(FALSE);
+
+   /* The x, y and z arrays are decoded as one run of 3*nAtoms values
+      split across the three COORDS arrays. Without a selection the
+      loops are kept free of the test so they can be vectorised
+   */
+   for(i=0; i<n; i+=nAtoms)
+   {
+      ULONG j;
+
+      out = (i == 0) ? frame->x : ((i == nAtoms) ? frame->y : frame->z);
+      if(traj->encoding == FCB_INT32)
+      {
+         int32_t *in = (int32_t *)block + i;
+         if(traj->select == NULL)
+         {
+            for(j=0; j<nAtoms; j++)
+               out[j] = (REAL)in[j] / FCB_SCALE;
+         }
+         else
+         {
+            for(j=k=0; j<nAtoms; j++)
+               if(SELECTED(traj->select, j))
+                  out[k++] = (REAL)in[j] / FCB_SCALE;
+         }
+      }
+      else if(traj->encoding == FCB_FLOAT64)
+      {
+         double *in = (double *)block + i;
+         if(traj->select == NULL)
+         {
+            for(j=0; j<nAtoms; j++)
+               out[j] = (COORD)in[j];
+         }
+         else
+         {
+            for(j=k=0; j<nAtoms; j++)
+               if(SELECTED(traj->select, j))
+                  out[k++] = (COORD)in[j];
+         }
+      }
+      else
+      {
+         float *in = (float *)block + i;
+         if(traj->select == NULL)
+         {
+            for(j=0; j<nAtoms; j++)
+               out[j] = (REAL)in[j];
+         }
+         else
+         {
+            for(j=k=0; j<nAtoms; j++)
+               if(SELECTED(traj->select, j))
+                  out[k++] = (REAL)in[j];
+         }
+      }
+   }
+   frame->nAtoms = (traj->select == NULL) ? nAtoms : k;
+   CountRead((ULONG)traj->frameSize, 0, (nAtoms != 0));
+
+   return(nAtoms != 0);
+}
+
+
+/***********************************************************************/
+/*>BOOL SeekFcb(TRAJ *traj, off_t offset)
+   --------------------------------------
+*//**
+   \param[in]  *traj           an open binary trajectory
+   \param[in]  offset          byte offset of a frame
+   \return                     Was there a frame at that offset?
+
+   Makes the frame at the given offset the next to be read
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL SeekFcb(TRAJ *traj, off_t offset)
+{
+   ULONG low  = 0,
+         high = traj->nFrames;
+
+   /* Frames are written in order so the offsets are sorted            */
+   while(low < high)
+   {
+      ULONG mid = low + (high - low) / 2;
+      if(traj->frameOffset[mid] < offset)
+         low = mid + 1;
+      else
+         high = mid;
+   }
+   if((low < traj->nFrames) && (traj->frameOffset[low] != offset))
+      return(FALSE);
+   traj->frameNum = low;
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>ULONG CountFcbFrames(TRAJ *traj, FRAMEINDEX *index)
+   ---------------------------------------------------
+*//**
+   \param[in]  *traj           an open binary trajectory
+   \param[out] *index          if not NULL, an empty frame index to
+                               fill in
+   \return                     the number of frames in the file
+
+   The frame count and offsets are in the file so nothing is read,
+   but the frames are counted for --stats
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Counts the frames for --stats
+*/
+ULONG CountFcbFrames(TRAJ *traj, FRAMEINDEX *index)
+{
+   ULONG i;
+
+   traj->frameNum = 0;
+   if(index != NULL)
+   {
+      for(i=0; i<traj->nFrames; i++)
+      {
+         if(!AddIndexFrame(index, traj->frameOffset[i]))
+            break;
+         index->nAtoms[i] = traj->nAtoms;
+      }
+   }
+   CountRead(0, 0, traj->nFrames);
+   return(traj->nFrames);
+}
+
+
+/***********************************************************************/
+/*>static BOOL WriteFcbHeader(FILE *fp, int encoding, ULONG nAtoms,
+                              ULONG nFrames, uint64_t *tables)
+   ----------------------------------------------------------------
+*//**
+   \param[in]  *fp             output file at the start
+   \param[in]  encoding        FCB_INT32, FCB_FLOAT32 or FCB_FLOAT64
+   \param[in]  nAtoms          atoms per frame
+   \param[in]  nFrames         number of frames
+   \param[in]  *tables         offsets of the frame, header and string
+                               tables and the size of the string table
+   \return                     Was the header written?
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL WriteFcbHeader(FILE *fp, int encoding, ULONG nAtoms,
+                           ULONG nFrames, uint64_t *tables)
+{
+   char     header[FCB_HEADERSIZE];
+   uint32_t values32[2];
+   uint64_t values64[6];
+
+   memset(header, 0, FCB_HEADERSIZE);
+   memcpy(header, FCB_MAGIC, FCB_MAGICLEN);
+   values32[0] = (uint32_t)encoding;
+   values32[1] = 0;
+   values64[0] = (uint64_t)nAtoms;
+   values64[1] = (uint64_t)nFrames;
+   memcpy(values64 + 2, tables, 4 * sizeof(uint64_t));
+   memcpy(header + FCB_MAGICLEN, values32, sizeof(values32));
+   memcpy(header + FCB_MAGICLEN + sizeof(values32), values64,
+          sizeof(values64));
+
+   return(fwrite(header, 1, FCB_HEADERSIZE, fp) == FCB_HEADERSIZE);
+}
+
+
+/***********************************************************************/
+/*>static BOOL EncodeFcbFrame(COORDS *frame, int encoding, void *buffer,
+                              ULONG *nRounded)
+   ---------------------------------------------------------------------
+*//**
+   \param[in]     *frame       a frame
+   \param[in]     encoding     FCB_INT32, FCB_FLOAT32 or FCB_FLOAT64
+   \param[out]    *buffer      the encoded frame
+   \param[in,out] *nRounded    incremented for every coordinate that
+                               couldn't be stored exactly
+   \return                     FALSE if a coordinate is too large for
+                               fixed point
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Encodes from COORD
+-  14.10.26 Encodes FCB_FLOAT64
+*/
+static BOOL EncodeFcbFrame(COORDS *frame, int encoding, void *buffer,
+                           ULONG *nRounded)
+{
+   ULONG i, j,
+         nAtoms = frame->nAtoms;
+   COORD *in;
+
+   for(i=0; i<3; i++)
+   {
+      in = (i == 0) ? frame->x : ((i == 1) ? frame->y : frame->z);
+      if(encoding == FCB_INT32)
+      {
+         int32_t *out = (int32_t *)buffer + i * nAtoms;
+         for(j=0; j<nAtoms; j++)
+         {
+            REAL scaled = floor(in[j] * FCB_SCALE + 0.5);
+            if(fabs(scaled) > FCB_MAXFIXED)
+               return(FALSE);
+            out[j] = (int32_t)scaled;
+            if((COORD)((REAL)out[j] / FCB_SCALE) != in[j])
+               (*nRounded)++;
+         }
+      }
+      else if(encoding == FCB_FLOAT64)
+      {
+         double *out = (double *)buffer + i * nAtoms;
+         for(j=0; j<nAtoms; j++)
+            out[j] = (double)in[j];
+      }
+      else
+      {
+         float *out = (float *)buffer + i * nAtoms;
+         for(j=0; j<nAtoms; j++)
+         {
+            out[j] = (float)in[j];
+            if((REAL)out[j] != in[j])
+               (*nRounded)++;
+         }
+      }
+   }
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>BOOL ConvertTraj(TRAJ *in, char *outFile, int encoding)
+   -------------------------------------------------------
+*//**
+   \param[in]  *in             an open trajectory (text or binary)
+   \param[in]  *outFile        the binary trajectory to write
+   \param[in]  encoding        FCB_INT32, FCB_FLOAT32 or FCB_FLOAT64
+   \return                     Was the trajectory converted?
+
+   Writes a trajectory in the binary format. The frames are written as
+   they are read and the tables appended at the end, so the trajectory
+   is read only once. A warning is given if any coordinates had to be
+   rounded.
+
+   With in->skipBad, frames whose atom count doesn't match the first
+   frame, and those ReadTrajFrame() finds bad, are left out with a
+   warning rather than stopping the conversion.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Leaves out bad frames with in->skipBad
+-  14.10.26 Fails at a bad frame
+-  14.10.26 Sizes the frames for the encoding
+*/
+BOOL ConvertTraj(TRAJ *in, char *outFile, int encoding)
+{
+   char       header[MAXBUFF],
+              *strings    = NULL;
+   COORDS     *frame      = NULL;
+   FRAMEINDEX *frames     = NULL,   /* Used as lists of the frame and   */
+              *headers    = NULL;   /* header offsets                   */
+   FILE       *fp;
+   void       *buffer     = NULL;
+   uint64_t   tables[4],
+              value;
+   size_t     stringSize  = 0,
+              maxStrings  = 0,
+              frameSize   = 0;
+   ULONG      nAtoms      = 0,
+              nRounded    = 0,
+              i;
+   BOOL       ok          = TRUE;
+
+   if((fp = fopen(outFile, "wb"))==NULL)
+      return(FALSE);
+
+   if(((frame  = AllocCoords(MINATOMS))==NULL) ||
+      ((frames = AllocFrameIndex())==NULL) ||
+      ((headers = AllocFrameIndex())==NULL))
+   {
+      Msg(MSG_NOMEM, "");
+      ok = FALSE;
+   }
+
+   /* The header is written again once the tables are known            */
+   memset(tables, 0, sizeof(tables));
+   if(ok)
+      ok = WriteFcbHeader(fp, encoding, 0, 0, tables);
+
+   RewindTraj(in);
+   while(ok && ReadTrajFrame(in, header, frame))
+   {
+      size_t len = strlen(header) + 1;
+
+      if(frames->nFrames == 0)
+      {
+         nAtoms    = frame->nAtoms;
+         frameSize = 3 * nAtoms * FCB_VALUESIZE(encoding);
+         if((buffer = CountedMalloc(frameSize))==NULL)
+         {
+            Msg(MSG_NOMEM, "");
+            ok = FALSE;
+            break;
+         }
+      }
+      else if(frame->nAtoms != nAtoms)
+      {
+         MsgBadFrame(in, in->frameNum-1, header, in->skipBad);
+         if(in->skipBad)
+            continue;
+         ok = FALSE;
+         break;
+      }
+
+      if(!EncodeFcbFrame(frame, encoding, buffer, &nRounded))
+      {
+         Msg("Coordinates too large for fixed point (use --float)\n  \
+Frame Header: ", header);
+         ok = FALSE;
+         break;
+      }
+
+      /* Record the frame offset and the header                        */
+      if(stringSize + len > maxStrings)
+      {
+         char *newStrings;
+         maxStrings = 2 * (stringSize + len) + MAXBUFF;
+         if((newStrings = (char *)CountedRealloc(strings,
+                                                 maxStrings))==NULL)
+         {
+            Msg(MSG_NOMEM, "");
+            ok = FALSE;
+            break;
+         }
+         strings = newStrings;
+      }
+      if(!AddIndexFrame(frames, ftello(fp)) ||
+         !AddIndexFrame(headers, (off_t)stringSize))
+      {
+         Msg(MSG_NOMEM, "");
+         ok = FALSE;
+         break;
+      }
+      memcpy(strings + stringSize, header, len);
+      stringSize += len;
+
+      ok = (fwrite(buffer, 1, frameSize, fp) == frameSize);
+   }
+   if(in->badFrame != FRAME_OK)
+      ok = FALSE;
+
+   if(ok && (frames->nFrames == 0))
+   {
+      Msg("No frames in trajectory", "");
+      ok = FALSE;
+   }
+
+   /* The tables                                                       */
+   if(ok)
+   {
+      tables[0] = (uint64_t)ftello(fp);
+      for(i=0; ok && (i<frames->nFrames); i++)
+      {
+         value = (uint64_t)frames->offset[i];
+         ok    = (fwrite(&value, sizeof(uint64_t), 1, fp) == 1);
+      }
+      tables[1] = (uint64_t)ftello(fp);
+      for(i=0; ok && (i<frames->nFrames); i++)
+      {
+         value = (uint64_t)headers->offset[i];
+         ok    = (fwrite(&value, sizeof(uint64_t), 1, fp) == 1);
+      }
+      tables[2] = (uint64_t)ftello(fp);
+      tables[3] = (uint64_t)stringSize;
+      ok = ok && (fwrite(strings, 1, stringSize, fp) == stringSize);
+   }
+
+   if(ok)
+   {
+      rewind(fp);
+      ok = WriteFcbHeader(fp, encoding, nAtoms, frames->nFrames, tables);
+   }
+
+   if(fclose(fp) != 0)
+      ok = FALSE;
+   if(!ok)
+      remove(outFile);
+   else if(nRounded)
+      fprintf(stderr, "%s warning: %lu coordinates could not be stored \
+exactly\n", PROGNAME, nRounded);
+
+   free(buffer);
+   free(strings);
+   FreeCoords(frame);
+   FreeFrameIndex(frames);
+   FreeFrameIndex(headers);
+
+   return(ok);
+}
@@ -0,0 +1,475 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       fit.c
+
+   Version:    V1.29
+   Date:       14.10.26
+   Function:   Fitted RMSDs and mean structure refinement for flexcalc
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   With --fit, each RMSD is calculated after optimally superposing the
+   two frames so that rigid-body motion of the whole molecule doesn't
+   count as flexibility.
+
+   The superposition uses the quaternion characteristic polynomial
+   (QCP) method of Theobald (Acta Cryst. A61:478, 2005) with the
+   rotation recovered as in Liu, Agrafiotis & Theobald (J. Comput.
+   Chem. 31:1561, 2010). Everything needed comes from a single sweep
+   over the atoms by the innerProduct kernel, which gathers the
+   coordinate sums and 3x3 inner-product matrix of the uncentred
+   frames; these are then centred algebraically. The largest
+   eigenvalue of the 4x4 key matrix is found by Newton-Raphson on its
+   characteristic polynomial starting from the upper bound E0, usually
+   in a handful of steps, and gives the RMSD directly. No SVD or
+   eigenvector is needed unless the frame is to be moved.
+
+   The mean of unfitted frames is smeared by the motion being removed,
+   so RefineMeanCoords() fits every frame to the mean and recomputes
+   it until it stops changing.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.12  14.10.26 Original
+   V1.17  14.10.26 The last refinement cycle gathers the RMSFs
+   V1.23  14.10.26 Checks that the new mean's sums could be allocated
+   V1.25  14.10.26 gFit is replaced by the TRAJ's fit option. Uses the
+                   frames' kernels
+   V1.26  14.10.26 REFINETOL moved to flexcalc.h for the MPI build
+   V1.29  14.10.26 Bad frames are reported with their byte offsets
+
+*************************************************************************/
+/* Includes
+*/
+#include "flexcalc.h"
+
+/***********************************************************************/
+/* Defines and macros
+ */
+#define EVALPREC  1.0e-11 /* Relative precision of the eigenvalue       */
+#define EVECPREC  1.0e-6  /* Smallest usable quaternion (squared)       */
+#define MAXNEWTON 50      /* Newton-Raphson iterations                  */
+
+/***********************************************************************/
+/* Prototypes
+ */
+static BOOL CentredInnerProduct(COORDS *frame1, COORDS *frame2,
+                                REAL *S, REAL *centre1, REAL *centre2,
+                                REAL *E0);
+static REAL MaxEigenvalue(REAL *S, REAL E0);
+static void QCPRotation(REAL *S, REAL lambda, REAL *rot);
+
+
+/***********************************************************************/
+/*>static BOOL CentredInnerProduct(COORDS *frame1, COORDS *frame2,
+                                   REAL *S, REAL *centre1,
+                                   REAL *centre2, REAL *E0)
+   ---------------------------------------------------------------
+*//**
+   \param[in]  *frame1         a frame
+   \param[in]  *frame2         a frame
+   \param[out] *S              the 3x3 inner-product matrix of the
+                               centred frames (Sxx, Sxy, Sxz, Syx ...)
+   \param[out] *centre1        the centroid of frame1
+   \param[out] *centre2        the centroid of frame2
+   \param[out] *E0             half the sum of the squared distances
+                               of both frames' atoms from their
+                               centroids
+   \return                     FALSE if the number of atoms doesn't
+                               match
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Uses frame2's kernels
+*/
+static BOOL CentredInnerProduct(COORDS *frame1, COORDS *frame2,
+                                REAL *S, REAL *centre1, REAL *centre2,
+                                REAL *E0)
+{
+   REAL  sums[NINNERSUMS];
+   ULONG nCoor;
+   int   i, j;
+
+   if(((nCoor = frame1->nAtoms) != frame2->nAtoms) || (nCoor == 0))
+      return(FALSE);
+
+   for(i=0; i<NINNERSUMS; i++)
+      sums[i] = 0.0;
+   frame2->kernels->innerProduct(frame1->x, frame1->y, frame1->z,
+                                 frame2->x, frame2->y, frame2->z, nCoor,
+                                 sums);
+
+   for(i=0; i<3; i++)
+   {
+      centre1[i] = sums[i]   / nCoor;
+      centre2[i] = sums[i+3] / nCoor;
+   }
+
+   *E0 = 0.5 * (sums[6] - nCoor * (centre1[0]*centre1[0] +
+                                   centre1[1]*centre1[1] +
+                                   centre1[2]*centre1[2] +
+                                   centre2[0]*centre2[0] +
+                                   centre2[1]*centre2[1] +
+                                   centre2[2]*centre2[2]));
+   for(i=0; i<3; i++)
+   {
+      for(j=0; j<3; j++)
+         S[3*i+j] = sums[7+3*i+j] - nCoor * centre1[i] * centre2[j];
+   }
+
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>static REAL MaxEigenvalue(REAL *S, REAL E0)
+   -------------------------------------------
+*//**
+   \param[in]  *S              the centred inner-product matrix
+   \param[in]  E0              from CentredInnerProduct()
+   \return                     the largest eigenvalue of the key
+                               matrix
+
+   Newton-Raphson on the characteristic polynomial of the 4x4 key
+   matrix, starting from E0 which is an upper bound
+
+-  14.10.26 Original   By: ACRM
+*/
+static REAL MaxEigenvalue(REAL *S, REAL E0)
+{
+   REAL Sxx = S[0], Sxy = S[1], Sxz = S[2],
+        Syx = S[3], Syy = S[4], Syz = S[5],
+        Szx = S[6], Szy = S[7], Szz = S[8],
+        Sxx2 = Sxx*Sxx, Syy2 = Syy*Syy, Szz2 = Szz*Szz,
+        Sxy2 = Sxy*Sxy, Syz2 = Syz*Syz, Sxz2 = Sxz*Sxz,
+        Syx2 = Syx*Syx, Szy2 = Szy*Szy, Szx2 = Szx*Szx,
+        SyzSzymSyySzz2       = 2.0*(Syz*Szy - Syy*Szz),
+        Sxx2Syy2Szz2Syz2Szy2 = Syy2 + Szz2 - Sxx2 + Syz2 + Szy2,
+        Sxy2Sxz2Syx2Szx2     = Sxy2 + Sxz2 - Syx2 - Szx2,
+        SxzpSzx = Sxz + Szx, SyzpSzy = Syz + Szy, SxypSyx = Sxy + Syx,
+        SyzmSzy = Syz - Szy, SxzmSzx = Sxz - Szx, SxymSyx = Sxy - Syx,
+        SxxpSyy = Sxx + Syy, SxxmSyy = Sxx - Syy,
+        C0, C1, C2,
+        lambda = E0;
+   int  i;
+
+   C2 = -2.0 * (Sxx2 + Syy2 + Szz2 + Sxy2 + Syx2 + Sxz2 + Szx2 +
+                Syz2 + Szy2);
+   C1 =  8.0 * (Sxx*Syz*Szy + Syy*Szx*Sxz + Szz*Sxy*Syx -
+                Sxx*Syy*Szz - Syz*Szx*Sxy - Szy*Syx*Sxz);
+   C0 = Sxy2Sxz2Syx2Szx2 * Sxy2Sxz2Syx2Szx2 +
+        (Sxx2Syy2Szz2Syz2Szy2 + SyzSzymSyySzz2) *
+        (Sxx2Syy2Szz2Syz2Szy2 - SyzSzymSyySzz2) +
+        (-SxzpSzx*SyzmSzy + SxymSyx*(SxxmSyy - Szz)) *
+        (-SxzmSzx*SyzpSzy + SxymSyx*(SxxmSyy + Szz)) +
+        (-SxzpSzx*SyzpSzy - SxypSyx*(SxxpSyy - Szz)) *
+        (-SxzmSzx*SyzmSzy - SxypSyx*(SxxpSyy + Szz)) +
+        ( SxypSyx*SyzpSzy + SxzpSzx*(SxxmSyy + Szz)) *
+        (-SxymSyx*SyzmSzy + SxzpSzx*(SxxpSyy + Szz)) +
+        ( SxypSyx*SyzmSzy + SxzmSzx*(SxxmSyy - Szz)) *
+        (-SxymSyx*SyzpSzy + SxzmSzx*(SxxpSyy - Szz));
+
+   for(i=0; i<MAXNEWTON; i++)
+   {
+      REAL old = lambda,
+           x2  = lambda * lambda,
+           b   = (x2 + C2) * lambda,
+           a   = b + C1,
+           d   = 2.0*x2*lambda + b + a;
+
+      if(d == 0.0)
+         break;
+      lambda -= (a*lambda + C0) / d;
+      if(fabs(lambda - old) < fabs(EVALPREC * lambda))
+         break;
+   }
+
+   return(lambda);
+}
+
+
+/***********************************************************************/
+/*>static void QCPRotation(REAL *S, REAL lambda, REAL *rot)
+   --------------------------------------------------------
+*//**
+   \param[in]  *S              the centred inner-product matrix
+   \param[in]  lambda          the largest eigenvalue of the key matrix
+   \param[out] *rot            3x3 rotation matrix (row major) which
+                               superposes the second frame onto the
+                               first
+
+   The quaternion is the eigenvector for lambda, taken from a column of
+   the adjoint of (K - lambda I). If that column is degenerate the
+   others are tried in turn and, if all are, no rotation is needed.
+
+-  14.10.26 Original   By: ACRM
+*/
+static void QCPRotation(REAL *S, REAL lambda, REAL *rot)
+{
+   REAL Sxx = S[0], Sxy = S[1], Sxz = S[2],
+        Syx = S[3], Syy = S[4], Syz = S[5],
+        Szx = S[6], Szy = S[7], Szz = S[8],
+        a11 = Sxx + Syy + Szz - lambda, a12 = Syz - Szy,
+        a13 = Szx - Sxz,                a14 = Sxy - Syx,
+        a21 = Syz - Szy,                a22 = Sxx - Syy - Szz - lambda,
+        a23 = Sxy + Syx,                a24 = Sxz + Szx,
+        a31 = a13, a32 = a23,           a33 = Syy - Sxx - Szz - lambda,
+        a34 = Syz + Szy,
+        a41 = a14, a42 = a24, a43 = a34,
+        a44 = Szz - Sxx - Syy - lambda,
+        a3344_4334 = a33*a44 - a43*a34, a3244_4234 = a32*a44 - a42*a34,
+        a3243_4233 = a32*a43 - a42*a33, a3143_4133 = a31*a43 - a41*a33,
+        a3144_4134 = a31*a44 - a41*a34, a3142_4132 = a31*a42 - a41*a32,
+        a1324_1423 = a13*a24 - a14*a23, a1224_1422 = a12*a24 - a14*a22,
+        a1223_1322 = a12*a23 - a13*a22, a1124_1421 = a11*a24 - a14*a21,
+        a1123_1321 = a11*a23 - a13*a21, a1122_1221 = a11*a22 - a12*a21,
+        q[4], qsqr, a2, x2, y2, z2, xy, az, zx, ay, yz, ax;
+   int  i;
+
+   q[0] =  a22*a3344_4334 - a23*a3244_4234 + a24*a3243_4233;
+   q[1] = -a21*a3344_4334 + a23*a3144_4134 - a24*a3143_4133;
+   q[2] =  a21*a3244_4234 - a22*a3144_4134 + a24*a3142_4132;
+   q[3] = -a21*a3243_4233 + a22*a3143_4133 - a23*a3142_4132;
+   qsqr = q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3];
+
+   if(qsqr < EVECPREC)
+   {
+      q[0] = -a12*a3344_4334 + a13*a3244_4234 - a14*a3243_4233;
+      q[1] =  a11*a3344_4334 - a13*a3144_4134 + a14*a3143_4133;
+      q[2] = -a11*a3244_4234 + a12*a3144_4134 - a14*a3142_4132;
+      q[3] =  a11*a3243_4233 - a12*a3143_4133 + a13*a3142_4132;
+      qsqr = q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3];
+   }
+   if(qsqr < EVECPREC)
+   {
+      q[0] =  a42*a1324_1423 - a43*a1224_1422 + a44*a1223_1322;
+      q[1] = -a41*a1324_1423 + a43*a1124_1421 - a44*a1123_1321;
+      q[2] =  a41*a1224_1422 - a42*a1124_1421 + a44*a1122_1221;
+      q[3] = -a41*a1223_1322 + a42*a1123_1321 - a43*a1122_1221;
+      qsqr = q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3];
+   }
+   if(qsqr < EVECPREC)
+   {
+      q[0] = -a32*a1324_1423 + a33*a1224_1422 - a34*a1223_1322;
+      q[1] =  a31*a1324_1423 - a33*a1124_1421 + a34*a1123_1321;
+      q[2] = -a31*a1224_1422 + a32*a1124_1421 - a34*a1122_1221;
+      q[3] =  a31*a1223_1322 - a32*a1123_1321 + a33*a1122_1221;
+      qsqr = q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3];
+   }
+   if(qsqr < EVECPREC)
+   {
+      for(i=0; i<9; i++)
+         rot[i] = ((i % 4) == 0) ? 1.0 : 0.0;
+      return;
+   }
+
+   qsqr = sqrt(qsqr);
+   for(i=0; i<4; i++)
+      q[i] /= qsqr;
+
+   a2 = q[0]*q[0]; x2 = q[1]*q[1]; y2 = q[2]*q[2]; z2 = q[3]*q[3];
+   xy = q[1]*q[2]; az = q[0]*q[3]; zx = q[3]*q[1];
+   ay = q[0]*q[2]; yz = q[2]*q[3]; ax = q[0]*q[1];
+
+   rot[0] = a2 + x2 - y2 - z2;
+   rot[1] = 2.0 * (xy + az);
+   rot[2] = 2.0 * (zx - ay);
+   rot[3] = 2.0 * (xy - az);
+   rot[4] = a2 - x2 + y2 - z2;
+   rot[5] = 2.0 * (yz + ax);
+   rot[6] = 2.0 * (zx + ay);
+   rot[7] = 2.0 * (yz - ax);
+   rot[8] = a2 - x2 - y2 + z2;
+}
+
+
+/***********************************************************************/
+/*>REAL FitRMSFrame(COORDS *frame1, COORDS *frame2)
+   ------------------------------------------------
+*//**
+   \param[in]  *frame1         a frame
+   \param[in]  *frame2         a frame
+   \return                     the RMSD after optimal superposition or
+                               -1.0 if the number of atoms does not
+                               match
+
+   Calculates the RMSD between two frames after superposing them. The
+   frames themselves are not moved.
+
+-  14.10.26 Original   By: ACRM
+*/
+REAL FitRMSFrame(COORDS *frame1, COORDS *frame2)
+{
+   REAL S[9], centre1[3], centre2[3], E0, lambda;
+
+   if(!CentredInnerProduct(frame1, frame2, S, centre1, centre2, &E0))
+      return(-1.0);
+
+   lambda = MaxEigenvalue(S, E0);
+   return(sqrt(fabs(2.0 * (E0 - lambda) / frame1->nAtoms)));
+}
+
+
+/***********************************************************************/
+/*>BOOL FitFrame(COORDS *reference, COORDS *frame)
+   -----------------------------------------------
+*//**
+   \param[in]     *reference   the frame to fit onto
+   \param[in,out] *frame       the frame to move
+   \return                     FALSE if the number of atoms does not
+                               match
+
+   Superposes frame onto reference, moving its coordinates in place
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL FitFrame(COORDS *reference, COORDS *frame)
+{
+   REAL  S[9], rot[9], centre1[3], centre2[3], E0;
+   ULONG i;
+
+   if(!CentredInnerProduct(reference, frame, S, centre1, centre2, &E0))
+      return(FALSE);
+
+   QCPRotation(S, MaxEigenvalue(S, E0), rot);
+
+   for(i=0; i<frame->nAtoms; i++)
+   {
+      REAL x = frame->x[i] - centre2[0],
+           y = frame->y[i] - centre2[1],
+           z = frame->z[i] - centre2[2];
+
+      frame->x[i] = rot[0]*x + rot[1]*y + rot[2]*z + centre1[0];
+      frame->y[i] = rot[3]*x + rot[4]*y + rot[5]*z + centre1[1];
+      frame->z[i] = rot[6]*x + rot[7]*y + rot[8]*z + centre1[2];
+   }
+
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>COORDS *RefineMeanCoords(TRAJ *in, COORDS *meanFrame, int maxCycles,
+                            int *nCycles)
+   --------------------------------------------------------------------
+*//**
+   \param[in]  *in             the trajectory
+   \param[in]  *meanFrame      the starting mean coordinates. This is
+                               freed, or returned if no cycles are run
+   \param[in]  maxCycles       the maximum number of refinement cycles
+   \param[out] *nCycles        the number of cycles run
+   \return                     the refined mean coordinates (NULL on
+                               error)
+
+   Each cycle is a pass of the trajectory which superposes every frame
+   onto the current mean and calculates a new (running) mean from the
+   fitted frames. This stops when the new mean is within REFINETOL of
+   the old one or after maxCycles cycles.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Zeroes the new mean before each cycle
+-  14.10.26 Gathers the squares of the fitted frames for the RMSFs
+-  14.10.26 Checks ZeroCoords()
+-  14.10.26 Reports a bad frame with MsgBadFrame()
+-  14.10.26 Gathers the squares in the TRAJ's RMSFs. Uses the frames'
+            kernels
+-  14.10.26 Fails at a bad frame
+*/
+COORDS *RefineMeanCoords(TRAJ *in, COORDS *meanFrame, int maxCycles,
+                         int *nCycles)
+{
+   COORDS *frame   = NULL,
+          *newMean = NULL;
+   char   header[MAXBUFF];
+
+   *nCycles = 0;
+   if(maxCycles < 1)
+      return(meanFrame);
+
+   if(((frame   = AllocCoords(meanFrame->nAtoms))==NULL) ||
+      ((newMean = AllocCoords(meanFrame->nAtoms))==NULL))
+   {
+      Msg(MSG_NOMEM, "");
+      FreeCoords(frame);
+      FreeCoords(meanFrame);
+      return(NULL);
+   }
+
+   while(*nCycles < maxCycles)
+   {
+      COORDS *swap;
+      ULONG  frameCount = 0;
+      REAL   change;
+
+      /* The running mean starts from zero, not the previous cycle's
+         mean, as large or non-finite leftovers would not cancel
+      */
+      (*nCycles)++;
+      if(!ZeroCoords(newMean, meanFrame->nAtoms))
+      {
+         Msg(MSG_NOMEM, "");
+         FreeCoords(frame);
+         FreeCoords(newMean);
+         FreeCoords(meanFrame);
+         return(NULL);
+      }
+      if(in->rmsf != NULL)
+         ResetRMSF(in->rmsf);
+      RewindTraj(in);
+      while(ReadTrajFrame(in, header, frame))
+      {
+         if(!FitFrame(meanFrame, frame) ||
+            !UpdateRunningMean(newMean, frame, ++frameCount) ||
+            ((in->rmsf != NULL) && !AddSquares(in->rmsf, frame)))
+         {
+            MsgBadFrame(in, in->frameNum-1, header, FALSE);
+            FreeCoords(frame);
+            FreeCoords(newMean);
+            FreeCoords(meanFrame);
+            return(NULL);
+         }
+      }
+      if(in->badFrame != FRAME_OK)
+      {
+         FreeCoords(frame);
+         FreeCoords(newMean);
+         FreeCoords(meanFrame);
+         return(NULL);
+      }
+
+      /* The fitted frames follow the old mean's orientation, so the
+         two means can be compared directly
+      */
+      change = sqrt(frame->kernels->sumSqDist(meanFrame->x, meanFrame->y,
+                                              meanFrame->z, newMean->x,
+                                              newMean->y, newMean->z,
+                                              newMean->nAtoms) /
+                    newMean->nAtoms);
+      swap      = meanFrame;
+      meanFrame = newMean;
+      newMean   = swap;
+
+      if(change < REFINETOL)
+         break;
+   }
+
+   FreeCoords(frame);
+   FreeCoords(newMean);
+
+#ifdef DEBUG
+   PrintFrame("refined average", meanFrame);
+#endif
+   return(meanFrame);
+}
@@ -3,8 +3,8 @@
    Program:    flexcalc
    File:       flexcalc.c
    
-   Version:    V1.0
-   Date:       24.11.25
+   Version:    V1.30
+   Date:       14.10.26
    Function:   Calculate a flexibility score from an MD trajectory
    
    Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
@@ -43,62 +43,181 @@
       frame closest to the average
    5. Calculate and display the average of the RMSDs
 
+   With -p 3 (--passes 3) the first two passes are merged by calculating
+   a running (Welford) mean so the number of frames need not be known
+   in advance. With -p 2 the search for the frame closest to the mean is
+   also folded into that pass by keeping a small set of candidate frames
+   that were closest to the running mean when they were read; these are
+   re-scored against the final mean at the end. Bounds kept for the
+   other frames show whether one of them could be closer, in which case
+   those that might be are read again (through the index with -i), so
+   the result is the same as with more passes.
+
+   With --fit every RMSD is calculated after superposing the two
+   frames (fit.c) and the mean is refined by fitting each frame to it
+   and recalculating it, which takes one more pass per cycle.
+
 **************************************************************************
 
    Usage:
    ======
-   flexcalc in.pdb
+   flexcalc [-p 2|3|4] [-m] [-i] [-t nthreads] [-k kernel] [--gpu]
+            [--timing]
+            [--stats] [--stats-json file] [--fit] [--refine n]
+            [--atoms list | --atoms-file file] [--start n] [--stop n]
+            [--stride n] [--series file | --series-binary file]
+            [--rmsf file] [--checkpoint file] [--list file]
+            [--pairwise file | --pairwise-triangle file |
+             --pairwise-sparse file --cutoff r] [--skip-bad]
+            [--sample n [--seed n]]
+            trajectory ...
+   flexcalc convert [-m] [-f] [--atoms list | --atoms-file file]
+            [--start n] [--stop n] [--stride n] [--skip-bad]
+            trajectory binarytrajectory
 
 **************************************************************************
 
    Revision History:
    =================
    V1.0   24.11.25 Original
+   V1.1   14.10.26 Added -p / --passes to select a lower-I/O engine
+   V1.2   14.10.26 Frames are now held as flat x[], y[], z[] arrays in
+                   a COORDS structure allocated once and reused for
+                   every frame rather than as a FRAME linked list
+   V1.3   14.10.26 Added -m / --mmap to read a memory-mapped file with
+                   a specialised number parser. Shared definitions
+                   moved to flexcalc.h
+   V1.4   14.10.26 Added -i / --index to build a frame index while
+                   counting, saved as a sidecar file and reused while
+                   the trajectory is unchanged
+   V1.5   14.10.26 Added -t to run the closest frame and RMSD passes
+                   in parallel (parallel.c). Options are now held in
+                   an OPTIONS structure
+   V1.6   14.10.26 With more than one thread, the mean is also
+                   calculated in parallel using Kahan summation
+   V1.7   14.10.26 Added -k / --kernel. The inner loops are now
+                   AVX2, AVX-512 or NEON kernels (kernels.c) chosen
+                   to suit the CPU
+   V1.8   14.10.26 Added 'flexcalc convert' to write a binary
+                   trajectory (fcbio.c) which can be read in place of
+                   the text file
+   V1.9   14.10.26 The trajectory may be "-" for standard input or a
+                   gzip or zstd compressed file. These are read once
+                   into a temporary binary trajectory
+   V1.10  14.10.26 Added --timing to report the time taken by each
+                   pass (used by t/bench.sh)
+   V1.11  14.10.26 Added --stats and --stats-json to report counters
+                   for each pass (stats.c)
+   V1.12  14.10.26 Added --fit and --refine for RMSDs after optimal
+                   superposition and a refined mean (fit.c)
+   V1.13  14.10.26 Added --atoms and --atoms-file to select the atoms
+                   used (select.c). Other atoms are never parsed
+   V1.14  14.10.26 Added --start, --stop and --stride to use a window
+                   of the frames. With an index, the other frames are
+                   seeked over
+   V1.15  14.10.26 Accepts several trajectories, or a --list of them,
+                   and processes them on a shared work-stealing pool
+                   of threads (pool.c), printing a result for each
+   V1.16  14.10.26 Added --series and --series-binary to write the RMSD
+                   of every frame during the last pass (series.c)
+   V1.17  14.10.26 Added --rmsf to write per-atom fluctuations gathered
+                   in the mean pass (rmsf.c)
+   V1.18  14.10.26 Added --checkpoint to keep the mean between runs so
+                   only frames appended since are read (checkpoint.c)
+   V1.19  14.10.26 -p 2 checks that its chosen frame is the closest
+                   and, if it can't be sure, re-checks the frames which
+                   might be closer
+   V1.20  14.10.26 ReadFrame() keeps its state in the TRAJ so any
+                   number of text trajectories can be read at once
+   V1.21  14.10.26 Added --prefetch
+   V1.22  14.10.26 -p 2 reuses the buffers of merged check blocks, so
+                   no pass allocates memory for each frame
+   V1.23  14.10.26 Coordinates are stored as COORD, which is float when
+                   built with -DSINGLE_COORDS. Means are accumulated
+                   with SUMX() etc. so they stay in REAL
+   V1.25  14.10.26 The passes are made by CalculateTrajFlexibility() so
+                   they can be run on a trajectory in memory by the
+                   library (library.c). main() is left out when built
+                   with -DFLEXCALC_LIBRARY. The fit option, RMSFs and
+                   series are held in the TRAJ rather than in globals
+   V1.27  14.10.26 Added --gpu to make the passes on a GPU (gpu.cu) in
+                   the GPU build (-DFLEXCALC_GPU)
+   V1.28  14.10.26 Added --pairwise, --pairwise-triangle and
+                   --pairwise-sparse to write the RMSDs between all
+                   pairs of frames (pairwise.c)
+   V1.29  14.10.26 Added --skip-bad to leave out frames that don't
+                   match. Bad frames are reported with their byte
+                   offsets. FindClosestToMean() reported the wrong
+                   header for a bad frame. Empty frames, headerless
+                   lines and unreadable selected lines are bad frames
+   V1.30  14.10.26 Added --sample and --seed to score a random sample
+                   of the frames with a bootstrap interval (sample.c)
 
 *************************************************************************/
 /* Includes
 */
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <math.h>
-#include "bioplib/macros.h"
-#include "bioplib/SysDefs.h"
-#include "bioplib/MathType.h"
+#include <ctype.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "flexcalc.h"
 
 /***********************************************************************/
 /* Defines and macros
  */
-#define MAXBUFF 512
-#define MAXFNM  1024
-#define PROGNAME "flexcalc"
-#define MSG_ATOMMISMATCH "Number of coordinates in frame doesn't match \
-first frame.\n  Frame Header: "
-#define MSG_NOMEM "No memory"
-typedef struct _frame
-{
-   REAL x, y, z;
-   struct _frame *next;
-}  FRAME;
+#define MAXCHECKBLOCKS 16     /* Reference means kept to check -p 2     */
+#define MINCHECKBLOCK  64     /* Initial frames for each reference      */
+#define BOUNDTOL       1.0e-9 /* Allowance for rounding in the bounds   */
 
+/* A trajectory in a batch run                                          */
+typedef struct
+{
+   char      *inFile;
+   OPTIONS   *options;
+   SELECTION *select;
+   off_t     size;           /* File size, to start the largest first   */
+   int       order;          /* Position on the command line or list    */
+   REAL      meanRMSD,
+             interval[2];    /* With --sample                           */
+   ULONG     nFrames;
+   BOOL      ok,
+             done;           /* Set once the result is ready            */
+}  BATCHJOB;
+
+/* Used to check the closest frame chosen from the -p 2 candidates. The
+   frames read are split into blocks of blockSize frames. Each block
+   has a reference, the running mean after its first frame, and lowest
+   is the lowest RMSD from it of the block's frames that were not kept
+   as candidates. When all the blocks are used, pairs are merged and
+   blockSize is doubled, so only MAXCHECKBLOCKS means are ever kept.
+   The references of merged blocks are kept after the blocks in use
+   and reused, so no more than MAXCHECKBLOCKS are ever allocated.
+*/
+typedef struct
+{
+   COORDS *reference[MAXCHECKBLOCKS];  /* NULL if not yet allocated    */
+   REAL   lowest[MAXCHECKBLOCKS];
+   ULONG  blockSize;
+   int    nBlocks;
+   BOOL   fit;               /* RMSDs after superposition              */
+}  CLOSESTCHECK;
 
 /***********************************************************************/
 /* Prototypes
  */
-BOOL  ParseCmdLine(int argc, char **argv, char *inFile);
-FRAME *CalculateMeanCoords(FILE *in, ULONG frameCount);
-FRAME *FindClosestToMean(FILE *in, FRAME *meanFrame, char *header);
-REAL  CalculateMeanRMSD(FILE *in, FRAME *closestFrame, ULONG frameCount);
-ULONG CountFrames(FILE *fp);
-FRAME *ReadFrame(FILE *in, char *header);
-REAL  RMSFrame(FRAME *frame1, FRAME *frame2);
-void  Usage(void);
-FRAME *CopyFrame(FRAME *frame);
-BOOL  AddFrame(FRAME *meanFrame, FRAME *frame, ULONG frameCount);
-void  Die(char *msg, char *submsg);
-void  Msg(char *msg, char *submsg);
-void  PrintFrame(char *header, FRAME *frame);
-
+static BOOL Fail(char *msg, char *submsg);
+static void BatchTask(void *arg);
+static int  CompareJobSize(const void *job1, const void *job2);
+static BOOL AddCheckFrame(CLOSESTCHECK *check, ULONG frameNum,
+                          COORDS *meanFrame);
+static void BoundCheckFrame(CLOSESTCHECK *check, ULONG frameNum,
+                            COORDS *frame);
+static BOOL CheckClosestFrame(TRAJ *in, CLOSESTCHECK *check,
+                              ULONG nFrames, COORDS *meanFrame,
+                              CANDIDATE *best);
+static void FreeClosestCheck(CLOSESTCHECK *check);
+
+
+#ifndef FLEXCALC_LIBRARY
 /***********************************************************************/
 /*>main(int argc, char **argv)
    ---------------------------
@@ -106,40 +225,193 @@ void  PrintFrame(char *header, FRAME *frame);
    Main program
 
 -  24.11.25 Original   By: ACRM
+-  14.10.26 Added nPasses to select the single-pass mean engine
+-  14.10.26 Reads through a TRAJ which may be memory mapped
+-  14.10.26 Added frame index
+-  14.10.26 Added threads and OPTIONS
+-  14.10.26 Added threaded mean
+-  14.10.26 Selects the kernels
+-  14.10.26 Added convert
+-  14.10.26 Added streamed input
+-  14.10.26 Added timing
+-  14.10.26 Added stats
+-  14.10.26 Added fitting and mean refinement
+-  14.10.26 Added atom selection
+-  14.10.26 Added frame window
+-  14.10.26 The calculation moved to CalculateFlexibility(). Added
+            batch runs
+-  14.10.26 Added RMSD series
+-  14.10.26 Added RMSFs
+-  14.10.26 Checks --gpu
+-  14.10.26 Added pairwise RMSDs
+-  14.10.26 Checks --skip-bad, which convert and pairwise RMSDs use
+-  14.10.26 Prints the interval with --sample
+-  14.10.26 The fit option, RMSFs and series are passed to the
+            calculation rather than set in globals
 */
 int main(int argc, char **argv)
 {
-   FILE *in;
-   char inFile[MAXFNM];
-   inFile[0] = '\0';
+   TRAJ      *in;
+   OPTIONS   options;
+   SELECTION *select = NULL;
+   RMSF      *rmsf   = NULL;
+   SERIES    *series = NULL;
+   REAL      meanRMSD,
+             interval[2];
+   ULONG     frameCount;
+   int       status;
+
+   StartStats();
    
-   if(ParseCmdLine(argc, argv, inFile))
+   if(ParseCmdLine(argc, argv, &options))
    {
-      if((in=fopen(inFile, "r"))!=NULL)
+      if(!SelectKernels(options.kernel))
+         Die("Kernel not available on this CPU: ", options.kernel);
+      gPrefetch = options.prefetch;
+      if((options.atoms[0] != '\0') || (options.atomsFile[0] != '\0'))
+         select = GetSelection(&options);
+
+#ifndef FLEXCALC_GPU
+      if(options.gpu)
+         Die("--gpu needs the GPU build (make gpu)", "");
+#endif
+      if(options.gpu && (options.fit || options.nThreads))
+         Die("--gpu can't be used with --fit or -t", "");
+      if(options.skipBad && (options.checkpointFile[0] != '\0'))
+         Die("--skip-bad can't be used with --checkpoint", "");
+      if(options.nSample && (options.convert || options.gpu ||
+                             (options.pairwiseFile[0] != '\0') ||
+                             (options.checkpointFile[0] != '\0')))
+         Die("--sample can't be used with convert, --pairwise, \
+--checkpoint or --gpu", "");
+
+      if(options.convert)
       {
-         char  header[MAXBUFF];
-         FRAME *meanFrame = NULL,
-               *closestFrame = NULL;
-         REAL  meanRMSD;
-         ULONG frameCount = 0;
-         if((frameCount   = CountFrames(in)) < 1)
-            Die("No frames in trajectory", "");
-
-         if((meanFrame    = CalculateMeanCoords(in, frameCount))==NULL)
-            Die("Unable to calculate mean coordinates", "");
+         BOOL ok;
+
+         if((in=(IsStreamTraj(options.inFile) ?
+                 OpenStreamTraj(options.inFile) :
+                 OpenTraj(options.inFile, options.useMmap)))==NULL)
+            Die("Unable to open trajectory: ", options.inFile);
+         in->select  = select;
+         in->skipBad = options.skipBad;
+         SetWindow(in, &options);
+         ok = ConvertTraj(in, options.outFile,
+                          (options.useFloat ? FCB_FLOAT32 : FCB_INT32));
+         if(in->stream && !FinishStream(in))
+         {
+            remove(options.outFile);
+            Die("Error reading trajectory: ", options.inFile);
+         }
+         if(!ok)
+            Die("Unable to write binary trajectory: ", options.outFile);
+         CloseTraj(in);
+         FreeSelection(select);
+         return(0);
+      }
 
-         if((closestFrame = FindClosestToMean(in, meanFrame,
-                                              header))==NULL)
-            Die("Couldn't find closest frame", header);
+      if(options.pairwiseFile[0] != '\0')
+      {
+         BOOL ok;
+
+         if(options.batch)
+            Die("Pairwise RMSDs can only be written for one trajectory",
+                "");
+         if((options.seriesFile[0] != '\0') ||
+            (options.rmsfFile[0] != '\0') ||
+            (options.checkpointFile[0] != '\0') ||
+            (options.statsFile[0] != '\0') || options.gpu)
+            Die("--pairwise can't be used with --series, --rmsf, \
+--checkpoint, --stats-json or --gpu", "");
+         if((options.pairwiseForm == PAIR_SPARSE) &&
+            (options.cutoff < 0.0))
+            Die("--pairwise-sparse needs a --cutoff", "");
+
+         if((in=(IsStreamTraj(options.inFile) ?
+                 OpenStreamTraj(options.inFile) :
+                 OpenTraj(options.inFile, options.useMmap)))==NULL)
+            Die("Unable to open trajectory: ", options.inFile);
+         in->select  = select;
+         in->skipBad = options.skipBad;
+         in->fit     = options.fit;
+         SetWindow(in, &options);
+         ok = WritePairwise(in, &options, &frameCount);
+         if(in->stream && !FinishStream(in))
+         {
+            remove(options.pairwiseFile);
+            Die("Error reading trajectory: ", options.inFile);
+         }
+         if(!ok)
+         {
+            remove(options.pairwiseFile);
+            Die("Unable to write pairwise RMSDs: ", options.pairwiseFile);
+         }
+         CloseTraj(in);
+         FreeSelection(select);
+
+         if(options.timing)
+            PrintTiming(stderr, frameCount);
+         if(options.stats)
+            PrintStats(stderr);
+         return(0);
+      }
 
-         if((meanRMSD     = CalculateMeanRMSD(in, closestFrame,
-                                              frameCount)) < 0.0)
-            Die("Unable to calculate mean RMSD", "");
-         
-         fclose(in); 
+      if(options.batch)
+      {
+         if(options.seriesFile[0] != '\0')
+            Die("An RMSD series can only be written for one trajectory",
+                "");
+         if(options.rmsfFile[0] != '\0')
+            Die("RMSFs can only be written for one trajectory", "");
+         if(options.checkpointFile[0] != '\0')
+            Die("A checkpoint can only be kept for one trajectory", "");
+         GetFileList(&options);
+         status = RunBatch(&options, select);
+         FreeSelection(select);
+         return(status);
+      }
 
-         printf("%.4f\n", meanRMSD);
+      if((options.checkpointFile[0] != '\0') &&
+         ((options.start != 1) || (options.stop != 0) ||
+          (options.stride != 1)))
+         Die("--checkpoint can't be used with --start, --stop or --stride",
+             "");
+      if((options.rmsfFile[0] != '\0') && ((rmsf = AllocRMSF())==NULL))
+         Die(MSG_NOMEM, "");
+      if((options.seriesFile[0] != '\0') &&
+         ((series = OpenSeries(options.seriesFile,
+                               options.seriesBinary))==NULL))
+         Die("Unable to write RMSD series: ", options.seriesFile);
+
+      if(!CalculateFlexibility(options.inFile, &options, select, rmsf,
+                               series, TRUE, &meanRMSD, interval,
+                               &frameCount))
+      {
+         if(series != NULL)
+         {
+            CloseSeries(series);
+            remove(options.seriesFile);
+         }
+         exit(1);
       }
+      if(!CloseSeries(series))
+         Die("Unable to write RMSD series: ", options.seriesFile);
+
+      if(options.timing)
+         PrintTiming(stderr, frameCount);
+      if(options.stats)
+         PrintStats(stderr);
+      if((options.statsFile[0] != '\0') &&
+         !WriteStatsJSON(options.statsFile, &options, frameCount,
+                         meanRMSD))
+         Msg("Unable to write statistics: ", options.statsFile);
+      FreeSelection(select);
+      FreeRMSF(rmsf);
+
+      if(options.nSample)
+         printf("%.4f %.4f %.4f\n", meanRMSD, interval[0], interval[1]);
+      else
+         printf("%.4f\n", meanRMSD);
    }
    else
    {
@@ -148,452 +420,2240 @@ int main(int argc, char **argv)
 
    return(0);
 }
+#endif
 
 
 /***********************************************************************/
-/*>void Die(char *msg, char *submsg)
-   ---------------------------------
+/*>static BOOL Fail(char *msg, char *submsg)
+   -----------------------------------------
 *//**
    \param[in]  *msg            Main messsage
    \param[in]  *submsg         Submessage
+   \return                     FALSE
 
-   Prints an error message and exits
+   Prints an error message for a trajectory which can't be processed
 
--  24.11.25 Original   By: ACRM
+-  14.10.26 Original   By: ACRM
 */
-void Die(char *msg, char *submsg)
+static BOOL Fail(char *msg, char *submsg)
 {
    Msg(msg, submsg);
-   exit(1);
-}
-
-/***********************************************************************/
-/*>void Msg(char *msg, char *submsg)
-   ---------------------------------
-*//**
-   \param[in]  *msg            Main messsage
-   \param[in]  *submsg         Submessage
-
-   Prints an error message
-
--  25.11.25 Original   By: ACRM
-*/
-void Msg(char *msg, char *submsg)
-{
-   fprintf(stderr, "%s error: %s%s\n", PROGNAME, msg, submsg);
+   return(FALSE);
 }
 
 
 /***********************************************************************/
-/*>REAL CalculateMeanRMSD(FILE *in, FRAME *closestFrame,
-                          ULONG frameCount)
-   -----------------------------------------------------
+/*>BOOL CalculateFlexibility(char *inFile, OPTIONS *options,
+                             SELECTION *select, RMSF *rmsf,
+                             SERIES *series, BOOL passStats,
+                             REAL *meanRMSD, REAL *interval,
+                             ULONG *nFrames)
+   ---------------------------------------------------------------
 *//**
-   \param[in]  *in             file pointer to trajectory
-   \param[in]  *closestFrame   The frame closest to the mean coordinates
-   \param[in]  frameCount      The number of frames
-   \return                     The mean RMSD
-
-   Reads through the frames and calculate an RMSD for each to the frame
-   closest to the mean coordinates. Returns the average of these RMSD
-   values.
-
--  24.11.25 Original   By: ACRM
+   \param[in]  *inFile         the trajectory
+   \param[in]  *options        the options for the run
+   \param[in]  *select         atoms to use (NULL for all)
+   \param[in]  *rmsf           gathers the RMSFs (NULL for none)
+   \param[in]  *series         writes the RMSD series (NULL for none)
+   \param[in]  passStats       record each pass in the statistics
+   \param[out] *meanRMSD       the mean RMSD from the frame closest to
+                               the mean
+   \param[out] *interval       its bootstrap interval with --sample
+                               (otherwise -1.0)
+   \param[out] *nFrames        the number of frames used
+   \return                     FALSE (with a message) if the trajectory
+                               couldn't be processed
+
+   Opens one trajectory and makes the passes through it with
+   CalculateTrajFlexibility(). In a batch run this is called from
+   several threads at once, so passStats must be FALSE.
+
+-  14.10.26 Original - split out of main()   By: ACRM
+-  14.10.26 Writes the RMSFs
+-  14.10.26 Uses a --checkpoint
+-  14.10.26 -p 2 keeps no candidates when the mean is refined
+-  14.10.26 Streams are no longer spilled one at a time
+-  14.10.26 The passes moved to CalculateTrajFlexibility()
+-  14.10.26 A stream leaves out bad frames as it is spilled with
+            --skip-bad
+-  14.10.26 Added interval
+-  14.10.26 Added rmsf and series. Sets the fit option in the TRAJ
+-  14.10.26 A stream is spilled with just the selected atoms
 */
-REAL CalculateMeanRMSD(FILE *in, FRAME *closestFrame, ULONG frameCount)
+BOOL CalculateFlexibility(char *inFile, OPTIONS *options,
+                          SELECTION *select, RMSF *rmsf,
+                          SERIES *series, BOOL passStats,
+                          REAL *meanRMSD, REAL *interval,
+                          ULONG *nFrames)
 {
-   REAL meanRMSD = 0.0;
-   FRAME *frame = NULL;
-   char  header[MAXBUFF];
+   TRAJ       *in;
+   FLEXRESULT result;
+   BOOL       ok;
 
-   /* Reset the frame reading                                           */
-   ReadFrame(NULL, NULL);
+   *meanRMSD   = -1.0;
+   interval[0] = interval[1] = -1.0;
+   *nFrames    = 0;
 
-   /* Read frames, one at a time                                        */
-   while((frame = ReadFrame(in, header))!=NULL)
+   /* A stream is read once into a temporary binary trajectory, which
+      holds only the selected atoms
+   */
+   if(IsStreamTraj(inFile))
    {
-      REAL rmsd;
-      /* Add the RMSD of this frame to the closest-to-mean frame and
-         the free this frame
-      */
-      if((rmsd = RMSFrame(closestFrame, frame)) < 0.0)
-      {
-         Msg(MSG_ATOMMISMATCH, header);
-         return(-1.0);
-      }
-
-#ifdef DEBUG
-      PrintFrame(header, frame);
-#endif
-      
-      meanRMSD += rmsd;
-      FREELIST(frame, FRAME);
+      if((in = SpillTraj(inFile, select, options->skipBad)) == NULL)
+         return(Fail("Unable to read trajectory: ", inFile));
    }
-
-   /* Divide by number of frames                                        */
-   meanRMSD /= frameCount;
-   rewind(in);
-   return(meanRMSD);
+   else if((in=OpenTraj(inFile, options->useMmap))==NULL)
+   {
+      return(Fail("Unable to open trajectory: ", inFile));
+   }
+   else
+   {
+      in->select = select;
+   }
+   if(passStats)
+      EndPass("open");
+
+   in->fit    = options->fit;
+   in->rmsf   = rmsf;
+   in->series = series;
+   SetWindow(in, options);
+
+   ok = CalculateTrajFlexibility(in, inFile, options, passStats,
+                                 &result);
+   *meanRMSD   = result.meanRMSD;
+   interval[0] = result.interval[0];
+   interval[1] = result.interval[1];
+   *nFrames    = result.nFrames;
+
+   CloseTraj(in);
+   FreeCoords(result.meanFrame);
+   FreeCoords(result.closestFrame);
+
+   return(ok);
 }
 
 
 /***********************************************************************/
-/*>FRAME *FindClosestToMean(FILE *in, FRAME *meanFrame, char *header)
-   ------------------------------------------------------------------
-   
+/*>BOOL CalculateTrajFlexibility(TRAJ *in, char *inFile,
+                                 OPTIONS *options, BOOL passStats,
+                                 FLEXRESULT *result)
+   -----------------------------------------------------------------
 *//**
-   \param[in]  *in             file pointer to trajectory
-   \param[in]  *meanFrame      A pretend trajectory frame containing
-                               the averaged coordinates
-   \param[out] *header         The header for the frame closest to the
-                               mean coordinates
-   \return                     The frame closest to the mean coordinates
-
-   Finds the frame closest to the averaged (pretend) frame.
-   
--  24.11.25 Original   By: ACRM
+   \param[in]  *in             the open trajectory, with its atom
+                               selection, window, kernels, fit option,
+                               RMSFs and series set
+   \param[in]  *inFile         its filename, for the index sidecar and
+                               messages
+   \param[in]  *options        the options for the run
+   \param[in]  passStats       record each pass in the statistics
+   \param[out] *result         the results. The mean and closest frames
+                               are set (or NULL) even on failure and
+                               must be freed by the caller
+   \return                     FALSE (with a message) if the trajectory
+                               couldn't be processed
+
+   Makes the passes through one trajectory
+
+-  14.10.26 Original - split out of CalculateFlexibility()   By: ACRM
+-  14.10.26 Makes the passes on the GPU with --gpu
+-  14.10.26 Leaves out frames that don't match with --skip-bad
+-  14.10.26 Uses a random sample of the frames with --sample
+-  14.10.26 Writes the TRAJ's RMSFs
+-  14.10.26 Checks only the window's frames in the index. A bad first
+            frame isn't reported as there being no frames
+-  14.10.26 SkipBadFrames() gives its own messages. The RMSFs of a
+            spilled stream are numbered by the atoms it holds
 */
-FRAME *FindClosestToMean(FILE *in, FRAME *meanFrame, char *header)
+BOOL CalculateTrajFlexibility(TRAJ *in, char *inFile, OPTIONS *options,
+                              BOOL passStats, FLEXRESULT *result)
 {
-   FRAME *frame = NULL,
-         *closestFrame = NULL;
-   BOOL  firstFrame = TRUE;
-   REAL  lowestRMSD;
-   char  thisHeader[MAXBUFF];
-
-   /* Reset the frame reading                                           */
-   ReadFrame(NULL, NULL);
-
-   /* Read frames, one at a time                                        */
-   while((frame = ReadFrame(in, thisHeader))!=NULL)
+   char       *header       = result->header;
+   COORDS     *meanFrame    = NULL,
+              *closestFrame = NULL;
+   FRAMEINDEX *index        = NULL;
+   REAL       *rmsds        = NULL;
+   ULONG      frameCount    = 0;
+   BOOL       ok            = TRUE;
+
+   header[0]            = '\0';
+   result->meanRMSD     = -1.0;
+   result->interval[0]  = -1.0;
+   result->interval[1]  = -1.0;
+   result->nFrames      = 0;
+   result->nSkipped     = 0;
+   result->meanFrame    = NULL;
+   result->closestFrame = NULL;
+
+   /* With a checkpoint only the frames added since it was saved are
+      read. This gives the mean and an index of every frame, so the
+      other passes are as with -i
+   */
+   if(options->checkpointFile[0] != '\0')
    {
-      REAL rmsd;
+      if(in->binary || in->stream || in->memory)
+         ok = Fail("A checkpoint needs a text trajectory: ", inFile);
+      else if((meanFrame = UpdateCheckpoint(in, options->checkpointFile,
+                                            &index))==NULL)
+         ok = FALSE;
+      else
+         frameCount = index->nFrames;
+   }
+   /* With an index the frames are counted here (or not at all if the
+      saved index is up to date) and the atom counts are checked before
+      any coordinates are read. With --skip-bad the frames that don't
+      match are left out of the window instead. With --sample the
+      window is then replaced by a random sample of its frames, whose
+      RMSDs are kept for the interval
+   */
+   else if(options->useIndex)
+   {
+      ULONG badFrame;
 
-      /* Calculate RMSD to the mean frame                               */
-      if((rmsd = RMSFrame(meanFrame, frame)) < 0.0)
+      index     = AllocFrameIndex();
+      in->index = index;
+      if(index == NULL)
       {
-         Msg(MSG_ATOMMISMATCH, header);
-         return(NULL);
+         ok = Fail(MSG_NOMEM, "");
       }
-
-      /* If it was the first frame, make a copy of it and assume it's
-         the best
-      */
-      if(firstFrame)
+      else if((frameCount = GetFrameIndex(in, inFile, index)) < 1)
       {
-         if((closestFrame = CopyFrame(frame))==NULL)
-         {
-            Msg(MSG_NOMEM, header);
-            return(NULL);
-         }
-         lowestRMSD = rmsd;
-         firstFrame = FALSE;
+         ok = Fail("No frames in trajectory", "");
       }
-      else
+      else if(options->skipBad)
       {
-         /* Not the first, so if better, free up the copy of the current
-            best and copy this to be the best
-         */
-         if(rmsd < lowestRMSD)
-         {
-            lowestRMSD = rmsd;
-            FREELIST(closestFrame, FRAME);
-            if((closestFrame = CopyFrame(frame))==NULL)
-               return(NULL);
-         }
+         ok = SkipBadFrames(in, index);
+      }
+      else if((badFrame = CheckFrameIndex(in, index)) < frameCount)
+      {
+         MsgBadFrame(in, badFrame, NULL, FALSE);
+         ok = FALSE;
       }
-      /* Free the current frame                                         */
-      FREELIST(frame, FRAME);
+      if(ok && (options->nSample != 0) &&
+         (!SampleTrajFrames(in, index, options->nSample, options->seed) ||
+          ((in->nSample != 0) &&
+           ((rmsds = (REAL *)CountedMalloc(in->nSample * sizeof(REAL)))
+            ==NULL))))
+         ok = Fail(MSG_NOMEM, "");
+      if(ok && ((frameCount = WindowFrameCount(in, frameCount)) < 1))
+         ok = Fail("No frames selected", "");
+      result->nSkipped = in->nSkip;
+      if(ok && passStats)
+         EndPass("index");
    }
-   rewind(in);
-   return(closestFrame);
-}
-
-
-/***********************************************************************/
-/*>FRAME *CalculateMeanCoords(FILE *in, ULONG frameCount)
-   ------------------------------------------------------
-*//**
-   \param[in]  *in             file pointer to trajectory
-   \param[in]  frameCount      the number of frames
-   \return                     a pretend frame containing coordinates
-                               averaged across the real frames
-
-   Generates a new frame containing coordinates averaged across the
-   other frames.
-                               
--  24.11.25 Original   By: ACRM
-*/
-FRAME *CalculateMeanCoords(FILE *in, ULONG frameCount)
-{
-   FRAME *frame     = NULL,
-         *meanFrame = NULL,
-         *f;
-   char  header[MAXBUFF];
 
-   /* Reset the frame reading                                           */
-   ReadFrame(NULL, NULL);
+   if(!ok || (meanFrame != NULL))
+   {
+      /* Nothing more to do                                            */
+   }
+#ifdef FLEXCALC_GPU
+   else if(options->gpu)
+   {
+      /* The GPU mean counts the frames as it sums them, so -p makes no
+         difference
+      */
+      if((meanFrame = CalculateMeanCoordsGpu(in, &frameCount))==NULL)
+      {
+         ok = Fail((((frameCount < 1) && (in->badFrame == FRAME_OK)) ?
+                    "No frames in trajectory" :
+                    "Unable to calculate mean coordinates"), "");
+      }
+   }
+#endif
+   else if((options->nPasses == 4) && (options->nThreads < 2))
+   {
+      if(frameCount == 0)
+      {
+         if((frameCount = CountTrajFrames(in, NULL)) < 1)
+            ok = Fail("No frames in trajectory", "");
+         else if((frameCount = WindowFrameCount(in, frameCount)) < 1)
+            ok = Fail("No frames selected", "");
+      }
+      if(ok && passStats && !options->useIndex)
+         EndPass("count");
 
-   /* Initialize the meanFrame - just read in the first frame then
-      reset to zero coordinates, then rewind the file so we will
-      re-read it.
-   */
-   meanFrame = ReadFrame(in, header);
-   for(f=meanFrame; f!=NULL; NEXT(f))
+      if(ok && ((meanFrame = CalculateMeanCoords(in, frameCount))==NULL))
+         ok = Fail("Unable to calculate mean coordinates", "");
+   }
+   else if((options->nThreads > 1) && (options->nPasses != 2))
    {
-      f->x = 0.0;
-      f->y = 0.0;
-      f->z = 0.0;
+      /* The index has counted the frames, so -p 3 is the same as -p 4
+         with threads
+      */
+      if((meanFrame = CalculateMeanCoordsThreaded(in, index,
+                                                  options->nThreads))
+         ==NULL)
+         ok = Fail("Unable to calculate mean coordinates", "");
    }
-   rewind(in);
-   
-   /* Reset the frame reading                                           */
-   ReadFrame(NULL, NULL);
-   
-   /* Read frames, one at a time                                        */
-   while((frame = ReadFrame(in, header))!=NULL)
+   else
    {
-      BOOL ok;
-      ok = AddFrame(meanFrame, frame, frameCount);
-      FREELIST(frame, FRAME);
-      if(!ok)
+      /* Count the frames while calculating a running mean and, for 2
+         passes, choose the closest frame at the same time unless the
+         mean is to be refined
+      */
+      BOOL findClosest = ((options->nPasses == 2) &&
+                          !(options->fit && (options->nRefine > 0)));
+
+      if((meanFrame = CalculateRunningMean(in, &frameCount,
+                         (findClosest ? &closestFrame : NULL),
+                                           header))==NULL)
       {
-         Msg(MSG_ATOMMISMATCH, header);
-         FREELIST(meanFrame, FRAME);
-         meanFrame = NULL;
-         break;
+         ok = Fail((((frameCount < 1) && (in->badFrame == FRAME_OK)) ?
+                    "No frames in trajectory" :
+                    "Unable to calculate mean coordinates"), "");
       }
    }
-   rewind(in);
+   if(ok && passStats)
+      EndPass("mean");
+   if(ok && (meanFrame->nAtoms == 0))
+      ok = Fail("No atoms selected", "");
+
+   /* Refine the mean by fitting the frames to it. -p 2 has not looked
+      for the closest frame, since it would have been scored against
+      the unrefined mean, so it is found properly afterwards
+   */
+   if(ok && options->fit && (options->nRefine > 0))
+   {
+      int nCycles;
+
+      if((meanFrame = RefineMeanCoords(in, meanFrame, options->nRefine,
+                                       &nCycles))==NULL)
+         ok = Fail("Unable to refine mean coordinates", "");
+      FreeCoords(closestFrame);
+      closestFrame = NULL;
+      if(ok && passStats)
+         EndPass("refine");
+   }
 
-#ifdef DEBUG
-   PrintFrame("average", meanFrame);
+   if(ok && (in->rmsf != NULL) &&
+      !WriteRMSF(options->rmsfFile, in->rmsf, meanFrame,
+                 ((in->kept != NULL) ? in->kept : in->select)))
+      ok = Fail("Unable to write RMSFs: ", options->rmsfFile);
+
+   if(ok && options->nThreads)
+   {
+      if((closestFrame == NULL) &&
+         ((closestFrame = FindClosestToMeanThreaded(in, index, meanFrame,
+                                                    header,
+                                                    options->nThreads))
+          ==NULL))
+         ok = Fail("Couldn't find closest frame", header);
+      if(ok && passStats)
+         EndPass("closest");
+
+      if(ok && ((result->meanRMSD =
+                 CalculateMeanRMSDThreaded(in, index, closestFrame,
+                                           options->nThreads, rmsds))
+                < 0.0))
+         ok = Fail("Unable to calculate mean RMSD", "");
+   }
+#ifdef FLEXCALC_GPU
+   else if(ok && options->gpu)
+   {
+      if((closestFrame == NULL) &&
+         ((closestFrame = FindClosestToMeanGpu(in, meanFrame, header))
+          ==NULL))
+         ok = Fail("Couldn't find closest frame", header);
+      if(ok && passStats)
+         EndPass("closest");
+
+      if(ok && ((result->meanRMSD = CalculateMeanRMSDGpu(in,
+                                                         closestFrame))
+                < 0.0))
+         ok = Fail("Unable to calculate mean RMSD", "");
+   }
 #endif
-   return(meanFrame);
+   else if(ok)
+   {
+      if((closestFrame == NULL) &&
+         ((closestFrame = FindClosestToMean(in, meanFrame, header))
+          ==NULL))
+         ok = Fail("Couldn't find closest frame", header);
+      if(ok && passStats)
+         EndPass("closest");
+
+      if(ok && ((result->meanRMSD = CalculateMeanRMSD(in, closestFrame,
+                                                      frameCount, rmsds))
+                < 0.0))
+         ok = Fail("Unable to calculate mean RMSD", "");
+   }
+   if(ok && (rmsds != NULL) &&
+      !BootstrapInterval(rmsds, frameCount, options->seed,
+                         result->interval))
+      ok = Fail(MSG_NOMEM, "");
+   if(ok && passStats)
+      EndPass("rmsd");
+
+   if(index != NULL)
+      frameCount = WindowFrameCount(in, index->nFrames);
+   result->nFrames      = frameCount;
+   result->meanFrame    = meanFrame;
+   result->closestFrame = closestFrame;
+
+   /* The TRAJ may outlive its index                                    */
+   in->index = NULL;
+   FreeFrameIndex(index);
+   free(in->skip);
+   in->skip    = NULL;
+   in->nSkip   = 0;
+   free(in->sample);
+   in->sample  = NULL;
+   in->nSample = 0;
+   free(rmsds);
+
+   return(ok);
 }
 
 
 /***********************************************************************/
-/*>BOOL ParseCmdLine(int argc, char **argv, char *inFile)
-   ------------------------------------------------------
+/*>static void BatchTask(void *arg)
+   --------------------------------
 *//**
-   \param[in]  argc            Argument count
-   \param[in]  argv            Argument array
-   \param[out] *inFile         Input filename from command line
+   \param[in,out] *arg         the BATCHJOB to run
 
-   Parses the command line
+   Pool task for one trajectory in a batch
 
--  24.11.25 Original   By: ACRM
--  25.11.25 Checks for -h
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Gets the interval with --sample
 */
-BOOL ParseCmdLine(int argc, char **argv, char *inFile)
+static void BatchTask(void *arg)
 {
-   argc--; argv++;
-   if(argc > 0)
-   {
-      strcpy(inFile, argv[0]);
-      argc--; argv++;
-   }
-   else
-   {
-      return(FALSE);
-   }
-   
-   if(!strcmp(inFile, "-h"))
-      return(FALSE);
-   
-   return(TRUE);
+   BATCHJOB *job = (BATCHJOB *)arg;
+
+   job->ok = CalculateFlexibility(job->inFile, job->options, job->select,
+                                  NULL, NULL, FALSE, &(job->meanRMSD),
+                                  job->interval, &(job->nFrames));
+   __atomic_store_n(&(job->done), TRUE, __ATOMIC_RELEASE);
 }
 
+
 /***********************************************************************/
-/*>FRAME *ReadFrame(FILE *in, char *header)
-   ----------------------------------------
+/*>static int CompareJobSize(const void *job1, const void *job2)
+   -------------------------------------------------------------
 *//**
-   \param[in]  *in             file pointer to trajectory
-   \param[out] *header         the frame header
-   \return                     the next frame from the file
-
-   Reads a frame allocating a FRAME linked list
+   \param[in]  *job1           pointer to a BATCHJOB pointer
+   \param[in]  *job2           pointer to a BATCHJOB pointer
+   \return                     qsort() comparison putting the largest
+                               file first and otherwise keeping the
+                               original order
 
--  24.11.25 Original   By: ACRM
+-  14.10.26 Original   By: ACRM
 */
-
-FRAME *ReadFrame(FILE *in, char *header)
+static int CompareJobSize(const void *job1, const void *job2)
 {
-   static char buffer[MAXBUFF];
-   static BOOL firstEntry = TRUE;
-   FRAME *frame = NULL,
-         *f = NULL;
+   BATCHJOB *j1 = *(BATCHJOB **)job1,
+            *j2 = *(BATCHJOB **)job2;
+
+   if(j1->size != j2->size)
+      return((j1->size > j2->size) ? -1 : 1);
+   return(j1->order - j2->order);
+}
 
-   if(in==NULL)
+
+/***********************************************************************/
+/*>int RunBatch(OPTIONS *options, SELECTION *select)
+   --------------------------------------------------
+*//**
+   \param[in]  *options        the options, with the trajectories in
+                               inFiles
+   \param[in]  *select         atoms to use (NULL for all)
+   \return                     exit status: 1 if any trajectory failed
+
+   Processes every trajectory on a shared pool of workers and prints a
+   line with each result in the order the files were given. The
+   workers are the -t threads or, by default, one per CPU. With -t the
+   passes through each trajectory are also split into chunks, exactly
+   as for a single trajectory, which idle workers steal so that a
+   large trajectory doesn't hold up the end of the batch.
+
+   The largest files are started first. Results are printed as soon
+   as they and every earlier one are ready.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Prints the interval with --sample
+*/
+int RunBatch(OPTIONS *options, SELECTION *select)
+{
+   BATCHJOB  *jobs,
+             **order;
+   TASKGROUP group;
+   POOL      *pool;
+   ULONG     totalFrames = 0;
+   REAL      sumRMSD     = 0.0;
+   int       nWorkers,
+             nDone       = 0,
+             status      = 0,
+             next,
+             i;
+
+   nWorkers = options->nThreads;
+   if(nWorkers < 1)
    {
-      firstEntry = TRUE;
-      return(NULL);
+      long nCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+      nWorkers   = (nCPUs < 1) ? 1 : ((nCPUs > MAXTHREADS) ?
+                                      MAXTHREADS : (int)nCPUs);
    }
-   
-   /* Copy the existing buffer - which should be the next header        */
-   if(firstEntry)
+
+   jobs  = (BATCHJOB *)CountedCalloc(options->nInFiles, sizeof(BATCHJOB));
+   order = (BATCHJOB **)CountedCalloc(options->nInFiles,
+                                      sizeof(BATCHJOB *));
+   if((jobs == NULL) || (order == NULL) ||
+      ((pool = StartPool(nWorkers))==NULL))
+      Die(MSG_NOMEM, "");
+
+   gPool = pool;
+
+   for(i=0; i<options->nInFiles; i++)
    {
-      buffer[0] = '\0';
+      struct stat st;
+
+      jobs[i].inFile  = options->inFiles[i];
+      jobs[i].options = options;
+      jobs[i].select  = select;
+      jobs[i].order   = i;
+      jobs[i].size    = (stat(jobs[i].inFile, &st) == 0) ? st.st_size : 0;
+      order[i]        = &(jobs[i]);
    }
-   else
+   qsort(order, options->nInFiles, sizeof(BATCHJOB *), CompareJobSize);
+
+   group.pending = 0;
+   for(i=0; i<options->nInFiles; i++)
    {
-      strncpy(header, buffer, MAXBUFF-1);
+      if(!SubmitTask(pool, BatchTask, (void *)order[i], &group, TRUE))
+         BatchTask((void *)order[i]);
    }
 
-   while(fgets(buffer, MAXBUFF-1, in))
+   /* Help with the work until the next result to print is ready       */
+   next = 0;
+   while(next < options->nInFiles)
    {
-      TERMINATE(buffer);
-      
-      if(buffer[0] == '>')  /* A header                                 */
-      {
-         if(!firstEntry)
-            break;
-         else
-            firstEntry = FALSE;
-      }
-      else
+      ULONG events = PoolEvents(pool);
+
+      while((next < options->nInFiles) &&
+            __atomic_load_n(&(jobs[next].done), __ATOMIC_ACQUIRE))
       {
-         if(frame == NULL)
+         if(jobs[next].ok)
          {
-            INIT(frame, FRAME);
-            f = frame;
+            if(options->nSample)
+               printf("%s %.4f %.4f %.4f\n", jobs[next].inFile,
+                      jobs[next].meanRMSD, jobs[next].interval[0],
+                      jobs[next].interval[1]);
+            else
+               printf("%s %.4f\n", jobs[next].inFile,
+                      jobs[next].meanRMSD);
+            totalFrames += jobs[next].nFrames;
+            sumRMSD     += jobs[next].meanRMSD;
+            nDone++;
          }
          else
          {
-            ALLOCNEXT(f, FRAME);
-         }
-         if(f==NULL)
-         {
-            FREELIST(frame, FRAME);
-            return(NULL);
+            printf("%s error\n", jobs[next].inFile);
+            status = 1;
          }
-
-         sscanf(buffer, "%lf %lf %lf", &(f->x), &(f->y), &(f->z));
+         fflush(stdout);
+         next++;
       }
+      if((next < options->nInFiles) && !RunPoolTask(pool, FALSE))
+         WaitPool(pool, events);
    }
-   
-   return(frame);
+
+   gPool = NULL;
+   StopPool(pool);
+   EndPass("batch");
+
+   if(options->timing)
+      PrintTiming(stderr, totalFrames);
+   if(options->stats)
+      PrintStats(stderr);
+   if((options->statsFile[0] != '\0') &&
+      !WriteStatsJSON(options->statsFile, options, totalFrames,
+                      (nDone ? sumRMSD / nDone : 0.0)))
+      Msg("Unable to write statistics: ", options->statsFile);
+
+   free(jobs);
+   free(order);
+   return(status);
 }
 
 
 /***********************************************************************/
-/*>ULONG CountFrames(FILE *fp)
-   ---------------------------
+/*>void Die(const char *msg, const char *submsg)
+   ---------------------------------------------
 *//**
-   \param[in]  *in             file pointer to trajectory
-   \return                     the number of frames in the file
+   \param[in]  *msg            Main messsage
+   \param[in]  *submsg         Submessage
 
-   Read the number of frames from the file
+   Prints an error message and exits
 
 -  24.11.25 Original   By: ACRM
+-  14.10.26 Takes const strings so it can be called from C++
 */
-ULONG CountFrames(FILE *fp)
+void Die(const char *msg, const char *submsg)
 {
-   ULONG frameCount = 0;
-   char buffer[MAXBUFF];
-
-   while(fgets(buffer, MAXBUFF-1, fp))
-   {
-      if(buffer[0] == '>')
-         frameCount++;
-   }
-   rewind(fp);
-   return(frameCount);
+   Msg(msg, submsg);
+   exit(1);
 }
 
-
 /***********************************************************************/
-/*>REAL RMSFrame(FRAME *frame1, FRAME *frame2)
-   -------------------------------------------
+/*>void Msg(const char *msg, const char *submsg)
+   ---------------------------------------------
 *//**
-   \param[in]  *frame1         a frame linked list
-   \param[in]  *frame2         a frame linked list
+   \param[in]  *msg            Main messsage
+   \param[in]  *submsg         Submessage
 
-   Calculates the RMSD between two frames
+   Prints an error message
 
--  24.11.25 Original   By: ACRM
+-  25.11.25 Original   By: ACRM
+-  14.10.26 Takes const strings so it can be called from C++
 */
-REAL RMSFrame(FRAME *frame1, FRAME *frame2)
+void Msg(const char *msg, const char *submsg)
 {
-   REAL  rmsd;
-   int nCoor;
-   FRAME *p, *q;
-   p = frame1;
-   q = frame2;
+   fprintf(stderr, "%s error: %s%s\n", PROGNAME, msg, submsg);
+}
 
-   rmsd  = 0.0;
-   nCoor = 0;
 
-   while((p!=NULL) && (q!=NULL))
+/***********************************************************************/
+/*>ULONG GetFrameIndex(TRAJ *in, char *inFile, FRAMEINDEX *index)
+   --------------------------------------------------------------
+*//**
+   \param[in]  *in             the open trajectory
+   \param[in]  *inFile         the trajectory filename
+   \param[out] *index          an empty frame index
+   \return                     the number of frames (0 if the index
+                               couldn't be built)
+
+   Reads the sidecar index for the trajectory if it is up to date.
+   Otherwise counts the frames, building the index, and saves it for
+   next time. Failing to save the index is not an error.
+
+   A binary trajectory, or one in memory, holds its own index so no
+   sidecar is used.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Binary trajectories
+-  14.10.26 Trajectories in memory
+*/
+ULONG GetFrameIndex(TRAJ *in, char *inFile, FRAMEINDEX *index)
+{
+   ULONG frameCount;
+   char  indexFile[MAXFNM];
+   BOOL  ownIndex = (in->binary || in->memory);
+
+   if(!ownIndex && ReadFrameIndex(index, inFile))
+      return(index->nFrames);
+
+   if((frameCount = CountTrajFrames(in, index)) != index->nFrames)
    {
-      rmsd += (p->x - q->x) * (p->x - q->x) +
-              (p->y - q->y) * (p->y - q->y) +
-              (p->z - q->z) * (p->z - q->z);
-      nCoor++;
-      NEXT(p);
-      NEXT(q);
+      Msg(MSG_NOMEM, " (frame index)");
+      return(0);
    }
 
-   if((p != NULL) || (q != NULL))
+   if(ownIndex)
+      return(frameCount);
+
+   if(!StampFrameIndex(index, inFile) || !WriteFrameIndex(index, inFile))
    {
-      return(-1.0);
+      IndexFileName(inFile, indexFile);
+      fprintf(stderr, "%s warning: Unable to save frame index %s\n",
+              PROGNAME, indexFile);
    }
-   
-   return(sqrt(rmsd/nCoor));
+
+   return(frameCount);
 }
 
 
 /***********************************************************************/
-/*>FRAME *CopyFrame(FRAME *frame)
-   ------------------------------
+/*>SELECTION *GetSelection(OPTIONS *options)
+   -----------------------------------------
 *//**
-   \param[in]  *frame          a frame linked list
-   \return                     a newly allocated copy of the input
-                               frame
+   \param[in]  *options        options with --atoms and/or --atoms-file
+   \return                     the atom selection
 
-   Copies a frame linked list                               
+   Builds the atom selection from the command line, exiting if it is
+   invalid
 
--  24.11.25 Original   By: ACRM
+-  14.10.26 Original   By: ACRM
 */
-FRAME *CopyFrame(FRAME *frame)
+SELECTION *GetSelection(OPTIONS *options)
 {
-   FRAME *copy = NULL,
-         *c, *f;
+   SELECTION *select;
+
+   if((select = AllocSelection())==NULL)
+      Die(MSG_NOMEM, "");
+   if((options->atoms[0] != '\0') &&
+      !ParseSelection(select, options->atoms))
+      Die("Invalid atom selection: ", options->atoms);
+   if((options->atomsFile[0] != '\0') &&
+      !ReadSelectionFile(select, options->atomsFile))
+      Die("Unable to read atom selection: ", options->atomsFile);
+
+   return(select);
+}
 
-   for(f=frame; f!=NULL; NEXT(f))
-   {
-      if(copy==NULL)
+
+/***********************************************************************/
+/*>void SetWindow(TRAJ *in, OPTIONS *options)
+   ------------------------------------------
+*//**
+   \param[in,out] *in          the open trajectory
+   \param[in]     *options     options with --start, --stop and --stride
+
+   Sets the trajectory's window of frames from the command line, which
+   numbers them from 1
+
+-  14.10.26 Original   By: ACRM
+*/
+void SetWindow(TRAJ *in, OPTIONS *options)
+{
+   SetTrajWindow(in, options->start - 1,
+                 (options->stop ? options->stop - 1 : ULONG_MAX),
+                 options->stride);
+}
+
+
+/***********************************************************************/
+/*>void GetFileList(OPTIONS *options)
+   ----------------------------------
+*//**
+   \param[in,out] *options     options with the trajectories from the
+                               command line and any --list file
+
+   Adds the trajectories named in the --list file (one per line; blank
+   lines and lines starting with # are ignored) to those from the
+   command line, exiting if the list can't be read or is empty
+
+-  14.10.26 Original   By: ACRM
+*/
+void GetFileList(OPTIONS *options)
+{
+   FILE *fp;
+   char buffer[MAXFNM],
+        **inFiles;
+   int  maxFiles;
+
+   if(options->listFile[0] == '\0')
+      return;
+   if((fp = fopen(options->listFile, "r"))==NULL)
+      Die("Unable to read trajectory list: ", options->listFile);
+
+   maxFiles = options->nInFiles + MAXBUFF;
+   if((inFiles = (char **)CountedMalloc(maxFiles * sizeof(char *)))==NULL)
+      Die(MSG_NOMEM, "");
+   if(options->nInFiles)
+      memcpy(inFiles, options->inFiles, options->nInFiles * sizeof(char *));
+   options->inFiles = inFiles;
+
+   while(fgets(buffer, MAXFNM, fp))
+   {
+      char *start = buffer,
+           *end;
+
+      while((*start == ' ') || (*start == '\t'))
+         start++;
+      end = start + strlen(start);
+      while((end > start) && isspace((unsigned char)end[-1]))
+         *(--end) = '\0';
+      if((*start == '\0') || (*start == '#'))
+         continue;
+
+      if(options->nInFiles == maxFiles)
+      {
+         maxFiles *= 2;
+         if((inFiles = (char **)CountedRealloc(options->inFiles,
+                                      maxFiles * sizeof(char *)))==NULL)
+            Die(MSG_NOMEM, "");
+         options->inFiles = inFiles;
+      }
+      if((options->inFiles[options->nInFiles] = strdup(start))==NULL)
+         Die(MSG_NOMEM, "");
+      options->nInFiles++;
+   }
+   fclose(fp);
+
+   if(options->nInFiles == 0)
+      Die("No trajectories in list: ", options->listFile);
+}
+
+
+/***********************************************************************/
+/*>REAL CalculateMeanRMSD(TRAJ *in, COORDS *closestFrame,
+                          ULONG frameCount, REAL *rmsds)
+   ------------------------------------------------------
+*//**
+   \param[in]  *in             file pointer to trajectory
+   \param[in]  *closestFrame   The frame closest to the mean coordinates
+   \param[in]  frameCount      The number of frames
+   \param[out] *rmsds          The RMSD of each frame (may be NULL)
+   \return                     The mean RMSD
+
+   Reads through the frames and calculate an RMSD for each to the frame
+   closest to the mean coordinates. Returns the average of these RMSD
+   values. With --series, each RMSD is also written to the series.
+
+-  24.11.25 Original   By: ACRM
+-  14.10.26 Reads into a single reused COORDS frame
+-  14.10.26 Reads from a TRAJ
+-  14.10.26 Writes the RMSD series
+-  14.10.26 Reports a bad frame with MsgBadFrame()
+-  14.10.26 Keeps each RMSD in rmsds
+-  14.10.26 Uses the TRAJ's fit option and series
+-  14.10.26 Fails at a bad frame
+*/
+REAL CalculateMeanRMSD(TRAJ *in, COORDS *closestFrame, ULONG frameCount,
+                       REAL *rmsds)
+{
+   REAL   meanRMSD = 0.0;
+   COORDS *frame   = NULL;
+   ULONG  n        = 0;
+   char   header[MAXBUFF];
+
+   if((frame = AllocCoords(closestFrame->nAtoms))==NULL)
+   {
+      Msg(MSG_NOMEM, "");
+      return(-1.0);
+   }
+
+   /* Go back to the start and reset the frame reading                 */
+   RewindTraj(in);
+
+   /* Read frames, one at a time                                        */
+   while(ReadTrajFrame(in, header, frame))
+   {
+      REAL rmsd;
+      /* Add the RMSD of this frame to the closest-to-mean frame        */
+      if((rmsd = RMSFrame(closestFrame, frame, in->fit)) < 0.0)
+      {
+         MsgBadFrame(in, in->frameNum-1, header, FALSE);
+         FreeCoords(frame);
+         return(-1.0);
+      }
+
+#ifdef DEBUG
+      PrintFrame(header, frame);
+#endif
+
+      if(in->series != NULL)
+         WriteSeries(in->series, in->frameNum, header, rmsd);
+      if((rmsds != NULL) && (n < frameCount))
+         rmsds[n++] = rmsd;
+      meanRMSD += rmsd;
+   }
+   FreeCoords(frame);
+   if(in->badFrame != FRAME_OK)
+      return(-1.0);
+
+   /* Divide by number of frames                                        */
+   meanRMSD /= frameCount;
+   return(meanRMSD);
+}
+
+
+/***********************************************************************/
+/*>COORDS *FindClosestToMean(TRAJ *in, COORDS *meanFrame, char *header)
+   --------------------------------------------------------------------
+
+*//**
+   \param[in]  *in             file pointer to trajectory
+   \param[in]  *meanFrame      A pretend trajectory frame containing
+                               the averaged coordinates
+   \param[out] *header         The header for the frame closest to the
+                               mean coordinates
+   \return                     The frame closest to the mean coordinates
+
+   Finds the frame closest to the averaged (pretend) frame.
+
+   Two frames are allocated: one being read into and one holding the
+   best so far. When a better frame is found the two are simply
+   swapped, so nothing is copied or allocated inside the loop.
+
+-  24.11.25 Original   By: ACRM
+-  14.10.26 Uses COORDS and swaps buffers rather than copying
+-  14.10.26 Reads from a TRAJ
+-  14.10.26 Reports a bad frame with MsgBadFrame(), giving its own header
+-  14.10.26 Uses the TRAJ's fit option
+-  14.10.26 Fails at a bad frame
+*/
+COORDS *FindClosestToMean(TRAJ *in, COORDS *meanFrame, char *header)
+{
+   COORDS *frame        = NULL,
+          *closestFrame = NULL;
+   BOOL   firstFrame    = TRUE;
+   REAL   lowestRMSD    = 0.0;
+   char   thisHeader[MAXBUFF];
+
+   if(((frame        = AllocCoords(meanFrame->nAtoms))==NULL) ||
+      ((closestFrame = AllocCoords(meanFrame->nAtoms))==NULL))
+   {
+      Msg(MSG_NOMEM, "");
+      FreeCoords(frame);
+      return(NULL);
+   }
+
+   /* Go back to the start and reset the frame reading                 */
+   RewindTraj(in);
+
+   /* Read frames, one at a time                                        */
+   while(ReadTrajFrame(in, thisHeader, frame))
+   {
+      REAL rmsd;
+
+      /* Calculate RMSD to the mean frame                               */
+      if((rmsd = RMSFrame(meanFrame, frame, in->fit)) < 0.0)
+      {
+         MsgBadFrame(in, in->frameNum-1, thisHeader, FALSE);
+         FreeCoords(frame);
+         FreeCoords(closestFrame);
+         return(NULL);
+      }
+
+      /* If it was the first frame, or it is better than the best so
+         far, keep it by swapping it with the current best
+      */
+      if(firstFrame || (rmsd < lowestRMSD))
+      {
+         COORDS *swap  = closestFrame;
+         closestFrame  = frame;
+         frame         = swap;
+         lowestRMSD    = rmsd;
+         firstFrame    = FALSE;
+         strcpy(header, thisHeader);
+      }
+   }
+   FreeCoords(frame);
+
+   if(firstFrame || (in->badFrame != FRAME_OK))
+   {
+      FreeCoords(closestFrame);
+      return(NULL);
+   }
+   return(closestFrame);
+}
+
+
+/***********************************************************************/
+/*>COORDS *CalculateMeanCoords(TRAJ *in, ULONG frameCount)
+   -------------------------------------------------------
+*//**
+   \param[in]  *in             file pointer to trajectory
+   \param[in]  frameCount      the number of frames
+   \return                     a pretend frame containing coordinates
+                               averaged across the real frames
+
+   Generates a new frame containing coordinates averaged across the
+   other frames.
+
+-  24.11.25 Original   By: ACRM
+-  14.10.26 Uses COORDS. The first frame is no longer read twice.
+-  14.10.26 Reads from a TRAJ
+-  14.10.26 Gathers the squares for the RMSFs
+-  14.10.26 Accumulates the mean in its sums
+-  14.10.26 Reports a bad frame with MsgBadFrame()
+-  14.10.26 Gathers the squares in the TRAJ's RMSFs
+-  14.10.26 Fails at a bad frame
+*/
+COORDS *CalculateMeanCoords(TRAJ *in, ULONG frameCount)
+{
+   COORDS *frame     = NULL,
+          *meanFrame = NULL;
+   char   header[MAXBUFF];
+   BOOL   firstFrame = TRUE;
+
+   if(((frame     = AllocCoords(MINATOMS))==NULL) ||
+      ((meanFrame = AllocCoords(MINATOMS))==NULL))
+   {
+      Msg(MSG_NOMEM, "");
+      FreeCoords(frame);
+      return(NULL);
+   }
+
+   /* Go back to the start and reset the frame reading                 */
+   RewindTraj(in);
+   if(in->rmsf != NULL)
+      ResetRMSF(in->rmsf);
+
+   /* Read frames, one at a time                                        */
+   while(ReadTrajFrame(in, header, frame))
+   {
+      /* Initialize the meanFrame to zero coordinates with the size of
+         the first frame
+      */
+      if(firstFrame)
+      {
+         if(!GrowCoords(meanFrame, frame->nAtoms) ||
+            !ZeroCoords(meanFrame, frame->nAtoms))
+         {
+            Msg(MSG_NOMEM, "");
+            FreeCoords(meanFrame);
+            meanFrame = NULL;
+            break;
+         }
+         firstFrame = FALSE;
+      }
+
+      if(!AddFrame(meanFrame, frame, frameCount))
+      {
+         MsgBadFrame(in, in->frameNum-1, header, FALSE);
+         FreeCoords(meanFrame);
+         meanFrame = NULL;
+         break;
+      }
+      if((in->rmsf != NULL) && !AddSquares(in->rmsf, frame))
+      {
+         Msg(MSG_NOMEM, "");
+         FreeCoords(meanFrame);
+         meanFrame = NULL;
+         break;
+      }
+   }
+   FreeCoords(frame);
+
+   if(firstFrame || (in->badFrame != FRAME_OK))
+   {
+      FreeCoords(meanFrame);
+      meanFrame = NULL;
+   }
+   else if(meanFrame != NULL)
+   {
+      StoreSums(meanFrame);
+   }
+
+#ifdef DEBUG
+   PrintFrame("average", meanFrame);
+#endif
+   return(meanFrame);
+}
+
+
+/***********************************************************************/
+/*>COORDS *CalculateRunningMean(TRAJ *in, ULONG *frameCount,
+                                COORDS **closestFrame, char *header)
+   -----------------------------------------------------------------
+*//**
+   \param[in]  *in             file pointer to trajectory
+   \param[out] *frameCount     the number of frames read
+   \param[out] **closestFrame  if not NULL, the candidate frame closest
+                               to the final mean coordinates
+   \param[out] *header         the header of the closest frame
+   \return                     a pretend frame containing coordinates
+                               averaged across the real frames
+
+   Generates a new frame containing coordinates averaged across the
+   other frames in a single pass. A running (Welford) mean is used so
+   the number of frames does not need to be known in advance and the
+   frames are counted at the same time.
+
+   If closestFrame is given, the frames which were closest to the
+   running mean when they were read are kept as candidates (at most
+   MAXCANDIDATES of them, re-scored against the running mean every
+   MAXCANDIDATES frames) and the candidate closest to the final mean
+   is chosen. This avoids a separate pass of the file.
+
+   Every frame dropped from (or never made) a candidate is also scored
+   against a reference mean kept for the block of frames it was read
+   in (see CLOSESTCHECK). At the end, this bounds how close to the
+   final mean those frames can be, and any blocks which might hold a
+   closer frame than the one chosen are searched again by
+   CheckClosestFrame(). The result is the same frame as
+   FindClosestToMean() would find.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Uses COORDS. Candidates keep the frame buffers they were
+            read into.
+-  14.10.26 Reads from a TRAJ
+-  14.10.26 Gathers the squares for the RMSFs
+-  14.10.26 Checks the chosen frame is the closest
+-  14.10.26 Zeroes the mean (and its sums) at the first frame
+-  14.10.26 Reports a bad frame with MsgBadFrame()
+-  14.10.26 Uses the TRAJ's fit option and RMSFs
+-  14.10.26 Fails at a bad frame
+*/
+COORDS *CalculateRunningMean(TRAJ *in, ULONG *frameCount,
+                             COORDS **closestFrame, char *header)
+{
+   COORDS       *frame     = NULL,
+                *meanFrame = NULL;
+   CANDIDATE    candidates[MAXCANDIDATES];
+   CLOSESTCHECK check;
+   ULONG        dropped;
+   int          nCandidates = 0,
+                best        = 0,
+                i;
+   char         thisHeader[MAXBUFF];
+   BOOL         ok          = TRUE;
+
+   *frameCount       = 0;
+   check.nBlocks     = 0;
+   check.blockSize   = MINCHECKBLOCK;
+   check.fit         = in->fit;
+   for(i=0; i<MAXCHECKBLOCKS; i++)
+      check.reference[i] = NULL;
+
+   if(((frame     = AllocCoords(MINATOMS))==NULL) ||
+      ((meanFrame = AllocCoords(MINATOMS))==NULL))
+   {
+      Msg(MSG_NOMEM, "");
+      FreeCoords(frame);
+      return(NULL);
+   }
+
+   /* Go back to the start and reset the frame reading                 */
+   RewindTraj(in);
+   if(in->rmsf != NULL)
+      ResetRMSF(in->rmsf);
+
+   /* Read frames, one at a time                                        */
+   while(ReadTrajFrame(in, thisHeader, frame))
+   {
+      (*frameCount)++;
+
+      /* The first frame provides the size of the mean, which starts
+         from zero so, with n=1, UpdateRunningMean() simply copies it
+      */
+      if(*frameCount == 1)
+      {
+         if(!GrowCoords(meanFrame, frame->nAtoms) ||
+            !ZeroCoords(meanFrame, frame->nAtoms))
+         {
+            Msg(MSG_NOMEM, "");
+            ok = FALSE;
+            break;
+         }
+      }
+
+      if(!UpdateRunningMean(meanFrame, frame, *frameCount))
+      {
+         MsgBadFrame(in, in->frameNum-1, thisHeader, FALSE);
+         ok = FALSE;
+         break;
+      }
+      if((in->rmsf != NULL) && !AddSquares(in->rmsf, frame))
+      {
+         Msg(MSG_NOMEM, "");
+         ok = FALSE;
+         break;
+      }
+
+      /* Score this frame against the mean so far and keep it if it is
+         one of the closest
+      */
+      if(closestFrame != NULL)
+      {
+         /* Every MAXCANDIDATES frames, re-score the candidates against
+            the current mean so that their scores remain comparable
+            with new frames
+         */
+         if((*frameCount % MAXCANDIDATES) == 0)
+         {
+            for(i=0; i<nCandidates; i++)
+               candidates[i].rmsd = RMSFrame(meanFrame,
+                                             candidates[i].frame,
+                                             in->fit);
+         }
+
+         if(!AddCheckFrame(&check, *frameCount - 1, meanFrame) ||
+            !UpdateCandidates(candidates, &nCandidates, &frame,
+                              RMSFrame(meanFrame, frame, in->fit),
+                              thisHeader,
+                              *frameCount - 1, &dropped))
+         {
+            Msg(MSG_NOMEM, "");
+            ok = FALSE;
+            break;
+         }
+
+         /* frame now holds whichever frame wasn't kept               */
+         if(dropped != ULONG_MAX)
+            BoundCheckFrame(&check, dropped, frame);
+      }
+   }
+   FreeCoords(frame);
+
+   if((*frameCount == 0) || (in->badFrame != FRAME_OK))
+      ok = FALSE;
+
+   /* Re-score the candidates against the final mean and keep the best,
+      taking the earliest if they tie as FindClosestToMean() does. Then
+      make sure no other frame is closer
+   */
+   if(closestFrame != NULL)
+   {
+      *closestFrame = NULL;
+      if(ok)
+      {
+         for(i=0; i<nCandidates; i++)
+         {
+            candidates[i].rmsd = RMSFrame(meanFrame,
+                                          candidates[i].frame, in->fit);
+            if((candidates[i].rmsd < candidates[best].rmsd) ||
+               ((candidates[i].rmsd == candidates[best].rmsd) &&
+                (candidates[i].frameNum < candidates[best].frameNum)))
+               best = i;
+         }
+         ok = CheckClosestFrame(in, &check, *frameCount, meanFrame,
+                                &(candidates[best]));
+      }
+      FreeClosestCheck(&check);
+
+      for(i=0; i<nCandidates; i++)
+      {
+         if(ok && (i == best))
+         {
+            *closestFrame = candidates[i].frame;
+            strcpy(header, candidates[i].header);
+         }
+         else
+         {
+            FreeCoords(candidates[i].frame);
+         }
+      }
+   }
+
+   if(!ok)
+   {
+      FreeCoords(meanFrame);
+      meanFrame = NULL;
+   }
+
+#ifdef DEBUG
+   PrintFrame("average", meanFrame);
+#endif
+   return(meanFrame);
+}
+
+
+/***********************************************************************/
+/*>BOOL UpdateCandidates(CANDIDATE *candidates, int *nCandidates,
+                         COORDS **frame, REAL rmsd, char *header,
+                         ULONG frameNum, ULONG *dropped)
+   ---------------------------------------------------------------
+*//**
+   \param[in,out] *candidates  array of MAXCANDIDATES candidate frames
+   \param[in,out] *nCandidates number of candidates in the array
+   \param[in,out] **frame      the frame just read. If it is kept, this
+                               is replaced by a buffer to read the next
+                               frame into
+   \param[in]     rmsd         score for this frame
+   \param[in]     *header      the frame header
+   \param[in]     frameNum     position of the frame in those read
+   \param[out]    *dropped     position of the frame left in **frame,
+                               or ULONG_MAX if it is a new buffer
+   \return                     FALSE if memory allocation failed
+
+   Keeps the frame as a candidate if there is space or if it scores
+   better than the worst current candidate. The candidate array takes
+   over the frame's buffer and the caller gets back either the buffer
+   of the candidate that was dropped, which still holds its
+   coordinates, or, while the array is filling, a newly allocated
+   buffer.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Swaps COORDS buffers rather than taking over a list
+-  14.10.26 Added frameNum and dropped
+*/
+BOOL UpdateCandidates(CANDIDATE *candidates, int *nCandidates,
+                      COORDS **frame, REAL rmsd, char *header,
+                      ULONG frameNum, ULONG *dropped)
+{
+   COORDS *spare;
+   int    i,
+          worst = 0;
+
+   *dropped = frameNum;
+   if(*nCandidates < MAXCANDIDATES)
+   {
+      if((spare = AllocCoords((*frame)->nAtoms))==NULL)
+         return(FALSE);
+      worst    = (*nCandidates)++;
+      *dropped = ULONG_MAX;
+   }
+   else
+   {
+      for(i=1; i<MAXCANDIDATES; i++)
+      {
+         if(candidates[i].rmsd > candidates[worst].rmsd)
+            worst = i;
+      }
+      if(rmsd >= candidates[worst].rmsd)
+         return(TRUE);
+      spare    = candidates[worst].frame;
+      *dropped = candidates[worst].frameNum;
+   }
+
+   candidates[worst].frame    = *frame;
+   candidates[worst].rmsd     = rmsd;
+   candidates[worst].frameNum = frameNum;
+   strncpy(candidates[worst].header, header, MAXBUFF-1);
+   candidates[worst].header[MAXBUFF-1] = '\0';
+   *frame = spare;
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>static BOOL AddCheckFrame(CLOSESTCHECK *check, ULONG frameNum,
+                             COORDS *meanFrame)
+   --------------------------------------------------------------
+*//**
+   \param[in,out] *check       the closest frame check
+   \param[in]     frameNum     position of the frame just read
+   \param[in]     *meanFrame   the running mean including it
+   \return                     FALSE if no memory
+
+   Starts a new block, with the running mean as its reference, if the
+   frame is the first of one. If all the blocks are in use, pairs are
+   merged first. The lowest RMSD from the second reference of a pair,
+   less the distance between the references, bounds the RMSD from the
+   first. The second references are moved to the end of the array to
+   be reused for later blocks.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Reuses the references of merged blocks
+-  14.10.26 Uses the check's fit option
+*/
+static BOOL AddCheckFrame(CLOSESTCHECK *check, ULONG frameNum,
+                          COORDS *meanFrame)
+{
+   COORDS *spare[MAXCHECKBLOCKS/2];
+   int    i;
+
+   if((frameNum % check->blockSize) != 0)
+      return(TRUE);
+
+   if(check->nBlocks == MAXCHECKBLOCKS)
+   {
+      for(i=0; i<MAXCHECKBLOCKS/2; i++)
+      {
+         REAL lowest = check->lowest[2*i+1] -
+                       RMSFrame(check->reference[2*i],
+                                check->reference[2*i+1], check->fit);
+
+         spare[i]            = check->reference[2*i+1];
+         check->reference[i] = check->reference[2*i];
+         check->lowest[i]    = MIN(check->lowest[2*i], lowest);
+      }
+      for(i=0; i<MAXCHECKBLOCKS/2; i++)
+         check->reference[MAXCHECKBLOCKS/2 + i] = spare[i];
+      check->nBlocks    = MAXCHECKBLOCKS/2;
+      check->blockSize *= 2;
+   }
+
+   if((check->reference[check->nBlocks] == NULL) &&
+      ((check->reference[check->nBlocks] =
+        AllocCoords(meanFrame->nAtoms))==NULL))
+      return(FALSE);
+   if(!CopyFrame(check->reference[check->nBlocks], meanFrame))
+      return(FALSE);
+   check->lowest[check->nBlocks] = HUGE_VAL;
+   check->nBlocks++;
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>static void BoundCheckFrame(CLOSESTCHECK *check, ULONG frameNum,
+                               COORDS *frame)
+   ----------------------------------------------------------------
+*//**
+   \param[in,out] *check       the closest frame check
+   \param[in]     frameNum     position of a frame which is not a
+                               candidate
+   \param[in]     *frame       its coordinates
+
+   Scores the frame against its block's reference
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Uses the check's fit option
+*/
+static void BoundCheckFrame(CLOSESTCHECK *check, ULONG frameNum,
+                            COORDS *frame)
+{
+   ULONG block = frameNum / check->blockSize;
+   REAL  rmsd  = RMSFrame(check->reference[block], frame, check->fit);
+
+   if(rmsd < check->lowest[block])
+      check->lowest[block] = rmsd;
+}
+
+
+/***********************************************************************/
+/*>static BOOL CheckClosestFrame(TRAJ *in, CLOSESTCHECK *check,
+                                 ULONG nFrames, COORDS *meanFrame,
+                                 CANDIDATE *best)
+   ------------------------------------------------------------
+*//**
+   \param[in]     *in          the trajectory
+   \param[in]     *check       the closest frame check
+   \param[in]     nFrames      the number of frames read
+   \param[in]     *meanFrame   the final mean
+   \param[in,out] *best        the best candidate, replaced by any frame
+                               found to be closer
+   \return                     FALSE if the frames couldn't be re-read
+
+   Any frame has RMSD(frame, mean) >= RMSD(frame, reference) -
+   RMSD(reference, mean), so a block can only hold a frame closer than
+   the best candidate if its lowest RMSD less the distance of its
+   reference from the final mean is no more than the best. The frames
+   of any such block are read again through the index and compared
+   with the mean itself. Without an index, the whole trajectory is
+   searched with FindClosestToMean().
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Reports a bad frame with MsgBadFrame()
+-  14.10.26 Uses the TRAJ's fit option
+*/
+static BOOL CheckClosestFrame(TRAJ *in, CLOSESTCHECK *check,
+                              ULONG nFrames, COORDS *meanFrame,
+                              CANDIDATE *best)
+{
+   COORDS *frame;
+   char   header[MAXBUFF];
+   BOOL   uncertain[MAXCHECKBLOCKS],
+          anyUncertain = FALSE;
+   ULONG  i, last;
+   int    j;
+
+   for(j=0; j<check->nBlocks; j++)
+   {
+      uncertain[j] = ((check->lowest[j] -
+                       RMSFrame(meanFrame, check->reference[j],
+                                in->fit)) <=
+                      (best->rmsd + BOUNDTOL));
+      if(uncertain[j])
+         anyUncertain = TRUE;
+   }
+   if(!anyUncertain)
+      return(TRUE);
+
+   if(in->index == NULL)
+   {
+      if((frame = FindClosestToMean(in, meanFrame, header))==NULL)
+         return(FALSE);
+      FreeCoords(best->frame);
+      best->frame = frame;
+      strcpy(best->header, header);
+      return(TRUE);
+   }
+
+   if((frame = AllocCoords(meanFrame->nAtoms))==NULL)
+   {
+      Msg(MSG_NOMEM, "");
+      return(FALSE);
+   }
+
+   header[0] = '\0';
+   for(j=0; j<check->nBlocks; j++)
+   {
+      if(!uncertain[j])
+         continue;
+
+      last = MIN((j+1) * check->blockSize, nFrames);
+      for(i=j * check->blockSize; i<last; i++)
+      {
+         REAL rmsd = -1.0;
+
+         if(!ReadIndexedFrame(in, in->index, WindowFrameNum(in, i),
+                              header, frame) ||
+            ((rmsd = RMSFrame(meanFrame, frame, in->fit)) < 0.0))
+         {
+            MsgBadFrame(in, WindowFrameNum(in, i), header, FALSE);
+            FreeCoords(frame);
+            return(FALSE);
+         }
+
+         if((rmsd < best->rmsd) ||
+            ((rmsd == best->rmsd) && (i < best->frameNum)))
+         {
+            COORDS *swap   = best->frame;
+            best->frame    = frame;
+            frame          = swap;
+            best->rmsd     = rmsd;
+            best->frameNum = i;
+            strcpy(best->header, header);
+         }
+      }
+   }
+
+   FreeCoords(frame);
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>static void FreeClosestCheck(CLOSESTCHECK *check)
+   -------------------------------------------------
+*//**
+   \param[in,out] *check       the closest frame check
+
+   Frees the reference means, including those kept for reuse
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Also frees the spare references
+*/
+static void FreeClosestCheck(CLOSESTCHECK *check)
+{
+   int i;
+
+   for(i=0; i<MAXCHECKBLOCKS; i++)
+   {
+      FreeCoords(check->reference[i]);
+      check->reference[i] = NULL;
+   }
+   check->nBlocks = 0;
+}
+
+
+/***********************************************************************/
+/*>void SetDefaultOptions(OPTIONS *options)
+   ----------------------------------------
+*//**
+   \param[out] *options        options to fill in
+
+   Sets the options to their defaults: 4 passes, no threads and so on
+
+-  14.10.26 Original - split out of ParseCmdLine()   By: ACRM
+*/
+void SetDefaultOptions(OPTIONS *options)
+{
+   options->inFile[0]  = '\0';
+   options->listFile[0] = '\0';
+   options->seriesFile[0] = '\0';
+   options->seriesBinary = FALSE;
+   options->rmsfFile[0] = '\0';
+   options->checkpointFile[0] = '\0';
+   options->pairwiseFile[0] = '\0';
+   options->pairwiseForm = PAIR_FULL;
+   options->cutoff     = -1.0;
+   options->inFiles    = NULL;
+   options->nInFiles   = 0;
+   options->batch      = FALSE;
+   options->outFile[0] = '\0';
+   options->convert    = FALSE;
+   options->useFloat   = FALSE;
+   options->timing     = FALSE;
+   options->stats      = FALSE;
+   options->statsFile[0] = '\0';
+   options->fit        = FALSE;
+   options->nRefine    = MAXREFINE;
+   options->atoms[0]   = '\0';
+   options->atomsFile[0] = '\0';
+   options->start      = 1;
+   options->stop       = 0;
+   options->stride     = 1;
+   options->nSample    = 0;
+   options->seed       = 1;
+   options->nPasses   = 4;
+   options->nThreads  = 0;
+   options->useMmap   = FALSE;
+   options->useIndex  = FALSE;
+   options->prefetch  = FALSE;
+   options->gpu       = FALSE;
+   options->skipBad   = FALSE;
+   strcpy(options->kernel, "auto");
+}
+
+
+/***********************************************************************/
+/*>BOOL ParseCmdLine(int argc, char **argv, OPTIONS *options)
+   -----------------------------------------------------------
+*//**
+   \param[in]  argc            Argument count
+   \param[in]  argv            Argument array
+   \param[out] *options        Options and input filename from command
+                               line (and output filename for convert)
+
+   Parses the command line
+
+-  24.11.25 Original   By: ACRM
+-  25.11.25 Checks for -h
+-  14.10.26 Added -p / --passes
+-  14.10.26 Added -m / --mmap
+-  14.10.26 Added -i / --index
+-  14.10.26 Added -t / --threads. Now fills in an OPTIONS structure.
+            -t implies -i
+-  14.10.26 Added -k / --kernel
+-  14.10.26 Added convert and -f / --float
+-  14.10.26 Added --timing
+-  14.10.26 Added --stats and --stats-json
+-  14.10.26 Added --fit and --refine
+-  14.10.26 Added --atoms and --atoms-file
+-  14.10.26 Added --start, --stop and --stride
+-  14.10.26 Accepts several trajectories. Added --list
+-  14.10.26 Added --series and --series-binary
+-  14.10.26 Added --rmsf
+-  14.10.26 Added --checkpoint
+-  14.10.26 Added --prefetch
+-  14.10.26 The defaults are set by SetDefaultOptions()
+-  14.10.26 Added --gpu
+-  14.10.26 Added --pairwise, --pairwise-triangle, --pairwise-sparse
+            and --cutoff
+-  14.10.26 Added --skip-bad
+-  14.10.26 Added --sample and --seed
+*/
+BOOL ParseCmdLine(int argc, char **argv, OPTIONS *options)
+{
+   argc--; argv++;
+
+   SetDefaultOptions(options);
+
+   if(argc && !strcmp(argv[0], "convert"))
+   {
+      options->convert = TRUE;
+      argc--; argv++;
+   }
+
+   while(argc)
+   {
+      if((argv[0][0] == '-') && (argv[0][1] != '\0'))
+      {
+         if(!strcmp(argv[0], "-p") || !strcmp(argv[0], "--passes"))
+         {
+            argc--; argv++;
+            if(!argc || (sscanf(argv[0], "%d", &(options->nPasses)) != 1) ||
+               (options->nPasses < 2) || (options->nPasses > 4))
+               return(FALSE);
+         }
+         else if(!strcmp(argv[0], "-m") || !strcmp(argv[0], "--mmap"))
+         {
+            options->useMmap = TRUE;
+         }
+         else if(!strcmp(argv[0], "--prefetch"))
+         {
+            options->prefetch = TRUE;
+         }
+         else if(!strcmp(argv[0], "--gpu"))
+         {
+            options->gpu = TRUE;
+         }
+         else if(!strcmp(argv[0], "-i") || !strcmp(argv[0], "--index"))
+         {
+            options->useIndex = TRUE;
+         }
+         else if(!strcmp(argv[0], "--skip-bad"))
+         {
+            /* The index gives the atom counts of all the frames        */
+            options->skipBad  = TRUE;
+            options->useIndex = TRUE;
+         }
+         else if(!strcmp(argv[0], "-t") || !strcmp(argv[0], "--threads"))
+         {
+            argc--; argv++;
+            if(!argc ||
+               (sscanf(argv[0], "%d", &(options->nThreads)) != 1) ||
+               (options->nThreads < 1) || (options->nThreads > MAXTHREADS))
+               return(FALSE);
+            options->useIndex = TRUE;
+         }
+         else if(!strcmp(argv[0], "-k") || !strcmp(argv[0], "--kernel"))
+         {
+            argc--; argv++;
+            if(!argc)
+               return(FALSE);
+            strncpy(options->kernel, argv[0], MAXKERNELNAME-1);
+            options->kernel[MAXKERNELNAME-1] = '\0';
+         }
+         else if(!strcmp(argv[0], "--timing"))
+         {
+            options->timing = TRUE;
+         }
+         else if(!strcmp(argv[0], "--stats"))
+         {
+            options->stats = TRUE;
+         }
+         else if(!strcmp(argv[0], "--stats-json"))
+         {
+            argc--; argv++;
+            if(!argc)
+               return(FALSE);
+            strncpy(options->statsFile, argv[0], MAXFNM-1);
+            options->statsFile[MAXFNM-1] = '\0';
+         }
+         else if(!strcmp(argv[0], "--fit"))
+         {
+            options->fit = TRUE;
+         }
+         else if(!strcmp(argv[0], "--refine"))
+         {
+            argc--; argv++;
+            if(!argc ||
+               (sscanf(argv[0], "%d", &(options->nRefine)) != 1) ||
+               (options->nRefine < 0))
+               return(FALSE);
+         }
+         else if(!strcmp(argv[0], "--atoms"))
+         {
+            argc--; argv++;
+            if(!argc)
+               return(FALSE);
+            strncpy(options->atoms, argv[0], MAXBUFF-1);
+            options->atoms[MAXBUFF-1] = '\0';
+         }
+         else if(!strcmp(argv[0], "--atoms-file"))
+         {
+            argc--; argv++;
+            if(!argc)
+               return(FALSE);
+            strncpy(options->atomsFile, argv[0], MAXFNM-1);
+            options->atomsFile[MAXFNM-1] = '\0';
+         }
+         else if(!strcmp(argv[0], "--series") ||
+                 !strcmp(argv[0], "--series-binary"))
+         {
+            options->seriesBinary = !strcmp(argv[0], "--series-binary");
+            argc--; argv++;
+            if(!argc)
+               return(FALSE);
+            strncpy(options->seriesFile, argv[0], MAXFNM-1);
+            options->seriesFile[MAXFNM-1] = '\0';
+         }
+         else if(!strcmp(argv[0], "--pairwise") ||
+                 !strcmp(argv[0], "--pairwise-triangle") ||
+                 !strcmp(argv[0], "--pairwise-sparse"))
+         {
+            options->pairwiseForm =
+               !strcmp(argv[0], "--pairwise") ? PAIR_FULL :
+               !strcmp(argv[0], "--pairwise-triangle") ? PAIR_TRIANGLE :
+               PAIR_SPARSE;
+            argc--; argv++;
+            if(!argc)
+               return(FALSE);
+            strncpy(options->pairwiseFile, argv[0], MAXFNM-1);
+            options->pairwiseFile[MAXFNM-1] = '\0';
+         }
+         else if(!strcmp(argv[0], "--cutoff"))
+         {
+            argc--; argv++;
+            if(!argc || (sscanf(argv[0], "%lf", &(options->cutoff)) != 1) ||
+               (options->cutoff < 0.0))
+               return(FALSE);
+         }
+         else if(!strcmp(argv[0], "--rmsf"))
+         {
+            argc--; argv++;
+            if(!argc)
+               return(FALSE);
+            strncpy(options->rmsfFile, argv[0], MAXFNM-1);
+            options->rmsfFile[MAXFNM-1] = '\0';
+         }
+         else if(!strcmp(argv[0], "--checkpoint"))
+         {
+            argc--; argv++;
+            if(!argc)
+               return(FALSE);
+            strncpy(options->checkpointFile, argv[0], MAXFNM-1);
+            options->checkpointFile[MAXFNM-1] = '\0';
+         }
+         else if(!strcmp(argv[0], "--list"))
+         {
+            argc--; argv++;
+            if(!argc)
+               return(FALSE);
+            strncpy(options->listFile, argv[0], MAXFNM-1);
+            options->listFile[MAXFNM-1] = '\0';
+         }
+         else if(!strcmp(argv[0], "--start"))
+         {
+            argc--; argv++;
+            if(!argc || (sscanf(argv[0], "%lu", &(options->start)) != 1) ||
+               (options->start < 1))
+               return(FALSE);
+         }
+         else if(!strcmp(argv[0], "--stop"))
+         {
+            argc--; argv++;
+            if(!argc || (sscanf(argv[0], "%lu", &(options->stop)) != 1) ||
+               (options->stop < 1))
+               return(FALSE);
+         }
+         else if(!strcmp(argv[0], "--stride"))
+         {
+            argc--; argv++;
+            if(!argc ||
+               (sscanf(argv[0], "%lu", &(options->stride)) != 1) ||
+               (options->stride < 1))
+               return(FALSE);
+         }
+         else if(!strcmp(argv[0], "--sample"))
+         {
+            /* The sampled frames are seeked to through the index      */
+            argc--; argv++;
+            if(!argc ||
+               (sscanf(argv[0], "%lu", &(options->nSample)) != 1) ||
+               (options->nSample < 1))
+               return(FALSE);
+            options->useIndex = TRUE;
+         }
+         else if(!strcmp(argv[0], "--seed"))
+         {
+            argc--; argv++;
+            if(!argc || (sscanf(argv[0], "%lu", &(options->seed)) != 1))
+               return(FALSE);
+         }
+         else if(options->convert &&
+                 (!strcmp(argv[0], "-f") || !strcmp(argv[0], "--float")))
+         {
+            options->useFloat = TRUE;
+         }
+         else
+         {
+            /* Includes -h                                              */
+            return(FALSE);
+         }
+      }
+      else
+      {
+         /* The filename(s) must be the last argument(s)                */
+         if(options->convert && (argc != 2))
+            return(FALSE);
+         strncpy(options->inFile, argv[0], MAXFNM-1);
+         options->inFile[MAXFNM-1] = '\0';
+         if(options->convert)
+         {
+            strncpy(options->outFile, argv[1], MAXFNM-1);
+            options->outFile[MAXFNM-1] = '\0';
+         }
+         else
+         {
+            options->inFiles  = argv;
+            options->nInFiles = argc;
+         }
+         break;
+      }
+      argc--; argv++;
+   }
+
+   if(options->convert)
+      return((options->inFile[0] != '\0') &&
+             (options->outFile[0] != '\0') &&
+             (options->listFile[0] == '\0'));
+
+   options->batch = ((options->nInFiles > 1) ||
+                     (options->listFile[0] != '\0'));
+   return(options->batch || (options->inFile[0] != '\0'));
+}
+
+/***********************************************************************/
+/*>BOOL ReadFrame(TRAJ *traj, char *header, COORDS *frame,
+                  SELECTION *select)
+   -------------------------------------------------------
+*//**
+   \param[in,out] *traj        a trajectory read with stdio
+   \param[out] *header         the frame header
+   \param[out] *frame          the frame to read into
+   \param[in]  *select         the atoms to read (NULL for all)
+   \return                     Was a frame read?
+
+   Reads the next frame into the arrays of an existing COORDS
+   structure, growing them if the frame has more atoms than they can
+   hold. Normally they are sized by the first frame and then simply
+   reused.
+
+   Only the lines of the selected atoms are parsed. As with
+   ReadMappedFrame(), a frame with one that doesn't start with three
+   numbers, or with no coordinate lines, is returned with no atoms and
+   traj->badFrame set to FRAME_NOCOORDS, and lines before the first
+   header are returned as a frame with an empty header and
+   FRAME_NOHEADER.
+
+   The header of the next frame is read at the end of each frame and
+   kept in the TRAJ (or an empty string at the end of the file), so
+   separate TRAJs can be read at the same time. Setting
+   traj->firstEntry resets reading after the file has been
+   repositioned.
+
+   traj->pos follows the offset of the next frame's header (from where
+   the file was positioned) and traj->frameStart is set to that of the
+   frame read, so a bad frame can be reported by its offset.
+
+-  24.11.25 Original   By: ACRM
+-  14.10.26 Header is now also returned for the first frame
+-  14.10.26 Reads into a COORDS structure rather than allocating a
+            FRAME linked list
+-  14.10.26 Counts the bytes and lines read
+-  14.10.26 Added atom selection
+-  14.10.26 Takes a TRAJ, which holds the read-ahead header, in place
+            of static variables
+-  14.10.26 Parses into REAL before storing as a COORD
+-  14.10.26 Records the offset of the frame
+-  14.10.26 Checks the selected lines with ParseCoords() and returns
+            bad, empty and headerless frames with traj->badFrame set
+-  14.10.26 Empties the buffer once the header is copied so a header
+            at the end of the file isn't read again
+-  14.10.26 Reads whole lines with ReadTrajLine()
+*/
+BOOL ReadFrame(TRAJ *traj, char *header, COORDS *frame, SELECTION *select)
+{
+   char   *buffer   = traj->lineBuffer;
+   ULONG  nAtoms    = 0,
+          nLines    = 0,
+          nBytes    = 0;
+   size_t len       = 0,
+          offset    = traj->pos;
+   BOOL   readable  = TRUE,
+          inBuffer  = FALSE;
+
+   traj->badFrame   = FRAME_OK;
+   traj->frameStart = (off_t)offset;
+
+   /* With nothing read ahead, read the first line. Otherwise the
+      buffer holds the next header (only its newline was removed) or
+      is empty at the end of the file
+   */
+   if(traj->firstEntry)
+   {
+      traj->firstEntry = FALSE;
+      nBytes = len = ReadTrajLine(traj->fp, buffer);
+      TERMINATE(buffer);
+      inBuffer = (len != 0);
+   }
+   else
+   {
+      len = traj->lineLength;
+   }
+
+   if(buffer[0] == '>')
+   {
+      /* The header is used, so the buffer is empty if the file ends  */
+      strncpy(header, buffer, MAXBUFF-1);
+      offset   += len;
+      inBuffer  = FALSE;
+      buffer[0] = '\0';
+   }
+   else if(inBuffer)
+   {
+      /* Lines before the first header                                  */
+      header[0]      = '\0';
+      traj->badFrame = FRAME_NOHEADER;
+   }
+   else
+   {
+      frame->nAtoms = 0;
+      return(FALSE);
+   }
+
+   while(inBuffer || ((len = ReadTrajLine(traj->fp, buffer)) != 0))
+   {
+      if(inBuffer)
       {
-         INIT(copy, FRAME);
-         c = copy;
+         inBuffer = FALSE;
       }
       else
       {
-         ALLOCNEXT(c, FRAME);
+         nBytes += len;
+         TERMINATE(buffer);
+
+         if(buffer[0] == '>')  /* The next header                       */
+         {
+            traj->lineLength = len;
+            break;
+         }
       }
-      if(c==NULL)
+
+      if(SELECTED(select, nLines))
       {
-         FREELIST(copy, FRAME);
-         return(NULL);
+         char *p = buffer;
+         REAL x, y, z;
+
+         if(!ParseCoords(&p, buffer + strlen(buffer), &x, &y, &z))
+         {
+            readable = FALSE;
+         }
+         else if(readable)
+         {
+            if((nAtoms == frame->maxAtoms) &&
+               !GrowCoords(frame, 2 * frame->maxAtoms))
+            {
+               frame->nAtoms = 0;
+               return(FALSE);
+            }
+            frame->x[nAtoms] = x;
+            frame->y[nAtoms] = y;
+            frame->z[nAtoms] = z;
+            nAtoms++;
+         }
+      }
+      nLines++;
+      offset += len;
+      buffer[0] = '\0';
+   }
+   traj->pos = offset;
+
+   if((!readable || (nLines == 0)) && (traj->badFrame == FRAME_OK))
+      traj->badFrame = FRAME_NOCOORDS;
+   if(traj->badFrame != FRAME_OK)
+      nAtoms = 0;
+
+   CountRead(nBytes, nAtoms, 1);
+   frame->nAtoms = nAtoms;
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>ULONG CountFrames(FILE *fp, FRAMEINDEX *index)
+   -----------------------------------------------
+*//**
+   \param[in]  *in             file pointer to trajectory
+   \param[out] *index          if not NULL, an empty frame index to
+                               fill in with the offset and atom count
+                               of each frame
+   \return                     the number of frames in the file
+
+   Read the number of frames from the file. Any lines before the first
+   header are counted as a frame without one, which is given no atoms
+   in the index. The coordinate lines are only counted, not parsed.
+
+-  24.11.25 Original   By: ACRM
+-  14.10.26 Added index
+-  14.10.26 Counts the bytes read
+-  14.10.26 Counts the frames for --stats
+-  14.10.26 Counts lines before the first header as a frame
+-  14.10.26 Reads whole lines with ReadTrajLine()
+*/
+ULONG CountFrames(FILE *fp, FRAMEINDEX *index)
+{
+   ULONG  frameCount = 0;
+   off_t  offset     = 0;
+   char   buffer[MAXBUFF];
+   BOOL   counting   = TRUE;
+   size_t len;
+
+   while((len = ReadTrajLine(fp, buffer)) != 0)
+   {
+      offset += len;
+      if(buffer[0] == '>')
+      {
+         frameCount++;
+         if((index != NULL) && !AddIndexFrame(index, offset - (off_t)len))
+            break;
+         counting = TRUE;
+      }
+      else if(frameCount == 0)
+      {
+         /* The lines before the first header are a frame which is bad */
+         frameCount++;
+         if(index != NULL)
+         {
+            if(!AddIndexFrame(index, 0))
+               break;
+            index->noHeader = TRUE;
+         }
+         counting = FALSE;
+      }
+      else if((index != NULL) && counting)
+      {
+         index->nAtoms[index->nFrames-1]++;
       }
+   }
+   CountRead((ULONG)offset, 0, frameCount);
+   rewind(fp);
+   return(frameCount);
+}
+
+
+/***********************************************************************/
+/*>REAL RMSFrame(COORDS *frame1, COORDS *frame2, BOOL fit)
+   -------------------------------------------------------
+*//**
+   \param[in]  *frame1         a frame
+   \param[in]  *frame2         a frame
+   \param[in]  fit             superpose the frames first (--fit)
+   \return                     the RMSD or -1.0 if the number of atoms
+                               does not match
+
+   Calculates the RMSD between two frames, after superposing them if
+   fit is set
+
+-  24.11.25 Original   By: ACRM
+-  14.10.26 Works over the contiguous COORDS arrays
+-  14.10.26 Uses the selected sumSqDist kernel
+-  14.10.26 Returns the fitted RMSD with --fit
+-  14.10.26 Uses frame2's kernels
+-  14.10.26 Takes fit rather than using gFit
+*/
+REAL RMSFrame(COORDS *frame1, COORDS *frame2, BOOL fit)
+{
+   REAL  rmsd;
+   ULONG nCoor;
 
-      c->x = f->x;
-      c->y = f->y;
-      c->z = f->z;
+   if(((nCoor = frame1->nAtoms) != frame2->nAtoms) || (nCoor == 0))
+   {
+      return(-1.0);
    }
 
-   return(copy);
+   if(fit)
+      return(FitRMSFrame(frame1, frame2));
+
+   rmsd = frame2->kernels->sumSqDist(frame1->x, frame1->y, frame1->z,
+                                     frame2->x, frame2->y, frame2->z,
+                                     nCoor);
+
+   return(sqrt(rmsd/nCoor));
 }
 
 
 /***********************************************************************/
-/*>BOOL AddFrame(FRAME *meanFrame, FRAME *frame, ULONG frameCount)
-   ---------------------------------------------------------------
+/*>COORDS *AllocCoords(ULONG maxAtoms)
+   -----------------------------------
+*//**
+   \param[in]  maxAtoms        the number of atoms to allocate space for
+   \return                     an empty frame (or NULL if no memory)
+
+   Allocates a COORDS structure and its coordinate arrays
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Counts allocations
+-  14.10.26 Initialises the sums for SINGLE_COORDS
+-  14.10.26 Initialises the kernels
+*/
+COORDS *AllocCoords(ULONG maxAtoms)
+{
+   COORDS *frame;
+
+   if((frame = (COORDS *)CountedMalloc(sizeof(COORDS)))==NULL)
+      return(NULL);
+
+   frame->x        = frame->y = frame->z = NULL;
+#ifdef SINGLE_COORDS
+   frame->sx       = frame->sy = frame->sz = NULL;
+#endif
+   frame->nAtoms   = 0;
+   frame->maxAtoms = 0;
+   frame->kernels  = &gKernels;
+
+   if(!GrowCoords(frame, (maxAtoms > 0) ? maxAtoms : 1))
+   {
+      FreeCoords(frame);
+      return(NULL);
+   }
+
+   return(frame);
+}
+
+
+/***********************************************************************/
+/*>BOOL GrowCoords(COORDS *frame, ULONG maxAtoms)
+   ----------------------------------------------
+*//**
+   \param[in,out] *frame       a frame
+   \param[in]     maxAtoms     the number of atoms needed
+   \return                     FALSE if there was no memory
+
+   Makes sure the coordinate arrays, and any sums, can hold at least
+   maxAtoms atoms. The existing coordinates are kept.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Counts allocations
+-  14.10.26 Arrays are COORD. Grows the sums for SINGLE_COORDS
+*/
+BOOL GrowCoords(COORDS *frame, ULONG maxAtoms)
+{
+   COORD *x, *y, *z;
+
+   if(maxAtoms <= frame->maxAtoms)
+      return(TRUE);
+
+   if((x = (COORD *)CountedRealloc(frame->x,
+                                   maxAtoms * sizeof(COORD)))==NULL)
+      return(FALSE);
+   frame->x = x;
+   if((y = (COORD *)CountedRealloc(frame->y,
+                                   maxAtoms * sizeof(COORD)))==NULL)
+      return(FALSE);
+   frame->y = y;
+   if((z = (COORD *)CountedRealloc(frame->z,
+                                   maxAtoms * sizeof(COORD)))==NULL)
+      return(FALSE);
+   frame->z = z;
+
+#ifdef SINGLE_COORDS
+   if(HASSUMS(frame))
+   {
+      REAL *s;
+      size_t size = maxAtoms * sizeof(REAL);
+
+      if((s = (REAL *)CountedRealloc(frame->sx, size))==NULL)
+         return(FALSE);
+      frame->sx = s;
+      if((s = (REAL *)CountedRealloc(frame->sy, size))==NULL)
+         return(FALSE);
+      frame->sy = s;
+      if((s = (REAL *)CountedRealloc(frame->sz, size))==NULL)
+         return(FALSE);
+      frame->sz = s;
+   }
+#endif
+
+   frame->maxAtoms = maxAtoms;
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>void FreeCoords(COORDS *frame)
+   ------------------------------
+*//**
+   \param[in]  *frame          a frame (may be NULL)
+
+   Frees a COORDS structure and its coordinate arrays
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Frees the sums for SINGLE_COORDS
+*/
+void FreeCoords(COORDS *frame)
+{
+   if(frame != NULL)
+   {
+      free(frame->x);
+      free(frame->y);
+      free(frame->z);
+#ifdef SINGLE_COORDS
+      free(frame->sx);
+      free(frame->sy);
+      free(frame->sz);
+#endif
+      free(frame);
+   }
+}
+
+
+/***********************************************************************/
+/*>BOOL CopyFrame(COORDS *copy, COORDS *frame)
+   -------------------------------------------
+*//**
+   \param[out] *copy           an allocated frame to copy into
+   \param[in]  *frame          the frame to copy
+   \return                     FALSE if there was no memory
+
+   Copies a frame into an existing COORDS structure, growing it only
+   if needed. Only the coordinates are copied, not any sums.
+
+-  24.11.25 Original   By: ACRM
+-  14.10.26 Copies into an existing COORDS rather than allocating
+            a new linked list
+-  14.10.26 Arrays are COORD
+-  14.10.26 Copies the kernels
+*/
+BOOL CopyFrame(COORDS *copy, COORDS *frame)
+{
+   if(!GrowCoords(copy, frame->nAtoms))
+      return(FALSE);
+
+   memcpy(copy->x, frame->x, frame->nAtoms * sizeof(COORD));
+   memcpy(copy->y, frame->y, frame->nAtoms * sizeof(COORD));
+   memcpy(copy->z, frame->z, frame->nAtoms * sizeof(COORD));
+   copy->nAtoms  = frame->nAtoms;
+   copy->kernels = frame->kernels;
+
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>BOOL AddFrame(COORDS *meanFrame, COORDS *frame, ULONG frameCount)
+   -----------------------------------------------------------------
 *//**
    \param[out] *meanFrame      a pre-allocated pretend frame containing
                                averaged coordinates
-   \param[in]  *frame          another frame linked list
+   \param[in]  *frame          another frame
    \param[in]  frameCount      the total number of frames
    \return                     Do the number of coordinates in the
                                frame match the meanFrame?
@@ -604,41 +2664,197 @@ FRAME *CopyFrame(FRAME *frame)
    divided by the number of frames before adding rather than adding
    everything first and dividing by the number of frames.
 
+   The mean is accumulated in SUMX() etc. so StoreSums() must be
+   called before it is used as coordinates.
+
 -  24.11.25 Original   By: ACRM
+-  14.10.26 Works over the contiguous COORDS arrays
+-  14.10.26 Uses the selected addDivided kernel
+-  14.10.26 Accumulates into the sums
+-  14.10.26 Uses the frame's kernels
+*/
+BOOL AddFrame(COORDS *meanFrame, COORDS *frame, ULONG frameCount)
+{
+   ULONG nCoor = meanFrame->nAtoms;
+
+   if(frame->nAtoms != nCoor)
+   {
+      return(FALSE);
+   }
+
+   frame->kernels->addDivided(SUMX(meanFrame), frame->x,
+                              (REAL)frameCount, nCoor);
+   frame->kernels->addDivided(SUMY(meanFrame), frame->y,
+                              (REAL)frameCount, nCoor);
+   frame->kernels->addDivided(SUMZ(meanFrame), frame->z,
+                              (REAL)frameCount, nCoor);
+
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>BOOL AddFrameKahan(COORDS *sum, COORDS *comp, COORDS *frame)
+   ------------------------------------------------------------
+*//**
+   \param[in,out] *sum         running sums of the coordinates
+   \param[in,out] *comp        Kahan compensation for the sums
+   \param[in]     *frame       another frame
+   \return                     Do the number of coordinates in the
+                               frame match the sums?
+
+   Adds the coordinates for `frame` to `sum` using Kahan summation.
+   `comp` holds the (negated) low-order part lost from each sum, so the
+   accurate total is sum - comp. Both are held in SUMX() etc.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Uses the selected addKahan kernel
+-  14.10.26 Accumulates into the sums
+-  14.10.26 Uses the frame's kernels
+*/
+BOOL AddFrameKahan(COORDS *sum, COORDS *comp, COORDS *frame)
+{
+   ULONG nCoor = sum->nAtoms;
+
+   if(frame->nAtoms != nCoor)
+   {
+      return(FALSE);
+   }
+
+   frame->kernels->addKahan(SUMX(sum), SUMX(comp), frame->x, nCoor);
+   frame->kernels->addKahan(SUMY(sum), SUMY(comp), frame->y, nCoor);
+   frame->kernels->addKahan(SUMZ(sum), SUMZ(comp), frame->z, nCoor);
+
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>BOOL ZeroCoords(COORDS *frame, ULONG nAtoms)
+   --------------------------------------------
+*//**
+   \param[in,out] *frame       a frame with space for nAtoms atoms
+   \param[in]     nAtoms       number of atoms
+   \return                     FALSE if no memory
+
+   Sets the number of atoms in a frame and zeros the coordinates and
+   sums, ready to accumulate a mean or sum. With SINGLE_COORDS this
+   allocates the sums the first time.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Zeroes the sums, allocating them for SINGLE_COORDS
 */
-BOOL AddFrame(FRAME *meanFrame, FRAME *frame, ULONG frameCount)
+BOOL ZeroCoords(COORDS *frame, ULONG nAtoms)
 {
-   FRAME *f, *g;
-   f = meanFrame;
-   g = frame;
-   while((f!=NULL) && (g!=NULL))
+#ifdef SINGLE_COORDS
+   if(!HASSUMS(frame))
    {
-      f->x += (g->x / frameCount);
-      f->y += (g->y / frameCount);
-      f->z += (g->z / frameCount);
+      size_t size = frame->maxAtoms * sizeof(REAL);
+
+      if(((frame->sx = (REAL *)CountedMalloc(size))==NULL) ||
+         ((frame->sy = (REAL *)CountedMalloc(size))==NULL) ||
+         ((frame->sz = (REAL *)CountedMalloc(size))==NULL))
+      {
+         free(frame->sx);
+         free(frame->sy);
+         frame->sx = frame->sy = NULL;
+         return(FALSE);
+      }
+   }
+   memset(frame->sx, 0, nAtoms * sizeof(REAL));
+   memset(frame->sy, 0, nAtoms * sizeof(REAL));
+   memset(frame->sz, 0, nAtoms * sizeof(REAL));
+#endif
+   frame->nAtoms = nAtoms;
+   memset(frame->x, 0, nAtoms * sizeof(COORD));
+   memset(frame->y, 0, nAtoms * sizeof(COORD));
+   memset(frame->z, 0, nAtoms * sizeof(COORD));
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>void StoreSums(COORDS *frame)
+   -----------------------------
+*//**
+   \param[in,out] *frame       a mean accumulated in the sums
+
+   Makes the coordinates of a mean built in SUMX() etc. available as
+   x, y and z. With SINGLE_COORDS they are rounded from the sums, which
+   are kept; otherwise they are the same arrays so there is nothing to
+   do.
 
-      NEXT(f);
-      NEXT(g);
+-  14.10.26 Original   By: ACRM
+*/
+void StoreSums(COORDS *frame)
+{
+#ifdef SINGLE_COORDS
+   ULONG i;
+
+   for(i=0; i<frame->nAtoms; i++)
+   {
+      frame->x[i] = (COORD)frame->sx[i];
+      frame->y[i] = (COORD)frame->sy[i];
+      frame->z[i] = (COORD)frame->sz[i];
    }
+#endif
+}
+
+
+/***********************************************************************/
+/*>BOOL UpdateRunningMean(COORDS *meanFrame, COORDS *frame,
+                          ULONG nFrames)
+   ------------------------------------------------------
+*//**
+   \param[in,out] *meanFrame   pretend frame containing the mean of the
+                               first nFrames-1 frames
+   \param[in]     *frame       another frame
+   \param[in]     nFrames      the number of frames including this one
+   \return                     Do the number of coordinates in the
+                               frame match the meanFrame?
+
+   Updates the running mean coordinates in `meanFrame` with `frame`
+   using Welford's method: mean += (x - mean) / n
+
+   The mean is kept in SUMX() etc. and stored as the coordinates each
+   time, since the running mean is used as each frame is read.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Works over the contiguous COORDS arrays
+-  14.10.26 Uses the selected updateMean kernel
+-  14.10.26 Accumulates into the sums
+-  14.10.26 Uses the frame's kernels
+*/
+BOOL UpdateRunningMean(COORDS *meanFrame, COORDS *frame, ULONG nFrames)
+{
+   ULONG nCoor = meanFrame->nAtoms;
 
-   if((f != NULL) || (g != NULL))
+   if(frame->nAtoms != nCoor)
    {
       return(FALSE);
    }
-   
+
+   frame->kernels->updateMean(SUMX(meanFrame), frame->x, (REAL)nFrames,
+                              nCoor);
+   frame->kernels->updateMean(SUMY(meanFrame), frame->y, (REAL)nFrames,
+                              nCoor);
+   frame->kernels->updateMean(SUMZ(meanFrame), frame->z, (REAL)nFrames,
+                              nCoor);
+   StoreSums(meanFrame);
+
    return(TRUE);
 }
 
 
 /***********************************************************************/
-void PrintFrame(char *header, FRAME *frame)
+void PrintFrame(char *header, COORDS *frame)
 {
-   FRAME *f;
-   
+   ULONG i;
+
    printf("%s\n", header);
-   for(f=frame; f!=NULL; NEXT(f))
+   for(i=0; i<frame->nAtoms; i++)
    {
-      printf("%.3f %.3f %.3f\n",f->x, f->y, f->z);
+      printf("%.3f %.3f %.3f\n", frame->x[i], frame->y[i], frame->z[i]);
    }
 }
 
@@ -650,12 +2866,232 @@ void PrintFrame(char *header, FRAME *frame)
    Print usage message
 
 -  24.11.25 Original   By: ACRM
+-  14.10.26 V1.1
+-  14.10.26 V1.2
+-  14.10.26 V1.3
+-  14.10.26 V1.4
+-  14.10.26 V1.5
+-  14.10.26 V1.6
+-  14.10.26 V1.7
+-  14.10.26 V1.8
+-  14.10.26 V1.10
+-  14.10.26 V1.11
+-  14.10.26 V1.12
+-  14.10.26 V1.13
+-  14.10.26 V1.14
+-  14.10.26 V1.15
+-  14.10.26 V1.16
+-  14.10.26 V1.17
+-  14.10.26 V1.18
+-  14.10.26 V1.20
+-  14.10.26 V1.21
+-  14.10.26 V1.27
+-  14.10.26 V1.28
+-  14.10.26 V1.29
+-  14.10.26 V1.30
 */
 void Usage(void)
 {
-   printf("\nflexcalc V1.0 (c) Andrew C.R. Martin, abYinformatics\n");
-
-   printf("\nUsage: flexcalc trajectoryfile\n");
+   printf("\nflexcalc V1.30 (c) Andrew C.R. Martin, abYinformatics\n");
+
+   printf("\nUsage: flexcalc [-p 2|3|4] [-m] [-i] [-t nthreads] \
+[-k kernel] [--prefetch]\n");
+   printf("                [--gpu] [--timing] [--stats] [--stats-json \
+file] [--fit]\n");
+   printf("                [--refine n] [--atoms list | --atoms-file \
+file]\n");
+   printf("                [--start n] [--stop n] [--stride n]\n");
+   printf("                [--series file | --series-binary file] \
+[--rmsf file]\n");
+   printf("                [--checkpoint file] [--list file]\n");
+   printf("                [--pairwise file | --pairwise-triangle file \
+|\n");
+   printf("                 --pairwise-sparse file --cutoff r] \
+[--skip-bad]\n");
+   printf("                [--sample n [--seed n]] trajectoryfile ...\n");
+   printf("       flexcalc convert [-m] [-f] [--atoms list | \
+--atoms-file file]\n");
+   printf("                [--start n] [--stop n] [--stride n] \
+[--skip-bad]\n");
+   printf("                trajectoryfile binaryfile\n");
+   printf("       The trajectoryfile may be - to read standard input, \
+or a gzip or\n");
+   printf("       zstd compressed file. These are read once, into a \
+temporary binary\n");
+   printf("       trajectory (see convert) in $TMPDIR.\n");
+   printf("       Given several trajectories (or --list), each is \
+processed on a shared\n");
+   printf("       pool of threads and a line with its name and \
+result is printed, in\n");
+   printf("       the order given (\"name error\" if it fails).\n");
+   printf("       -p  Number of passes through the file (default 4). \
+With 3 passes\n");
+   printf("           a running mean is used so the frames needn't be \
+counted first.\n");
+   printf("           With 2 passes the closest frame to the mean is \
+also chosen\n");
+   printf("           from a set of candidates while calculating the \
+mean. If another\n");
+   printf("           frame might be closer, those that might be are \
+checked again\n");
+   printf("           (cheaply with -i), so the result is the same.\n");
+   printf("       -m  Memory map the file and parse it in place. This is \
+much faster\n");
+   printf("           and makes the extra passes cheap when the file is \
+in the page\n");
+   printf("           cache.\n");
+   printf("       --prefetch  Without -m, read the file ahead in large \
+blocks on a\n");
+   printf("           separate I/O thread so that reading overlaps the \
+calculations.\n");
+   printf("       -i  Build an index of the frames while counting them \
+and save it\n");
+   printf("           as trajectoryfile.fcidx. If this is up to date, \
+it is reused\n");
+   printf("           and the frames are not counted again.\n");
+   printf("       --skip-bad  Leave out frames whose number of atoms \
+differs from that\n");
+   printf("           of most of the frames, or which can't be read, \
+with a warning\n");
+   printf("           giving each one's number and byte offset, \
+rather than stopping.\n");
+   printf("           Implies -i. With convert, --pairwise or a \
+stream, frames are\n");
+   printf("           compared with the first as they are read. Not \
+with --checkpoint.\n");
+   printf("       -t  Use the specified number of threads to find the \
+closest frame\n");
+   printf("           and calculate the RMSDs. Implies -i. Results \
+with -t 1 are\n");
+   printf("           identical to the default. With more than one \
+thread, the mean\n");
+   printf("           is also calculated in parallel using compensated \
+summation.\n");
+   printf("       -k  Select the vectorised kernels to use (");
+   ListKernels(stdout);
+   printf(").\n");
+   printf("           By default the best supported by the CPU is used. \
+The choice\n");
+   printf("           only affects the last few digits of the RMSDs; \
+use -k scalar\n");
+   printf("           to reproduce earlier versions exactly.\n");
+   printf("       --gpu     Calculate the mean and RMSDs on a GPU \
+(only in a build made\n");
+   printf("                 with make gpu). The frames are still parsed \
+here, while the\n");
+   printf("                 last batch is on the GPU. The mean uses \
+compensated\n");
+   printf("                 summation as with -t. Not with --fit or \
+-t.\n");
+   printf("       --timing  Report the time taken by each pass on \
+stderr.\n");
+   printf("       --stats   Report the wall and CPU time, bytes read, \
+coordinate lines\n");
+   printf("                 parsed, frames read, allocations and peak \
+memory use for\n");
+   printf("                 each pass on stderr.\n");
+   printf("       --stats-json  Write the same statistics to a JSON \
+file.\n");
+   printf("       --fit     Superpose the frames before calculating \
+each RMSD so that\n");
+   printf("                 rigid-body motion is ignored. The mean is \
+refined by fitting\n");
+   printf("                 every frame to it and recalculating it, \
+which needs an\n");
+   printf("                 extra pass of the file per cycle. With -p 2 \
+the closest\n");
+   printf("                 frame is then found with a full pass.\n");
+   printf("       --refine  Maximum number of mean refinement cycles \
+with --fit\n");
+   printf("                 (default %d). Stops early once the mean \
+changes by less\n", MAXREFINE);
+   printf("                 than 0.0001A. 0 uses the unfitted mean.\n");
+   printf("       --atoms   Only use the listed atoms of each frame, \
+e.g. 1-100,205,300-\n");
+   printf("                 (numbered from 1; a range with no end runs \
+to the end of\n");
+   printf("                 the frame). Other lines are skipped \
+without being parsed.\n");
+   printf("                 With convert, only these atoms are \
+written.\n");
+   printf("       --atoms-file  Read the atom list from a file (may be \
+split over lines;\n");
+   printf("                 # starts a comment).\n");
+   printf("       --series  Write the RMSD of each frame to a file \
+as it is calculated,\n");
+   printf("                 one line per frame: frame number, RMSD \
+and header.\n");
+   printf("       --series-binary  The same as binary records (see \
+README.md).\n");
+   printf("       --rmsf    Write the RMS fluctuation of each atom \
+to a file, one line\n");
+   printf("                 per atom: atom number and RMSF. These are \
+gathered in the\n");
+   printf("                 mean pass (or, with --fit, the last \
+refinement cycle).\n");
+   printf("       --checkpoint  Keep the state of the mean pass in a \
+file. If the\n");
+   printf("                 trajectory has only been appended to since, \
+just the new\n");
+   printf("                 frames are read to update the mean, then \
+the closest frame\n");
+   printf("                 and RMSD passes use the saved index. -p is \
+ignored.\n");
+   printf("       --list    Read trajectory names from a file, one \
+per line (blank lines\n");
+   printf("                 and lines starting # are ignored), as \
+well as any given.\n");
+   printf("                 The pool has -t threads (default one per \
+CPU). With -t the\n");
+   printf("                 passes through each trajectory are also \
+split across the\n");
+   printf("                 threads, so results match running each \
+with the same -t.\n");
+   printf("                 Statistics cover the whole batch.\n");
+   printf("       --pairwise  Instead of the score, write the RMSD \
+between every pair of\n");
+   printf("                 frames to a binary file (see README.md) as \
+a float matrix.\n");
+   printf("                 Only the frames are held in memory. They \
+are compared in\n");
+   printf("                 cache-sized tiles, shared between -t \
+threads. --fit and\n");
+   printf("                 the atom selection and frame window \
+apply.\n");
+   printf("       --pairwise-triangle  The same, but just the upper \
+triangle.\n");
+   printf("       --pairwise-sparse  Write a text line (frame1 frame2 \
+RMSD) for each pair\n");
+   printf("                 of frames no more than --cutoff apart.\n");
+   printf("       --start, --stop, --stride  Only use frames start \
+(default 1) to stop\n");
+   printf("                 (default the last), taking every stride'th \
+frame. With -i\n");
+   printf("                 or a binary trajectory the other frames are \
+seeked over;\n");
+   printf("                 otherwise they are skipped without parsing \
+them. With\n");
+   printf("                 convert, only these frames are written.\n");
+   printf("       --sample  Use just n frames of the window, chosen at \
+random and read\n");
+   printf("                 through the index (implies -i), for a quick \
+estimate. The\n");
+   printf("                 score is followed by its 95%% bootstrap \
+interval. Not with\n");
+   printf("                 convert, --pairwise, --checkpoint or \
+--gpu.\n");
+   printf("       --seed    Seed for choosing the frames (default 1), \
+so runs repeat.\n");
+   printf("\n       convert writes a compact binary copy of the \
+trajectory which can\n");
+   printf("       then be given in place of the text file and is read \
+with no\n");
+   printf("       parsing. Coordinates are stored as fixed point to \
+0.001, which is\n");
+   printf("       exact for the usual 3 decimal places.\n");
+   printf("       -f  Store the coordinates as 32-bit floats instead. \
+This is not\n");
+   printf("           exact, but has no limit on their size.\n");
 
    printf("\nTakes a simple trajectory file in the format:\n");
    printf("      >frame header\n");
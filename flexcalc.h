@@ -0,0 +1,599 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       flexcalc.h
+
+   Version:    V1.30
+   Date:       14.10.26
+   Function:   Shared definitions for flexcalc
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   Types, defines and prototypes shared between the flexcalc source
+   files.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.3   14.10.26 Original - split out of flexcalc.c when the
+                   memory-mapped reader (trajio.c) was added
+   V1.4   14.10.26 Added FRAMEINDEX (frameindex.c)
+   V1.5   14.10.26 Added OPTIONS and threaded passes (parallel.c)
+   V1.6   14.10.26 Added threaded mean and Kahan summation
+   V1.7   14.10.26 Added KERNELS (kernels.c)
+   V1.8   14.10.26 Added binary trajectories (fcbio.c)
+   V1.9   14.10.26 Added streamed trajectories
+   V1.10  14.10.26 Added timing
+   V1.11  14.10.26 Added stats (stats.c)
+   V1.12  14.10.26 Added fitted RMSDs (fit.c)
+   V1.13  14.10.26 Added SELECTION (select.c)
+   V1.14  14.10.26 Added a frame window to TRAJ
+   V1.15  14.10.26 Added batch runs and POOL (pool.c)
+   V1.16  14.10.26 Added SERIES (series.c)
+   V1.17  14.10.26 Added RMSF (rmsf.c)
+   V1.18  14.10.26 Added checkpoints (checkpoint.c)
+   V1.19  14.10.26 Candidates record their frame number
+   V1.20  14.10.26 TRAJ holds the stdio reader's state
+   V1.21  14.10.26 Added read-ahead (prefetch.c)
+   V1.23  14.10.26 Added COORD and the SINGLE_COORDS build, in which
+                   coordinates are stored as float
+   V1.24  14.10.26 COORDS and TRAJ carry kernels chosen for their
+                   atom count (KernelsForAtoms())
+   V1.25  14.10.26 Added trajectories held in memory (memtraj.c),
+                   FLEXRESULT and the library context (library.c).
+                   TRAJ carries the kernels, --fit, RMSFs and series
+                   of its calculation
+   V1.26  14.10.26 MergeKahanSums() is public for the MPI build
+   V1.27  14.10.26 Added the GPU passes (gpu.cu). May be included from
+                   C++
+   V1.28  14.10.26 Added the pairwise RMSD matrix (pairwise.c)
+   V1.29  14.10.26 TRAJ can leave out frames that don't match
+                   (--skip-bad), and records why a frame read is bad
+                   and the atoms a spilled stream holds
+   V1.30  14.10.26 TRAJ can read a random sample of the window
+                   (sample.c)
+
+*************************************************************************/
+#ifndef _FLEXCALC_H
+#define _FLEXCALC_H
+
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/types.h>
+#include "bioplib/macros.h"
+#include "bioplib/SysDefs.h"
+#include "bioplib/MathType.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***********************************************************************/
+/* Defines and macros
+ */
+#define MAXBUFF 512
+#define MAXFNM  1024
+#define PROGNAME "flexcalc"
+#define MSG_ATOMMISMATCH "Number of coordinates in frame doesn't match \
+first frame.\n  Frame Header: "
+#define MSG_NOMEM "No memory"
+#define MAXCANDIDATES 16  /* Candidate closest frames kept with -p 2    */
+#define MINATOMS 1024     /* Initial allocation for the first frame     */
+#define MAXTHREADS 1024
+#define MAXKERNELNAME 16
+#define FCB_INT32   0     /* Binary coordinate encodings (fcbio.c)      */
+#define FCB_FLOAT32 1
+#define FCB_FLOAT64 2
+#define NINNERSUMS  16    /* Sums gathered by the innerProduct kernel   */
+#define MAXREFINE   10    /* Default mean refinement cycles with --fit  */
+#define REFINETOL   1.0e-4 /* RMSD change (A) at which refinement stops */
+#define NBOOTSTRAP  1000  /* Bootstrap resamples for --sample          */
+#define PAIR_FULL     0   /* Pairwise RMSD forms (pairwise.c)           */
+#define PAIR_TRIANGLE 1
+#define PAIR_SPARSE   2
+#define FRAME_OK       0  /* Why a frame read is bad (TRAJ badFrame)   */
+#define FRAME_NOHEADER 1  /*    The lines before the first header      */
+#define FRAME_NOCOORDS 2  /*    No lines or one that can't be read     */
+
+/* Tests whether atom i (from 0) of a frame is in a SELECTION. A NULL
+   selection selects every atom.
+*/
+#define SELECTED(s, i) (((s) == NULL) || ((i) >= (s)->allFrom) || \
+                        (((i) < (s)->nMask) && (s)->mask[i]))
+
+/* The first line of a frame (from 0) from which a SELECTION selects
+   nothing (ULONG_MAX if there is none). This is 0 when nothing is
+   selected, as when frames are being skipped
+*/
+#define LASTLINE(s) ((((s) == NULL) || ((s)->allFrom != ULONG_MAX)) ? \
+                     ULONG_MAX : (s)->nMask)
+
+/* The type used to store coordinates. Building with -DSINGLE_COORDS
+   stores them as float, halving the memory each frame takes. All
+   arithmetic, and every sum over frames, is still done in REAL.
+*/
+#ifdef SINGLE_COORDS
+typedef float COORD;
+#else
+typedef REAL  COORD;
+#endif
+
+/* A frame of coordinates held as contiguous arrays. The arrays are
+   sized from the first frame read and then reused for every frame.
+
+   A COORDS used to build a mean or sum over frames accumulates into
+   SUMX(), SUMY() and SUMZ(). Normally these are just x, y and z, but
+   with SINGLE_COORDS they are separate REAL arrays (allocated by
+   ZeroCoords()) and StoreSums() rounds them into x, y and z.
+*/
+typedef struct
+{
+   COORD *x, *y, *z;
+#ifdef SINGLE_COORDS
+   REAL  *sx, *sy, *sz;   /* The sums in full precision (or NULL)       */
+#endif
+   ULONG nAtoms,          /* Number of atoms in this frame              */
+         maxAtoms;        /* Number of atoms allocated                  */
+   struct kernels *kernels;  /* Kernels for nAtoms (KernelsForAtoms())  */
+}  COORDS;
+
+#ifdef SINGLE_COORDS
+#  define SUMX(f)    ((f)->sx)
+#  define SUMY(f)    ((f)->sy)
+#  define SUMZ(f)    ((f)->sz)
+#  define HASSUMS(f) ((f)->sx != NULL)
+#else
+#  define SUMX(f)    ((f)->x)
+#  define SUMY(f)    ((f)->y)
+#  define SUMZ(f)    ((f)->z)
+#  define HASSUMS(f) TRUE
+#endif
+
+typedef struct
+{
+   COORDS *frame;
+   REAL   rmsd;
+   ULONG  frameNum;       /* Position in the frames read (from 0)       */
+   char   header[MAXBUFF];
+}  CANDIDATE;
+
+/* The byte offset and atom count of every frame in a trajectory      */
+typedef struct
+{
+   off_t  *offset;        /* Offset of each frame's header line         */
+   ULONG  *nAtoms;        /* Number of atoms in each frame              */
+   ULONG  nFrames,
+          maxFrames;
+   off_t  fileSize;       /* Size, modification time (seconds and       */
+   time_t fileTime;       /* nanoseconds) and inode of the trajectory   */
+   long   fileNsec;       /* when it was indexed                        */
+   ino_t  fileInode;
+   BOOL   noHeader;       /* Frame 0 is lines before the first header   */
+}  FRAMEINDEX;
+
+/* The atoms to read from each frame (select.c)                        */
+typedef struct
+{
+   char  *mask;           /* Non-zero for each selected atom            */
+   ULONG nMask,           /* Atoms covered by the mask                  */
+         allFrom;         /* Atoms from here on are all selected        */
+}  SELECTION;
+
+/* A per-frame RMSD series being written (series.c)                   */
+typedef struct
+{
+   FILE  *fp;
+   char  *buffer;         /* stdio buffer for fp                        */
+   BOOL  binary;
+}  SERIES;
+
+/* Per-atom sums of squared coordinates for the RMSFs (rmsf.c)        */
+typedef struct
+{
+   REAL  *sumSq;          /* Sum of x*x + y*y + z*z over the frames     */
+   ULONG nAtoms,
+         maxAtoms,        /* Atoms allocated                            */
+         nFrames;         /* Frames added                               */
+}  RMSF;
+
+/* A frame held in the caller's memory (memtraj.c). Nothing is copied
+   when it is added, so the arrays must stay valid while it is used.
+*/
+typedef struct
+{
+   COORD *x, *y, *z;      /* The caller's coordinates. Not owned        */
+   char  *header;         /* The caller's header (NULL for none)        */
+   ULONG nAtoms;
+}  MEMFRAME;
+
+/* An open trajectory. Either fp is set and frames are read with
+   fgets() or the file is memory mapped and data points to the
+   mapping. A binary trajectory (fcbio.c) is read in the same two ways
+   but has its frame offsets and headers loaded when it is opened. A
+   trajectory in memory (memtraj.c) has no file, just a table of the
+   caller's frames.
+*/
+typedef struct
+{
+   FILE   *fp;
+   char   *data;          /* The mapped file                            */
+   size_t size,           /* Size of the mapped file                    */
+          pos;            /* Offset of the next line (stdio: frame)     */
+   BOOL   mapped,
+          shared,         /* Mapping belongs to another TRAJ            */
+          binary,         /* A binary (.fcb) trajectory                 */
+          memory,         /* Frames held in memory (memtraj.c)          */
+          stream;         /* stdin or a pipe which can't be rewound     */
+   pid_t  pid;            /* Decompressor writing to the stream         */
+   char   filename[MAXFNM];
+   ULONG  frameNum,       /* Number of the next frame in the file       */
+          firstFrame,     /* Frames read are firstFrame, firstFrame +   */
+          lastFrame,      /* stride ... up to lastFrame (all counted    */
+          stride;         /* from 0)                                    */
+   FRAMEINDEX *index;     /* Used to seek over frames. Not owned        */
+   int    encoding;       /* Binary trajectories: an FCB_ encoding      */
+   ULONG  nAtoms,         /*    Atoms in every frame                    */
+          nFrames,        /*    Number of frames                        */
+          *headerOffset;  /*    Offset of each header in headers        */
+   size_t frameSize;      /*    Bytes per frame                         */
+   off_t  *frameOffset;   /*    Offset of each frame                    */
+   char   *headers;       /*    The frame headers                       */
+   void   *buffer;        /*    A frame read with stdio                 */
+   MEMFRAME *frames;      /* In memory: the frames (nFrames of them)    */
+   ULONG  maxFrames;      /*    Space in frames                         */
+   SELECTION *select;     /* Atoms to read (NULL for all). Not owned    */
+   SELECTION *kept;       /* Spilled stream: the atoms it holds (NULL   */
+                          /* for all). Not owned                        */
+   off_t  frameStart;     /* Text: offset of the last frame read        */
+   BOOL   skipBad;        /* Leave out frames that don't match          */
+   int    badFrame;       /* Text: why the last frame read was bad      */
+   ULONG  *skip,          /* Window positions (from 0, sorted) of the   */
+          nSkip,          /* frames left out. Not owned                 */
+          *sample,        /* Frames (from 0, sorted) read in place of   */
+          nSample;        /* the window if not NULL. Not owned          */
+   struct kernels *kernelSet,  /* Kernels to use (NULL for gKernels)   */
+                  *kernels;    /* Chosen for kernelAtoms (or NULL)     */
+   ULONG  kernelAtoms;    /* Atoms in the frames read                   */
+   BOOL   fit;            /* RMSDs after superposition (--fit)          */
+   RMSF   *rmsf;          /* Gathers the RMSFs (or NULL). Not owned     */
+   SERIES *series;        /* Writes the RMSD series (or NULL). Not      */
+                          /* owned                                      */
+   BOOL   firstEntry;     /* stdio: nothing read ahead yet              */
+   char   lineBuffer[MAXBUFF];  /* stdio: the next frame's header,     */
+                                /* read at the end of the last frame   */
+   size_t lineLength;     /* stdio: bytes in that header's line         */
+}  TRAJ;
+
+/* A set of inner-loop kernels working on single coordinate arrays,
+   apart from sumSqDist and innerProduct which take the x, y and z
+   arrays of two frames and addSquares which adds x*x + y*y + z*z of
+   one frame to sum[]. innerProduct adds to sums[NINNERSUMS]: the
+   sums of x1, y1, z1, x2, y2, z2, the sum of all their squares and
+   the cross products x1x2, x1y2, x1z2, y1x2, ... z1z2.
+*/
+typedef struct kernels
+{
+   char *name;
+   REAL (*sumSqDist)(COORD *x1, COORD *y1, COORD *z1,
+                     COORD *x2, COORD *y2, COORD *z2, ULONG n);
+   void (*addDivided)(REAL *sum, COORD *x, REAL divisor, ULONG n);
+   void (*updateMean)(REAL *mean, COORD *x, REAL count, ULONG n);
+   void (*addKahan)(REAL *sum, REAL *comp, COORD *x, ULONG n);
+   void (*innerProduct)(COORD *x1, COORD *y1, COORD *z1,
+                        COORD *x2, COORD *y2, COORD *z2, ULONG n,
+                        REAL *sums);
+   void (*addSquares)(REAL *sum, COORD *x, COORD *y, COORD *z,
+                      ULONG n);
+   ULONG width;                 /* Atoms per vector                     */
+   struct kernels *blocked,     /* For a multiple of width atoms and    */
+                  *fixed;       /* for FIXEDATOMS atoms (or NULL)       */
+}  KERNELS;
+
+/* A work-stealing thread pool (pool.c) and a group of tasks submitted
+   to it. pending counts the tasks in the group not yet finished.
+*/
+typedef struct pool POOL;
+
+typedef struct
+{
+   ULONG pending;
+}  TASKGROUP;
+
+/* Command line options                                                 */
+typedef struct
+{
+   char inFile[MAXFNM],
+        outFile[MAXFNM],        /* Binary trajectory for convert        */
+        statsFile[MAXFNM],      /* JSON statistics report               */
+        kernel[MAXKERNELNAME],  /* Kernels to use ("auto" for the best) */
+        atoms[MAXBUFF],         /* Atom selection                       */
+        atomsFile[MAXFNM],      /* ...or file containing it             */
+        listFile[MAXFNM],       /* File listing trajectories for batch  */
+        seriesFile[MAXFNM],     /* Per-frame RMSDs                      */
+        rmsfFile[MAXFNM],       /* Per-atom RMSFs                       */
+        checkpointFile[MAXFNM], /* Saved state of the mean pass         */
+        pairwiseFile[MAXFNM],   /* All-against-all RMSDs                */
+        **inFiles;              /* All the trajectories given           */
+   int  nInFiles,         /* Number of trajectories in inFiles          */
+        nPasses,          /* Passes through the file (2-4)              */
+        nThreads,         /* Threads for the later passes (0 = serial)  */
+        nRefine,          /* Maximum mean refinement cycles with fit    */
+        pairwiseForm;     /* PAIR_FULL, PAIR_TRIANGLE or PAIR_SPARSE    */
+   ULONG start,           /* First frame to use (from 1)                */
+         stop,            /* Last frame to use (0 for the end)          */
+         stride,          /* Use every stride'th frame                  */
+         nSample,         /* Random frames to use (0 for all)           */
+         seed;            /* Seed for choosing them                     */
+   REAL cutoff;           /* Largest RMSD written by PAIR_SPARSE        */
+   BOOL useMmap,          /* Memory map the file                        */
+        useIndex,         /* Build or reuse a frame index               */
+        convert,          /* Convert to a binary trajectory             */
+        useFloat,         /* ...with float rather than fixed point      */
+        timing,           /* Report the time for each pass              */
+        stats,            /* Report statistics for each pass            */
+        fit,              /* Superpose frames before each RMSD          */
+        prefetch,         /* Read stdio files ahead in an I/O thread    */
+        gpu,              /* Make the passes on a GPU (make gpu)        */
+        skipBad,          /* Leave out frames that don't match          */
+        batch,            /* Several trajectories (or a list)           */
+        seriesBinary;     /* Write the series as binary records         */
+}  OPTIONS;
+
+/* The results for one trajectory. The frames belong to the caller,
+   who must free them with FreeCoords().
+*/
+typedef struct
+{
+   COORDS *meanFrame,     /* Mean coordinates                           */
+          *closestFrame;  /* The frame closest to the mean              */
+   REAL   meanRMSD,       /* Mean RMSD from the closest frame           */
+          interval[2];    /* Its 95% bootstrap interval with --sample   */
+   ULONG  nFrames,        /* Frames used                                */
+          nSkipped;       /* Frames left out by --skip-bad              */
+   char   header[MAXBUFF];  /* Header of the closest frame              */
+}  FLEXRESULT;
+
+/* A calculation on frames pushed from the caller's memory
+   (library.c). The options are those of the command line; those for
+   files, such as --series, are not used. The context may be reset
+   and reused for any number of trajectories.
+*/
+typedef struct
+{
+   OPTIONS    options;
+   SELECTION  *select;    /* Atoms to use (NULL for all). Not owned     */
+   TRAJ       *traj;      /* The frames pushed                          */
+   FLEXRESULT result;     /* From the last RunFlexCalc()                */
+   BOOL       done;       /* result is filled in                        */
+}  FLEXCALC;
+
+
+/***********************************************************************/
+/* Prototypes
+ */
+/* flexcalc.c                                                           */
+BOOL  ParseCmdLine(int argc, char **argv, OPTIONS *options);
+void  SetDefaultOptions(OPTIONS *options);
+ULONG GetFrameIndex(TRAJ *in, char *inFile, FRAMEINDEX *index);
+SELECTION *GetSelection(OPTIONS *options);
+void  SetWindow(TRAJ *in, OPTIONS *options);
+void  GetFileList(OPTIONS *options);
+BOOL  CalculateFlexibility(char *inFile, OPTIONS *options,
+                           SELECTION *select, RMSF *rmsf,
+                           SERIES *series, BOOL passStats,
+                           REAL *meanRMSD, REAL *interval,
+                           ULONG *nFrames);
+BOOL  CalculateTrajFlexibility(TRAJ *in, char *inFile, OPTIONS *options,
+                               BOOL passStats, FLEXRESULT *result);
+int   RunBatch(OPTIONS *options, SELECTION *select);
+COORDS *CalculateMeanCoords(TRAJ *in, ULONG frameCount);
+COORDS *CalculateRunningMean(TRAJ *in, ULONG *frameCount,
+                             COORDS **closestFrame, char *header);
+BOOL  UpdateRunningMean(COORDS *meanFrame, COORDS *frame, ULONG nFrames);
+BOOL  UpdateCandidates(CANDIDATE *candidates, int *nCandidates,
+                       COORDS **frame, REAL rmsd, char *header,
+                       ULONG frameNum, ULONG *dropped);
+COORDS *FindClosestToMean(TRAJ *in, COORDS *meanFrame, char *header);
+REAL  CalculateMeanRMSD(TRAJ *in, COORDS *closestFrame, ULONG frameCount,
+                        REAL *rmsds);
+ULONG CountFrames(FILE *fp, FRAMEINDEX *index);
+BOOL  ReadFrame(TRAJ *traj, char *header, COORDS *frame,
+                 SELECTION *select);
+REAL  RMSFrame(COORDS *frame1, COORDS *frame2, BOOL fit);
+void  Usage(void);
+COORDS *AllocCoords(ULONG maxAtoms);
+BOOL  GrowCoords(COORDS *frame, ULONG maxAtoms);
+void  FreeCoords(COORDS *frame);
+BOOL  CopyFrame(COORDS *copy, COORDS *frame);
+BOOL  AddFrame(COORDS *meanFrame, COORDS *frame, ULONG frameCount);
+BOOL  AddFrameKahan(COORDS *sum, COORDS *comp, COORDS *frame);
+BOOL  ZeroCoords(COORDS *frame, ULONG nAtoms);
+void  StoreSums(COORDS *frame);
+void  Die(const char *msg, const char *submsg);
+void  Msg(const char *msg, const char *submsg);
+void  PrintFrame(char *header, COORDS *frame);
+
+/* trajio.c                                                             */
+TRAJ  *OpenTraj(char *filename, BOOL useMmap);
+void  CloseTraj(TRAJ *traj);
+void  RewindTraj(TRAJ *traj);
+BOOL  ReadTrajFrame(TRAJ *traj, char *header, COORDS *frame);
+BOOL  SeekTraj(TRAJ *traj, off_t offset);
+TRAJ  *DupTraj(TRAJ *traj);
+BOOL  IsStreamTraj(char *filename);
+TRAJ  *OpenStreamTraj(char *filename);
+BOOL  FinishStream(TRAJ *traj);
+TRAJ  *SpillTraj(char *filename, SELECTION *select, BOOL skipBad);
+void  SetTrajWindow(TRAJ *traj, ULONG firstFrame, ULONG lastFrame,
+                    ULONG stride);
+ULONG WindowFrameCount(TRAJ *traj, ULONG nFrames);
+ULONG WindowFrameNum(TRAJ *traj, ULONG n);
+BOOL  ReadIndexedFrame(TRAJ *traj, FRAMEINDEX *index, ULONG frameNum,
+                       char *header, COORDS *frame);
+ULONG CountTrajFrames(TRAJ *traj, FRAMEINDEX *index);
+BOOL  ReadMappedFrame(TRAJ *traj, char *header, COORDS *frame);
+ULONG CountMappedFrames(TRAJ *traj, FRAMEINDEX *index);
+REAL  ParseReal(char **ptr, char *end);
+BOOL  ParseCoords(char **ptr, char *end, REAL *x, REAL *y, REAL *z);
+size_t ReadTrajLine(FILE *fp, char *buffer);
+BOOL  SkipBadFrames(TRAJ *traj, FRAMEINDEX *index);
+void  MsgBadFrame(TRAJ *traj, ULONG frameNum, char *header,
+                  BOOL skipped);
+
+/* memtraj.c                                                            */
+TRAJ  *OpenMemoryTraj(void);
+BOOL  AddMemoryFrame(TRAJ *traj, COORD *x, COORD *y, COORD *z,
+                     ULONG nAtoms, char *header);
+void  ClearMemoryTraj(TRAJ *traj);
+void  CloseMemoryTraj(TRAJ *traj);
+BOOL  ReadMemoryFrame(TRAJ *traj, char *header, COORDS *frame);
+ULONG CountMemoryFrames(TRAJ *traj, FRAMEINDEX *index);
+
+/* library.c                                                            */
+FLEXCALC *AllocFlexCalc(void);
+void  FreeFlexCalc(FLEXCALC *fc);
+void  ResetFlexCalc(FLEXCALC *fc);
+BOOL  PushFlexCalcFrame(FLEXCALC *fc, COORD *x, COORD *y, COORD *z,
+                        ULONG nAtoms, char *header);
+BOOL  RunFlexCalc(FLEXCALC *fc);
+REAL  FlexCalcScore(FLEXCALC *fc);
+COORDS *FlexCalcMean(FLEXCALC *fc);
+COORDS *FlexCalcClosest(FLEXCALC *fc, char **header);
+ULONG FlexCalcSkipped(FLEXCALC *fc);
+BOOL  FlexCalcInterval(FLEXCALC *fc, REAL *low, REAL *high);
+
+/* frameindex.c                                                         */
+FRAMEINDEX *AllocFrameIndex(void);
+void  FreeFrameIndex(FRAMEINDEX *index);
+BOOL  AddIndexFrame(FRAMEINDEX *index, off_t offset);
+ULONG CheckFrameIndex(TRAJ *traj, FRAMEINDEX *index);
+BOOL  StampFrameIndex(FRAMEINDEX *index, char *trajFile);
+void  IndexFileName(char *trajFile, char *indexFile);
+BOOL  WriteFrameIndex(FRAMEINDEX *index, char *trajFile);
+BOOL  ReadFrameIndex(FRAMEINDEX *index, char *trajFile);
+
+/* parallel.c                                                           */
+COORDS *CalculateMeanCoordsThreaded(TRAJ *in, FRAMEINDEX *index,
+                                    int nThreads);
+COORDS *FindClosestToMeanThreaded(TRAJ *in, FRAMEINDEX *index,
+                                  COORDS *meanFrame, char *header,
+                                  int nThreads);
+REAL  CalculateMeanRMSDThreaded(TRAJ *in, FRAMEINDEX *index,
+                                COORDS *closestFrame, int nThreads,
+                                REAL *rmsds);
+void  MergeKahanSums(COORDS *sum1, COORDS *comp1, COORDS *sum2,
+                     COORDS *comp2);
+
+/* fcbio.c                                                              */
+BOOL  IsFcbTraj(TRAJ *traj);
+BOOL  OpenFcb(TRAJ *traj);
+void  CloseFcb(TRAJ *traj);
+BOOL  ReadFcbFrame(TRAJ *traj, char *header, COORDS *frame);
+BOOL  SeekFcb(TRAJ *traj, off_t offset);
+ULONG CountFcbFrames(TRAJ *traj, FRAMEINDEX *index);
+BOOL  ConvertTraj(TRAJ *in, char *outFile, int encoding);
+
+/* stats.c                                                              */
+REAL  WallTime(void);
+void  StartStats(void);
+void  EndPass(char *name);
+void  CountRead(ULONG bytes, ULONG lines, ULONG frames);
+void  *CountedMalloc(size_t size);
+void  *CountedCalloc(size_t n, size_t size);
+void  *CountedRealloc(void *ptr, size_t size);
+void  PrintTiming(FILE *out, ULONG nFrames);
+void  PrintStats(FILE *out);
+BOOL  WriteStatsJSON(char *jsonFile, OPTIONS *options, ULONG nFrames,
+                     REAL result);
+
+/* fit.c                                                                */
+REAL  FitRMSFrame(COORDS *frame1, COORDS *frame2);
+BOOL  FitFrame(COORDS *reference, COORDS *frame);
+COORDS *RefineMeanCoords(TRAJ *in, COORDS *meanFrame, int maxCycles,
+                         int *nCycles);
+
+/* select.c                                                             */
+SELECTION *AllocSelection(void);
+void  FreeSelection(SELECTION *select);
+BOOL  ParseSelection(SELECTION *select, char *spec);
+BOOL  ReadSelectionFile(SELECTION *select, char *filename);
+ULONG CountSelected(SELECTION *select, ULONG nAtoms);
+
+/* series.c                                                             */
+SERIES *OpenSeries(char *filename, BOOL binary);
+SERIES *OpenSeriesPart(SERIES *series);
+void  WriteSeries(SERIES *series, ULONG frameNum, char *header,
+                  REAL rmsd);
+BOOL  AppendSeries(SERIES *series, SERIES *part);
+BOOL  CloseSeries(SERIES *series);
+
+/* rmsf.c                                                               */
+RMSF  *AllocRMSF(void);
+void  FreeRMSF(RMSF *rmsf);
+void  ResetRMSF(RMSF *rmsf);
+BOOL  AddSquares(RMSF *rmsf, COORDS *frame);
+BOOL  MergeRMSF(RMSF *rmsf, RMSF *part);
+BOOL  WriteRMSF(char *filename, RMSF *rmsf, COORDS *meanFrame,
+                SELECTION *select);
+
+/* checkpoint.c                                                         */
+COORDS *UpdateCheckpoint(TRAJ *in, char *filename, FRAMEINDEX **index);
+
+/* pairwise.c                                                           */
+BOOL  WritePairwise(TRAJ *in, OPTIONS *options, ULONG *nFrames);
+
+/* sample.c                                                             */
+BOOL  SampleTrajFrames(TRAJ *traj, FRAMEINDEX *index, ULONG nSample,
+                       ULONG seed);
+BOOL  BootstrapInterval(REAL *rmsds, ULONG nFrames, ULONG seed,
+                        REAL *interval);
+
+/* prefetch.c                                                           */
+extern BOOL gPrefetch;
+FILE  *OpenPrefetch(int fd);
+
+/* pool.c                                                               */
+extern POOL *gPool;
+POOL  *StartPool(int nWorkers);
+void  StopPool(POOL *pool);
+BOOL  SubmitTask(POOL *pool, void (*func)(void *arg), void *arg,
+                 TASKGROUP *group, BOOL isFile);
+BOOL  RunPoolTask(POOL *pool, BOOL chunksOnly);
+ULONG PoolEvents(POOL *pool);
+void  WaitPool(POOL *pool, ULONG events);
+void  WaitTaskGroup(POOL *pool, TASKGROUP *group, BOOL chunksOnly);
+
+/* gpu.cu (only in the GPU build)                                       */
+COORDS *CalculateMeanCoordsGpu(TRAJ *in, ULONG *frameCount);
+COORDS *FindClosestToMeanGpu(TRAJ *in, COORDS *meanFrame, char *header);
+REAL  CalculateMeanRMSDGpu(TRAJ *in, COORDS *closestFrame);
+
+/* kernels.c                                                            */
+extern KERNELS gKernels;
+BOOL  SelectKernels(char *name);
+KERNELS *FindKernels(char *name);
+void  ListKernels(FILE *out);
+KERNELS *KernelsForAtoms(KERNELS *kernels, ULONG nAtoms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,371 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       frameindex.c
+
+   Version:    V1.29
+   Date:       14.10.26
+   Function:   Index of frame offsets in a trajectory
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   A FRAMEINDEX holds the byte offset of the header line and the number
+   of atoms of every frame in a trajectory. It is filled in by
+   CountTrajFrames() so it costs nothing beyond the counting pass, and
+   allows frames to be seeked to directly and atom counts to be checked
+   without parsing any coordinates.
+
+   The index may be saved next to the trajectory as a sidecar file
+   (trajectory.fcidx). This records the size, modification time (to the
+   nanosecond) and inode of the trajectory so that it is only reused
+   while the trajectory is unchanged; a file rewritten or replaced
+   within the same second is caught by the nanoseconds or the inode.
+   Its layout, in native byte order, is:
+
+      char     magic[8]     "FCIDX003"
+      uint64_t fileSize
+      int64_t  fileTime     seconds
+      int64_t  fileNsec     nanoseconds
+      uint64_t fileInode
+      uint64_t nFrames
+      uint64_t noHeader     1 if there are lines before the first header
+      uint64_t offset, nAtoms      (repeated nFrames times)
+
+   A frame with a coordinate line that can't be read has no atoms in
+   the index, as does the frame made by any lines before the first
+   header, so both are bad frames.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.4   14.10.26 Original
+   V1.11  14.10.26 Counts allocations for --stats
+   V1.29  14.10.26 Records lines before the first header. The index of
+                   an older version, which didn't check the coordinate
+                   lines, is not used
+                   The index is stamped with the nanoseconds of the
+                   modification time and the inode as well
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdint.h>
+#include <sys/stat.h>
+#include "flexcalc.h"
+
+/***********************************************************************/
+/* Defines and macros
+ */
+#define INDEX_MAGIC     "FCIDX003"
+#define INDEX_MAGICLEN  8
+#define INDEX_EXT       ".fcidx"
+#define MINFRAMES       1024
+
+
+/***********************************************************************/
+/*>FRAMEINDEX *AllocFrameIndex(void)
+   ---------------------------------
+*//**
+   \return                     an empty frame index (or NULL if no
+                               memory)
+
+   Allocates an empty frame index
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Initialises noHeader
+-  14.10.26 Initialises fileNsec and fileInode
+*/
+FRAMEINDEX *AllocFrameIndex(void)
+{
+   FRAMEINDEX *index;
+
+   if((index = (FRAMEINDEX *)CountedMalloc(sizeof(FRAMEINDEX)))!=NULL)
+   {
+      index->offset    = NULL;
+      index->nAtoms    = NULL;
+      index->nFrames   = 0;
+      index->maxFrames = 0;
+      index->fileSize  = 0;
+      index->fileTime  = 0;
+      index->fileNsec  = 0;
+      index->fileInode = 0;
+      index->noHeader  = FALSE;
+   }
+   return(index);
+}
+
+
+/***********************************************************************/
+/*>void FreeFrameIndex(FRAMEINDEX *index)
+   --------------------------------------
+*//**
+   \param[in]  *index          a frame index (may be NULL)
+
+   Frees a frame index
+
+-  14.10.26 Original   By: ACRM
+*/
+void FreeFrameIndex(FRAMEINDEX *index)
+{
+   if(index != NULL)
+   {
+      free(index->offset);
+      free(index->nAtoms);
+      free(index);
+   }
+}
+
+
+/***********************************************************************/
+/*>BOOL AddIndexFrame(FRAMEINDEX *index, off_t offset)
+   ---------------------------------------------------
+*//**
+   \param[in,out] *index       a frame index
+   \param[in]     offset       byte offset of the frame's header line
+   \return                     FALSE if there was no memory
+
+   Adds a frame (with no atoms as yet) to the end of the index
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL AddIndexFrame(FRAMEINDEX *index, off_t offset)
+{
+   if(index->nFrames == index->maxFrames)
+   {
+      ULONG maxFrames = (index->maxFrames) ? 2 * index->maxFrames
+                                           : MINFRAMES;
+      off_t *newOffset;
+      ULONG *newAtoms;
+
+      if((newOffset = (off_t *)CountedRealloc(index->offset,
+                                    maxFrames * sizeof(off_t)))==NULL)
+         return(FALSE);
+      index->offset = newOffset;
+      if((newAtoms = (ULONG *)CountedRealloc(index->nAtoms,
+                                   maxFrames * sizeof(ULONG)))==NULL)
+         return(FALSE);
+      index->nAtoms    = newAtoms;
+      index->maxFrames = maxFrames;
+   }
+
+   index->offset[index->nFrames] = offset;
+   index->nAtoms[index->nFrames] = 0;
+   index->nFrames++;
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>ULONG CheckFrameIndex(TRAJ *traj, FRAMEINDEX *index)
+   -----------------------------------------------------
+*//**
+   \param[in]  *traj           the trajectory with its window set
+   \param[in]  *index          its frame index
+   \return                     the first frame in the window whose atom
+                               count doesn't match the window's first
+                               frame, or which has no atoms, or
+                               nFrames if all match
+
+   Checks that every frame in the window has the same number of atoms
+   without having to read any of them. The frames outside the window
+   aren't read, so aren't checked.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Only checks the frames in the window
+*/
+ULONG CheckFrameIndex(TRAJ *traj, FRAMEINDEX *index)
+{
+   ULONG nFrames = WindowFrameCount(traj, index->nFrames),
+         nAtoms,
+         p,
+         f;
+
+   if(nFrames == 0)
+      return(index->nFrames);
+
+   nAtoms = index->nAtoms[WindowFrameNum(traj, 0)];
+   for(p=0; p<nFrames; p++)
+   {
+      f = WindowFrameNum(traj, p);
+      if((index->nAtoms[f] != nAtoms) || (index->nAtoms[f] == 0))
+         return(f);
+   }
+   return(index->nFrames);
+}
+
+
+/***********************************************************************/
+/*>BOOL StampFrameIndex(FRAMEINDEX *index, char *trajFile)
+   -------------------------------------------------------
+*//**
+   \param[in,out] *index       a frame index
+   \param[in]     *trajFile    the trajectory it indexes
+   \return                     FALSE if the trajectory couldn't be
+                               examined
+
+   Records the size, modification time and inode of the trajectory in
+   the index so that a saved copy can later be checked against it
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Records the nanoseconds and the inode
+*/
+BOOL StampFrameIndex(FRAMEINDEX *index, char *trajFile)
+{
+   struct stat st;
+
+   if(stat(trajFile, &st) < 0)
+      return(FALSE);
+   index->fileSize = st.st_size;
+   index->fileTime  = st.st_mtime;
+   index->fileNsec  = st.st_mtim.tv_nsec;
+   index->fileInode = st.st_ino;
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>void IndexFileName(char *trajFile, char *indexFile)
+   ---------------------------------------------------
+*//**
+   \param[in]  *trajFile       the trajectory filename
+   \param[out] *indexFile      the sidecar index filename (MAXFNM chars)
+
+   Builds the name of the sidecar index file for a trajectory
+
+-  14.10.26 Original   By: ACRM
+*/
+void IndexFileName(char *trajFile, char *indexFile)
+{
+   snprintf(indexFile, MAXFNM, "%s%s", trajFile, INDEX_EXT);
+}
+
+
+/***********************************************************************/
+/*>BOOL WriteFrameIndex(FRAMEINDEX *index, char *trajFile)
+   -------------------------------------------------------
+*//**
+   \param[in]  *index          a stamped frame index
+   \param[in]  *trajFile       the trajectory it indexes
+   \return                     Was the sidecar written?
+
+   Saves the index as a sidecar file next to the trajectory
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Saves noHeader
+-  14.10.26 Saves the nanoseconds and the inode
+*/
+BOOL WriteFrameIndex(FRAMEINDEX *index, char *trajFile)
+{
+   char     indexFile[MAXFNM];
+   FILE     *fp;
+   uint64_t values[2],
+            noHeader,
+            fileInode = (uint64_t)index->fileInode;
+   int64_t  fileTime  = (int64_t)index->fileTime,
+            fileNsec  = (int64_t)index->fileNsec;
+   ULONG    i;
+   BOOL     ok;
+
+   IndexFileName(trajFile, indexFile);
+   if((fp = fopen(indexFile, "wb"))==NULL)
+      return(FALSE);
+
+   values[0] = (uint64_t)index->fileSize;
+   values[1] = (uint64_t)index->nFrames;
+   noHeader  = (uint64_t)index->noHeader;
+   ok = ((fwrite(INDEX_MAGIC, 1, INDEX_MAGICLEN, fp) == INDEX_MAGICLEN) &&
+         (fwrite(&values[0], sizeof(uint64_t), 1, fp) == 1)           &&
+         (fwrite(&fileTime,  sizeof(int64_t),  1, fp) == 1)           &&
+         (fwrite(&fileNsec,  sizeof(int64_t),  1, fp) == 1)           &&
+         (fwrite(&fileInode, sizeof(uint64_t), 1, fp) == 1)           &&
+         (fwrite(&values[1], sizeof(uint64_t), 1, fp) == 1)           &&
+         (fwrite(&noHeader,  sizeof(uint64_t), 1, fp) == 1));
+
+   for(i=0; ok && (i<index->nFrames); i++)
+   {
+      values[0] = (uint64_t)index->offset[i];
+      values[1] = (uint64_t)index->nAtoms[i];
+      ok = (fwrite(values, sizeof(uint64_t), 2, fp) == 2);
+   }
+
+   if(fclose(fp) != 0)
+      ok = FALSE;
+   if(!ok)
+      remove(indexFile);
+   return(ok);
+}
+
+
+/***********************************************************************/
+/*>BOOL ReadFrameIndex(FRAMEINDEX *index, char *trajFile)
+   ------------------------------------------------------
+*//**
+   \param[out] *index          an empty frame index
+   \param[in]  *trajFile       the trajectory
+   \return                     Was a valid sidecar index read?
+
+   Reads the sidecar index for a trajectory. It is only accepted if the
+   trajectory's size, modification time and inode still match;
+   otherwise the index is left empty and the trajectory must be
+   re-indexed.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Reads noHeader
+-  14.10.26 Checks the nanoseconds and the inode
+*/
+BOOL ReadFrameIndex(FRAMEINDEX *index, char *trajFile)
+{
+   char     indexFile[MAXFNM],
+            magic[INDEX_MAGICLEN];
+   FILE     *fp;
+   uint64_t fileSize, fileInode, nFrames, noHeader, values[2];
+   int64_t  fileTime, fileNsec;
+   ULONG    i;
+   BOOL     ok;
+
+   if(!StampFrameIndex(index, trajFile))
+      return(FALSE);
+
+   IndexFileName(trajFile, indexFile);
+   if((fp = fopen(indexFile, "rb"))==NULL)
+      return(FALSE);
+
+   ok = ((fread(magic, 1, INDEX_MAGICLEN, fp) == INDEX_MAGICLEN)   &&
+         !strncmp(magic, INDEX_MAGIC, INDEX_MAGICLEN)              &&
+         (fread(&fileSize, sizeof(uint64_t), 1, fp) == 1)          &&
+         (fread(&fileTime, sizeof(int64_t),  1, fp) == 1)          &&
+         (fread(&fileNsec, sizeof(int64_t),  1, fp) == 1)          &&
+         (fread(&fileInode, sizeof(uint64_t), 1, fp) == 1)         &&
+         (fread(&nFrames,  sizeof(uint64_t), 1, fp) == 1)          &&
+         (fread(&noHeader, sizeof(uint64_t), 1, fp) == 1)          &&
+         (fileSize  == (uint64_t)index->fileSize)                  &&
+         (fileTime  == (int64_t)index->fileTime)                   &&
+         (fileNsec  == (int64_t)index->fileNsec)                   &&
+         (fileInode == (uint64_t)index->fileInode));
+
+   for(i=0; ok && (i<nFrames); i++)
+   {
+      if((ok = (fread(values, sizeof(uint64_t), 2, fp) == 2)) &&
+         (ok = AddIndexFrame(index, (off_t)values[0])))
+      {
+         index->nAtoms[i] = (ULONG)values[1];
+      }
+   }
+   fclose(fp);
+
+   index->noHeader = (ok && noHeader);
+   if(!ok)
+      index->nFrames = 0;
+   return(ok);
+}
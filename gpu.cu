@@ -0,0 +1,834 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       gpu.cu
+
+   Version:    V1.29
+   Date:       14.10.26
+   Function:   The mean, closest frame and RMSD passes on a GPU
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   GPU versions of CalculateMeanCoords(), FindClosestToMean() and
+   CalculateMeanRMSD() for --gpu in the GPU build (make gpu). This is
+   CUDA, and builds with HIP for AMD GPUs when FLEXCALC_HIP is defined.
+
+   The host still reads and parses the frames with ReadTrajFrame(),
+   copying each into one of two pinned batches of frames. While the
+   GPU copies one batch to the device and works on it, the host fills
+   the other, so parsing overlaps the transfers and the calculations.
+   A batch is refilled only once the GPU has finished with it (its
+   event has fired) and its results have been taken. Everything for
+   one pass runs in order on one stream, so the device needs only one
+   batch buffer.
+
+   Each frame in a batch is held as its x, then y, then z coordinates.
+
+   For the mean, one GPU thread keeps the Kahan sum of each coordinate
+   on the device, adding the batch's frames in order in the same way as
+   AddFrameKahan(). The sums are copied back and divided by the number
+   of frames once, as the threaded mean does (parallel.c). The frames
+   are counted as they are read, so no counting pass is needed.
+
+   For the closest frame and the RMSDs, one block calculates the RMSD
+   of each frame in the batch from the reference frame and the RMSDs
+   are copied back. The host then takes the lowest (earliest on a tie)
+   or adds them in frame order, and writes the --series, so only the
+   order of the atoms within each RMSD differs from the CPU, as it does
+   between the CPU kernels.
+
+   --fit is not available on the GPU.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.27  14.10.26 Original
+   V1.29  14.10.26 Bad frames are reported with their byte offsets
+
+*************************************************************************/
+/* Includes
+*/
+#ifdef FLEXCALC_HIP
+#  include <hip/hip_runtime.h>
+#else
+#  include <cuda_runtime.h>
+#endif
+
+#include "flexcalc.h"
+
+/***********************************************************************/
+/* Defines and macros
+ */
+#define GPUBATCHBYTES (64 * 1024 * 1024) /* Coordinates in each batch  */
+#define GPUMAXFRAMES  4096    /* Most frames in a batch                 */
+#define GPUTHREADS    256     /* Threads per block (a power of 2)       */
+#define GPUMAXBLOCKS  65535   /* Most blocks for the mean kernel        */
+
+#define TASK_MEAN    0
+#define TASK_CLOSEST 1
+#define TASK_RMSD    2
+
+/* The HIP runtime has the same calls as CUDA under other names         */
+#ifdef FLEXCALC_HIP
+#  define cudaError_t            hipError_t
+#  define cudaSuccess            hipSuccess
+#  define cudaGetErrorString     hipGetErrorString
+#  define cudaGetLastError       hipGetLastError
+#  define cudaGetDeviceCount     hipGetDeviceCount
+#  define cudaMalloc             hipMalloc
+#  define cudaFree               hipFree
+#  define cudaMallocHost         hipHostMalloc
+#  define cudaFreeHost           hipHostFree
+#  define cudaMemset             hipMemset
+#  define cudaMemcpy             hipMemcpy
+#  define cudaMemcpyAsync        hipMemcpyAsync
+#  define cudaMemcpyHostToDevice hipMemcpyHostToDevice
+#  define cudaMemcpyDeviceToHost hipMemcpyDeviceToHost
+#  define cudaStream_t           hipStream_t
+#  define cudaStreamCreate       hipStreamCreate
+#  define cudaStreamDestroy      hipStreamDestroy
+#  define cudaStreamSynchronize  hipStreamSynchronize
+#  define cudaEvent_t            hipEvent_t
+#  define cudaEventCreate        hipEventCreate
+#  define cudaEventDestroy       hipEventDestroy
+#  define cudaEventRecord        hipEventRecord
+#  define cudaEventSynchronize   hipEventSynchronize
+#endif
+
+/* One pass of a trajectory through the GPU                             */
+typedef struct
+{
+   COORD        *host[2],        /* Pinned batches of frames            */
+                *device,         /* The batch on the device             */
+                *reference;      /* Frame to compare with (device)      */
+   REAL         *sum,            /* Kahan sums and compensations of     */
+                *comp,           /* each coordinate (device)            */
+                *rmsd[2],        /* Pinned RMSDs of each batch          */
+                *devRMSD;        /* RMSDs of the batch (device)         */
+   char         *header[2];      /* Headers of each batch's frames      */
+   ULONG        *frameNum[2],    /* Frame numbers of each batch's frames*/
+                nFrames[2],      /* Frames in each batch (0 if idle)    */
+                batchFrames,     /* Frames each batch can hold          */
+                nAtoms,
+                nRead,           /* Frames read                         */
+                totalFrames;     /* Frames whose results have been used */
+   cudaStream_t stream;
+   cudaEvent_t  done[2];         /* Set when the GPU is done with each  */
+   BOOL         haveStream,
+                haveEvents;
+   int          task;            /* TASK_MEAN, TASK_CLOSEST or TASK_RMSD*/
+   SERIES       *series;         /* TASK_RMSD: the TRAJ's (or NULL)     */
+
+   /* Results                                                           */
+   COORDS       *closestFrame;   /* TASK_CLOSEST                        */
+   REAL         lowestRMSD,
+                sumRMSD;         /* TASK_RMSD                           */
+   char         closestHeader[MAXBUFF];
+}  GPUPASS;
+
+/***********************************************************************/
+/* Prototypes
+ */
+__global__ static void KahanSumKernel(REAL *sum, REAL *comp,
+                                      const COORD *batch, ULONG nFrames,
+                                      ULONG nCoor);
+__global__ static void RMSDKernel(REAL *rmsd, const COORD *batch,
+                                  const COORD *reference, ULONG nAtoms);
+static BOOL GpuOK(cudaError_t err);
+static BOOL OpenGpuPass(GPUPASS *pass, ULONG nAtoms, int task,
+                        COORDS *reference);
+static void CloseGpuPass(GPUPASS *pass);
+static BOOL StartBatch(GPUPASS *pass, int slot, ULONG n);
+static BOOL FinishBatch(GPUPASS *pass, int slot);
+static BOOL RunGpuPass(TRAJ *in, GPUPASS *pass, int task,
+                       COORDS *reference);
+static void PackFrame(COORD *packed, COORDS *frame);
+
+
+/***********************************************************************/
+/*>COORDS *CalculateMeanCoordsGpu(TRAJ *in, ULONG *frameCount)
+   -----------------------------------------------------------
+*//**
+   \param[in]  *in             the open trajectory
+   \param[out] *frameCount     the number of frames read (even on error)
+   \return                     a pretend frame containing coordinates
+                               averaged across the real frames (NULL,
+                               with a message, on error)
+
+   GPU version of CalculateMeanCoords(). The frames are counted while
+   they are summed. The sums are compensated, so the mean is as with
+   -t rather than the serial code.
+
+-  14.10.26 Original   By: ACRM
+*/
+COORDS *CalculateMeanCoordsGpu(TRAJ *in, ULONG *frameCount)
+{
+   GPUPASS pass;
+   COORDS  *meanFrame = NULL;
+   REAL    *sums      = NULL;
+   ULONG   nCoor,
+           i;
+   BOOL    ok;
+
+   ok          = (RunGpuPass(in, &pass, TASK_MEAN, NULL) &&
+                  (pass.totalFrames > 0));
+   nCoor       = 3 * pass.nAtoms;
+   *frameCount = pass.nRead;
+
+   /* Copy back the sums followed by the compensations                 */
+   if(ok &&
+      (((sums      = (REAL *)CountedMalloc(2 * nCoor * sizeof(REAL)))
+        ==NULL) ||
+       ((meanFrame = AllocCoords(pass.nAtoms))==NULL) ||
+       !ZeroCoords(meanFrame, pass.nAtoms)))
+   {
+      Msg(MSG_NOMEM, "");
+      ok = FALSE;
+   }
+   if(ok)
+      ok = (GpuOK(cudaMemcpy(sums, pass.sum, nCoor * sizeof(REAL),
+                             cudaMemcpyDeviceToHost)) &&
+            GpuOK(cudaMemcpy(sums + nCoor, pass.comp,
+                             nCoor * sizeof(REAL),
+                             cudaMemcpyDeviceToHost)));
+
+   if(ok)
+   {
+      REAL *comp = sums + nCoor;
+
+      for(i=0; i<pass.nAtoms; i++)
+      {
+         SUMX(meanFrame)[i] = (sums[i] - comp[i]) / pass.totalFrames;
+         SUMY(meanFrame)[i] = (sums[pass.nAtoms + i] -
+                               comp[pass.nAtoms + i]) / pass.totalFrames;
+         SUMZ(meanFrame)[i] = (sums[2*pass.nAtoms + i] -
+                               comp[2*pass.nAtoms + i]) /
+                              pass.totalFrames;
+      }
+      StoreSums(meanFrame);
+   }
+
+   CloseGpuPass(&pass);
+   free(sums);
+   if(!ok)
+   {
+      FreeCoords(meanFrame);
+      meanFrame = NULL;
+   }
+
+#ifdef DEBUG
+   PrintFrame("average", meanFrame);
+#endif
+   return(meanFrame);
+}
+
+
+/***********************************************************************/
+/*>COORDS *FindClosestToMeanGpu(TRAJ *in, COORDS *meanFrame,
+                                char *header)
+   ---------------------------------------------------------
+*//**
+   \param[in]  *in             the open trajectory
+   \param[in]  *meanFrame      A pretend trajectory frame containing
+                               the averaged coordinates
+   \param[out] *header         The header for the frame closest to the
+                               mean coordinates
+   \return                     The frame closest to the mean coordinates
+
+   GPU version of FindClosestToMean()
+
+-  14.10.26 Original   By: ACRM
+*/
+COORDS *FindClosestToMeanGpu(TRAJ *in, COORDS *meanFrame, char *header)
+{
+   GPUPASS pass;
+   COORDS  *closestFrame = NULL;
+
+   if(RunGpuPass(in, &pass, TASK_CLOSEST, meanFrame) &&
+      (pass.totalFrames > 0))
+   {
+      closestFrame      = pass.closestFrame;
+      pass.closestFrame = NULL;
+      strcpy(header, pass.closestHeader);
+   }
+   CloseGpuPass(&pass);
+
+   return(closestFrame);
+}
+
+
+/***********************************************************************/
+/*>REAL CalculateMeanRMSDGpu(TRAJ *in, COORDS *closestFrame)
+   ---------------------------------------------------------
+*//**
+   \param[in]  *in             the open trajectory
+   \param[in]  *closestFrame   The frame closest to the mean coordinates
+   \return                     The mean RMSD (-1.0 on error)
+
+   GPU version of CalculateMeanRMSD(). With --series, each RMSD is also
+   written to the series.
+
+-  14.10.26 Original   By: ACRM
+*/
+REAL CalculateMeanRMSDGpu(TRAJ *in, COORDS *closestFrame)
+{
+   GPUPASS pass;
+   REAL    meanRMSD = -1.0;
+
+   if(RunGpuPass(in, &pass, TASK_RMSD, closestFrame) &&
+      (pass.totalFrames > 0))
+      meanRMSD = pass.sumRMSD / pass.totalFrames;
+   CloseGpuPass(&pass);
+
+   return(meanRMSD);
+}
+
+
+/***********************************************************************/
+/*>static BOOL RunGpuPass(TRAJ *in, GPUPASS *pass, int task,
+                          COORDS *reference)
+   ---------------------------------------------------------
+*//**
+   \param[in]  *in             the open trajectory
+   \param[out] *pass           the pass and its results. Must be closed
+                               with CloseGpuPass() even on failure
+   \param[in]  task            TASK_MEAN, TASK_CLOSEST or TASK_RMSD
+   \param[in]  *reference      frame to compare each frame with (NULL
+                               for TASK_MEAN)
+   \return                     FALSE (with a message) on error
+
+   Reads the frames into the two batches in turn, running each batch on
+   the GPU while the other is filled
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Reports a bad frame with MsgBadFrame()
+-  14.10.26 Uses the TRAJ's RMSFs and series
+-  14.10.26 Fails at a bad frame
+*/
+static BOOL RunGpuPass(TRAJ *in, GPUPASS *pass, int task,
+                       COORDS *reference)
+{
+   COORDS *frame;
+   char   header[MAXBUFF];
+   BOOL   ok   = TRUE,
+          more;
+   ULONG  nAtoms;
+   int    slot = 0,
+          i;
+
+   memset(pass, 0, sizeof(GPUPASS));
+   pass->series = in->series;
+   if((frame = AllocCoords((reference != NULL) ? reference->nAtoms
+                                                : MINATOMS))==NULL)
+   {
+      Msg(MSG_NOMEM, "");
+      return(FALSE);
+   }
+
+   /* Go back to the start and reset the frame reading                 */
+   RewindTraj(in);
+   if((task == TASK_MEAN) && (in->rmsf != NULL))
+      ResetRMSF(in->rmsf);
+
+   /* The first frame sizes the batches for the mean                    */
+   if(!(more = ReadTrajFrame(in, header, frame)))
+   {
+      FreeCoords(frame);
+      return(in->badFrame == FRAME_OK);
+   }
+   pass->nRead = 1;
+   nAtoms = ((reference != NULL) ? reference->nAtoms : frame->nAtoms);
+   if(nAtoms == 0)
+   {
+      Msg("No atoms selected", "");
+      FreeCoords(frame);
+      return(FALSE);
+   }
+   if(!OpenGpuPass(pass, nAtoms, task, reference))
+   {
+      FreeCoords(frame);
+      return(FALSE);
+   }
+
+   while(ok && more)
+   {
+      ULONG n;
+
+      /* Take the results from this batch's last use before refilling */
+      if(pass->nFrames[slot] && !FinishBatch(pass, slot))
+      {
+         ok = FALSE;
+         break;
+      }
+
+      for(n=0; more && (n<pass->batchFrames); n++)
+      {
+         if(frame->nAtoms != nAtoms)
+         {
+            MsgBadFrame(in, in->frameNum-1, header, FALSE);
+            ok = FALSE;
+            break;
+         }
+         if((task == TASK_MEAN) && (in->rmsf != NULL) &&
+            !AddSquares(in->rmsf, frame))
+         {
+            Msg(MSG_NOMEM, "");
+            ok = FALSE;
+            break;
+         }
+
+         PackFrame(pass->host[slot] + n * 3 * nAtoms, frame);
+         strcpy(pass->header[slot] + n * MAXBUFF, header);
+         pass->frameNum[slot][n] = in->frameNum;
+
+         if((more = ReadTrajFrame(in, header, frame)))
+            pass->nRead++;
+      }
+
+      if(ok && !StartBatch(pass, slot, n))
+         ok = FALSE;
+      slot = 1 - slot;
+   }
+   if(in->badFrame != FRAME_OK)
+      ok = FALSE;
+
+   /* Finish the batches still running, the older first                 */
+   for(i=0; i<2; i++)
+   {
+      if(pass->nFrames[slot] && !FinishBatch(pass, slot))
+         ok = FALSE;
+      slot = 1 - slot;
+   }
+
+   FreeCoords(frame);
+   return(ok);
+}
+
+
+/***********************************************************************/
+/*>static BOOL OpenGpuPass(GPUPASS *pass, ULONG nAtoms, int task,
+                           COORDS *reference)
+   -------------------------------------------------------------
+*//**
+   \param[in,out] *pass        a zeroed pass
+   \param[in]     nAtoms       number of atoms in each frame
+   \param[in]     task         TASK_MEAN, TASK_CLOSEST or TASK_RMSD
+   \param[in]     *reference   frame to compare each frame with (NULL
+                               for TASK_MEAN)
+   \return                     FALSE (with a message) on error
+
+   Allocates the batches and the device memory, and copies the
+   reference frame to the device. The batches hold as many frames as
+   fit in GPUBATCHBYTES (at least one, at most GPUMAXFRAMES).
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL OpenGpuPass(GPUPASS *pass, ULONG nAtoms, int task,
+                        COORDS *reference)
+{
+   size_t frameSize = 3 * nAtoms * sizeof(COORD);
+   int    nDevices  = 0,
+          i;
+
+   pass->task   = task;
+   pass->nAtoms = nAtoms;
+   pass->batchFrames = GPUBATCHBYTES / frameSize;
+   if(pass->batchFrames < 1)
+      pass->batchFrames = 1;
+   if(pass->batchFrames > GPUMAXFRAMES)
+      pass->batchFrames = GPUMAXFRAMES;
+
+   if((cudaGetDeviceCount(&nDevices) != cudaSuccess) || (nDevices < 1))
+   {
+      Msg("No GPU available", "");
+      return(FALSE);
+   }
+
+   if(!GpuOK(cudaStreamCreate(&(pass->stream))))
+      return(FALSE);
+   pass->haveStream = TRUE;
+   if(!GpuOK(cudaEventCreate(&(pass->done[0]))))
+      return(FALSE);
+   if(!GpuOK(cudaEventCreate(&(pass->done[1]))))
+   {
+      cudaEventDestroy(pass->done[0]);
+      return(FALSE);
+   }
+   pass->haveEvents = TRUE;
+
+   for(i=0; i<2; i++)
+   {
+      if(!GpuOK(cudaMallocHost((void **)&(pass->host[i]),
+                               pass->batchFrames * frameSize)) ||
+         !GpuOK(cudaMallocHost((void **)&(pass->rmsd[i]),
+                               pass->batchFrames * sizeof(REAL))))
+         return(FALSE);
+      if(((pass->header[i]   = (char *)CountedMalloc(pass->batchFrames *
+                                                     MAXBUFF))==NULL) ||
+         ((pass->frameNum[i] = (ULONG *)CountedMalloc(pass->batchFrames *
+                                                     sizeof(ULONG)))==NULL))
+      {
+         Msg(MSG_NOMEM, "");
+         return(FALSE);
+      }
+   }
+   if(!GpuOK(cudaMalloc((void **)&(pass->device),
+                        pass->batchFrames * frameSize)))
+      return(FALSE);
+
+   if(task == TASK_MEAN)
+   {
+      if(!GpuOK(cudaMalloc((void **)&(pass->sum),
+                           3 * nAtoms * sizeof(REAL))) ||
+         !GpuOK(cudaMalloc((void **)&(pass->comp),
+                           3 * nAtoms * sizeof(REAL))) ||
+         !GpuOK(cudaMemset(pass->sum,  0, 3 * nAtoms * sizeof(REAL))) ||
+         !GpuOK(cudaMemset(pass->comp, 0, 3 * nAtoms * sizeof(REAL))))
+         return(FALSE);
+   }
+   else
+   {
+      if(!GpuOK(cudaMalloc((void **)&(pass->devRMSD),
+                           pass->batchFrames * sizeof(REAL))) ||
+         !GpuOK(cudaMalloc((void **)&(pass->reference), frameSize)))
+         return(FALSE);
+
+      /* The first batch is free to stage the reference                */
+      PackFrame(pass->host[0], reference);
+      if(!GpuOK(cudaMemcpy(pass->reference, pass->host[0], frameSize,
+                           cudaMemcpyHostToDevice)))
+         return(FALSE);
+   }
+
+   if((task == TASK_CLOSEST) &&
+      ((pass->closestFrame = AllocCoords(nAtoms))==NULL))
+   {
+      Msg(MSG_NOMEM, "");
+      return(FALSE);
+   }
+
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>static void CloseGpuPass(GPUPASS *pass)
+   ---------------------------------------
+*//**
+   \param[in,out] *pass        a pass run by RunGpuPass()
+
+   Waits for the GPU to finish with the pass and frees it
+
+-  14.10.26 Original   By: ACRM
+*/
+static void CloseGpuPass(GPUPASS *pass)
+{
+   int i;
+
+   if(pass->haveStream)
+   {
+      cudaStreamSynchronize(pass->stream);
+      cudaStreamDestroy(pass->stream);
+   }
+   if(pass->haveEvents)
+   {
+      cudaEventDestroy(pass->done[0]);
+      cudaEventDestroy(pass->done[1]);
+   }
+
+   for(i=0; i<2; i++)
+   {
+      if(pass->host[i] != NULL)
+         cudaFreeHost(pass->host[i]);
+      if(pass->rmsd[i] != NULL)
+         cudaFreeHost(pass->rmsd[i]);
+      free(pass->header[i]);
+      free(pass->frameNum[i]);
+   }
+   if(pass->device != NULL)
+      cudaFree(pass->device);
+   if(pass->reference != NULL)
+      cudaFree(pass->reference);
+   if(pass->sum != NULL)
+      cudaFree(pass->sum);
+   if(pass->comp != NULL)
+      cudaFree(pass->comp);
+   if(pass->devRMSD != NULL)
+      cudaFree(pass->devRMSD);
+   FreeCoords(pass->closestFrame);
+
+   memset(pass, 0, sizeof(GPUPASS));
+}
+
+
+/***********************************************************************/
+/*>static BOOL StartBatch(GPUPASS *pass, int slot, ULONG n)
+   --------------------------------------------------------
+*//**
+   \param[in,out] *pass        the pass
+   \param[in]     slot         the batch just filled (0 or 1)
+   \param[in]     n            the number of frames in it
+   \return                     FALSE (with a message) on error
+
+   Queues the copy of the batch to the device and the kernel for it,
+   then (except for the mean) the copy of the RMSDs back. The batch's
+   event is recorded after them.
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL StartBatch(GPUPASS *pass, int slot, ULONG n)
+{
+   ULONG nCoor = 3 * pass->nAtoms;
+
+   if(n == 0)
+      return(TRUE);
+
+   if(!GpuOK(cudaMemcpyAsync(pass->device, pass->host[slot],
+                             n * nCoor * sizeof(COORD),
+                             cudaMemcpyHostToDevice, pass->stream)))
+      return(FALSE);
+
+   if(pass->task == TASK_MEAN)
+   {
+      ULONG nBlocks = (nCoor + GPUTHREADS - 1) / GPUTHREADS;
+
+      if(nBlocks > GPUMAXBLOCKS)
+         nBlocks = GPUMAXBLOCKS;
+      KahanSumKernel<<<(unsigned int)nBlocks, GPUTHREADS, 0,
+                       pass->stream>>>(pass->sum, pass->comp,
+                                       pass->device, n, nCoor);
+   }
+   else
+   {
+      RMSDKernel<<<(unsigned int)n, GPUTHREADS, 0,
+                   pass->stream>>>(pass->devRMSD, pass->device,
+                                   pass->reference, pass->nAtoms);
+   }
+   if(!GpuOK(cudaGetLastError()))
+      return(FALSE);
+
+   if((pass->task != TASK_MEAN) &&
+      !GpuOK(cudaMemcpyAsync(pass->rmsd[slot], pass->devRMSD,
+                             n * sizeof(REAL), cudaMemcpyDeviceToHost,
+                             pass->stream)))
+      return(FALSE);
+
+   if(!GpuOK(cudaEventRecord(pass->done[slot], pass->stream)))
+      return(FALSE);
+   pass->nFrames[slot] = n;
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>static BOOL FinishBatch(GPUPASS *pass, int slot)
+   ------------------------------------------------
+*//**
+   \param[in,out] *pass        the pass
+   \param[in]     slot         a batch started by StartBatch()
+   \return                     FALSE (with a message) on error
+
+   Waits for the GPU to finish with the batch and uses its results: the
+   closest frame is taken from the batch (earliest first) or the RMSDs
+   are added in order and written to the series. The batch is then
+   free to refill.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Writes the pass's series
+*/
+static BOOL FinishBatch(GPUPASS *pass, int slot)
+{
+   ULONG n    = pass->nFrames[slot],
+         best = n,
+         i;
+   REAL  *rmsd = pass->rmsd[slot];
+
+   pass->nFrames[slot] = 0;
+   if(!GpuOK(cudaEventSynchronize(pass->done[slot])))
+      return(FALSE);
+
+   if(pass->task == TASK_CLOSEST)
+   {
+      for(i=0; i<n; i++)
+      {
+         if(((pass->totalFrames + i) == 0) ||
+            (rmsd[i] < pass->lowestRMSD))
+         {
+            pass->lowestRMSD = rmsd[i];
+            best             = i;
+         }
+      }
+
+      /* Unpack the best frame of the batch                             */
+      if(best < n)
+      {
+         COORD  *packed = pass->host[slot] + best * 3 * pass->nAtoms;
+         COORDS *frame  = pass->closestFrame;
+
+         frame->nAtoms = pass->nAtoms;
+         memcpy(frame->x, packed, pass->nAtoms * sizeof(COORD));
+         memcpy(frame->y, packed + pass->nAtoms,
+                pass->nAtoms * sizeof(COORD));
+         memcpy(frame->z, packed + 2 * pass->nAtoms,
+                pass->nAtoms * sizeof(COORD));
+         strcpy(pass->closestHeader, pass->header[slot] + best * MAXBUFF);
+      }
+   }
+   else if(pass->task == TASK_RMSD)
+   {
+      for(i=0; i<n; i++)
+      {
+         pass->sumRMSD += rmsd[i];
+         if(pass->series != NULL)
+            WriteSeries(pass->series, pass->frameNum[slot][i],
+                        pass->header[slot] + i * MAXBUFF, rmsd[i]);
+      }
+   }
+
+   pass->totalFrames += n;
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>static void PackFrame(COORD *packed, COORDS *frame)
+   ---------------------------------------------------
+*//**
+   \param[out] *packed         space for 3 * frame->nAtoms coordinates
+   \param[in]  *frame          a frame
+
+   Copies a frame into a batch as its x, then y, then z coordinates
+
+-  14.10.26 Original   By: ACRM
+*/
+static void PackFrame(COORD *packed, COORDS *frame)
+{
+   memcpy(packed,                      frame->x,
+          frame->nAtoms * sizeof(COORD));
+   memcpy(packed + frame->nAtoms,      frame->y,
+          frame->nAtoms * sizeof(COORD));
+   memcpy(packed + 2 * frame->nAtoms,  frame->z,
+          frame->nAtoms * sizeof(COORD));
+}
+
+
+/***********************************************************************/
+/*>static BOOL GpuOK(cudaError_t err)
+   ----------------------------------
+*//**
+   \param[in]  err             result of a CUDA (or HIP) call
+   \return                     did it succeed?
+
+   Reports a failed call
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL GpuOK(cudaError_t err)
+{
+   if(err == cudaSuccess)
+      return(TRUE);
+   Msg("GPU error: ", cudaGetErrorString(err));
+   return(FALSE);
+}
+
+
+/***********************************************************************/
+/*>__global__ static void KahanSumKernel(REAL *sum, REAL *comp,
+                                         const COORD *batch,
+                                         ULONG nFrames, ULONG nCoor)
+   ---------------------------------------------------------------
+*//**
+   \param[in,out] *sum         Kahan sums of each coordinate
+   \param[in,out] *comp        and their compensations
+   \param[in]     *batch       nFrames frames of nCoor coordinates
+   \param[in]     nFrames      number of frames in the batch
+   \param[in]     nCoor        coordinates in each frame (3 * atoms)
+
+   Each thread adds the batch's frames, in order, into the sums of
+   one or more coordinates, as AddFrameKahan() does
+
+-  14.10.26 Original   By: ACRM
+*/
+__global__ static void KahanSumKernel(REAL *sum, REAL *comp,
+                                      const COORD *batch, ULONG nFrames,
+                                      ULONG nCoor)
+{
+   ULONG j;
+
+   for(j = (ULONG)blockIdx.x * blockDim.x + threadIdx.x;
+       j < nCoor;
+       j += (ULONG)blockDim.x * gridDim.x)
+   {
+      REAL  s = sum[j],
+            c = comp[j];
+      ULONG f;
+
+      for(f=0; f<nFrames; f++)
+      {
+         REAL v = (REAL)batch[f * nCoor + j] - c,
+              t = s + v;
+         c = (t - s) - v;
+         s = t;
+      }
+      sum[j]  = s;
+      comp[j] = c;
+   }
+}
+
+
+/***********************************************************************/
+/*>__global__ static void RMSDKernel(REAL *rmsd, const COORD *batch,
+                                     const COORD *reference,
+                                     ULONG nAtoms)
+   -----------------------------------------------------------------
+*//**
+   \param[out] *rmsd           the RMSD of each frame in the batch
+   \param[in]  *batch          the frames
+   \param[in]  *reference      the frame to compare with
+   \param[in]  nAtoms          atoms in each frame
+
+   Block b calculates the RMSD of frame b. Each thread sums the squared
+   distances of some of the atoms and the sums are added in a tree.
+
+-  14.10.26 Original   By: ACRM
+*/
+__global__ static void RMSDKernel(REAL *rmsd, const COORD *batch,
+                                  const COORD *reference, ULONG nAtoms)
+{
+   __shared__ REAL partial[GPUTHREADS];
+   const COORD *frame = batch + (size_t)blockIdx.x * 3 * nAtoms;
+   REAL        sumSq  = 0.0;
+   ULONG       i;
+   unsigned    step;
+
+   for(i=threadIdx.x; i<nAtoms; i+=blockDim.x)
+   {
+      REAL dx = (REAL)frame[i]            - (REAL)reference[i],
+           dy = (REAL)frame[nAtoms + i]   - (REAL)reference[nAtoms + i],
+           dz = (REAL)frame[2*nAtoms + i] - (REAL)reference[2*nAtoms + i];
+      sumSq += dx*dx + dy*dy + dz*dz;
+   }
+   partial[threadIdx.x] = sumSq;
+   __syncthreads();
+
+   for(step=blockDim.x/2; step>0; step/=2)
+   {
+      if(threadIdx.x < step)
+         partial[threadIdx.x] += partial[threadIdx.x + step];
+      __syncthreads();
+   }
+
+   if(threadIdx.x == 0)
+      rmsd[blockIdx.x] = sqrt(partial[0] / nAtoms);
+}
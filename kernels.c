@@ -0,0 +1,1280 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       kernels.c
+
+   Version:    V1.25
+   Date:       14.10.26
+   Function:   Vectorised kernels for the RMSD and mean calculations
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   The inner loops of RMSFrame(), AddFrame(), UpdateRunningMean() and
+   AddFrameKahan() work on the contiguous COORDS arrays, so they are
+   provided here in scalar, AVX2, AVX-512 and NEON versions. The set to
+   use is chosen once at startup with SelectKernels(), either by name
+   or automatically from the CPU features. FindKernels() makes the
+   same choice for a single trajectory, which then uses that set
+   whatever gKernels holds.
+
+   innerProduct gathers, in one sweep, all the sums needed to fit one
+   frame onto another: the coordinate sums of both frames, their
+   summed squares and the nine cross products. addSquares adds the
+   squared x, y and z of each atom to a per-atom sum for the RMSFs.
+
+   Only the squared-distance and inner-product sums change their
+   results with the kernel since they add the atoms in a different
+   order. The accumulation kernels work on each coordinate
+   independently and use the same operations as the scalar code, so
+   give identical results.
+
+   The coordinates are COORDs, which are floats in a SINGLE_COORDS
+   build. All the arithmetic, and every sum, is still done in REAL:
+   the vector kernels widen the coordinates as they load them.
+
+   Each x86 set also has kernels for a multiple of the vector width,
+   with no remainder, and, built with -DFIXEDATOMS=n, the x86 and
+   scalar sets have kernels for exactly n atoms. KernelsForAtoms()
+   picks between them once a trajectory's atom count is known
+   (ReadTrajFrame()) and the frames it reads carry the choice, so
+   RMSFrame() and the accumulation functions call them with no test
+   of the count. They give identical results to the general kernels.
+
+   The x86 kernels are compiled with GCC/Clang target attributes so
+   the program as a whole can be built for any x86-64 CPU. NEON is
+   always present on AArch64 so needs no check.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.7   14.10.26 Original
+   V1.12  14.10.26 Added innerProduct for fitted RMSDs (fit.c)
+   V1.17  14.10.26 Added addSquares for RMSFs (rmsf.c)
+   V1.23  14.10.26 Coordinates are COORDs
+   V1.24  14.10.26 Added the kernels for a multiple of the vector
+                   width and for FIXEDATOMS atoms (KernelsForAtoms()).
+                   The scalar remainder is only called when there is
+                   one
+   V1.25  14.10.26 Added FindKernels() so each trajectory can use its
+                   own set
+
+*************************************************************************/
+/* Includes
+*/
+#include "flexcalc.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#  define X86_KERNELS
+#  include <immintrin.h>
+#endif
+#if defined(__aarch64__)
+#  define NEON_KERNELS
+#  include <arm_neon.h>
+#endif
+
+/***********************************************************************/
+/* Defines and macros
+ */
+/* Load coordinates into a vector of doubles. A SINGLE_COORDS build
+   widens them from float as they are loaded.
+*/
+#ifdef SINGLE_COORDS
+#  define LOADCOORD4(p) _mm256_cvtps_pd(_mm_loadu_ps(p))
+#  define LOADCOORD8(p) _mm512_cvtps_pd(_mm256_loadu_ps(p))
+#  define LOADCOORD2(p) vcvt_f64_f32(vld1_f32(p))
+#else
+#  define LOADCOORD4(p) _mm256_loadu_pd(p)
+#  define LOADCOORD8(p) _mm512_loadu_pd(p)
+#  define LOADCOORD2(p) vld1q_f64(p)
+#endif
+
+/* Unroll the vector loops. This leaves the order of the sums alone    */
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ >= 8))
+#  define UNROLL _Pragma("GCC unroll 4")
+#else
+#  define UNROLL
+#endif
+
+/* With FIXEDATOMS defined (e.g. make DEFS=-DFIXEDATOMS=3341) each set
+   has kernels for exactly that many atoms. FIXEDBLOCKS(w) is the
+   number of them done w at a time.
+*/
+#ifdef FIXEDATOMS
+#  define FIXEDBLOCKS(w) ((ULONG)(FIXEDATOMS) - (ULONG)(FIXEDATOMS) % (w))
+#  define FIXEDSET(k)    (&(k))
+#else
+#  define FIXEDSET(k)    NULL
+#endif
+
+/***********************************************************************/
+/* Prototypes
+ */
+static REAL SumSqDistScalar(COORD *x1, COORD *y1, COORD *z1,
+                            COORD *x2, COORD *y2, COORD *z2, ULONG n);
+static void AddDividedScalar(REAL *sum, COORD *x, REAL divisor, ULONG n);
+static void UpdateMeanScalar(REAL *mean, COORD *x, REAL count, ULONG n);
+static void AddKahanScalar(REAL *sum, REAL *comp, COORD *x, ULONG n);
+static void AddSquaresScalar(REAL *sum, COORD *x, COORD *y, COORD *z,
+                             ULONG n);
+static void InnerProductScalar(COORD *x1, COORD *y1, COORD *z1,
+                               COORD *x2, COORD *y2, COORD *z2, ULONG n,
+                               REAL *sums);
+#ifdef FIXEDATOMS
+static REAL SumSqDistFixedScalar(COORD *x1, COORD *y1, COORD *z1,
+                                 COORD *x2, COORD *y2, COORD *z2,
+                                 ULONG n);
+static void AddDividedFixedScalar(REAL *sum, COORD *x, REAL divisor,
+                                  ULONG n);
+static void UpdateMeanFixedScalar(REAL *mean, COORD *x, REAL count,
+                                  ULONG n);
+static void AddKahanFixedScalar(REAL *sum, REAL *comp, COORD *x,
+                                ULONG n);
+#endif
+#ifdef X86_KERNELS
+static REAL SumSqDistBlockedAVX2(COORD *x1, COORD *y1, COORD *z1,
+                                 COORD *x2, COORD *y2, COORD *z2, ULONG n);
+static void AddDividedBlockedAVX2(REAL *sum, COORD *x, REAL divisor, ULONG n);
+static void UpdateMeanBlockedAVX2(REAL *mean, COORD *x, REAL count, ULONG n);
+static void AddKahanBlockedAVX2(REAL *sum, REAL *comp, COORD *x, ULONG n);
+static void AddSquaresBlockedAVX2(REAL *sum, COORD *x, COORD *y, COORD *z,
+                                  ULONG n);
+static void InnerProductBlockedAVX2(COORD *x1, COORD *y1, COORD *z1,
+                                    COORD *x2, COORD *y2, COORD *z2, ULONG n,
+                                    REAL *sums);
+static REAL ReduceAVX2(__m256d v);
+static REAL SumSqDistAVX2(COORD *x1, COORD *y1, COORD *z1,
+                          COORD *x2, COORD *y2, COORD *z2, ULONG n);
+static void AddDividedAVX2(REAL *sum, COORD *x, REAL divisor, ULONG n);
+static void UpdateMeanAVX2(REAL *mean, COORD *x, REAL count, ULONG n);
+static void AddKahanAVX2(REAL *sum, REAL *comp, COORD *x, ULONG n);
+static void AddSquaresAVX2(REAL *sum, COORD *x, COORD *y, COORD *z, ULONG n);
+static void InnerProductAVX2(COORD *x1, COORD *y1, COORD *z1,
+                             COORD *x2, COORD *y2, COORD *z2, ULONG n,
+                             REAL *sums);
+static REAL SumSqDistBlockedAVX512(COORD *x1, COORD *y1, COORD *z1,
+                                   COORD *x2, COORD *y2, COORD *z2, ULONG n);
+static void AddDividedBlockedAVX512(REAL *sum, COORD *x, REAL divisor,
+                                    ULONG n);
+static void UpdateMeanBlockedAVX512(REAL *mean, COORD *x, REAL count, ULONG n);
+static void AddKahanBlockedAVX512(REAL *sum, REAL *comp, COORD *x, ULONG n);
+static void AddSquaresBlockedAVX512(REAL *sum, COORD *x, COORD *y, COORD *z,
+                                    ULONG n);
+static void InnerProductBlockedAVX512(COORD *x1, COORD *y1, COORD *z1,
+                                      COORD *x2, COORD *y2, COORD *z2,
+                                      ULONG n, REAL *sums);
+static REAL SumSqDistAVX512(COORD *x1, COORD *y1, COORD *z1,
+                            COORD *x2, COORD *y2, COORD *z2, ULONG n);
+static void AddDividedAVX512(REAL *sum, COORD *x, REAL divisor, ULONG n);
+static void UpdateMeanAVX512(REAL *mean, COORD *x, REAL count, ULONG n);
+static void AddKahanAVX512(REAL *sum, REAL *comp, COORD *x, ULONG n);
+static void AddSquaresAVX512(REAL *sum, COORD *x, COORD *y, COORD *z, ULONG n);
+static void InnerProductAVX512(COORD *x1, COORD *y1, COORD *z1,
+                               COORD *x2, COORD *y2, COORD *z2, ULONG n,
+                               REAL *sums);
+#ifdef FIXEDATOMS
+static REAL SumSqDistFixedBlocksAVX2(COORD *x1, COORD *y1, COORD *z1,
+                                     COORD *x2, COORD *y2, COORD *z2, ULONG n);
+static REAL SumSqDistFixedAVX2(COORD *x1, COORD *y1, COORD *z1,
+                               COORD *x2, COORD *y2, COORD *z2, ULONG n);
+static void AddDividedFixedBlocksAVX2(REAL *sum, COORD *x, REAL divisor,
+                                      ULONG n);
+static void AddDividedFixedAVX2(REAL *sum, COORD *x, REAL divisor, ULONG n);
+static void UpdateMeanFixedBlocksAVX2(REAL *mean, COORD *x, REAL count,
+                                      ULONG n);
+static void UpdateMeanFixedAVX2(REAL *mean, COORD *x, REAL count, ULONG n);
+static void AddKahanFixedBlocksAVX2(REAL *sum, REAL *comp, COORD *x, ULONG n);
+static void AddKahanFixedAVX2(REAL *sum, REAL *comp, COORD *x, ULONG n);
+static REAL SumSqDistFixedBlocksAVX512(COORD *x1, COORD *y1, COORD *z1,
+                                       COORD *x2, COORD *y2, COORD *z2,
+                                       ULONG n);
+static REAL SumSqDistFixedAVX512(COORD *x1, COORD *y1, COORD *z1,
+                                 COORD *x2, COORD *y2, COORD *z2, ULONG n);
+static void AddDividedFixedBlocksAVX512(REAL *sum, COORD *x, REAL divisor,
+                                        ULONG n);
+static void AddDividedFixedAVX512(REAL *sum, COORD *x, REAL divisor, ULONG n);
+static void UpdateMeanFixedBlocksAVX512(REAL *mean, COORD *x, REAL count,
+                                        ULONG n);
+static void UpdateMeanFixedAVX512(REAL *mean, COORD *x, REAL count, ULONG n);
+static void AddKahanFixedBlocksAVX512(REAL *sum, REAL *comp, COORD *x,
+                                      ULONG n);
+static void AddKahanFixedAVX512(REAL *sum, REAL *comp, COORD *x, ULONG n);
+#endif
+#endif
+#ifdef NEON_KERNELS
+static REAL SumSqDistNEON(COORD *x1, COORD *y1, COORD *z1,
+                          COORD *x2, COORD *y2, COORD *z2, ULONG n);
+static void AddDividedNEON(REAL *sum, COORD *x, REAL divisor, ULONG n);
+static void UpdateMeanNEON(REAL *mean, COORD *x, REAL count, ULONG n);
+static void AddKahanNEON(REAL *sum, REAL *comp, COORD *x, ULONG n);
+static void AddSquaresNEON(REAL *sum, COORD *x, COORD *y, COORD *z,
+                           ULONG n);
+static void InnerProductNEON(COORD *x1, COORD *y1, COORD *z1,
+                             COORD *x2, COORD *y2, COORD *z2, ULONG n,
+                             REAL *sums);
+#endif
+
+/***********************************************************************/
+/* Globals
+ */
+/* The kernels for a multiple of the vector width and for FIXEDATOMS
+   atoms. The FIXEDATOMS sets share innerProduct and addSquares with
+   the general set.
+*/
+#ifdef X86_KERNELS
+static KERNELS sBlockedAVX512 =
+{
+   "avx512", SumSqDistBlockedAVX512, AddDividedBlockedAVX512,
+             UpdateMeanBlockedAVX512, AddKahanBlockedAVX512,
+             InnerProductBlockedAVX512, AddSquaresBlockedAVX512,
+             8, NULL, NULL
+};
+static KERNELS sBlockedAVX2 =
+{
+   "avx2",   SumSqDistBlockedAVX2, AddDividedBlockedAVX2,
+             UpdateMeanBlockedAVX2, AddKahanBlockedAVX2,
+             InnerProductBlockedAVX2, AddSquaresBlockedAVX2,
+             4, NULL, NULL
+};
+#endif
+#ifdef FIXEDATOMS
+#  ifdef X86_KERNELS
+static KERNELS sFixedAVX512 =
+{
+   "avx512", SumSqDistFixedAVX512, AddDividedFixedAVX512,
+             UpdateMeanFixedAVX512, AddKahanFixedAVX512,
+             InnerProductAVX512, AddSquaresAVX512, 8, NULL, NULL
+};
+static KERNELS sFixedAVX2 =
+{
+   "avx2",   SumSqDistFixedAVX2, AddDividedFixedAVX2,
+             UpdateMeanFixedAVX2, AddKahanFixedAVX2,
+             InnerProductAVX2, AddSquaresAVX2, 4, NULL, NULL
+};
+#  endif
+static KERNELS sFixedScalar =
+{
+   "scalar", SumSqDistFixedScalar, AddDividedFixedScalar,
+             UpdateMeanFixedScalar, AddKahanFixedScalar,
+             InnerProductScalar, AddSquaresScalar, 1, NULL, NULL
+};
+#endif
+
+/* The available kernels, best first                                    */
+static KERNELS sKernels[] =
+{
+#ifdef X86_KERNELS
+   {"avx512", SumSqDistAVX512, AddDividedAVX512, UpdateMeanAVX512,
+              AddKahanAVX512,   InnerProductAVX512, AddSquaresAVX512,
+              8, &sBlockedAVX512, FIXEDSET(sFixedAVX512)},
+   {"avx2",   SumSqDistAVX2,   AddDividedAVX2,   UpdateMeanAVX2,
+              AddKahanAVX2,     InnerProductAVX2,   AddSquaresAVX2,
+              4, &sBlockedAVX2,   FIXEDSET(sFixedAVX2)},
+#endif
+#ifdef NEON_KERNELS
+   {"neon",   SumSqDistNEON,   AddDividedNEON,   UpdateMeanNEON,
+              AddKahanNEON,     InnerProductNEON,   AddSquaresNEON,
+              2, NULL,            NULL},
+#endif
+   {"scalar", SumSqDistScalar, AddDividedScalar, UpdateMeanScalar,
+              AddKahanScalar,   InnerProductScalar, AddSquaresScalar,
+              1, NULL,            FIXEDSET(sFixedScalar)}
+};
+#define NKERNELS (sizeof(sKernels) / sizeof(KERNELS))
+
+/* The kernels in use - scalar until SelectKernels() is called          */
+KERNELS gKernels =
+{
+   "scalar", SumSqDistScalar, AddDividedScalar, UpdateMeanScalar,
+             AddKahanScalar,   InnerProductScalar, AddSquaresScalar,
+             1, NULL,          FIXEDSET(sFixedScalar)
+};
+
+
+/***********************************************************************/
+/*>static BOOL KernelSupported(char *name)
+   ---------------------------------------
+*//**
+   \param[in]  *name           kernel name
+   \return                     Does this CPU support the kernel?
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL KernelSupported(char *name)
+{
+#ifdef X86_KERNELS
+   __builtin_cpu_init();
+   if(!strcmp(name, "avx512"))
+      return(__builtin_cpu_supports("avx512f") ? TRUE : FALSE);
+   if(!strcmp(name, "avx2"))
+      return((__builtin_cpu_supports("avx2") &&
+              __builtin_cpu_supports("fma")) ? TRUE : FALSE);
+#endif
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>BOOL SelectKernels(char *name)
+   ------------------------------
+*//**
+   \param[in]  *name           kernel name, or "auto" (or NULL or
+                               blank) for the best this CPU supports
+   \return                     Was the kernel available?
+
+   Sets gKernels to the requested kernels
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Uses FindKernels()
+*/
+BOOL SelectKernels(char *name)
+{
+   KERNELS *kernels;
+
+   if((kernels = FindKernels(name))==NULL)
+      return(FALSE);
+   gKernels = *kernels;
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>KERNELS *FindKernels(char *name)
+   --------------------------------
+*//**
+   \param[in]  *name           kernel name, or "auto" (or NULL or
+                               blank) for the best this CPU supports
+   \return                     the kernels (NULL if not available)
+
+   Finds the requested kernels without changing gKernels, so that
+   calculations in several threads can each use their own
+
+-  14.10.26 Original   By: ACRM
+*/
+KERNELS *FindKernels(char *name)
+{
+   ULONG i;
+   BOOL  autoSelect = ((name == NULL) || (name[0] == '\0') ||
+                       !strcmp(name, "auto"));
+
+   for(i=0; i<NKERNELS; i++)
+   {
+      if((autoSelect || !strcmp(name, sKernels[i].name)) &&
+         KernelSupported(sKernels[i].name))
+         return(&(sKernels[i]));
+   }
+   return(NULL);
+}
+
+
+/***********************************************************************/
+/*>KERNELS *KernelsForAtoms(KERNELS *kernels, ULONG nAtoms)
+   --------------------------------------------------------
+*//**
+   \param[in]  *kernels        a set of kernels (normally &gKernels)
+   \param[in]  nAtoms          number of atoms they will be used for
+   \return                     the set specialised for that number of
+                               atoms, or kernels itself if there isn't
+                               one
+
+   Chooses, once for a trajectory's atom count, the kernels without a
+   remainder (a multiple of the vector width) or, with FIXEDATOMS, for
+   exactly that count. They may then only be used for nAtoms atoms.
+
+-  14.10.26 Original   By: ACRM
+*/
+KERNELS *KernelsForAtoms(KERNELS *kernels, ULONG nAtoms)
+{
+#ifdef FIXEDATOMS
+   if((nAtoms == FIXEDATOMS) && (kernels->fixed != NULL))
+      return(kernels->fixed);
+#endif
+   if((kernels->blocked != NULL) && ((nAtoms % kernels->width) == 0))
+      return(kernels->blocked);
+   return(kernels);
+}
+
+
+/***********************************************************************/
+/*>void ListKernels(FILE *out)
+   ---------------------------
+*//**
+   \param[in]  *out            output file
+
+   Lists the kernels built into the program
+
+-  14.10.26 Original   By: ACRM
+*/
+void ListKernels(FILE *out)
+{
+   ULONG i;
+
+   for(i=0; i<NKERNELS; i++)
+      fprintf(out, "%s%s", (i ? ", " : ""), sKernels[i].name);
+}
+
+
+/***********************************************************************/
+/* Scalar kernels. SumSqDistScalar() adds the atoms in the same order
+   as the original RMSFrame() code. The coordinates are converted to
+   REAL before any arithmetic so a float build does not compute in float.
+*/
+static REAL SumSqDistScalar(COORD *x1, COORD *y1, COORD *z1,
+                            COORD *x2, COORD *y2, COORD *z2, ULONG n)
+{
+   REAL  sum = 0.0;
+   ULONG i;
+
+   for(i=0; i<n; i++)
+   {
+      REAL dx = (REAL)x1[i] - (REAL)x2[i],
+           dy = (REAL)y1[i] - (REAL)y2[i],
+           dz = (REAL)z1[i] - (REAL)z2[i];
+      sum += dx * dx + dy * dy + dz * dz;
+   }
+   return(sum);
+}
+
+static void AddDividedScalar(REAL *sum, COORD *x, REAL divisor, ULONG n)
+{
+   ULONG i;
+   for(i=0; i<n; i++)
+      sum[i] += ((REAL)x[i] / divisor);
+}
+
+static void UpdateMeanScalar(REAL *mean, COORD *x, REAL count, ULONG n)
+{
+   ULONG i;
+   for(i=0; i<n; i++)
+      mean[i] += ((REAL)x[i] - mean[i]) / count;
+}
+
+static void AddKahanScalar(REAL *sum, REAL *comp, COORD *x, ULONG n)
+{
+   ULONG i;
+   for(i=0; i<n; i++)
+   {
+      REAL v = (REAL)x[i] - comp[i],
+           t = sum[i] + v;
+      comp[i] = (t - sum[i]) - v;
+      sum[i]  = t;
+   }
+}
+
+static void AddSquaresScalar(REAL *sum, COORD *x, COORD *y, COORD *z,
+                             ULONG n)
+{
+   ULONG i;
+   for(i=0; i<n; i++)
+   {
+      REAL xi = x[i], yi = y[i], zi = z[i];
+      sum[i] += xi * xi + yi * yi + zi * zi;
+   }
+}
+
+static void InnerProductScalar(COORD *x1, COORD *y1, COORD *z1,
+                               COORD *x2, COORD *y2, COORD *z2, ULONG n,
+                               REAL *sums)
+{
+   ULONG i;
+   for(i=0; i<n; i++)
+   {
+      REAL ax = x1[i], ay = y1[i], az = z1[i],
+           bx = x2[i], by = y2[i], bz = z2[i];
+
+      sums[0]  += ax;
+      sums[1]  += ay;
+      sums[2]  += az;
+      sums[3]  += bx;
+      sums[4]  += by;
+      sums[5]  += bz;
+      sums[6]  += ax*ax + ay*ay + az*az +
+                  bx*bx + by*by + bz*bz;
+      sums[7]  += ax * bx;
+      sums[8]  += ax * by;
+      sums[9]  += ax * bz;
+      sums[10] += ay * bx;
+      sums[11] += ay * by;
+      sums[12] += ay * bz;
+      sums[13] += az * bx;
+      sums[14] += az * by;
+      sums[15] += az * bz;
+   }
+}
+
+#ifdef FIXEDATOMS
+/* Scalar kernels for exactly FIXEDATOMS atoms. The count is a constant
+   so the compiler can unroll the loops. n is ignored.
+*/
+static REAL SumSqDistFixedScalar(COORD *x1, COORD *y1, COORD *z1,
+                                 COORD *x2, COORD *y2, COORD *z2,
+                                 ULONG n)
+{
+   return(SumSqDistScalar(x1, y1, z1, x2, y2, z2, FIXEDATOMS));
+}
+
+static void AddDividedFixedScalar(REAL *sum, COORD *x, REAL divisor,
+                                  ULONG n)
+{
+   AddDividedScalar(sum, x, divisor, FIXEDATOMS);
+}
+
+static void UpdateMeanFixedScalar(REAL *mean, COORD *x, REAL count,
+                                  ULONG n)
+{
+   UpdateMeanScalar(mean, x, count, FIXEDATOMS);
+}
+
+static void AddKahanFixedScalar(REAL *sum, REAL *comp, COORD *x,
+                                ULONG n)
+{
+   AddKahanScalar(sum, comp, x, FIXEDATOMS);
+}
+#endif
+
+
+#ifdef X86_KERNELS
+/***********************************************************************/
+/* AVX2 kernels - 4 doubles at a time. Separate accumulators for x, y
+   and z keep the three FMA chains independent.
+
+   Each ...Blocked() kernel does a multiple of 4 atoms and is the
+   kernel used when there is no remainder. The general kernels, and
+   with FIXEDATOMS the Fixed ones, are plain code which calls it and
+   then the scalar kernel for any remaining atoms, so they add the same
+   values in the same order and give identical results. The loops of
+   the kernels with a Fixed version are inlined from ...Blocks() so
+   that one has a constant count.
+
+   Only the vector code is compiled for AVX, and it only returns, so
+   the compiler clears the upper halves of the vector registers
+   (vzeroupper) as it leaves. The scalar code, like the rest of the
+   program, is SSE code which runs far more slowly while they are
+   dirty.
+*/
+__attribute__((target("avx2,fma"), always_inline))
+static __inline__ REAL SumSqDistBlocksAVX2(COORD *x1, COORD *y1, COORD *z1,
+                                           COORD *x2, COORD *y2, COORD *z2,
+                                           ULONG n)
+{
+   __m256d ax = _mm256_setzero_pd(),
+           ay = _mm256_setzero_pd(),
+           az = _mm256_setzero_pd(),
+           d;
+   ULONG   i;
+
+   UNROLL
+   for(i=0; i<n; i+=4)
+   {
+      d  = _mm256_sub_pd(LOADCOORD4(x1+i), LOADCOORD4(x2+i));
+      ax = _mm256_fmadd_pd(d, d, ax);
+      d  = _mm256_sub_pd(LOADCOORD4(y1+i), LOADCOORD4(y2+i));
+      ay = _mm256_fmadd_pd(d, d, ay);
+      d  = _mm256_sub_pd(LOADCOORD4(z1+i), LOADCOORD4(z2+i));
+      az = _mm256_fmadd_pd(d, d, az);
+   }
+   return(ReduceAVX2(_mm256_add_pd(_mm256_add_pd(ax, ay), az)));
+}
+
+__attribute__((target("avx2,fma")))
+static REAL SumSqDistBlockedAVX2(COORD *x1, COORD *y1, COORD *z1,
+                                 COORD *x2, COORD *y2, COORD *z2, ULONG n)
+{
+   return(SumSqDistBlocksAVX2(x1, y1, z1, x2, y2, z2, n));
+}
+
+__attribute__((target("avx2,fma"), always_inline))
+static __inline__ void AddDividedBlocksAVX2(REAL *sum, COORD *x, REAL divisor,
+                                            ULONG n)
+{
+   __m256d d = _mm256_set1_pd(divisor);
+   ULONG   i;
+
+   UNROLL
+   for(i=0; i<n; i+=4)
+   {
+      _mm256_storeu_pd(sum+i,
+                       _mm256_add_pd(_mm256_loadu_pd(sum+i),
+                                     _mm256_div_pd(LOADCOORD4(x+i),
+                                                   d)));
+   }
+}
+
+__attribute__((target("avx2,fma")))
+static void AddDividedBlockedAVX2(REAL *sum, COORD *x, REAL divisor, ULONG n)
+{
+   AddDividedBlocksAVX2(sum, x, divisor, n);
+}
+
+__attribute__((target("avx2,fma"), always_inline))
+static __inline__ void UpdateMeanBlocksAVX2(REAL *mean, COORD *x, REAL count,
+                                            ULONG n)
+{
+   __m256d c = _mm256_set1_pd(count),
+           m;
+   ULONG   i;
+
+   UNROLL
+   for(i=0; i<n; i+=4)
+   {
+      m = _mm256_loadu_pd(mean+i);
+      m = _mm256_add_pd(m, _mm256_div_pd(_mm256_sub_pd(
+                                            LOADCOORD4(x+i), m), c));
+      _mm256_storeu_pd(mean+i, m);
+   }
+}
+
+__attribute__((target("avx2,fma")))
+static void UpdateMeanBlockedAVX2(REAL *mean, COORD *x, REAL count, ULONG n)
+{
+   UpdateMeanBlocksAVX2(mean, x, count, n);
+}
+
+__attribute__((target("avx2,fma"), always_inline))
+static __inline__ void AddKahanBlocksAVX2(REAL *sum, REAL *comp, COORD *x,
+                                          ULONG n)
+{
+   __m256d s, c, v, t;
+   ULONG   i;
+
+   UNROLL
+   for(i=0; i<n; i+=4)
+   {
+      s = _mm256_loadu_pd(sum+i);
+      c = _mm256_loadu_pd(comp+i);
+      v = _mm256_sub_pd(LOADCOORD4(x+i), c);
+      t = _mm256_add_pd(s, v);
+      _mm256_storeu_pd(comp+i, _mm256_sub_pd(_mm256_sub_pd(t, s), v));
+      _mm256_storeu_pd(sum+i,  t);
+   }
+}
+
+__attribute__((target("avx2,fma")))
+static void AddKahanBlockedAVX2(REAL *sum, REAL *comp, COORD *x, ULONG n)
+{
+   AddKahanBlocksAVX2(sum, comp, x, n);
+}
+
+__attribute__((target("avx2,fma")))
+static void AddSquaresBlockedAVX2(REAL *sum, COORD *x, COORD *y, COORD *z,
+                                  ULONG n)
+{
+   __m256d a, b, c;
+   ULONG   i;
+
+   /* Multiply and add separately, as the scalar code does, so the
+      sums are identical
+   */
+   for(i=0; i<n; i+=4)
+   {
+      a = LOADCOORD4(x+i);
+      b = LOADCOORD4(y+i);
+      c = LOADCOORD4(z+i);
+      a = _mm256_add_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(b, b));
+      a = _mm256_add_pd(a, _mm256_mul_pd(c, c));
+      _mm256_storeu_pd(sum+i, _mm256_add_pd(_mm256_loadu_pd(sum+i), a));
+   }
+}
+
+__attribute__((target("avx2,fma")))
+static void InnerProductBlockedAVX2(COORD *x1, COORD *y1, COORD *z1,
+                                    COORD *x2, COORD *y2, COORD *z2, ULONG n,
+                                    REAL *sums)
+{
+   __m256d acc[NINNERSUMS], a[3], b[3];
+   ULONG   i;
+   int     j, k;
+
+   for(j=0; j<NINNERSUMS; j++)
+      acc[j] = _mm256_setzero_pd();
+
+   for(i=0; i<n; i+=4)
+   {
+      a[0] = LOADCOORD4(x1+i);
+      a[1] = LOADCOORD4(y1+i);
+      a[2] = LOADCOORD4(z1+i);
+      b[0] = LOADCOORD4(x2+i);
+      b[1] = LOADCOORD4(y2+i);
+      b[2] = LOADCOORD4(z2+i);
+      for(j=0; j<3; j++)
+      {
+         acc[j]   = _mm256_add_pd(acc[j],   a[j]);
+         acc[j+3] = _mm256_add_pd(acc[j+3], b[j]);
+         acc[6]   = _mm256_fmadd_pd(a[j], a[j], acc[6]);
+         acc[6]   = _mm256_fmadd_pd(b[j], b[j], acc[6]);
+         for(k=0; k<3; k++)
+            acc[7+3*j+k] = _mm256_fmadd_pd(a[j], b[k], acc[7+3*j+k]);
+      }
+   }
+   for(j=0; j<NINNERSUMS; j++)
+      sums[j] += ReduceAVX2(acc[j]);
+}
+
+__attribute__((target("avx2,fma")))
+static REAL ReduceAVX2(__m256d v)
+{
+   __m128d lo = _mm256_castpd256_pd128(v),
+           hi = _mm256_extractf128_pd(v, 1);
+   lo = _mm_add_pd(lo, hi);
+   return(_mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo))));
+}
+
+static REAL SumSqDistAVX2(COORD *x1, COORD *y1, COORD *z1,
+                          COORD *x2, COORD *y2, COORD *z2, ULONG n)
+{
+   ULONG i   = n - n % 4;
+   REAL  sum = SumSqDistBlockedAVX2(x1, y1, z1, x2, y2, z2, i);
+
+   if(i < n)
+      sum += SumSqDistScalar(x1+i, y1+i, z1+i, x2+i, y2+i, z2+i, n-i);
+   return(sum);
+}
+
+static void AddDividedAVX2(REAL *sum, COORD *x, REAL divisor, ULONG n)
+{
+   ULONG i = n - n % 4;
+
+   AddDividedBlockedAVX2(sum, x, divisor, i);
+   if(i < n)
+      AddDividedScalar(sum+i, x+i, divisor, n-i);
+}
+
+static void UpdateMeanAVX2(REAL *mean, COORD *x, REAL count, ULONG n)
+{
+   ULONG i = n - n % 4;
+
+   UpdateMeanBlockedAVX2(mean, x, count, i);
+   if(i < n)
+      UpdateMeanScalar(mean+i, x+i, count, n-i);
+}
+
+static void AddKahanAVX2(REAL *sum, REAL *comp, COORD *x, ULONG n)
+{
+   ULONG i = n - n % 4;
+
+   AddKahanBlockedAVX2(sum, comp, x, i);
+   if(i < n)
+      AddKahanScalar(sum+i, comp+i, x+i, n-i);
+}
+
+static void AddSquaresAVX2(REAL *sum, COORD *x, COORD *y, COORD *z, ULONG n)
+{
+   ULONG i = n - n % 4;
+
+   AddSquaresBlockedAVX2(sum, x, y, z, i);
+   if(i < n)
+      AddSquaresScalar(sum+i, x+i, y+i, z+i, n-i);
+}
+
+static void InnerProductAVX2(COORD *x1, COORD *y1, COORD *z1,
+                             COORD *x2, COORD *y2, COORD *z2, ULONG n,
+                             REAL *sums)
+{
+   ULONG i = n - n % 4;
+
+   InnerProductBlockedAVX2(x1, y1, z1, x2, y2, z2, i, sums);
+   if(i < n)
+      InnerProductScalar(x1+i, y1+i, z1+i, x2+i, y2+i, z2+i, n-i, sums);
+}
+
+#ifdef FIXEDATOMS
+/* For exactly FIXEDATOMS atoms. n is ignored                           */
+__attribute__((target("avx2,fma")))
+static REAL SumSqDistFixedBlocksAVX2(COORD *x1, COORD *y1, COORD *z1,
+                                     COORD *x2, COORD *y2, COORD *z2, ULONG n)
+{
+   return(SumSqDistBlocksAVX2(x1, y1, z1, x2, y2, z2, FIXEDBLOCKS(4)));
+}
+
+static REAL SumSqDistFixedAVX2(COORD *x1, COORD *y1, COORD *z1,
+                               COORD *x2, COORD *y2, COORD *z2, ULONG n)
+{
+   REAL sum = SumSqDistFixedBlocksAVX2(x1, y1, z1, x2, y2, z2, n);
+
+   if(FIXEDBLOCKS(4) < FIXEDATOMS)
+      sum += SumSqDistScalar(x1+FIXEDBLOCKS(4), y1+FIXEDBLOCKS(4),
+                             z1+FIXEDBLOCKS(4), x2+FIXEDBLOCKS(4),
+                             y2+FIXEDBLOCKS(4), z2+FIXEDBLOCKS(4),
+                             FIXEDATOMS - FIXEDBLOCKS(4));
+   return(sum);
+}
+
+__attribute__((target("avx2,fma")))
+static void AddDividedFixedBlocksAVX2(REAL *sum, COORD *x, REAL divisor,
+                                      ULONG n)
+{
+   AddDividedBlocksAVX2(sum, x, divisor, FIXEDBLOCKS(4));
+}
+
+static void AddDividedFixedAVX2(REAL *sum, COORD *x, REAL divisor, ULONG n)
+{
+   AddDividedFixedBlocksAVX2(sum, x, divisor, n);
+   if(FIXEDBLOCKS(4) < FIXEDATOMS)
+      AddDividedScalar(sum+FIXEDBLOCKS(4), x+FIXEDBLOCKS(4), divisor,
+                       FIXEDATOMS - FIXEDBLOCKS(4));
+}
+
+__attribute__((target("avx2,fma")))
+static void UpdateMeanFixedBlocksAVX2(REAL *mean, COORD *x, REAL count,
+                                      ULONG n)
+{
+   UpdateMeanBlocksAVX2(mean, x, count, FIXEDBLOCKS(4));
+}
+
+static void UpdateMeanFixedAVX2(REAL *mean, COORD *x, REAL count, ULONG n)
+{
+   UpdateMeanFixedBlocksAVX2(mean, x, count, n);
+   if(FIXEDBLOCKS(4) < FIXEDATOMS)
+      UpdateMeanScalar(mean+FIXEDBLOCKS(4), x+FIXEDBLOCKS(4), count,
+                       FIXEDATOMS - FIXEDBLOCKS(4));
+}
+
+__attribute__((target("avx2,fma")))
+static void AddKahanFixedBlocksAVX2(REAL *sum, REAL *comp, COORD *x, ULONG n)
+{
+   AddKahanBlocksAVX2(sum, comp, x, FIXEDBLOCKS(4));
+}
+
+static void AddKahanFixedAVX2(REAL *sum, REAL *comp, COORD *x, ULONG n)
+{
+   AddKahanFixedBlocksAVX2(sum, comp, x, n);
+   if(FIXEDBLOCKS(4) < FIXEDATOMS)
+      AddKahanScalar(sum+FIXEDBLOCKS(4), comp+FIXEDBLOCKS(4),
+                     x+FIXEDBLOCKS(4), FIXEDATOMS - FIXEDBLOCKS(4));
+}
+#endif
+
+
+/***********************************************************************/
+/* AVX-512 kernels - 8 doubles at a time, built in the same way        */
+__attribute__((target("avx512f"), always_inline))
+static __inline__ REAL SumSqDistBlocksAVX512(COORD *x1, COORD *y1, COORD *z1,
+                                             COORD *x2, COORD *y2, COORD *z2,
+                                             ULONG n)
+{
+   __m512d ax = _mm512_setzero_pd(),
+           ay = _mm512_setzero_pd(),
+           az = _mm512_setzero_pd(),
+           d;
+   ULONG   i;
+
+   UNROLL
+   for(i=0; i<n; i+=8)
+   {
+      d  = _mm512_sub_pd(LOADCOORD8(x1+i), LOADCOORD8(x2+i));
+      ax = _mm512_fmadd_pd(d, d, ax);
+      d  = _mm512_sub_pd(LOADCOORD8(y1+i), LOADCOORD8(y2+i));
+      ay = _mm512_fmadd_pd(d, d, ay);
+      d  = _mm512_sub_pd(LOADCOORD8(z1+i), LOADCOORD8(z2+i));
+      az = _mm512_fmadd_pd(d, d, az);
+   }
+   return(_mm512_reduce_add_pd(_mm512_add_pd(_mm512_add_pd(ax, ay), az)));
+}
+
+__attribute__((target("avx512f")))
+static REAL SumSqDistBlockedAVX512(COORD *x1, COORD *y1, COORD *z1,
+                                   COORD *x2, COORD *y2, COORD *z2, ULONG n)
+{
+   return(SumSqDistBlocksAVX512(x1, y1, z1, x2, y2, z2, n));
+}
+
+__attribute__((target("avx512f"), always_inline))
+static __inline__ void AddDividedBlocksAVX512(REAL *sum, COORD *x,
+                                              REAL divisor, ULONG n)
+{
+   __m512d d = _mm512_set1_pd(divisor);
+   ULONG   i;
+
+   UNROLL
+   for(i=0; i<n; i+=8)
+   {
+      _mm512_storeu_pd(sum+i,
+                       _mm512_add_pd(_mm512_loadu_pd(sum+i),
+                                     _mm512_div_pd(LOADCOORD8(x+i),
+                                                   d)));
+   }
+}
+
+__attribute__((target("avx512f")))
+static void AddDividedBlockedAVX512(REAL *sum, COORD *x, REAL divisor,
+                                    ULONG n)
+{
+   AddDividedBlocksAVX512(sum, x, divisor, n);
+}
+
+__attribute__((target("avx512f"), always_inline))
+static __inline__ void UpdateMeanBlocksAVX512(REAL *mean, COORD *x,
+                                              REAL count, ULONG n)
+{
+   __m512d c = _mm512_set1_pd(count),
+           m;
+   ULONG   i;
+
+   UNROLL
+   for(i=0; i<n; i+=8)
+   {
+      m = _mm512_loadu_pd(mean+i);
+      m = _mm512_add_pd(m, _mm512_div_pd(_mm512_sub_pd(
+                                            LOADCOORD8(x+i), m), c));
+      _mm512_storeu_pd(mean+i, m);
+   }
+}
+
+__attribute__((target("avx512f")))
+static void UpdateMeanBlockedAVX512(REAL *mean, COORD *x, REAL count, ULONG n)
+{
+   UpdateMeanBlocksAVX512(mean, x, count, n);
+}
+
+__attribute__((target("avx512f"), always_inline))
+static __inline__ void AddKahanBlocksAVX512(REAL *sum, REAL *comp, COORD *x,
+                                            ULONG n)
+{
+   __m512d s, c, v, t;
+   ULONG   i;
+
+   UNROLL
+   for(i=0; i<n; i+=8)
+   {
+      s = _mm512_loadu_pd(sum+i);
+      c = _mm512_loadu_pd(comp+i);
+      v = _mm512_sub_pd(LOADCOORD8(x+i), c);
+      t = _mm512_add_pd(s, v);
+      _mm512_storeu_pd(comp+i, _mm512_sub_pd(_mm512_sub_pd(t, s), v));
+      _mm512_storeu_pd(sum+i,  t);
+   }
+}
+
+__attribute__((target("avx512f")))
+static void AddKahanBlockedAVX512(REAL *sum, REAL *comp, COORD *x, ULONG n)
+{
+   AddKahanBlocksAVX512(sum, comp, x, n);
+}
+
+__attribute__((target("avx512f")))
+static void AddSquaresBlockedAVX512(REAL *sum, COORD *x, COORD *y, COORD *z,
+                                    ULONG n)
+{
+   __m512d a, b, c;
+   ULONG   i;
+
+   /* Multiply and add separately, as the scalar code does, so the
+      sums are identical
+   */
+   for(i=0; i<n; i+=8)
+   {
+      a = LOADCOORD8(x+i);
+      b = LOADCOORD8(y+i);
+      c = LOADCOORD8(z+i);
+      a = _mm512_add_pd(_mm512_mul_pd(a, a), _mm512_mul_pd(b, b));
+      a = _mm512_add_pd(a, _mm512_mul_pd(c, c));
+      _mm512_storeu_pd(sum+i, _mm512_add_pd(_mm512_loadu_pd(sum+i), a));
+   }
+}
+
+__attribute__((target("avx512f")))
+static void InnerProductBlockedAVX512(COORD *x1, COORD *y1, COORD *z1,
+                                      COORD *x2, COORD *y2, COORD *z2,
+                                      ULONG n, REAL *sums)
+{
+   __m512d acc[NINNERSUMS], a[3], b[3];
+   ULONG   i;
+   int     j, k;
+
+   for(j=0; j<NINNERSUMS; j++)
+      acc[j] = _mm512_setzero_pd();
+
+   for(i=0; i<n; i+=8)
+   {
+      a[0] = LOADCOORD8(x1+i);
+      a[1] = LOADCOORD8(y1+i);
+      a[2] = LOADCOORD8(z1+i);
+      b[0] = LOADCOORD8(x2+i);
+      b[1] = LOADCOORD8(y2+i);
+      b[2] = LOADCOORD8(z2+i);
+      for(j=0; j<3; j++)
+      {
+         acc[j]   = _mm512_add_pd(acc[j],   a[j]);
+         acc[j+3] = _mm512_add_pd(acc[j+3], b[j]);
+         acc[6]   = _mm512_fmadd_pd(a[j], a[j], acc[6]);
+         acc[6]   = _mm512_fmadd_pd(b[j], b[j], acc[6]);
+         for(k=0; k<3; k++)
+            acc[7+3*j+k] = _mm512_fmadd_pd(a[j], b[k], acc[7+3*j+k]);
+      }
+   }
+   for(j=0; j<NINNERSUMS; j++)
+      sums[j] += _mm512_reduce_add_pd(acc[j]);
+}
+
+static REAL SumSqDistAVX512(COORD *x1, COORD *y1, COORD *z1,
+                            COORD *x2, COORD *y2, COORD *z2, ULONG n)
+{
+   ULONG i   = n - n % 8;
+   REAL  sum = SumSqDistBlockedAVX512(x1, y1, z1, x2, y2, z2, i);
+
+   if(i < n)
+      sum += SumSqDistScalar(x1+i, y1+i, z1+i, x2+i, y2+i, z2+i, n-i);
+   return(sum);
+}
+
+static void AddDividedAVX512(REAL *sum, COORD *x, REAL divisor, ULONG n)
+{
+   ULONG i = n - n % 8;
+
+   AddDividedBlockedAVX512(sum, x, divisor, i);
+   if(i < n)
+      AddDividedScalar(sum+i, x+i, divisor, n-i);
+}
+
+static void UpdateMeanAVX512(REAL *mean, COORD *x, REAL count, ULONG n)
+{
+   ULONG i = n - n % 8;
+
+   UpdateMeanBlockedAVX512(mean, x, count, i);
+   if(i < n)
+      UpdateMeanScalar(mean+i, x+i, count, n-i);
+}
+
+static void AddKahanAVX512(REAL *sum, REAL *comp, COORD *x, ULONG n)
+{
+   ULONG i = n - n % 8;
+
+   AddKahanBlockedAVX512(sum, comp, x, i);
+   if(i < n)
+      AddKahanScalar(sum+i, comp+i, x+i, n-i);
+}
+
+static void AddSquaresAVX512(REAL *sum, COORD *x, COORD *y, COORD *z, ULONG n)
+{
+   ULONG i = n - n % 8;
+
+   AddSquaresBlockedAVX512(sum, x, y, z, i);
+   if(i < n)
+      AddSquaresScalar(sum+i, x+i, y+i, z+i, n-i);
+}
+
+static void InnerProductAVX512(COORD *x1, COORD *y1, COORD *z1,
+                               COORD *x2, COORD *y2, COORD *z2, ULONG n,
+                               REAL *sums)
+{
+   ULONG i = n - n % 8;
+
+   InnerProductBlockedAVX512(x1, y1, z1, x2, y2, z2, i, sums);
+   if(i < n)
+      InnerProductScalar(x1+i, y1+i, z1+i, x2+i, y2+i, z2+i, n-i, sums);
+}
+
+#ifdef FIXEDATOMS
+/* For exactly FIXEDATOMS atoms. n is ignored                           */
+__attribute__((target("avx512f")))
+static REAL SumSqDistFixedBlocksAVX512(COORD *x1, COORD *y1, COORD *z1,
+                                       COORD *x2, COORD *y2, COORD *z2,
+                                       ULONG n)
+{
+   return(SumSqDistBlocksAVX512(x1, y1, z1, x2, y2, z2, FIXEDBLOCKS(8)));
+}
+
+static REAL SumSqDistFixedAVX512(COORD *x1, COORD *y1, COORD *z1,
+                                 COORD *x2, COORD *y2, COORD *z2, ULONG n)
+{
+   REAL sum = SumSqDistFixedBlocksAVX512(x1, y1, z1, x2, y2, z2, n);
+
+   if(FIXEDBLOCKS(8) < FIXEDATOMS)
+      sum += SumSqDistScalar(x1+FIXEDBLOCKS(8), y1+FIXEDBLOCKS(8),
+                             z1+FIXEDBLOCKS(8), x2+FIXEDBLOCKS(8),
+                             y2+FIXEDBLOCKS(8), z2+FIXEDBLOCKS(8),
+                             FIXEDATOMS - FIXEDBLOCKS(8));
+   return(sum);
+}
+
+__attribute__((target("avx512f")))
+static void AddDividedFixedBlocksAVX512(REAL *sum, COORD *x, REAL divisor,
+                                        ULONG n)
+{
+   AddDividedBlocksAVX512(sum, x, divisor, FIXEDBLOCKS(8));
+}
+
+static void AddDividedFixedAVX512(REAL *sum, COORD *x, REAL divisor, ULONG n)
+{
+   AddDividedFixedBlocksAVX512(sum, x, divisor, n);
+   if(FIXEDBLOCKS(8) < FIXEDATOMS)
+      AddDividedScalar(sum+FIXEDBLOCKS(8), x+FIXEDBLOCKS(8), divisor,
+                       FIXEDATOMS - FIXEDBLOCKS(8));
+}
+
+__attribute__((target("avx512f")))
+static void UpdateMeanFixedBlocksAVX512(REAL *mean, COORD *x, REAL count,
+                                        ULONG n)
+{
+   UpdateMeanBlocksAVX512(mean, x, count, FIXEDBLOCKS(8));
+}
+
+static void UpdateMeanFixedAVX512(REAL *mean, COORD *x, REAL count, ULONG n)
+{
+   UpdateMeanFixedBlocksAVX512(mean, x, count, n);
+   if(FIXEDBLOCKS(8) < FIXEDATOMS)
+      UpdateMeanScalar(mean+FIXEDBLOCKS(8), x+FIXEDBLOCKS(8), count,
+                       FIXEDATOMS - FIXEDBLOCKS(8));
+}
+
+__attribute__((target("avx512f")))
+static void AddKahanFixedBlocksAVX512(REAL *sum, REAL *comp, COORD *x,
+                                      ULONG n)
+{
+   AddKahanBlocksAVX512(sum, comp, x, FIXEDBLOCKS(8));
+}
+
+static void AddKahanFixedAVX512(REAL *sum, REAL *comp, COORD *x, ULONG n)
+{
+   AddKahanFixedBlocksAVX512(sum, comp, x, n);
+   if(FIXEDBLOCKS(8) < FIXEDATOMS)
+      AddKahanScalar(sum+FIXEDBLOCKS(8), comp+FIXEDBLOCKS(8),
+                     x+FIXEDBLOCKS(8), FIXEDATOMS - FIXEDBLOCKS(8));
+}
+#endif
+#endif
+
+
+#ifdef NEON_KERNELS
+/***********************************************************************/
+/* NEON kernels - 2 doubles at a time                                   */
+static REAL SumSqDistNEON(COORD *x1, COORD *y1, COORD *z1,
+                          COORD *x2, COORD *y2, COORD *z2, ULONG n)
+{
+   float64x2_t ax = vdupq_n_f64(0.0),
+               ay = vdupq_n_f64(0.0),
+               az = vdupq_n_f64(0.0),
+               d;
+   REAL        sum;
+   ULONG       i;
+
+   for(i=0; i+2<=n; i+=2)
+   {
+      d  = vsubq_f64(LOADCOORD2(x1+i), LOADCOORD2(x2+i));
+      ax = vfmaq_f64(ax, d, d);
+      d  = vsubq_f64(LOADCOORD2(y1+i), LOADCOORD2(y2+i));
+      ay = vfmaq_f64(ay, d, d);
+      d  = vsubq_f64(LOADCOORD2(z1+i), LOADCOORD2(z2+i));
+      az = vfmaq_f64(az, d, d);
+   }
+   sum = vaddvq_f64(vaddq_f64(vaddq_f64(ax, ay), az));
+
+   if(i < n)
+      sum += SumSqDistScalar(x1+i, y1+i, z1+i, x2+i, y2+i, z2+i, n-i);
+   return(sum);
+}
+
+static void AddDividedNEON(REAL *sum, COORD *x, REAL divisor, ULONG n)
+{
+   float64x2_t d = vdupq_n_f64(divisor);
+   ULONG       i;
+
+   for(i=0; i+2<=n; i+=2)
+      vst1q_f64(sum+i, vaddq_f64(vld1q_f64(sum+i),
+                                 vdivq_f64(LOADCOORD2(x+i), d)));
+   if(i < n)
+      AddDividedScalar(sum+i, x+i, divisor, n-i);
+}
+
+static void UpdateMeanNEON(REAL *mean, COORD *x, REAL count, ULONG n)
+{
+   float64x2_t c = vdupq_n_f64(count),
+               m;
+   ULONG       i;
+
+   for(i=0; i+2<=n; i+=2)
+   {
+      m = vld1q_f64(mean+i);
+      m = vaddq_f64(m, vdivq_f64(vsubq_f64(LOADCOORD2(x+i), m), c));
+      vst1q_f64(mean+i, m);
+   }
+   if(i < n)
+      UpdateMeanScalar(mean+i, x+i, count, n-i);
+}
+
+static void AddKahanNEON(REAL *sum, REAL *comp, COORD *x, ULONG n)
+{
+   float64x2_t s, c, v, t;
+   ULONG       i;
+
+   for(i=0; i+2<=n; i+=2)
+   {
+      s = vld1q_f64(sum+i);
+      c = vld1q_f64(comp+i);
+      v = vsubq_f64(LOADCOORD2(x+i), c);
+      t = vaddq_f64(s, v);
+      vst1q_f64(comp+i, vsubq_f64(vsubq_f64(t, s), v));
+      vst1q_f64(sum+i,  t);
+   }
+   if(i < n)
+      AddKahanScalar(sum+i, comp+i, x+i, n-i);
+}
+
+static void AddSquaresNEON(REAL *sum, COORD *x, COORD *y, COORD *z,
+                           ULONG n)
+{
+   float64x2_t a, b, c;
+   ULONG       i;
+
+   /* Multiply and add separately, as the scalar code does, so the
+      sums are identical
+   */
+   for(i=0; i+2<=n; i+=2)
+   {
+      a = LOADCOORD2(x+i);
+      b = LOADCOORD2(y+i);
+      c = LOADCOORD2(z+i);
+      a = vaddq_f64(vmulq_f64(a, a), vmulq_f64(b, b));
+      a = vaddq_f64(a, vmulq_f64(c, c));
+      vst1q_f64(sum+i, vaddq_f64(vld1q_f64(sum+i), a));
+   }
+   if(i < n)
+      AddSquaresScalar(sum+i, x+i, y+i, z+i, n-i);
+}
+
+static void InnerProductNEON(COORD *x1, COORD *y1, COORD *z1,
+                             COORD *x2, COORD *y2, COORD *z2, ULONG n,
+                             REAL *sums)
+{
+   float64x2_t acc[NINNERSUMS], a[3], b[3];
+   ULONG       i;
+   int         j, k;
+
+   for(j=0; j<NINNERSUMS; j++)
+      acc[j] = vdupq_n_f64(0.0);
+
+   for(i=0; i+2<=n; i+=2)
+   {
+      a[0] = LOADCOORD2(x1+i);
+      a[1] = LOADCOORD2(y1+i);
+      a[2] = LOADCOORD2(z1+i);
+      b[0] = LOADCOORD2(x2+i);
+      b[1] = LOADCOORD2(y2+i);
+      b[2] = LOADCOORD2(z2+i);
+      for(j=0; j<3; j++)
+      {
+         acc[j]   = vaddq_f64(acc[j],   a[j]);
+         acc[j+3] = vaddq_f64(acc[j+3], b[j]);
+         acc[6]   = vfmaq_f64(acc[6], a[j], a[j]);
+         acc[6]   = vfmaq_f64(acc[6], b[j], b[j]);
+         for(k=0; k<3; k++)
+            acc[7+3*j+k] = vfmaq_f64(acc[7+3*j+k], a[j], b[k]);
+      }
+   }
+   for(j=0; j<NINNERSUMS; j++)
+      sums[j] += vaddvq_f64(acc[j]);
+
+   if(i < n)
+      InnerProductScalar(x1+i, y1+i, z1+i, x2+i, y2+i, z2+i, n-i, sums);
+}
+#endif
@@ -0,0 +1,341 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       library.c
+
+   Version:    V1.30
+   Date:       14.10.26
+   Function:   The libflexcalc calculation context
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   Lets a program that already holds its frames in memory calculate
+   the flexibility score without writing them to a file. Frames are
+   pushed into a FLEXCALC as pointers to the caller's x, y and z
+   arrays, which are not copied, and RunFlexCalc() then makes the same
+   passes as the flexcalc program over a trajectory in memory
+   (memtraj.c), so the results are identical to running it on the
+   same frames. The context can then be reset and reused.
+
+      FLEXCALC *fc = AllocFlexCalc();
+      for(i=0; i<nFrames; i++)
+         PushFlexCalcFrame(fc, x[i], y[i], z[i], nAtoms, NULL);
+      if(RunFlexCalc(fc))
+         printf("%.4f\n", FlexCalcScore(fc));
+      ResetFlexCalc(fc);
+      ...
+      FreeFlexCalc(fc);
+
+   fc->options may be changed before RunFlexCalc() to set the passes,
+   threads, kernels, --fit, --refine, --skip-bad, --sample, --seed and
+   the frame window. RunFlexCalc() doesn't change them.
+   fc->select may be set to an atom selection.
+
+   The kernels and fit option are kept in the context's TRAJ, not in
+   gKernels and gFit, so contexts with different options may be run
+   from several threads at once. Errors are reported on stderr and
+   with a FALSE return.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.25  14.10.26 Original. Each context has its own kernels and fit
+                   option and RunFlexCalc() works on a copy of the
+                   options
+   V1.29  14.10.26 options.skipBad leaves out frames that don't match.
+                   Added FlexCalcSkipped()
+   V1.30  14.10.26 options.nSample scores a random sample of the
+                   frames. Added FlexCalcInterval()
+
+*************************************************************************/
+/* Includes
+*/
+#include "flexcalc.h"
+
+/***********************************************************************/
+/* Prototypes
+ */
+static void FreeResult(FLEXCALC *fc);
+
+
+/***********************************************************************/
+/*>FLEXCALC *AllocFlexCalc(void)
+   -----------------------------
+*//**
+   \return                     a new context with the default options
+                               and no frames (NULL if no memory)
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 No longer selects the kernels
+*/
+FLEXCALC *AllocFlexCalc(void)
+{
+   FLEXCALC *fc;
+
+   if((fc = (FLEXCALC *)CountedMalloc(sizeof(FLEXCALC)))==NULL)
+      return(NULL);
+   if((fc->traj = OpenMemoryTraj())==NULL)
+   {
+      free(fc);
+      return(NULL);
+   }
+
+   SetDefaultOptions(&(fc->options));
+   fc->select              = NULL;
+   fc->result.meanFrame    = NULL;
+   fc->result.closestFrame = NULL;
+   fc->done                = FALSE;
+
+   return(fc);
+}
+
+
+/***********************************************************************/
+/*>void FreeFlexCalc(FLEXCALC *fc)
+   -------------------------------
+*//**
+   \param[in]  *fc             a context (may be NULL)
+
+   Frees the context and its results. The caller's frames and
+   selection are untouched.
+
+-  14.10.26 Original   By: ACRM
+*/
+void FreeFlexCalc(FLEXCALC *fc)
+{
+   if(fc != NULL)
+   {
+      FreeResult(fc);
+      CloseTraj(fc->traj);
+      free(fc);
+   }
+}
+
+
+/***********************************************************************/
+/*>void ResetFlexCalc(FLEXCALC *fc)
+   --------------------------------
+*//**
+   \param[in,out] *fc          a context
+
+   Forgets the frames and results, ready for another trajectory. The
+   options and selection are kept.
+
+-  14.10.26 Original   By: ACRM
+*/
+void ResetFlexCalc(FLEXCALC *fc)
+{
+   FreeResult(fc);
+   ClearMemoryTraj(fc->traj);
+}
+
+
+/***********************************************************************/
+/*>static void FreeResult(FLEXCALC *fc)
+   ------------------------------------
+*//**
+   \param[in,out] *fc          a context
+
+-  14.10.26 Original   By: ACRM
+*/
+static void FreeResult(FLEXCALC *fc)
+{
+   FreeCoords(fc->result.meanFrame);
+   FreeCoords(fc->result.closestFrame);
+   fc->result.meanFrame    = NULL;
+   fc->result.closestFrame = NULL;
+   fc->done                = FALSE;
+}
+
+
+/***********************************************************************/
+/*>BOOL PushFlexCalcFrame(FLEXCALC *fc, COORD *x, COORD *y, COORD *z,
+                          ULONG nAtoms, char *header)
+   ------------------------------------------------------------------
+*//**
+   \param[in,out] *fc          a context
+   \param[in]     *x           the frame's x coordinates
+   \param[in]     *y           the frame's y coordinates
+   \param[in]     *z           the frame's z coordinates
+   \param[in]     nAtoms       number of atoms
+   \param[in]     *header      the frame's header (may be NULL)
+   \return                     FALSE if no memory or the frame has no
+                               atoms
+
+   Adds a frame after those already pushed. Only the pointers are
+   kept, so the arrays and header must stay valid and unchanged until
+   the context is reset or freed.
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL PushFlexCalcFrame(FLEXCALC *fc, COORD *x, COORD *y, COORD *z,
+                       ULONG nAtoms, char *header)
+{
+   return(AddMemoryFrame(fc->traj, x, y, z, nAtoms, header));
+}
+
+
+/***********************************************************************/
+/*>BOOL RunFlexCalc(FLEXCALC *fc)
+   ------------------------------
+*//**
+   \param[in,out] *fc          a context with frames pushed
+   \return                     FALSE (with a message) if the frames
+                               couldn't be processed
+
+   Calculates the mean, the frame closest to it and the mean RMSD from
+   that frame, as the flexcalc program does with fc->options. It may be
+   run again after more frames are pushed.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Uses the index with skipBad
+-  14.10.26 And with nSample
+-  14.10.26 Works on a copy of the options. Sets the kernels and fit
+            option in the TRAJ rather than gKernels and gFit
+*/
+BOOL RunFlexCalc(FLEXCALC *fc)
+{
+   OPTIONS options = fc->options;
+   KERNELS *kernels;
+   BOOL    ok;
+
+   FreeResult(fc);
+
+   if(options.checkpointFile[0] != '\0')
+   {
+      Msg("Checkpoints can't be used with frames in memory", "");
+      return(FALSE);
+   }
+   if((kernels = FindKernels(options.kernel))==NULL)
+   {
+      Msg("Kernel not available on this CPU: ", options.kernel);
+      return(FALSE);
+   }
+
+   /* As on the command line, threads, skipBad and nSample use the
+      index
+   */
+   if((options.nThreads > 0) || options.skipBad ||
+      (options.nSample != 0))
+      options.useIndex = TRUE;
+
+   fc->traj->select    = fc->select;
+   fc->traj->fit       = options.fit;
+   fc->traj->kernelSet = kernels;
+   fc->traj->kernels   = NULL;
+   SetWindow(fc->traj, &options);
+
+   ok = CalculateTrajFlexibility(fc->traj, fc->traj->filename, &options,
+                                 FALSE, &(fc->result));
+   if(!ok)
+      FreeResult(fc);
+   fc->done = ok;
+
+   return(ok);
+}
+
+
+/***********************************************************************/
+/*>REAL FlexCalcScore(FLEXCALC *fc)
+   --------------------------------
+*//**
+   \param[in]  *fc             a context
+   \return                     the flexibility score (the mean RMSD
+                               from the frame closest to the mean)
+                               from the last RunFlexCalc(), or -1.0
+
+-  14.10.26 Original   By: ACRM
+*/
+REAL FlexCalcScore(FLEXCALC *fc)
+{
+   return(fc->done ? fc->result.meanRMSD : -1.0);
+}
+
+
+/***********************************************************************/
+/*>COORDS *FlexCalcMean(FLEXCALC *fc)
+   ----------------------------------
+*//**
+   \param[in]  *fc             a context
+   \return                     the mean coordinates from the last
+                               RunFlexCalc() (NULL if none). They
+                               belong to the context.
+
+-  14.10.26 Original   By: ACRM
+*/
+COORDS *FlexCalcMean(FLEXCALC *fc)
+{
+   return(fc->done ? fc->result.meanFrame : NULL);
+}
+
+
+/***********************************************************************/
+/*>COORDS *FlexCalcClosest(FLEXCALC *fc, char **header)
+   ----------------------------------------------------
+*//**
+   \param[in]  *fc             a context
+   \param[out] **header        if not NULL, set to the header pushed
+                               with the frame
+   \return                     the frame closest to the mean from the
+                               last RunFlexCalc() (NULL if none). It
+                               belongs to the context.
+
+-  14.10.26 Original   By: ACRM
+*/
+COORDS *FlexCalcClosest(FLEXCALC *fc, char **header)
+{
+   if(header != NULL)
+      *header = fc->result.header;
+   return(fc->done ? fc->result.closestFrame : NULL);
+}
+
+
+/***********************************************************************/
+/*>ULONG FlexCalcSkipped(FLEXCALC *fc)
+   -----------------------------------
+*//**
+   \param[in]  *fc             a context
+   \return                     the number of frames left out because
+                               they didn't match, with
+                               fc->options.skipBad, by the last
+                               RunFlexCalc()
+
+-  14.10.26 Original   By: ACRM
+*/
+ULONG FlexCalcSkipped(FLEXCALC *fc)
+{
+   return(fc->done ? fc->result.nSkipped : 0);
+}
+
+
+/***********************************************************************/
+/*>BOOL FlexCalcInterval(FLEXCALC *fc, REAL *low, REAL *high)
+   ----------------------------------------------------------
+*//**
+   \param[in]  *fc             a context
+   \param[out] *low            the lower end of the 95% bootstrap
+                               interval of the score
+   \param[out] *high           its upper end
+   \return                     Was there an interval? Only when the
+                               last RunFlexCalc() used
+                               fc->options.nSample
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL FlexCalcInterval(FLEXCALC *fc, REAL *low, REAL *high)
+{
+   *low  = fc->done ? fc->result.interval[0] : -1.0;
+   *high = fc->done ? fc->result.interval[1] : -1.0;
+   return(*low >= 0.0);
+}
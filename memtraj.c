@@ -0,0 +1,254 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       memtraj.c
+
+   Version:    V1.25
+   Date:       14.10.26
+   Function:   Trajectories held in the caller's memory
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   A trajectory in memory is a TRAJ with no file, just a table of
+   MEMFRAMEs pointing at the caller's x, y and z arrays and headers.
+   Adding a frame copies nothing, so the caller's arrays must stay
+   valid, and unchanged, until the trajectory is closed or cleared.
+
+   It is read through ReadTrajFrame() like any other trajectory, so
+   every pass, the frame window, atom selection and threads work as
+   they do for a file. Each frame read is copied into the pass's own
+   COORDS buffer (only the selected atoms) since --fit moves the
+   frames it reads. Frame numbers serve as the offsets in a
+   FRAMEINDEX, as the frame table is its own index.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.25  14.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include "flexcalc.h"
+
+/***********************************************************************/
+/* Defines and macros
+ */
+#define MINMEMFRAMES 1024    /* Initial size of the frame table         */
+
+
+/***********************************************************************/
+/*>TRAJ *OpenMemoryTraj(void)
+   --------------------------
+*//**
+   \return                     an empty trajectory in memory (NULL if no
+                               memory)
+
+-  14.10.26 Original   By: ACRM
+*/
+TRAJ *OpenMemoryTraj(void)
+{
+   TRAJ *traj;
+
+   if((traj = (TRAJ *)CountedMalloc(sizeof(TRAJ)))==NULL)
+      return(NULL);
+   memset(traj, 0, sizeof(TRAJ));
+   traj->memory     = TRUE;
+   traj->firstEntry = TRUE;
+   SetTrajWindow(traj, 0, ULONG_MAX, 1);
+   strcpy(traj->filename, "(memory)");
+
+   return(traj);
+}
+
+
+/***********************************************************************/
+/*>BOOL AddMemoryFrame(TRAJ *traj, COORD *x, COORD *y, COORD *z,
+                       ULONG nAtoms, char *header)
+   -------------------------------------------------------------
+*//**
+   \param[in,out] *traj        a trajectory in memory
+   \param[in]     *x           the caller's x coordinates
+   \param[in]     *y           the caller's y coordinates
+   \param[in]     *z           the caller's z coordinates
+   \param[in]     nAtoms       number of atoms
+   \param[in]     *header      the frame header (may be NULL)
+   \return                     FALSE if no memory or the frame has no
+                               atoms
+
+   Adds a frame to the end of the trajectory. Only the pointers are
+   kept.
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL AddMemoryFrame(TRAJ *traj, COORD *x, COORD *y, COORD *z,
+                    ULONG nAtoms, char *header)
+{
+   MEMFRAME *frame;
+
+   if((nAtoms == 0) || (x == NULL) || (y == NULL) || (z == NULL))
+      return(FALSE);
+
+   if(traj->nFrames == traj->maxFrames)
+   {
+      ULONG    maxFrames = (traj->maxFrames) ? 2 * traj->maxFrames
+                                             : MINMEMFRAMES;
+      MEMFRAME *frames;
+
+      if((frames = (MEMFRAME *)CountedRealloc(traj->frames,
+                                  maxFrames * sizeof(MEMFRAME)))==NULL)
+         return(FALSE);
+      traj->frames    = frames;
+      traj->maxFrames = maxFrames;
+   }
+
+   frame         = traj->frames + traj->nFrames;
+   frame->x      = x;
+   frame->y      = y;
+   frame->z      = z;
+   frame->nAtoms = nAtoms;
+   frame->header = header;
+   traj->nFrames++;
+
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>void ClearMemoryTraj(TRAJ *traj)
+   --------------------------------
+*//**
+   \param[in,out] *traj        a trajectory in memory
+
+   Forgets all the frames, keeping the table for the next trajectory
+
+-  14.10.26 Original   By: ACRM
+*/
+void ClearMemoryTraj(TRAJ *traj)
+{
+   traj->nFrames  = 0;
+   traj->frameNum = 0;
+}
+
+
+/***********************************************************************/
+/*>void CloseMemoryTraj(TRAJ *traj)
+   --------------------------------
+*//**
+   \param[in,out] *traj        a trajectory in memory
+
+   Frees the frame table unless it belongs to another TRAJ. The
+   caller's frames are untouched.
+
+-  14.10.26 Original   By: ACRM
+*/
+void CloseMemoryTraj(TRAJ *traj)
+{
+   if(!traj->shared)
+      free(traj->frames);
+   traj->frames    = NULL;
+   traj->nFrames   = 0;
+   traj->maxFrames = 0;
+}
+
+
+/***********************************************************************/
+/*>BOOL ReadMemoryFrame(TRAJ *traj, char *header, COORDS *frame)
+   -------------------------------------------------------------
+*//**
+   \param[in,out] *traj        a trajectory in memory
+   \param[out]    *header      the frame header
+   \param[out]    *frame       the frame to copy into
+   \return                     Was a frame read?
+
+   Copies the selected atoms of the next frame
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL ReadMemoryFrame(TRAJ *traj, char *header, COORDS *frame)
+{
+   MEMFRAME *in;
+   ULONG    i,
+            nAtoms = 0;
+
+   if(traj->frameNum >= traj->nFrames)
+      return(FALSE);
+   in = traj->frames + traj->frameNum;
+   traj->frameNum++;
+
+   strncpy(header, ((in->header != NULL) ? in->header : ""), MAXBUFF-1);
+   header[MAXBUFF-1] = '\0';
+
+   if(!GrowCoords(frame, in->nAtoms))
+      return(FALSE);
+
+   if(traj->select == NULL)
+   {
+      nAtoms = in->nAtoms;
+      memcpy(frame->x, in->x, nAtoms * sizeof(COORD));
+      memcpy(frame->y, in->y, nAtoms * sizeof(COORD));
+      memcpy(frame->z, in->z, nAtoms * sizeof(COORD));
+   }
+   else
+   {
+      for(i=0; i<in->nAtoms; i++)
+      {
+         if(SELECTED(traj->select, i))
+         {
+            frame->x[nAtoms] = in->x[i];
+            frame->y[nAtoms] = in->y[i];
+            frame->z[nAtoms] = in->z[i];
+            nAtoms++;
+         }
+      }
+   }
+   frame->nAtoms = nAtoms;
+   CountRead((ULONG)(3 * in->nAtoms * sizeof(COORD)), 0, 1);
+
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>ULONG CountMemoryFrames(TRAJ *traj, FRAMEINDEX *index)
+   ------------------------------------------------------
+*//**
+   \param[in,out] *traj        a trajectory in memory
+   \param[out]    *index       if not NULL, an empty frame index to fill
+                               in
+   \return                     the number of frames
+
+   Goes back to the start. The index is given each frame's number as
+   its offset.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Counts the frames for --stats
+*/
+ULONG CountMemoryFrames(TRAJ *traj, FRAMEINDEX *index)
+{
+   ULONG i;
+
+   traj->frameNum = 0;
+   if(index != NULL)
+   {
+      for(i=0; i<traj->nFrames; i++)
+      {
+         if(!AddIndexFrame(index, (off_t)i))
+            break;
+         index->nAtoms[i] = traj->frames[i].nAtoms;
+      }
+   }
+   CountRead(0, 0, traj->nFrames);
+   return(traj->nFrames);
+}
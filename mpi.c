@@ -0,0 +1,852 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       mpi.c
+
+   Version:    V1.30
+   Date:       14.10.26
+   Function:   Calculate a flexibility score over trajectory shards on
+               several MPI ranks
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   main() for flexcalc-mpi (make mpi). The trajectories given are the
+   shards of one trajectory, in order, and the score is that of their
+   concatenation. The shards are split into one contiguous run for
+   each rank (rank 0 taking the first) and each rank only ever opens
+   its own, so they may be on a disk local to that rank's node as long
+   as every rank is given the same list of names.
+
+   Each rank makes the passes over its own shards and only small
+   summaries are exchanged:
+
+   1. The mean. Each rank sums its frames' coordinates with Kahan
+      summation, counting them as it goes. The frame and atom counts
+      are shared, each rank sends its sums and compensations to rank 0,
+      which merges them in rank order with MergeKahanSums(), divides by
+      the total number of frames and broadcasts the mean. As with the
+      threaded mean (parallel.c), the error does not grow with the
+      number of frames and does not depend on where the shards are
+      split. With --fit the mean is refined in the same way, fitting
+      each frame to the last mean before it is added.
+   2. The closest frame. Each rank finds its own closest frame, the
+      lowest RMSD is taken with MPI_MINLOC (the lowest rank on a tie,
+      so the earliest frame as in the serial code) and that rank
+      broadcasts the frame.
+   3. The RMSDs. Each rank's sum of RMSDs is sent to rank 0, which adds
+      them in rank order.
+
+   Every step that may fail is followed by a collective check so that
+   all ranks stop together. Only rank 0 prints the result.
+
+**************************************************************************
+
+   Usage:
+   ======
+   mpirun -np nranks flexcalc-mpi [-m] [-k kernel] [--prefetch] [--fit]
+            [--refine n] [--atoms list | --atoms-file file]
+            [--list file] shard ...
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.26  14.10.26 Original
+   V1.27  14.10.26 Rejects --gpu
+   V1.29  14.10.26 Rejects --skip-bad. Bad frames are reported with
+                   their shard and byte offset
+   V1.30  14.10.26 Rejects --sample
+
+*************************************************************************/
+/* Includes
+*/
+#include <float.h>
+#include <mpi.h>
+#include "flexcalc.h"
+
+/***********************************************************************/
+/* Defines and macros
+ */
+#define ROOTRANK 0
+#define TAG_SUMS 1
+#define TAG_RMSD 2
+
+/* MPI datatypes for REAL and COORD                                     */
+#define MPI_REALTYPE  ((sizeof(REAL)  == sizeof(float)) ? MPI_FLOAT     \
+                                                        : MPI_DOUBLE)
+#define MPI_COORDTYPE ((sizeof(COORD) == sizeof(float)) ? MPI_FLOAT     \
+                                                        : MPI_DOUBLE)
+
+/* This rank's part of the trajectory                                   */
+typedef struct
+{
+   TRAJ  **trajs;         /* This rank's shards, in order               */
+   int   nShards,
+         rank,
+         nRanks;
+}  SHARDS;
+
+/***********************************************************************/
+/* Prototypes
+ */
+static void   UsageMPI(void);
+static BOOL   CheckOptions(OPTIONS *options, int rank);
+static BOOL   AllOK(BOOL ok);
+static BOOL   OpenShards(SHARDS *shards, OPTIONS *options,
+                         SELECTION *select);
+static void   CloseShards(SHARDS *shards);
+static COORDS *ShardMean(SHARDS *shards, COORDS *fitTo, ULONG *nFrames);
+static COORDS *RefineShardMean(SHARDS *shards, COORDS *meanFrame,
+                               int maxCycles);
+static COORDS *ShardClosest(SHARDS *shards, COORDS *meanFrame);
+static REAL   ShardMeanRMSD(SHARDS *shards, COORDS *closestFrame,
+                            ULONG nFrames);
+static void   SendSums(COORDS *sum, COORDS *comp, int dest);
+static void   RecvSums(COORDS *sum, COORDS *comp, int source);
+
+
+/***********************************************************************/
+/*>main(int argc, char **argv)
+   ---------------------------
+*//**
+   Main program for flexcalc-mpi
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 The fit option is set by OpenShards()
+*/
+int main(int argc, char **argv)
+{
+   OPTIONS   options;
+   SHARDS    shards;
+   SELECTION *select       = NULL;
+   COORDS    *meanFrame    = NULL,
+             *closestFrame = NULL;
+   REAL      meanRMSD      = -1.0;
+   ULONG     nFrames       = 0;
+   BOOL      ok;
+
+   MPI_Init(&argc, &argv);
+   MPI_Comm_rank(MPI_COMM_WORLD, &(shards.rank));
+   MPI_Comm_size(MPI_COMM_WORLD, &(shards.nRanks));
+   shards.trajs   = NULL;
+   shards.nShards = 0;
+   StartStats();
+
+   if(!ParseCmdLine(argc, argv, &options) || options.convert)
+   {
+      if(shards.rank == ROOTRANK)
+         UsageMPI();
+      MPI_Finalize();
+      return(0);
+   }
+
+   if((ok = CheckOptions(&options, shards.rank)))
+   {
+      if(!SelectKernels(options.kernel))
+      {
+         if(shards.rank == ROOTRANK)
+            Msg("Kernel not available on this CPU: ", options.kernel);
+         ok = FALSE;
+      }
+      ok = AllOK(ok);
+   }
+
+   if(ok)
+   {
+      gPrefetch = options.prefetch;
+      if((options.atoms[0] != '\0') || (options.atomsFile[0] != '\0'))
+         select = GetSelection(&options);
+      GetFileList(&options);
+
+      ok = AllOK(OpenShards(&shards, &options, select));
+   }
+
+   if(ok && ((meanFrame = ShardMean(&shards, NULL, &nFrames))==NULL))
+      ok = FALSE;
+   if(ok && (meanFrame->nAtoms == 0))
+   {
+      if(shards.rank == ROOTRANK)
+         Msg("No atoms selected", "");
+      ok = FALSE;
+   }
+   if(ok && options.fit && (options.nRefine > 0) &&
+      ((meanFrame = RefineShardMean(&shards, meanFrame,
+                                    options.nRefine))==NULL))
+      ok = FALSE;
+   if(ok && ((closestFrame = ShardClosest(&shards, meanFrame))==NULL))
+      ok = FALSE;
+   if(ok && ((meanRMSD = ShardMeanRMSD(&shards, closestFrame,
+                                       nFrames)) < 0.0))
+      ok = FALSE;
+
+   if(ok && (shards.rank == ROOTRANK))
+      printf("%.4f\n", meanRMSD);
+
+   FreeCoords(meanFrame);
+   FreeCoords(closestFrame);
+   CloseShards(&shards);
+   FreeSelection(select);
+   MPI_Finalize();
+
+   return(ok ? 0 : 1);
+}
+
+
+/***********************************************************************/
+/*>static BOOL CheckOptions(OPTIONS *options, int rank)
+   ----------------------------------------------------
+*//**
+   \param[in]  *options        the options from the command line
+   \param[in]  rank            this rank
+   \return                     Can they be used with flexcalc-mpi?
+
+   Options for the passes of the single program, and those which write
+   files or apply a frame window, are not available. Rank 0 reports
+   any that were given.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Rejects --gpu
+-  14.10.26 Rejects --skip-bad
+-  14.10.26 Rejects --sample
+*/
+static BOOL CheckOptions(OPTIONS *options, int rank)
+{
+   char *option = NULL;
+
+   if((options->nPasses != 4) || options->useIndex ||
+      (options->nThreads != 0) || options->gpu || options->skipBad)
+      option = "-p, -i, -t, --gpu and --skip-bad";
+   else if((options->seriesFile[0] != '\0') ||
+           (options->rmsfFile[0] != '\0') ||
+           (options->checkpointFile[0] != '\0'))
+      option = "--series, --rmsf and --checkpoint";
+   else if((options->start != 1) || (options->stop != 0) ||
+           (options->stride != 1) || (options->nSample != 0))
+      option = "--start, --stop, --stride and --sample";
+   else if(options->timing || options->stats ||
+           (options->statsFile[0] != '\0'))
+      option = "--timing and --stats";
+
+   if(option == NULL)
+      return(TRUE);
+   if(rank == ROOTRANK)
+      Msg("These options can't be used with flexcalc-mpi: ", option);
+   return(FALSE);
+}
+
+
+/***********************************************************************/
+/*>static BOOL AllOK(BOOL ok)
+   --------------------------
+*//**
+   \param[in]  ok              did this rank succeed?
+   \return                     did every rank succeed?
+
+   Collective: every rank must call it at the same point
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL AllOK(BOOL ok)
+{
+   int mine = (ok ? 1 : 0),
+       all  = 0;
+
+   MPI_Allreduce(&mine, &all, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+   return(all != 0);
+}
+
+
+/***********************************************************************/
+/*>static BOOL OpenShards(SHARDS *shards, OPTIONS *options,
+                          SELECTION *select)
+   --------------------------------------------------------
+*//**
+   \param[in,out] *shards      rank and number of ranks set
+   \param[in]     *options     options with the list of shards
+   \param[in]     *select      atoms to use (NULL for all)
+   \return                     FALSE (with a message) if this rank's
+                               shards couldn't be opened
+
+   Opens this rank's contiguous run of the shards. A rank may have none
+   if there are more ranks than shards.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Sets the fit option
+-  14.10.26 A stream is spilled with just the selected atoms
+*/
+static BOOL OpenShards(SHARDS *shards, OPTIONS *options,
+                       SELECTION *select)
+{
+   int  first = (int)(((long)options->nInFiles * shards->rank) /
+                      shards->nRanks),
+        last  = (int)(((long)options->nInFiles * (shards->rank + 1)) /
+                      shards->nRanks),
+        i;
+   BOOL ok    = TRUE;
+
+   if((shards->trajs = (TRAJ **)CountedCalloc(last - first + 1,
+                                              sizeof(TRAJ *)))==NULL)
+   {
+      Msg(MSG_NOMEM, "");
+      return(FALSE);
+   }
+   shards->nShards = last - first;
+
+   for(i=0; i<shards->nShards; i++)
+   {
+      char *inFile = options->inFiles[first + i];
+      TRAJ *in;
+
+      /* A stream is read once into a temporary binary trajectory,
+         which holds only the selected atoms
+      */
+      if(IsStreamTraj(inFile))
+      {
+         in = SpillTraj(inFile, select, FALSE);
+      }
+      else if((in = OpenTraj(inFile, options->useMmap)) != NULL)
+      {
+         in->select = select;
+      }
+      if(in == NULL)
+      {
+         Msg("Unable to open trajectory: ", inFile);
+         ok = FALSE;
+         break;
+      }
+      in->fit          = options->fit;
+      shards->trajs[i] = in;
+   }
+
+   return(ok);
+}
+
+
+/***********************************************************************/
+/*>static void CloseShards(SHARDS *shards)
+   ---------------------------------------
+*//**
+   \param[in,out] *shards      this rank's shards
+
+-  14.10.26 Original   By: ACRM
+*/
+static void CloseShards(SHARDS *shards)
+{
+   int i;
+
+   if(shards->trajs != NULL)
+   {
+      for(i=0; i<shards->nShards; i++)
+         CloseTraj(shards->trajs[i]);
+      free(shards->trajs);
+   }
+   shards->trajs   = NULL;
+   shards->nShards = 0;
+}
+
+
+/***********************************************************************/
+/*>static COORDS *ShardMean(SHARDS *shards, COORDS *fitTo,
+                            ULONG *nFrames)
+   -------------------------------------------------------
+*//**
+   \param[in]  *shards         this rank's shards
+   \param[in]  *fitTo          if not NULL, each frame is fitted to this
+                               before it is added
+   \param[out] *nFrames        the number of frames in all the shards
+   \return                     the mean coordinates, the same on every
+                               rank (NULL on every rank on error)
+
+   Collective. Each rank sums its frames with Kahan summation. Rank 0
+   merges the sums in rank order and broadcasts the mean.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Reports a bad frame with MsgBadFrame()
+-  14.10.26 Fails at a bad frame
+*/
+static COORDS *ShardMean(SHARDS *shards, COORDS *fitTo, ULONG *nFrames)
+{
+   COORDS *frame       = NULL,
+          *sum         = NULL,
+          *comp        = NULL,
+          *partSum     = NULL,
+          *partComp    = NULL;
+   ULONG  mine[2],
+          *counts      = NULL,
+          localFrames  = 0,
+          nAtoms       = 0,
+          i;
+   char   header[MAXBUFF];
+   BOOL   ok           = TRUE;
+   int    j;
+
+   *nFrames = 0;
+   if(((frame  = AllocCoords(MINATOMS))==NULL) ||
+      ((sum    = AllocCoords(MINATOMS))==NULL) ||
+      ((comp   = AllocCoords(MINATOMS))==NULL) ||
+      ((counts = (ULONG *)CountedMalloc(2 * shards->nRanks *
+                                        sizeof(ULONG)))==NULL))
+   {
+      Msg(MSG_NOMEM, "");
+      ok = FALSE;
+   }
+
+   /* Sum the coordinates of this rank's frames                         */
+   for(j=0; ok && (j<shards->nShards); j++)
+   {
+      TRAJ *in = shards->trajs[j];
+
+      RewindTraj(in);
+      while(ok && ReadTrajFrame(in, header, frame))
+      {
+         if(localFrames == 0)
+         {
+            nAtoms = frame->nAtoms;
+            if(!GrowCoords(sum, nAtoms) || !GrowCoords(comp, nAtoms) ||
+               !ZeroCoords(sum, nAtoms) || !ZeroCoords(comp, nAtoms))
+            {
+               Msg(MSG_NOMEM, "");
+               ok = FALSE;
+               break;
+            }
+         }
+
+         if(((fitTo != NULL) && !FitFrame(fitTo, frame)) ||
+            !AddFrameKahan(sum, comp, frame))
+         {
+            MsgBadFrame(in, in->frameNum-1, header, FALSE);
+            ok = FALSE;
+         }
+         localFrames++;
+      }
+      if(in->badFrame != FRAME_OK)
+         ok = FALSE;
+   }
+   if(!AllOK(ok))
+      goto done;
+
+   /* Share the frame and atom counts. Ranks with no frames take the
+      atom count from the others
+   */
+   mine[0] = localFrames;
+   mine[1] = nAtoms;
+   MPI_Allgather(mine, 2, MPI_UNSIGNED_LONG, counts, 2,
+                 MPI_UNSIGNED_LONG, MPI_COMM_WORLD);
+   nAtoms = 0;
+   for(j=0; j<shards->nRanks; j++)
+   {
+      if(counts[2*j] == 0)
+         continue;
+      if((*nFrames != 0) && (counts[2*j+1] != nAtoms))
+      {
+         if(shards->rank == ROOTRANK)
+         {
+            sprintf(header, "(first frame on rank %d)", j);
+            Msg(MSG_ATOMMISMATCH, header);
+         }
+         ok = FALSE;
+         goto done;
+      }
+      nAtoms    = counts[2*j+1];
+      *nFrames += counts[2*j];
+   }
+   if(*nFrames == 0)
+   {
+      if(shards->rank == ROOTRANK)
+         Msg("No frames in trajectory", "");
+      ok = FALSE;
+      goto done;
+   }
+
+   /* Ranks with no frames send zeros. Rank 0 needs space for the sums
+      it receives
+   */
+   if((localFrames == 0) &&
+      (!GrowCoords(sum, nAtoms) || !GrowCoords(comp, nAtoms) ||
+       !ZeroCoords(sum, nAtoms) || !ZeroCoords(comp, nAtoms)))
+      ok = FALSE;
+   if((shards->rank == ROOTRANK) &&
+      (((partSum  = AllocCoords(nAtoms))==NULL) ||
+       ((partComp = AllocCoords(nAtoms))==NULL) ||
+       !ZeroCoords(partSum, nAtoms) || !ZeroCoords(partComp, nAtoms)))
+      ok = FALSE;
+   if(!ok)
+      Msg(MSG_NOMEM, "");
+   if(!AllOK(ok))
+      goto done;
+
+   /* Merge the sums in rank order on rank 0 and broadcast the mean     */
+   if(shards->rank == ROOTRANK)
+   {
+      for(j=1; j<shards->nRanks; j++)
+      {
+         RecvSums(partSum, partComp, j);
+         MergeKahanSums(sum, comp, partSum, partComp);
+      }
+      for(i=0; i<nAtoms; i++)
+      {
+         SUMX(sum)[i] = (SUMX(sum)[i] - SUMX(comp)[i]) / *nFrames;
+         SUMY(sum)[i] = (SUMY(sum)[i] - SUMY(comp)[i]) / *nFrames;
+         SUMZ(sum)[i] = (SUMZ(sum)[i] - SUMZ(comp)[i]) / *nFrames;
+      }
+   }
+   else
+   {
+      SendSums(sum, comp, ROOTRANK);
+   }
+
+   MPI_Bcast(SUMX(sum), (int)nAtoms, MPI_REALTYPE, ROOTRANK,
+             MPI_COMM_WORLD);
+   MPI_Bcast(SUMY(sum), (int)nAtoms, MPI_REALTYPE, ROOTRANK,
+             MPI_COMM_WORLD);
+   MPI_Bcast(SUMZ(sum), (int)nAtoms, MPI_REALTYPE, ROOTRANK,
+             MPI_COMM_WORLD);
+   StoreSums(sum);
+
+done:
+   FreeCoords(frame);
+   FreeCoords(comp);
+   FreeCoords(partSum);
+   FreeCoords(partComp);
+   free(counts);
+   if(!ok)
+   {
+      FreeCoords(sum);
+      sum = NULL;
+   }
+   return(sum);
+}
+
+
+/***********************************************************************/
+/*>static COORDS *RefineShardMean(SHARDS *shards, COORDS *meanFrame,
+                                  int maxCycles)
+   -----------------------------------------------------------------
+*//**
+   \param[in]  *shards         this rank's shards
+   \param[in]  *meanFrame      the starting mean. This is freed.
+   \param[in]  maxCycles       the maximum number of refinement cycles
+   \return                     the refined mean (NULL on every rank on
+                               error)
+
+   Collective. As RefineMeanCoords(), but each cycle is a ShardMean()
+   of the frames fitted to the last mean. Rank 0 decides when the mean
+   has stopped changing, since the kernels may differ between nodes.
+
+-  14.10.26 Original   By: ACRM
+*/
+static COORDS *RefineShardMean(SHARDS *shards, COORDS *meanFrame,
+                               int maxCycles)
+{
+   int cycle;
+
+   for(cycle=0; cycle<maxCycles; cycle++)
+   {
+      COORDS *newMean;
+      ULONG  nFrames;
+      int    converged = 0;
+
+      if((newMean = ShardMean(shards, meanFrame, &nFrames))==NULL)
+      {
+         FreeCoords(meanFrame);
+         return(NULL);
+      }
+
+      /* The fitted frames follow the old mean's orientation, so the
+         two means can be compared directly
+      */
+      if(shards->rank == ROOTRANK)
+      {
+         REAL change = sqrt(gKernels.sumSqDist(meanFrame->x,
+                                               meanFrame->y,
+                                               meanFrame->z,
+                                               newMean->x, newMean->y,
+                                               newMean->z,
+                                               newMean->nAtoms) /
+                            newMean->nAtoms);
+         converged = (change < REFINETOL);
+      }
+      MPI_Bcast(&converged, 1, MPI_INT, ROOTRANK, MPI_COMM_WORLD);
+
+      FreeCoords(meanFrame);
+      meanFrame = newMean;
+      if(converged)
+         break;
+   }
+
+   return(meanFrame);
+}
+
+
+/***********************************************************************/
+/*>static COORDS *ShardClosest(SHARDS *shards, COORDS *meanFrame)
+   --------------------------------------------------------------
+*//**
+   \param[in]  *shards         this rank's shards
+   \param[in]  *meanFrame      the mean coordinates
+   \return                     the frame closest to the mean, the same
+                               on every rank (NULL on every rank on
+                               error)
+
+   Collective. Each rank finds its closest frame, earliest first, and
+   the rank with the lowest RMSD (the lowest rank on a tie) broadcasts
+   its frame.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Reports a bad frame with MsgBadFrame()
+-  14.10.26 Uses the TRAJ's fit option
+-  14.10.26 Fails at a bad frame
+*/
+static COORDS *ShardClosest(SHARDS *shards, COORDS *meanFrame)
+{
+   COORDS *frame        = NULL,
+          *closestFrame = NULL;
+   REAL   lowestRMSD    = 0.0;
+   BOOL   found         = FALSE,
+          ok            = TRUE;
+   char   header[MAXBUFF];
+   int    j;
+   struct
+   {
+      double rmsd;
+      int    rank;
+   }  mine, best;
+
+   if(((frame        = AllocCoords(meanFrame->nAtoms))==NULL) ||
+      ((closestFrame = AllocCoords(meanFrame->nAtoms))==NULL))
+   {
+      Msg(MSG_NOMEM, "");
+      ok = FALSE;
+   }
+
+   for(j=0; ok && (j<shards->nShards); j++)
+   {
+      TRAJ *in = shards->trajs[j];
+
+      RewindTraj(in);
+      while(ReadTrajFrame(in, header, frame))
+      {
+         REAL rmsd;
+
+         if((rmsd = RMSFrame(meanFrame, frame, in->fit)) < 0.0)
+         {
+            MsgBadFrame(in, in->frameNum-1, header, FALSE);
+            ok = FALSE;
+            break;
+         }
+         if(!found || (rmsd < lowestRMSD))
+         {
+            COORDS *swap  = closestFrame;
+            closestFrame  = frame;
+            frame         = swap;
+            lowestRMSD    = rmsd;
+            found         = TRUE;
+         }
+      }
+      if(in->badFrame != FRAME_OK)
+         ok = FALSE;
+   }
+   FreeCoords(frame);
+   if(!AllOK(ok))
+   {
+      FreeCoords(closestFrame);
+      return(NULL);
+   }
+
+   /* A rank with no frames can never be chosen                         */
+   mine.rmsd = (found ? (double)lowestRMSD : DBL_MAX);
+   mine.rank = shards->rank;
+   MPI_Allreduce(&mine, &best, 1, MPI_DOUBLE_INT, MPI_MINLOC,
+                 MPI_COMM_WORLD);
+
+   closestFrame->nAtoms = meanFrame->nAtoms;
+   MPI_Bcast(closestFrame->x, (int)closestFrame->nAtoms, MPI_COORDTYPE,
+             best.rank, MPI_COMM_WORLD);
+   MPI_Bcast(closestFrame->y, (int)closestFrame->nAtoms, MPI_COORDTYPE,
+             best.rank, MPI_COMM_WORLD);
+   MPI_Bcast(closestFrame->z, (int)closestFrame->nAtoms, MPI_COORDTYPE,
+             best.rank, MPI_COMM_WORLD);
+
+   return(closestFrame);
+}
+
+
+/***********************************************************************/
+/*>static REAL ShardMeanRMSD(SHARDS *shards, COORDS *closestFrame,
+                             ULONG nFrames)
+   ---------------------------------------------------------------
+*//**
+   \param[in]  *shards         this rank's shards
+   \param[in]  *closestFrame   the frame closest to the mean
+   \param[in]  nFrames         the number of frames in all the shards
+   \return                     the mean RMSD on rank 0 (0.0 on the
+                               others) or -1.0 on every rank on error
+
+   Collective. Each rank sums its RMSDs from the closest frame and rank
+   0 adds the sums in rank order.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Reports a bad frame with MsgBadFrame()
+-  14.10.26 Uses the TRAJ's fit option
+-  14.10.26 Fails at a bad frame
+*/
+static REAL ShardMeanRMSD(SHARDS *shards, COORDS *closestFrame,
+                          ULONG nFrames)
+{
+   COORDS *frame;
+   REAL   sumRMSD = 0.0;
+   BOOL   ok      = TRUE;
+   char   header[MAXBUFF];
+   int    j;
+
+   if((frame = AllocCoords(closestFrame->nAtoms))==NULL)
+   {
+      Msg(MSG_NOMEM, "");
+      ok = FALSE;
+   }
+
+   for(j=0; ok && (j<shards->nShards); j++)
+   {
+      TRAJ *in = shards->trajs[j];
+
+      RewindTraj(in);
+      while(ReadTrajFrame(in, header, frame))
+      {
+         REAL rmsd;
+
+         if((rmsd = RMSFrame(closestFrame, frame, in->fit)) < 0.0)
+         {
+            MsgBadFrame(in, in->frameNum-1, header, FALSE);
+            ok = FALSE;
+            break;
+         }
+         sumRMSD += rmsd;
+      }
+      if(in->badFrame != FRAME_OK)
+         ok = FALSE;
+   }
+   FreeCoords(frame);
+   if(!AllOK(ok))
+      return(-1.0);
+
+   if(shards->rank == ROOTRANK)
+   {
+      for(j=1; j<shards->nRanks; j++)
+      {
+         REAL part;
+
+         MPI_Recv(&part, 1, MPI_REALTYPE, j, TAG_RMSD, MPI_COMM_WORLD,
+                  MPI_STATUS_IGNORE);
+         sumRMSD += part;
+      }
+      return(sumRMSD / nFrames);
+   }
+
+   MPI_Send(&sumRMSD, 1, MPI_REALTYPE, ROOTRANK, TAG_RMSD,
+            MPI_COMM_WORLD);
+   return(0.0);
+}
+
+
+/***********************************************************************/
+/*>static void SendSums(COORDS *sum, COORDS *comp, int dest)
+   ---------------------------------------------------------
+*//**
+   \param[in]  *sum            Kahan sums of the coordinates
+   \param[in]  *comp           and their compensations
+   \param[in]  dest            rank to send them to
+
+-  14.10.26 Original   By: ACRM
+*/
+static void SendSums(COORDS *sum, COORDS *comp, int dest)
+{
+   int nAtoms = (int)sum->nAtoms;
+
+   MPI_Send(SUMX(sum),  nAtoms, MPI_REALTYPE, dest, TAG_SUMS,
+            MPI_COMM_WORLD);
+   MPI_Send(SUMY(sum),  nAtoms, MPI_REALTYPE, dest, TAG_SUMS,
+            MPI_COMM_WORLD);
+   MPI_Send(SUMZ(sum),  nAtoms, MPI_REALTYPE, dest, TAG_SUMS,
+            MPI_COMM_WORLD);
+   MPI_Send(SUMX(comp), nAtoms, MPI_REALTYPE, dest, TAG_SUMS,
+            MPI_COMM_WORLD);
+   MPI_Send(SUMY(comp), nAtoms, MPI_REALTYPE, dest, TAG_SUMS,
+            MPI_COMM_WORLD);
+   MPI_Send(SUMZ(comp), nAtoms, MPI_REALTYPE, dest, TAG_SUMS,
+            MPI_COMM_WORLD);
+}
+
+
+/***********************************************************************/
+/*>static void RecvSums(COORDS *sum, COORDS *comp, int source)
+   -----------------------------------------------------------
+*//**
+   \param[out] *sum            sized for the sums to be received
+   \param[out] *comp           and for their compensations
+   \param[in]  source          rank sending them
+
+   Receives the sums sent by SendSums()
+
+-  14.10.26 Original   By: ACRM
+*/
+static void RecvSums(COORDS *sum, COORDS *comp, int source)
+{
+   int nAtoms = (int)sum->nAtoms;
+
+   MPI_Recv(SUMX(sum),  nAtoms, MPI_REALTYPE, source, TAG_SUMS,
+            MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+   MPI_Recv(SUMY(sum),  nAtoms, MPI_REALTYPE, source, TAG_SUMS,
+            MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+   MPI_Recv(SUMZ(sum),  nAtoms, MPI_REALTYPE, source, TAG_SUMS,
+            MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+   MPI_Recv(SUMX(comp), nAtoms, MPI_REALTYPE, source, TAG_SUMS,
+            MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+   MPI_Recv(SUMY(comp), nAtoms, MPI_REALTYPE, source, TAG_SUMS,
+            MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+   MPI_Recv(SUMZ(comp), nAtoms, MPI_REALTYPE, source, TAG_SUMS,
+            MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+}
+
+
+/***********************************************************************/
+/*>static void UsageMPI(void)
+   --------------------------
+*//**
+   Prints a usage message for flexcalc-mpi
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 V1.27
+-  14.10.26 V1.29
+-  14.10.26 V1.30
+*/
+static void UsageMPI(void)
+{
+   printf("\nflexcalc-mpi V1.30 (c) Andrew C.R. Martin, \
+abYinformatics\n");
+
+   printf("\nUsage: mpirun -np nranks flexcalc-mpi [-m] [-k kernel] \
+[--prefetch] [--fit]\n");
+   printf("                [--refine n] [--atoms list | --atoms-file \
+file]\n");
+   printf("                [--list file] shard ...\n");
+   printf("       The shards are the parts of one trajectory, in \
+order. They are\n");
+   printf("       shared out in contiguous runs, rank 0 taking the \
+first, and each\n");
+   printf("       rank reads only its own. Only the per-atom sums, \
+the closest frame\n");
+   printf("       and the RMSD sums are exchanged. The score is that \
+of the shards\n");
+   printf("       joined together. The other options are as for \
+flexcalc.\n\n");
+}
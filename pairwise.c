@@ -0,0 +1,691 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       pairwise.c
+
+   Version:    V1.29
+   Date:       14.10.26
+   Function:   All-against-all RMSD matrix of the frames
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   Calculates the RMSD between every pair of frames in the window
+   (--pairwise), for clustering. The frames are read once, with any
+   reader, into a single contiguous block laid out as in a binary
+   trajectory (each frame's x values, then y then z), so only
+   nFrames frames are held in memory. The matrix itself never is.
+
+   The pairs are calculated in square tiles of frames, sized so that
+   the two tiles' frames fit in PAIRCACHEBYTES, and every frame of one
+   tile is compared with every frame of the other while they are in
+   the cache. The tiles on and above the diagonal are taken a row of
+   tiles at a time, and the threads (-t) share out each row's tiles.
+   Every RMSD is independent, so the output does not depend on the
+   number of threads.
+
+   The binary forms are written straight into a memory-mapped output
+   file, so the kernel writes the pages back as they are filled. In
+   native byte order they are:
+
+      char     magic[8]     "FCPAIRS1"
+      uint32_t form         PAIR_FULL or PAIR_TRIANGLE
+      uint32_t reserved
+      uint64_t nFrames
+      uint64_t frame[nFrames]  frame numbers in the trajectory (from 1)
+
+   followed by float RMSDs: for PAIR_FULL the nFrames x nFrames
+   matrix by rows, and for PAIR_TRIANGLE just the pairs i<j of the
+   upper triangle by rows, (0,1) (0,2) ... (0,n-1) (1,2) ...
+
+   The sparse form (PAIR_SPARSE) is text with a line
+
+      frame1 frame2 rmsd
+
+   for each pair, frame1 < frame2, whose RMSD is no more than the
+   cutoff, in order of frame1 then frame2. Each row of tiles is
+   gathered in memory and then written.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.28  14.10.26 Original
+   V1.29  14.10.26 With --skip-bad, frames that don't match the first
+                   are left out
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "flexcalc.h"
+
+/***********************************************************************/
+/* Defines and macros
+ */
+#define PAIR_MAGIC      "FCPAIRS1"
+#define PAIR_MAGICLEN   8
+#define PAIR_HEADERSIZE 24
+#define PAIRCACHEBYTES  (256*1024) /* Frames of two tiles to keep cached */
+#define PAIRMAXTILE     256        /* Most frames in a tile              */
+#define MINPAIRFRAMES   1024       /* Initial frames in the block        */
+#define MINTILEPAIRS    1024       /* Initial pairs kept for a tile      */
+#define PAIRBUFF        (1024*1024) /* stdio buffer for sparse output    */
+
+/* Position of pair (i,j), i<j, in the upper triangle of n frames      */
+#define TRIANGLEINDEX(i, j, n) ((size_t)(i) * (2*(size_t)(n) - (i) - 1) \
+                                / 2 + ((j) - (i) - 1))
+
+/* The frames, one after the other as x[nAtoms], y[nAtoms], z[nAtoms]  */
+typedef struct
+{
+   COORD *coords;
+   ULONG *frameNum;       /* Number of each frame in the file (from 1)  */
+   ULONG nFrames,
+         maxFrames,       /* Frames allocated                           */
+         nAtoms;
+   KERNELS *kernels;      /* The kernels for nAtoms                     */
+   BOOL  fit;             /* RMSDs after superposition (--fit)          */
+}  PAIRFRAMES;
+
+/* The pairs of a sparse tile within the cutoff, by row. Those for the
+   tile's row k are pairs rowStart[k] to rowStart[k+1]-1
+*/
+typedef struct
+{
+   ULONG *frame2;         /* Column frame of each pair (from 0)         */
+   REAL  *rmsd;
+   ULONG nPairs,
+         maxPairs,
+         rowStart[PAIRMAXTILE+1];
+   BOOL  failed;          /* No memory for the pairs                    */
+}  PAIRTILE;
+
+/* A row of tiles being calculated                                      */
+typedef struct
+{
+   PAIRFRAMES      *frames;
+   int             form;
+   REAL            cutoff;
+   char            *data;       /* The mapped file (PAIR_FULL/TRIANGLE) */
+   size_t          size;        /* ...and its size                      */
+   float           *matrix;     /* The RMSDs in the mapping             */
+   PAIRTILE        *tiles;      /* The row's tiles (PAIR_SPARSE)        */
+   ULONG           tileSize,
+                   nTiles,      /* Tiles across the matrix              */
+                   row,         /* Tile row being calculated            */
+                   nextTile;    /* Next tile in the row to take         */
+   pthread_mutex_t lock;
+}  PAIRROW;
+
+/***********************************************************************/
+/* Prototypes
+ */
+static BOOL ReadPairFrames(TRAJ *in, PAIRFRAMES *frames);
+static BOOL RunPairRow(PAIRROW *job, int nThreads);
+static void *PairWorker(void *arg);
+static void CalculateTile(PAIRROW *job, ULONG column);
+static BOOL AddTilePair(PAIRTILE *tile, ULONG frame2, REAL rmsd);
+static void WriteSparseRow(FILE *fp, PAIRROW *job);
+static void SetPairFrame(COORDS *frame, PAIRFRAMES *frames, ULONG n);
+static char *MapPairFile(char *filename, int form, PAIRFRAMES *frames,
+                         size_t *size);
+
+
+
+/***********************************************************************/
+/*>BOOL WritePairwise(TRAJ *in, OPTIONS *options, ULONG *nFrames)
+   --------------------------------------------------------------
+*//**
+   \param[in,out] *in          an open trajectory with its window and
+                               atom selection set
+   \param[in]     *options     the options for the run: the file and
+                               form to write, the cutoff and threads
+   \param[out]    *nFrames     number of frames used
+   \return                     FALSE (with a message if the frames
+                               couldn't be read) if the file wasn't
+                               written
+
+   Reads the frames in the window and writes the RMSD of every pair of
+   them to options->pairwiseFile in options->pairwiseForm
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL WritePairwise(TRAJ *in, OPTIONS *options, ULONG *nFrames)
+{
+   PAIRFRAMES frames;
+   PAIRROW    job;
+   FILE       *fp      = NULL;
+   char       *buffer  = NULL;
+   ULONG      i;
+   BOOL       ok       = TRUE;
+   int        nThreads = (options->nThreads > 1) ? options->nThreads : 1;
+
+   memset(&job, 0, sizeof(PAIRROW));
+   *nFrames = 0;
+   if(!ReadPairFrames(in, &frames))
+   {
+      free(frames.coords);
+      free(frames.frameNum);
+      return(FALSE);
+   }
+   *nFrames = frames.nFrames;
+   EndPass("read");
+
+   /* Two tiles of frames should fit in the cache                       */
+   job.tileSize = PAIRCACHEBYTES / (2 * 3 * frames.nAtoms * sizeof(COORD));
+   if(job.tileSize < 1)
+      job.tileSize = 1;
+   if(job.tileSize > PAIRMAXTILE)
+      job.tileSize = PAIRMAXTILE;
+
+   job.frames = &frames;
+   job.form   = options->pairwiseForm;
+   job.cutoff = options->cutoff;
+   job.nTiles = (frames.nFrames + job.tileSize - 1) / job.tileSize;
+
+   if(job.form == PAIR_SPARSE)
+   {
+      if((job.tiles = (PAIRTILE *)CountedCalloc(job.nTiles,
+                                                sizeof(PAIRTILE)))==NULL)
+      {
+         Msg(MSG_NOMEM, "");
+         ok = FALSE;
+      }
+      else if((fp = fopen(options->pairwiseFile, "w"))==NULL)
+      {
+         ok = FALSE;
+      }
+      else if((buffer = (char *)CountedMalloc(PAIRBUFF)) != NULL)
+      {
+         setvbuf(fp, buffer, _IOFBF, PAIRBUFF);
+      }
+   }
+   else
+   {
+      if((job.data = MapPairFile(options->pairwiseFile, job.form,
+                                 &frames, &(job.size)))==NULL)
+         ok = FALSE;
+      else
+         job.matrix = (float *)(job.data + PAIR_HEADERSIZE +
+                                frames.nFrames * sizeof(uint64_t));
+   }
+
+   if(ok)
+   {
+      pthread_mutex_init(&(job.lock), NULL);
+      for(job.row=0; ok && (job.row<job.nTiles); job.row++)
+      {
+         if(!RunPairRow(&job, nThreads))
+         {
+            Msg(MSG_NOMEM, "");
+            ok = FALSE;
+         }
+         else if(fp != NULL)
+         {
+            WriteSparseRow(fp, &job);
+         }
+      }
+      pthread_mutex_destroy(&(job.lock));
+   }
+
+   if((job.data != NULL) && (munmap(job.data, job.size) != 0))
+      ok = FALSE;
+   if((fp != NULL) && (fclose(fp) != 0))
+      ok = FALSE;
+   free(buffer);
+
+   if(job.tiles != NULL)
+   {
+      for(i=0; i<job.nTiles; i++)
+      {
+         free(job.tiles[i].frame2);
+         free(job.tiles[i].rmsd);
+      }
+      free(job.tiles);
+   }
+   free(frames.coords);
+   free(frames.frameNum);
+
+   if(ok)
+      EndPass("pairwise");
+   return(ok);
+}
+
+
+/***********************************************************************/
+/*>static BOOL ReadPairFrames(TRAJ *in, PAIRFRAMES *frames)
+   --------------------------------------------------------
+*//**
+   \param[in,out] *in          an open trajectory
+   \param[out]    *frames      the frames in the window. The caller
+                               frees frames->coords and frames->frameNum
+                               even if this fails
+   \return                     FALSE (with a message) if no frames were
+                               read, none had atoms selected, the
+                               frames did not match or there was no
+                               memory
+
+   With in->skipBad, frames whose atom count doesn't match the first
+   frame, and those ReadTrajFrame() finds bad, are left out with a
+   warning. The frames are numbered from in->frameNum, so the numbers
+   are still those in the file.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Leaves out bad frames with in->skipBad
+-  14.10.26 Keeps the kernels for the atom count
+-  14.10.26 Keeps the TRAJ's fit option
+-  14.10.26 Fails at a bad frame
+*/
+static BOOL ReadPairFrames(TRAJ *in, PAIRFRAMES *frames)
+{
+   COORDS *frame;
+   char   header[MAXBUFF];
+   COORD  *coords;
+   BOOL   ok = TRUE;
+
+   memset(frames, 0, sizeof(PAIRFRAMES));
+   frames->fit = in->fit;
+   if((frame = AllocCoords(MINATOMS))==NULL)
+   {
+      Msg(MSG_NOMEM, "");
+      return(FALSE);
+   }
+
+   RewindTraj(in);
+   while(ReadTrajFrame(in, header, frame))
+   {
+      if(frames->nFrames == 0)
+      {
+         if((frames->nAtoms = frame->nAtoms) == 0)
+         {
+            Msg("No atoms selected", "");
+            ok = FALSE;
+            break;
+         }
+         frames->kernels = frame->kernels;
+      }
+      else if(frame->nAtoms != frames->nAtoms)
+      {
+         MsgBadFrame(in, in->frameNum-1, header, in->skipBad);
+         if(in->skipBad)
+            continue;
+         ok = FALSE;
+         break;
+      }
+
+      if(frames->nFrames == frames->maxFrames)
+      {
+         ULONG maxFrames = (frames->maxFrames) ? 2 * frames->maxFrames
+                                               : MINPAIRFRAMES;
+         ULONG *frameNum;
+
+         if((coords = (COORD *)CountedRealloc(frames->coords,
+                         maxFrames * 3 * frames->nAtoms * sizeof(COORD)))
+            != NULL)
+            frames->coords = coords;
+         if((frameNum = (ULONG *)CountedRealloc(frames->frameNum,
+                                              maxFrames * sizeof(ULONG)))
+            != NULL)
+            frames->frameNum = frameNum;
+         if((coords == NULL) || (frameNum == NULL))
+         {
+            Msg(MSG_NOMEM, "");
+            ok = FALSE;
+            break;
+         }
+         frames->maxFrames = maxFrames;
+      }
+
+      coords = frames->coords + frames->nFrames * 3 * frames->nAtoms;
+      memcpy(coords, frame->x, frames->nAtoms * sizeof(COORD));
+      memcpy(coords + frames->nAtoms, frame->y,
+             frames->nAtoms * sizeof(COORD));
+      memcpy(coords + 2 * frames->nAtoms, frame->z,
+             frames->nAtoms * sizeof(COORD));
+      frames->frameNum[frames->nFrames] = in->frameNum;
+      frames->nFrames++;
+   }
+   FreeCoords(frame);
+   if(in->badFrame != FRAME_OK)
+      ok = FALSE;
+
+   if(ok && (frames->nFrames == 0))
+   {
+      Msg("No frames in trajectory", "");
+      ok = FALSE;
+   }
+   return(ok);
+}
+
+
+/***********************************************************************/
+/*>static BOOL RunPairRow(PAIRROW *job, int nThreads)
+   --------------------------------------------------
+*//**
+   \param[in,out] *job         the row of tiles to calculate (job->row)
+   \param[in]     nThreads     number of threads to use
+   \return                     FALSE if there was no memory for a
+                               sparse tile's pairs
+
+   Calculates the tiles of the row on and above the diagonal. Each
+   thread takes the next tile not yet started until there are none
+   left. If a thread can't be started, the others take its share.
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL RunPairRow(PAIRROW *job, int nThreads)
+{
+   pthread_t threads[MAXTHREADS];
+   BOOL      threaded[MAXTHREADS];
+   ULONG     i;
+   int       t;
+
+   job->nextTile = job->row;
+   for(t=1; t<nThreads; t++)
+      threaded[t] = (pthread_create(&(threads[t]), NULL, PairWorker,
+                                    (void *)job) == 0);
+   PairWorker((void *)job);
+   for(t=1; t<nThreads; t++)
+   {
+      if(threaded[t])
+         pthread_join(threads[t], NULL);
+   }
+
+   if(job->tiles != NULL)
+   {
+      for(i=job->row; i<job->nTiles; i++)
+      {
+         if(job->tiles[i].failed)
+            return(FALSE);
+      }
+   }
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>static void *PairWorker(void *arg)
+   ----------------------------------
+*//**
+   \param[in,out] *arg         the PAIRROW being calculated
+
+   Thread function. Calculates tiles of the row until none are left.
+
+-  14.10.26 Original   By: ACRM
+*/
+static void *PairWorker(void *arg)
+{
+   PAIRROW *job = (PAIRROW *)arg;
+   ULONG   column;
+
+   for(;;)
+   {
+      pthread_mutex_lock(&(job->lock));
+      column = job->nextTile++;
+      pthread_mutex_unlock(&(job->lock));
+
+      if(column >= job->nTiles)
+         break;
+      CalculateTile(job, column);
+   }
+   return(NULL);
+}
+
+
+/***********************************************************************/
+/*>static void SetPairFrame(COORDS *frame, PAIRFRAMES *frames, ULONG n)
+   -------------------------------------------------------------------
+*//**
+   \param[out]    *frame       a COORDS to point at the frame. It owns
+                               nothing so must not be freed
+   \param[in]     *frames      the frames
+   \param[in]     n            the frame (from 0)
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Sets the kernels
+*/
+static void SetPairFrame(COORDS *frame, PAIRFRAMES *frames, ULONG n)
+{
+   frame->x        = frames->coords + n * 3 * frames->nAtoms;
+   frame->y        = frame->x + frames->nAtoms;
+   frame->z        = frame->y + frames->nAtoms;
+#ifdef SINGLE_COORDS
+   frame->sx       = frame->sy = frame->sz = NULL;
+#endif
+   frame->nAtoms   = frames->nAtoms;
+   frame->maxAtoms = frames->nAtoms;
+   frame->kernels  = frames->kernels;
+}
+
+
+/***********************************************************************/
+/*>static void CalculateTile(PAIRROW *job, ULONG column)
+   -----------------------------------------------------
+*//**
+   \param[in,out] *job         the row of tiles being calculated
+   \param[in]     column       the tile in the row (at least job->row)
+
+   Calculates the RMSDs between the frames of tile row job->row and
+   those of tile column column, just those above the diagonal for the
+   tile on it. They go into the mapped matrix, or the pairs within the
+   cutoff into the column's PAIRTILE.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Uses the frames' fit option
+*/
+static void CalculateTile(PAIRROW *job, ULONG column)
+{
+   PAIRFRAMES *frames = job->frames;
+   PAIRTILE   *tile   = NULL;
+   COORDS     frame1,
+              frame2;
+   ULONG      n       = frames->nFrames,
+              first1  = job->row * job->tileSize,
+              first2  = column * job->tileSize,
+              last1   = first1 + job->tileSize,
+              last2   = first2 + job->tileSize,
+              i, j;
+   REAL       rmsd;
+
+   if(last1 > n)
+      last1 = n;
+   if(last2 > n)
+      last2 = n;
+
+   if(job->tiles != NULL)
+   {
+      tile         = &(job->tiles[column]);
+      tile->nPairs = 0;
+      tile->failed = FALSE;
+   }
+
+   for(i=first1; i<last1; i++)
+   {
+      SetPairFrame(&frame1, frames, i);
+      if(tile != NULL)
+         tile->rowStart[i-first1] = tile->nPairs;
+
+      for(j=((column == job->row) ? i+1 : first2); j<last2; j++)
+      {
+         SetPairFrame(&frame2, frames, j);
+         rmsd = RMSFrame(&frame1, &frame2, frames->fit);
+
+         switch(job->form)
+         {
+         case PAIR_FULL:
+            job->matrix[(size_t)i * n + j] = (float)rmsd;
+            job->matrix[(size_t)j * n + i] = (float)rmsd;
+            break;
+         case PAIR_TRIANGLE:
+            job->matrix[TRIANGLEINDEX(i, j, n)] = (float)rmsd;
+            break;
+         default:
+            if((rmsd <= job->cutoff) && !AddTilePair(tile, j, rmsd))
+               tile->failed = TRUE;
+            break;
+         }
+      }
+   }
+
+   if(tile != NULL)
+      tile->rowStart[last1-first1] = tile->nPairs;
+}
+
+
+/***********************************************************************/
+/*>static BOOL AddTilePair(PAIRTILE *tile, ULONG frame2, REAL rmsd)
+   ----------------------------------------------------------------
+*//**
+   \param[in,out] *tile        a sparse tile
+   \param[in]     frame2       the column frame of the pair (from 0)
+   \param[in]     rmsd         the pair's RMSD
+   \return                     FALSE if no memory
+
+   Adds a pair within the cutoff, growing the tile's arrays as needed
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL AddTilePair(PAIRTILE *tile, ULONG frame2, REAL rmsd)
+{
+   if(tile->nPairs == tile->maxPairs)
+   {
+      ULONG maxPairs = (tile->maxPairs) ? 2 * tile->maxPairs
+                                        : MINTILEPAIRS;
+      ULONG *frames;
+      REAL  *rmsds;
+
+      if((frames = (ULONG *)CountedRealloc(tile->frame2,
+                                           maxPairs * sizeof(ULONG)))
+         != NULL)
+         tile->frame2 = frames;
+      if((rmsds = (REAL *)CountedRealloc(tile->rmsd,
+                                         maxPairs * sizeof(REAL)))!=NULL)
+         tile->rmsd = rmsds;
+      if((frames == NULL) || (rmsds == NULL))
+         return(FALSE);
+      tile->maxPairs = maxPairs;
+   }
+
+   tile->frame2[tile->nPairs] = frame2;
+   tile->rmsd[tile->nPairs]   = rmsd;
+   tile->nPairs++;
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>static void WriteSparseRow(FILE *fp, PAIRROW *job)
+   --------------------------------------------------
+*//**
+   \param[in,out] *fp          the sparse output file
+   \param[in]     *job         a row of tiles that has been calculated
+
+   Writes the pairs within the cutoff from the row's tiles, frame by
+   frame and, for each frame, tile by tile, so they are in order of
+   both frames. Errors are found when the file is closed.
+
+-  14.10.26 Original   By: ACRM
+*/
+static void WriteSparseRow(FILE *fp, PAIRROW *job)
+{
+   ULONG    *frameNum = job->frames->frameNum,
+            first     = job->row * job->tileSize,
+            last      = first + job->tileSize,
+            i, column, p;
+   PAIRTILE *tile;
+
+   if(last > job->frames->nFrames)
+      last = job->frames->nFrames;
+
+   for(i=first; i<last; i++)
+   {
+      for(column=job->row; column<job->nTiles; column++)
+      {
+         tile = &(job->tiles[column]);
+         for(p=tile->rowStart[i-first]; p<tile->rowStart[i-first+1]; p++)
+            fprintf(fp, "%lu %lu %.4f\n", frameNum[i],
+                    frameNum[tile->frame2[p]], tile->rmsd[p]);
+      }
+   }
+}
+
+
+/***********************************************************************/
+/*>static char *MapPairFile(char *filename, int form, PAIRFRAMES *frames,
+                            size_t *size)
+   ----------------------------------------------------------------------
+*//**
+   \param[in]     *filename    the file to write
+   \param[in]     form         PAIR_FULL or PAIR_TRIANGLE
+   \param[in]     *frames      the frames
+   \param[out]    *size        size of the file
+   \return                     the file mapped for writing, with its
+                               header and frame numbers filled in (NULL
+                               if it couldn't be created)
+
+   Creates the output file at its full size and maps it. The space is
+   allocated first so that filling the mapping can't run out of disk.
+   The RMSDs start zeroed, which is the diagonal of PAIR_FULL.
+
+-  14.10.26 Original   By: ACRM
+*/
+static char *MapPairFile(char *filename, int form, PAIRFRAMES *frames,
+                         size_t *size)
+{
+   char     *data;
+   uint32_t word;
+   uint64_t value;
+   size_t   nValues;
+   ULONG    i;
+   int      fd;
+
+   nValues = (form == PAIR_FULL) ?
+             (size_t)frames->nFrames * frames->nFrames :
+             (size_t)frames->nFrames * (frames->nFrames - 1) / 2;
+   *size   = PAIR_HEADERSIZE + frames->nFrames * sizeof(uint64_t) +
+             nValues * sizeof(float);
+
+   if((fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0)
+      return(NULL);
+   if(posix_fallocate(fd, 0, (off_t)(*size)) != 0)
+   {
+      close(fd);
+      return(NULL);
+   }
+   data = (char *)mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       fd, 0);
+   close(fd);
+   if(data == MAP_FAILED)
+      return(NULL);
+
+   memcpy(data, PAIR_MAGIC, PAIR_MAGICLEN);
+   word  = (uint32_t)form;
+   memcpy(data + 8,  &word,  sizeof(word));
+   word  = 0;
+   memcpy(data + 12, &word,  sizeof(word));
+   value = frames->nFrames;
+   memcpy(data + 16, &value, sizeof(value));
+   for(i=0; i<frames->nFrames; i++)
+   {
+      value = frames->frameNum[i];
+      memcpy(data + PAIR_HEADERSIZE + i * sizeof(uint64_t), &value,
+             sizeof(value));
+   }
+
+   return(data);
+}
+
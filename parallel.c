@@ -0,0 +1,686 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       parallel.c
+
+   Version:    V1.30
+   Date:       14.10.26
+   Function:   Multi-threaded passes through a trajectory
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   Threaded versions of CalculateMeanCoords(), FindClosestToMean() and
+   CalculateMeanRMSD().
+
+   The frame index is used to split the frames into one contiguous
+   chunk per thread. Each thread has its own reader (DupTraj()) and
+   seeks straight to the first frame of its chunk. The per-chunk
+   results are then combined in chunk order, so the result for a given
+   number of threads is always the same. With one thread, the sums
+   are done in exactly the same order as the serial code so results
+   are identical. The closest frame is always identical since ties are
+   resolved in favour of the earliest frame, as in the serial code.
+
+   For the mean, each thread sums the coordinates of its chunk into
+   its own arrays using Kahan (compensated) summation. The per-thread
+   sums are then combined pairwise in a fixed tree order and divided by
+   the number of frames once. The error is therefore independent of the
+   number of frames, rather than growing with it as happens when
+   adding coordinates which have each been divided by the number of
+   frames (AddFrame()).
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.5   14.10.26 Original
+   V1.6   14.10.26 Added CalculateMeanCoordsThreaded()
+   V1.11  14.10.26 Counts allocations for --stats
+   V1.13  14.10.26 Frames are sized by the atom selection
+   V1.14  14.10.26 The chunks cover the frames in the TRAJ's window
+   V1.15  14.10.26 In a batch run the chunks are pool tasks
+   V1.16  14.10.26 The RMSD chunks write parts of the RMSD series
+   V1.17  14.10.26 The mean chunks gather squares for the RMSFs
+   V1.23  14.10.26 The Kahan sums are kept in the COORDS sums so they
+                   stay in REAL with SINGLE_COORDS
+   V1.25  14.10.26 The RMSFs, series and fit option are those of the
+                   TRAJ rather than gRMSF, gSeries and gFit
+   V1.26  14.10.26 MergeKahanSums() is used by the MPI build (mpi.c)
+   V1.29  14.10.26 A chunk records the frame that failed, which is
+                   reported with its byte offset
+   V1.30  14.10.26 The RMSD chunks can keep each frame's RMSD for the
+                   --sample interval
+
+*************************************************************************/
+/* Includes
+*/
+#include <pthread.h>
+#include "flexcalc.h"
+
+/***********************************************************************/
+/* Defines and macros
+ */
+#define TASK_MEAN    0
+#define TASK_CLOSEST 1
+#define TASK_RMSD    2
+
+/* Adds Kahan sum s2 (compensation c2) into s1 (compensation c1) using
+   TwoSum. t, v and e are temporaries
+*/
+#define MERGEKAHAN(s1, c1, s2, c2)                                      \
+   do {  t    = (s1) + (s2);                                            \
+         v    = t - (s1);                                               \
+         e    = ((s1) - (t - v)) + ((s2) - v);                          \
+         (s1) = t;                                                      \
+         (c1) = (c1) + (c2) - e;                                        \
+      }  while(0)
+
+typedef struct
+{
+   TRAJ       *traj;         /* This chunk's own reader                 */
+   FRAMEINDEX *index;
+   COORDS     *reference,    /* Frame to compare with (shared)          */
+              *bestFrame,    /* Closest frame in this chunk             */
+              *sum,          /* Sum of coordinates in this chunk and    */
+              *comp;         /* the Kahan compensation for the sum      */
+   ULONG      start,         /* Frames start..stop-1 of the window      */
+              stop,
+              bestFrameNum,  /* Frame number of bestFrame               */
+              errFrame;      /* Failed frame (ULONG_MAX if no memory)   */
+   REAL       sumRMSD,       /* Sum of RMSDs across the chunk           */
+              lowestRMSD;    /* RMSD of bestFrame                       */
+   REAL       *rmsds;        /* RMSD of each frame (shared, or NULL)    */
+   SERIES     *series;       /* Part of the RMSD series (or NULL)       */
+   RMSF       *rmsf;         /* Squares for the RMSFs (or NULL)         */
+   int        task;          /* TASK_MEAN, TASK_CLOSEST or TASK_RMSD    */
+   BOOL       threaded,      /* Is it being run in its own thread?      */
+              ok;
+   char       header[MAXBUFF],
+              errHeader[MAXBUFF];
+}  CHUNK;
+
+/***********************************************************************/
+/* Prototypes
+ */
+static void *ProcessChunk(void *arg);
+static void ProcessChunkTask(void *arg);
+static CHUNK *RunChunks(TRAJ *in, FRAMEINDEX *index, COORDS *reference,
+                        int nThreads, int task, REAL *rmsds);
+static void FreeChunks(CHUNK *chunks, int nThreads);
+static void MsgChunkError(TRAJ *in, CHUNK *chunk);
+
+
+/***********************************************************************/
+/*>COORDS *CalculateMeanCoordsThreaded(TRAJ *in, FRAMEINDEX *index,
+                                       int nThreads)
+   ------------------------------------------------------------------
+*//**
+   \param[in]  *in             the open trajectory
+   \param[in]  *index          frame index for the trajectory (atom
+                               counts already checked)
+   \param[in]  nThreads        Number of threads
+   \return                     a pretend frame containing coordinates
+                               averaged across the real frames
+
+   Multi-threaded version of CalculateMeanCoords(). Each chunk keeps
+   its own compensated sums, which are combined pairwise (chunk 0 with
+   1, 2 with 3, ... then 0 with 2, ...) before dividing by the number
+   of frames.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Divides by the frames in the window
+-  14.10.26 Gathers the RMSFs
+-  14.10.26 Works on the sums and stores the mean from them
+-  14.10.26 Reports errors with MsgChunkError()
+-  14.10.26 Gathers the TRAJ's RMSFs
+*/
+COORDS *CalculateMeanCoordsThreaded(TRAJ *in, FRAMEINDEX *index,
+                                    int nThreads)
+{
+   CHUNK  *chunks;
+   COORDS *meanFrame,
+          *comp;
+   ULONG  i,
+          nFrames = WindowFrameCount(in, index->nFrames);
+   int    step,
+          j;
+
+   if((chunks = RunChunks(in, index, NULL, nThreads, TASK_MEAN, NULL))==NULL)
+      return(NULL);
+
+   for(j=0; j<nThreads; j++)
+   {
+      if(!chunks[j].ok)
+      {
+         MsgChunkError(in, &(chunks[j]));
+         FreeChunks(chunks, nThreads);
+         return(NULL);
+      }
+   }
+
+   /* The squares are simply added in chunk order                       */
+   if(in->rmsf != NULL)
+   {
+      ResetRMSF(in->rmsf);
+      for(j=0; j<nThreads; j++)
+      {
+         if(!MergeRMSF(in->rmsf, chunks[j].rmsf))
+         {
+            Msg(MSG_NOMEM, "");
+            FreeChunks(chunks, nThreads);
+            return(NULL);
+         }
+      }
+   }
+
+   /* Tree reduction into chunk 0                                       */
+   for(step=1; step<nThreads; step*=2)
+   {
+      for(j=0; j+step<nThreads; j+=2*step)
+      {
+         MergeKahanSums(chunks[j].sum,       chunks[j].comp,
+                        chunks[j+step].sum,  chunks[j+step].comp);
+      }
+   }
+
+   /* Apply the compensation and divide by the number of frames         */
+   meanFrame = chunks[0].sum;
+   comp      = chunks[0].comp;
+   for(i=0; i<meanFrame->nAtoms; i++)
+   {
+      SUMX(meanFrame)[i] = (SUMX(meanFrame)[i] - SUMX(comp)[i]) / nFrames;
+      SUMY(meanFrame)[i] = (SUMY(meanFrame)[i] - SUMY(comp)[i]) / nFrames;
+      SUMZ(meanFrame)[i] = (SUMZ(meanFrame)[i] - SUMZ(comp)[i]) / nFrames;
+   }
+   StoreSums(meanFrame);
+   chunks[0].sum = NULL;
+   FreeChunks(chunks, nThreads);
+
+#ifdef DEBUG
+   PrintFrame("average", meanFrame);
+#endif
+   return(meanFrame);
+}
+
+
+/***********************************************************************/
+/*>COORDS *FindClosestToMeanThreaded(TRAJ *in, FRAMEINDEX *index,
+                                     COORDS *meanFrame, char *header,
+                                     int nThreads)
+   ----------------------------------------------------------------
+*//**
+   \param[in]  *in             the open trajectory
+   \param[in]  *index          frame index for the trajectory
+   \param[in]  *meanFrame      A pretend trajectory frame containing
+                               the averaged coordinates
+   \param[out] *header         The header for the frame closest to the
+                               mean coordinates
+   \param[in]  nThreads        Number of threads
+   \return                     The frame closest to the mean coordinates
+
+   Multi-threaded version of FindClosestToMean(). Each chunk finds its
+   own closest frame and the best of these is taken, earliest first.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Reports errors with MsgChunkError()
+*/
+COORDS *FindClosestToMeanThreaded(TRAJ *in, FRAMEINDEX *index,
+                                  COORDS *meanFrame, char *header,
+                                  int nThreads)
+{
+   CHUNK  *chunks;
+   COORDS *closestFrame = NULL;
+   int    i,
+          best          = -1;
+
+   if((chunks = RunChunks(in, index, meanFrame, nThreads,
+                           TASK_CLOSEST, NULL))==NULL)
+      return(NULL);
+
+   for(i=0; i<nThreads; i++)
+   {
+      if(!chunks[i].ok)
+      {
+         MsgChunkError(in, &(chunks[i]));
+         FreeChunks(chunks, nThreads);
+         return(NULL);
+      }
+      if((chunks[i].start < chunks[i].stop) &&
+         ((best < 0) || (chunks[i].lowestRMSD < chunks[best].lowestRMSD)))
+      {
+         best = i;
+      }
+   }
+
+   if(best >= 0)
+   {
+      closestFrame           = chunks[best].bestFrame;
+      chunks[best].bestFrame = NULL;
+      strcpy(header, chunks[best].header);
+   }
+
+   FreeChunks(chunks, nThreads);
+   return(closestFrame);
+}
+
+
+/***********************************************************************/
+/*>REAL CalculateMeanRMSDThreaded(TRAJ *in, FRAMEINDEX *index,
+                                  COORDS *closestFrame, int nThreads,
+                                  REAL *rmsds)
+   ------------------------------------------------------------------
+*//**
+   \param[in]  *in             the open trajectory
+   \param[in]  *index          frame index for the trajectory
+   \param[in]  *closestFrame   The frame closest to the mean coordinates
+   \param[in]  nThreads        Number of threads
+   \param[out] *rmsds          The RMSD of each frame in the window (may
+                               be NULL)
+   \return                     The mean RMSD
+
+   Multi-threaded version of CalculateMeanRMSD(). The partial sums from
+   each chunk are added in chunk order.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Divides by the frames in the window
+-  14.10.26 Writes the RMSD series
+-  14.10.26 Reports errors with MsgChunkError()
+-  14.10.26 Keeps each RMSD in rmsds
+-  14.10.26 Writes the TRAJ's series
+*/
+REAL CalculateMeanRMSDThreaded(TRAJ *in, FRAMEINDEX *index,
+                               COORDS *closestFrame, int nThreads,
+                               REAL *rmsds)
+{
+   CHUNK *chunks;
+   REAL  meanRMSD = 0.0;
+   int   i;
+
+   if((chunks = RunChunks(in, index, closestFrame, nThreads,
+                          TASK_RMSD, rmsds))==NULL)
+      return(-1.0);
+
+   for(i=0; i<nThreads; i++)
+   {
+      if(!chunks[i].ok)
+      {
+         MsgChunkError(in, &(chunks[i]));
+         FreeChunks(chunks, nThreads);
+         return(-1.0);
+      }
+      meanRMSD += chunks[i].sumRMSD;
+   }
+
+   /* Add each chunk's part of the series in order                      */
+   for(i=0; (in->series != NULL) && (i<nThreads); i++)
+   {
+      if(!AppendSeries(in->series, chunks[i].series))
+      {
+         Msg("Unable to write RMSD series", "");
+         FreeChunks(chunks, nThreads);
+         return(-1.0);
+      }
+   }
+   FreeChunks(chunks, nThreads);
+
+   /* Divide by number of frames                                        */
+   meanRMSD /= WindowFrameCount(in, index->nFrames);
+   return(meanRMSD);
+}
+
+
+/***********************************************************************/
+/*>static CHUNK *RunChunks(TRAJ *in, FRAMEINDEX *index,
+                           COORDS *reference, int nThreads, int task,
+                           REAL *rmsds)
+   ----------------------------------------------------------------
+*//**
+   \param[in]  *in             the open trajectory
+   \param[in]  *index          frame index for the trajectory
+   \param[in]  *reference      frame to compare each frame with (NULL
+                               for TASK_MEAN)
+   \param[in]  nThreads        number of threads (and chunks)
+   \param[in]  task            TASK_MEAN to sum the coordinates,
+                               TASK_CLOSEST to find the closest frame to
+                               the reference or TASK_RMSD to sum the
+                               RMSDs from it
+   \param[out] *rmsds          for TASK_RMSD, the RMSD of each frame in
+                               the window (may be NULL)
+   \return                     array of nThreads completed chunks, or
+                               NULL if they couldn't be set up
+
+   Splits the frames in the window into nThreads contiguous chunks and
+   processes each in its own thread. The calling thread processes the
+   first chunk. In a batch run (gPool set) the other chunks are instead
+   queued on the pool, where idle workers can take them, and the
+   calling thread runs whichever of them are left.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Added task, including TASK_MEAN
+-  14.10.26 Sizes the mean from the atom selection
+-  14.10.26 Uses the frame window
+-  14.10.26 Uses the pool in a batch run
+-  14.10.26 Opens the RMSD chunks' series parts
+-  14.10.26 Allocates the mean chunks' RMSFs
+-  14.10.26 Added rmsds
+-  14.10.26 Uses the TRAJ's series and RMSFs
+-  14.10.26 Sizes the mean from the window's first frame, as frame 0
+            may have been left out
+*/
+static CHUNK *RunChunks(TRAJ *in, FRAMEINDEX *index, COORDS *reference,
+                        int nThreads, int task, REAL *rmsds)
+{
+   CHUNK     *chunks;
+   pthread_t *threads;
+   int       i;
+   BOOL      ok     = TRUE;
+   ULONG     nFrames = WindowFrameCount(in, index->nFrames),
+             nAtoms  = (reference != NULL) ? reference->nAtoms
+                          : ((nFrames == 0) ? 0
+                             : CountSelected(in->select,
+                                  index->nAtoms[WindowFrameNum(in, 0)]));
+
+   chunks  = (CHUNK *)CountedCalloc(nThreads, sizeof(CHUNK));
+   threads = (pthread_t *)CountedCalloc(nThreads, sizeof(pthread_t));
+   if((chunks == NULL) || (threads == NULL))
+   {
+      Msg(MSG_NOMEM, "");
+      free(chunks);
+      free(threads);
+      return(NULL);
+   }
+
+   for(i=0; i<nThreads; i++)
+   {
+      chunks[i].index       = index;
+      chunks[i].reference   = reference;
+      chunks[i].task        = task;
+      chunks[i].rmsds       = rmsds;
+      chunks[i].start       = (ULONG)(((unsigned long long)nFrames
+                                       * i) / nThreads);
+      chunks[i].stop        = (ULONG)(((unsigned long long)nFrames
+                                       * (i+1)) / nThreads);
+      if((chunks[i].traj = DupTraj(in))==NULL)
+         ok = FALSE;
+
+      if((task == TASK_CLOSEST) &&
+         ((chunks[i].bestFrame = AllocCoords(nAtoms))==NULL))
+         ok = FALSE;
+
+      if((task == TASK_RMSD) && (in->series != NULL) &&
+         ((chunks[i].series = OpenSeriesPart(in->series))==NULL))
+         ok = FALSE;
+
+      if((task == TASK_MEAN) && (in->rmsf != NULL) &&
+         ((chunks[i].rmsf = AllocRMSF())==NULL))
+         ok = FALSE;
+
+      if(task == TASK_MEAN)
+      {
+         if(((chunks[i].sum  = AllocCoords(nAtoms))==NULL) ||
+            ((chunks[i].comp = AllocCoords(nAtoms))==NULL) ||
+            !ZeroCoords(chunks[i].sum,  nAtoms) ||
+            !ZeroCoords(chunks[i].comp, nAtoms))
+            ok = FALSE;
+      }
+   }
+
+   if(!ok)
+   {
+      Msg(MSG_NOMEM, "");
+      FreeChunks(chunks, nThreads);
+      free(threads);
+      return(NULL);
+   }
+
+   if(gPool != NULL)
+   {
+      TASKGROUP group;
+
+      group.pending = 0;
+      for(i=1; i<nThreads; i++)
+      {
+         if(!SubmitTask(gPool, ProcessChunkTask, (void *)&(chunks[i]),
+                        &group, FALSE))
+            ProcessChunk((void *)&(chunks[i]));
+      }
+      ProcessChunk((void *)&(chunks[0]));
+      WaitTaskGroup(gPool, &group, TRUE);
+      free(threads);
+      return(chunks);
+   }
+
+   /* Start the other threads, running anything that can't be given a
+      thread here afterwards
+   */
+   for(i=1; i<nThreads; i++)
+   {
+      chunks[i].threaded = (pthread_create(&(threads[i]), NULL,
+                                           ProcessChunk,
+                                           (void *)&(chunks[i])) == 0);
+   }
+   ProcessChunk((void *)&(chunks[0]));
+   for(i=1; i<nThreads; i++)
+   {
+      if(chunks[i].threaded)
+         pthread_join(threads[i], NULL);
+      else
+         ProcessChunk((void *)&(chunks[i]));
+   }
+
+   free(threads);
+   return(chunks);
+}
+
+
+/***********************************************************************/
+/*>static void *ProcessChunk(void *arg)
+   ------------------------------------
+*//**
+   \param[in,out] *arg         the CHUNK to process
+
+   Thread function. Reads the chunk's frames and either sums their
+   coordinates, finds the one closest to the reference frame or sums
+   their RMSDs from it.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Added TASK_MEAN
+-  14.10.26 Reads the frames in the window
+-  14.10.26 Writes the chunk's part of the RMSD series
+-  14.10.26 Gathers the squares for the RMSFs
+-  14.10.26 Records the frame that failed
+-  14.10.26 Keeps each RMSD
+-  14.10.26 Uses the TRAJ's fit option
+-  14.10.26 Sizes the frame from the chunk's first frame
+*/
+static void *ProcessChunk(void *arg)
+{
+   CHUNK  *chunk   = (CHUNK *)arg;
+   COORDS *frame;
+   ULONG  i;
+   char   thisHeader[MAXBUFF];
+
+   thisHeader[0]     = '\0';
+   chunk->ok         = TRUE;
+   chunk->sumRMSD    = 0.0;
+   chunk->lowestRMSD = 0.0;
+
+   if((frame = AllocCoords((chunk->start < chunk->stop)
+                           ? chunk->index->nAtoms[WindowFrameNum(chunk->traj,
+                                                        chunk->start)]
+                           : 0))==NULL)
+   {
+      chunk->ok       = FALSE;
+      chunk->errFrame = ULONG_MAX;
+      return(NULL);
+   }
+
+   for(i=chunk->start; i<chunk->stop; i++)
+   {
+      REAL rmsd = 0.0;
+
+      if(!ReadIndexedFrame(chunk->traj, chunk->index,
+                           WindowFrameNum(chunk->traj, i), thisHeader,
+                           frame) ||
+         ((chunk->task == TASK_MEAN) &&
+          (!AddFrameKahan(chunk->sum, chunk->comp, frame) ||
+           ((chunk->rmsf != NULL) && !AddSquares(chunk->rmsf, frame)))) ||
+         ((chunk->task != TASK_MEAN) &&
+          ((rmsd = RMSFrame(chunk->reference, frame,
+                            chunk->traj->fit)) < 0.0)))
+      {
+         chunk->ok       = FALSE;
+         chunk->errFrame = WindowFrameNum(chunk->traj, i);
+         strcpy(chunk->errHeader, thisHeader);
+         break;
+      }
+
+      if(chunk->task == TASK_CLOSEST)
+      {
+         if((i == chunk->start) || (rmsd < chunk->lowestRMSD))
+         {
+            COORDS *swap       = chunk->bestFrame;
+            chunk->bestFrame    = frame;
+            frame               = swap;
+            chunk->lowestRMSD   = rmsd;
+            chunk->bestFrameNum = i;
+            strcpy(chunk->header, thisHeader);
+         }
+      }
+      else if(chunk->task == TASK_RMSD)
+      {
+         chunk->sumRMSD += rmsd;
+         if(chunk->rmsds != NULL)
+            chunk->rmsds[i] = rmsd;
+         if(chunk->series != NULL)
+            WriteSeries(chunk->series,
+                        WindowFrameNum(chunk->traj, i) + 1, thisHeader,
+                        rmsd);
+      }
+   }
+
+   FreeCoords(frame);
+   return(NULL);
+}
+
+
+/***********************************************************************/
+/*>static void ProcessChunkTask(void *arg)
+   ---------------------------------------
+*//**
+   \param[in,out] *arg         the CHUNK to process
+
+   Pool task wrapper for ProcessChunk()
+
+-  14.10.26 Original   By: ACRM
+*/
+static void ProcessChunkTask(void *arg)
+{
+   ProcessChunk(arg);
+}
+
+
+/***********************************************************************/
+/*>static void FreeChunks(CHUNK *chunks, int nThreads)
+   ---------------------------------------------------
+*//**
+   \param[in]  *chunks         array of chunks
+   \param[in]  nThreads        number of chunks
+
+   Closes the readers and series parts and frees the chunks
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Closes the series parts
+-  14.10.26 Frees the RMSFs
+*/
+static void FreeChunks(CHUNK *chunks, int nThreads)
+{
+   int i;
+
+   for(i=0; i<nThreads; i++)
+   {
+      CloseTraj(chunks[i].traj);
+      FreeCoords(chunks[i].bestFrame);
+      FreeCoords(chunks[i].sum);
+      FreeCoords(chunks[i].comp);
+      CloseSeries(chunks[i].series);
+      FreeRMSF(chunks[i].rmsf);
+   }
+   free(chunks);
+}
+
+
+/***********************************************************************/
+/*>void MergeKahanSums(COORDS *sum1, COORDS *comp1, COORDS *sum2,
+                       COORDS *comp2)
+   ---------------------------------------------------------------
+*//**
+   \param[in,out] *sum1        compensated sums to add into
+   \param[in,out] *comp1
+   \param[in]     *sum2        compensated sums to add
+   \param[in]     *comp2
+
+   Adds one set of Kahan sums into another. The two sums are added
+   exactly using Knuth's TwoSum, with the rounding error carried into
+   the compensation along with the two existing compensations.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Works on the sums
+-  14.10.26 No longer static
+*/
+void MergeKahanSums(COORDS *sum1, COORDS *comp1, COORDS *sum2,
+                    COORDS *comp2)
+{
+   ULONG i;
+
+   for(i=0; i<sum1->nAtoms; i++)
+   {
+      REAL t, v, e;
+
+      MERGEKAHAN(SUMX(sum1)[i], SUMX(comp1)[i],
+                 SUMX(sum2)[i], SUMX(comp2)[i]);
+      MERGEKAHAN(SUMY(sum1)[i], SUMY(comp1)[i],
+                 SUMY(sum2)[i], SUMY(comp2)[i]);
+      MERGEKAHAN(SUMZ(sum1)[i], SUMZ(comp1)[i],
+                 SUMZ(sum2)[i], SUMZ(comp2)[i]);
+   }
+}
+
+
+/***********************************************************************/
+/*>static void MsgChunkError(TRAJ *in, CHUNK *chunk)
+   -------------------------------------------------
+*//**
+   \param[in,out] *in          the open trajectory
+   \param[in]     *chunk       a chunk which failed
+
+   Reports why a chunk failed. Other than for lack of memory, its
+   frame couldn't be read or didn't match. The reason the chunk's
+   reader gave is copied to in->badFrame.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Gives the reason from the chunk's reader
+*/
+static void MsgChunkError(TRAJ *in, CHUNK *chunk)
+{
+   if(chunk->errFrame == ULONG_MAX)
+   {
+      Msg(MSG_NOMEM, "");
+   }
+   else
+   {
+      /* Why the chunk's reader found the frame bad                    */
+      in->badFrame = chunk->traj->badFrame;
+      MsgBadFrame(in, chunk->errFrame, chunk->errHeader, FALSE);
+   }
+}
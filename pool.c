@@ -0,0 +1,546 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       pool.c
+
+   Version:    V1.15
+   Date:       14.10.26
+   Function:   Work-stealing thread pool for batch runs
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   A fixed set of workers shared by every trajectory in a batch. The
+   thread that starts the pool is worker 0 and takes part whenever it
+   waits, so a pool of n workers starts n-1 threads.
+
+   There are two kinds of task. Whole trajectories (file tasks) go on a
+   single shared queue and are taken oldest first. The chunks of a
+   large trajectory's threaded passes (parallel.c) go on the deque of
+   the worker running that trajectory. A worker takes its own newest
+   chunk first and otherwise steals the oldest chunk from another
+   worker, so idle workers help with large trajectories rather than
+   waiting for them. Only when there are no chunks anywhere is a new
+   trajectory started.
+
+   A worker waiting for its own chunks only runs chunks while it
+   waits, so a trajectory is never held up behind another whole
+   trajectory started on the same worker.
+
+   The queues are small and each has its own mutex. A single condition
+   variable wakes sleeping workers whenever a task is added or
+   finished.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.15  14.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <pthread.h>
+#include "flexcalc.h"
+
+/***********************************************************************/
+/* Defines and macros
+ */
+#define MINQUEUE 64       /* Initial size of each task queue            */
+
+typedef struct
+{
+   void      (*func)(void *arg);
+   void      *arg;
+   TASKGROUP *group;
+}  TASK;
+
+/* A ring buffer of tasks. Tasks are added at the tail; the owner takes
+   the newest from the tail and thieves the oldest from the head
+*/
+typedef struct
+{
+   TASK            *tasks;
+   ULONG           head,
+                   count,
+                   size;
+   pthread_mutex_t lock;
+}  TASKQUEUE;
+
+struct pool
+{
+   int             nWorkers,      /* Fixed before any thread starts     */
+                   nStarted;      /* Threads running. Not for workers   */
+   TASKQUEUE       files,         /* Whole trajectories                 */
+                   *deques;       /* Chunks, one deque per worker       */
+   pthread_t       *threads;
+   pthread_mutex_t lock;          /* Protects events and stop           */
+   pthread_cond_t  changed;
+   ULONG           events;        /* Count of tasks added and finished  */
+   BOOL            stop;
+};
+
+typedef struct
+{
+   POOL *pool;
+   int  worker;
+}  WORKERARG;
+
+/***********************************************************************/
+/* Prototypes
+ */
+static BOOL InitQueue(TASKQUEUE *queue);
+static void FreeQueue(TASKQUEUE *queue);
+static BOOL PushTask(TASKQUEUE *queue, TASK *task);
+static BOOL PopTask(TASKQUEUE *queue, BOOL newest, TASK *task);
+static void Notify(POOL *pool);
+static void *Worker(void *arg);
+
+/***********************************************************************/
+/* Globals
+ */
+/* The pool used by the threaded passes in a batch run (NULL if none)  */
+POOL *gPool = NULL;
+
+/* The worker number of the current thread                             */
+static __thread int sWorker = 0;
+
+
+/***********************************************************************/
+/*>static BOOL InitQueue(TASKQUEUE *queue)
+   ---------------------------------------
+*//**
+   \param[out] *queue          the queue to initialise
+   \return                     FALSE if no memory
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL InitQueue(TASKQUEUE *queue)
+{
+   queue->head  = 0;
+   queue->count = 0;
+   queue->size  = MINQUEUE;
+   if((queue->tasks = (TASK *)CountedMalloc(MINQUEUE * sizeof(TASK)))
+      ==NULL)
+      return(FALSE);
+   pthread_mutex_init(&(queue->lock), NULL);
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>static void FreeQueue(TASKQUEUE *queue)
+   ---------------------------------------
+*//**
+   \param[in]  *queue          a queue set up by InitQueue()
+
+-  14.10.26 Original   By: ACRM
+*/
+static void FreeQueue(TASKQUEUE *queue)
+{
+   if(queue->tasks != NULL)
+   {
+      pthread_mutex_destroy(&(queue->lock));
+      free(queue->tasks);
+      queue->tasks = NULL;
+   }
+}
+
+
+/***********************************************************************/
+/*>static BOOL PushTask(TASKQUEUE *queue, TASK *task)
+   --------------------------------------------------
+*//**
+   \param[in,out] *queue       a task queue
+   \param[in]     *task        the task to add at the tail
+   \return                     FALSE if no memory
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL PushTask(TASKQUEUE *queue, TASK *task)
+{
+   BOOL ok = TRUE;
+
+   pthread_mutex_lock(&(queue->lock));
+   if(queue->count == queue->size)
+   {
+      TASK  *tasks;
+      ULONG i;
+
+      /* Unwrap the ring into a buffer twice the size                  */
+      if((tasks = (TASK *)CountedMalloc(2 * queue->size * sizeof(TASK)))
+         ==NULL)
+      {
+         ok = FALSE;
+      }
+      else
+      {
+         for(i=0; i<queue->count; i++)
+            tasks[i] = queue->tasks[(queue->head + i) % queue->size];
+         free(queue->tasks);
+         queue->tasks = tasks;
+         queue->head  = 0;
+         queue->size *= 2;
+      }
+   }
+   if(ok)
+   {
+      queue->tasks[(queue->head + queue->count) % queue->size] = *task;
+      queue->count++;
+   }
+   pthread_mutex_unlock(&(queue->lock));
+
+   return(ok);
+}
+
+
+/***********************************************************************/
+/*>static BOOL PopTask(TASKQUEUE *queue, BOOL newest, TASK *task)
+   -------------------------------------------------------------
+*//**
+   \param[in,out] *queue       a task queue
+   \param[in]     newest       take the newest task rather than the
+                               oldest
+   \param[out]    *task        the task taken
+   \return                     Was there a task?
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL PopTask(TASKQUEUE *queue, BOOL newest, TASK *task)
+{
+   BOOL found = FALSE;
+
+   pthread_mutex_lock(&(queue->lock));
+   if(queue->count > 0)
+   {
+      if(newest)
+      {
+         *task = queue->tasks[(queue->head + queue->count - 1) %
+                              queue->size];
+      }
+      else
+      {
+         *task       = queue->tasks[queue->head];
+         queue->head = (queue->head + 1) % queue->size;
+      }
+      queue->count--;
+      found = TRUE;
+   }
+   pthread_mutex_unlock(&(queue->lock));
+
+   return(found);
+}
+
+
+/***********************************************************************/
+/*>static void Notify(POOL *pool)
+   ------------------------------
+*//**
+   \param[in,out] *pool        the pool
+
+   Records that a task has been added or finished and wakes any waiting
+   workers
+
+-  14.10.26 Original   By: ACRM
+*/
+static void Notify(POOL *pool)
+{
+   pthread_mutex_lock(&(pool->lock));
+   pool->events++;
+   pthread_cond_broadcast(&(pool->changed));
+   pthread_mutex_unlock(&(pool->lock));
+}
+
+
+/***********************************************************************/
+/*>static void *Worker(void *arg)
+   ------------------------------
+*//**
+   \param[in]  *arg            pointer to a WORKERARG
+
+   Thread function for workers 1 to n-1. Runs tasks until the pool is
+   stopped.
+
+-  14.10.26 Original   By: ACRM
+*/
+static void *Worker(void *arg)
+{
+   WORKERARG *workerArg = (WORKERARG *)arg;
+   POOL      *pool      = workerArg->pool;
+
+   sWorker = workerArg->worker;
+   free(workerArg);
+
+   for(;;)
+   {
+      ULONG events = PoolEvents(pool);
+      BOOL  stop;
+
+      pthread_mutex_lock(&(pool->lock));
+      stop = pool->stop;
+      pthread_mutex_unlock(&(pool->lock));
+      if(stop)
+         break;
+
+      if(!RunPoolTask(pool, FALSE))
+         WaitPool(pool, events);
+   }
+   return(NULL);
+}
+
+
+/***********************************************************************/
+/*>POOL *StartPool(int nWorkers)
+   -----------------------------
+*//**
+   \param[in]  nWorkers        number of workers including the calling
+                               thread
+   \return                     the pool (NULL on failure)
+
+   Creates a pool and starts its threads. The calling thread becomes
+   worker 0. If fewer threads can be started, the deques of the others
+   just stay empty.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 nWorkers is not changed once the threads have started.
+            The lock is set up before anything can fail
+*/
+POOL *StartPool(int nWorkers)
+{
+   POOL *pool;
+   int  i;
+   BOOL ok;
+
+   if((pool = (POOL *)CountedCalloc(1, sizeof(POOL)))==NULL)
+      return(NULL);
+   pthread_mutex_init(&(pool->lock), NULL);
+   pthread_cond_init(&(pool->changed), NULL);
+   pool->nWorkers = (nWorkers < 1) ? 1 : nWorkers;
+   pool->nStarted = 1;
+   pool->deques   = (TASKQUEUE *)CountedCalloc(pool->nWorkers,
+                                               sizeof(TASKQUEUE));
+   pool->threads  = (pthread_t *)CountedCalloc(pool->nWorkers,
+                                               sizeof(pthread_t));
+   ok = ((pool->deques != NULL) && (pool->threads != NULL) &&
+         InitQueue(&(pool->files)));
+   for(i=0; ok && (i<pool->nWorkers); i++)
+      ok = InitQueue(&(pool->deques[i]));
+   if(!ok)
+   {
+      StopPool(pool);
+      return(NULL);
+   }
+
+   /* Fewer threads than asked for still works - just more slowly. The
+      workers read nWorkers, so only nStarted records how many there are
+   */
+   sWorker = 0;
+   for(i=1; i<pool->nWorkers; i++)
+   {
+      WORKERARG *arg;
+
+      if((arg = (WORKERARG *)CountedMalloc(sizeof(WORKERARG)))==NULL)
+         break;
+      arg->pool   = pool;
+      arg->worker = i;
+      if(pthread_create(&(pool->threads[i]), NULL, Worker,
+                        (void *)arg) != 0)
+      {
+         free(arg);
+         break;
+      }
+   }
+   pool->nStarted = i;
+   return(pool);
+}
+
+
+/***********************************************************************/
+/*>void StopPool(POOL *pool)
+   -------------------------
+*//**
+   \param[in]  *pool           a pool from StartPool()
+
+   Stops the workers, once they have finished their current tasks, and
+   frees the pool. Any tasks still queued are not run.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Joins the nStarted threads
+*/
+void StopPool(POOL *pool)
+{
+   int i;
+
+   if(pool == NULL)
+      return;
+
+   pthread_mutex_lock(&(pool->lock));
+   pool->stop = TRUE;
+   pthread_cond_broadcast(&(pool->changed));
+   pthread_mutex_unlock(&(pool->lock));
+   for(i=1; i<pool->nStarted; i++)
+      pthread_join(pool->threads[i], NULL);
+   pthread_mutex_destroy(&(pool->lock));
+   pthread_cond_destroy(&(pool->changed));
+
+   FreeQueue(&(pool->files));
+   if(pool->deques != NULL)
+   {
+      for(i=0; i<pool->nWorkers; i++)
+         FreeQueue(&(pool->deques[i]));
+   }
+   free(pool->deques);
+   free(pool->threads);
+   free(pool);
+}
+
+
+/***********************************************************************/
+/*>BOOL SubmitTask(POOL *pool, void (*func)(void *arg), void *arg,
+                   TASKGROUP *group, BOOL isFile)
+   ---------------------------------------------------------------
+*//**
+   \param[in,out] *pool        the pool
+   \param[in]     func         the task function
+   \param[in]     *arg         its argument
+   \param[in,out] *group       group to count the task in until it has
+                               finished
+   \param[in]     isFile       a whole trajectory rather than a chunk
+   \return                     FALSE if no memory
+
+   Queues a task. A whole trajectory goes on the shared queue and a
+   chunk on the calling worker's own deque.
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL SubmitTask(POOL *pool, void (*func)(void *arg), void *arg,
+                TASKGROUP *group, BOOL isFile)
+{
+   TASK task;
+
+   task.func  = func;
+   task.arg   = arg;
+   task.group = group;
+
+   __atomic_add_fetch(&(group->pending), 1, __ATOMIC_SEQ_CST);
+   if(!PushTask((isFile ? &(pool->files) : &(pool->deques[sWorker])),
+                &task))
+   {
+      __atomic_sub_fetch(&(group->pending), 1, __ATOMIC_SEQ_CST);
+      return(FALSE);
+   }
+   Notify(pool);
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>BOOL RunPoolTask(POOL *pool, BOOL chunksOnly)
+   ---------------------------------------------
+*//**
+   \param[in,out] *pool        the pool
+   \param[in]     chunksOnly   don't start a new trajectory
+   \return                     Was a task run?
+
+   Runs one task: this worker's newest chunk, or else the oldest chunk
+   of another worker, or else (unless chunksOnly) the next trajectory
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL RunPoolTask(POOL *pool, BOOL chunksOnly)
+{
+   TASK task;
+   BOOL found;
+   int  i;
+
+   found = PopTask(&(pool->deques[sWorker]), TRUE, &task);
+   for(i=1; !found && (i<pool->nWorkers); i++)
+      found = PopTask(&(pool->deques[(sWorker + i) % pool->nWorkers]),
+                      FALSE, &task);
+   if(!found && !chunksOnly)
+      found = PopTask(&(pool->files), FALSE, &task);
+   if(!found)
+      return(FALSE);
+
+   task.func(task.arg);
+   __atomic_sub_fetch(&(task.group->pending), 1, __ATOMIC_SEQ_CST);
+   Notify(pool);
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>ULONG PoolEvents(POOL *pool)
+   ----------------------------
+*//**
+   \param[in]  *pool           the pool
+   \return                     the count of tasks added and finished
+
+   Read before looking for work, to pass to WaitPool() if none is found
+
+-  14.10.26 Original   By: ACRM
+*/
+ULONG PoolEvents(POOL *pool)
+{
+   ULONG events;
+
+   pthread_mutex_lock(&(pool->lock));
+   events = pool->events;
+   pthread_mutex_unlock(&(pool->lock));
+   return(events);
+}
+
+
+/***********************************************************************/
+/*>void WaitPool(POOL *pool, ULONG events)
+   ---------------------------------------
+*//**
+   \param[in]  *pool           the pool
+   \param[in]  events          from PoolEvents()
+
+   Sleeps until a task has been added or finished since PoolEvents()
+   returned events (or the pool is stopped)
+
+-  14.10.26 Original   By: ACRM
+*/
+void WaitPool(POOL *pool, ULONG events)
+{
+   pthread_mutex_lock(&(pool->lock));
+   while((pool->events == events) && !pool->stop)
+      pthread_cond_wait(&(pool->changed), &(pool->lock));
+   pthread_mutex_unlock(&(pool->lock));
+}
+
+
+/***********************************************************************/
+/*>void WaitTaskGroup(POOL *pool, TASKGROUP *group, BOOL chunksOnly)
+   -----------------------------------------------------------------
+*//**
+   \param[in,out] *pool        the pool
+   \param[in]     *group       the tasks to wait for
+   \param[in]     chunksOnly   only help with chunks while waiting
+
+   Runs other tasks until every task in the group has finished
+
+-  14.10.26 Original   By: ACRM
+*/
+void WaitTaskGroup(POOL *pool, TASKGROUP *group, BOOL chunksOnly)
+{
+   while(__atomic_load_n(&(group->pending), __ATOMIC_SEQ_CST) > 0)
+   {
+      ULONG events = PoolEvents(pool);
+
+      if(!RunPoolTask(pool, chunksOnly) &&
+         (__atomic_load_n(&(group->pending), __ATOMIC_SEQ_CST) > 0))
+         WaitPool(pool, events);
+   }
+}
@@ -0,0 +1,500 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       prefetch.c
+
+   Version:    V1.21
+   Date:       14.10.26
+   Function:   Read-ahead I/O thread for stdio trajectories
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   With --prefetch, text trajectories read with stdio get an I/O thread
+   which reads the file in large page-aligned blocks ahead of the
+   parser, so the next read from disk overlaps the parsing and the RMSD
+   and mean calculations on the frames already read.
+
+   The blocks are held in a ring which the I/O thread fills and the
+   reading thread empties. Each side only writes its own index (head
+   for the I/O thread, tail for the reader), so while there are blocks
+   ready and space to fill neither takes a lock. A block's start and
+   length are published by the release store of head, and the reader
+   only looks at them after an acquire load, so it never reads the
+   I/O thread's own position. A mutex and condition variable are used
+   only to sleep when the ring is empty or full.
+
+   The ring is wrapped as a FILE with fopencookie(), so fgets(),
+   ftello() and fseeko() in the readers work as before. A seek to a
+   block already in the ring just moves along it; any other seek stops
+   the I/O thread and starts it again from the new offset. Pipes can't
+   seek, but are read ahead in the same way.
+
+   Without fopencookie() (it is a GNU extension) the file is read with
+   plain stdio.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.21  14.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "flexcalc.h"
+
+/***********************************************************************/
+/* Defines and macros
+ */
+#define NPREFETCH     4            /* Blocks in the ring                */
+#define PREFETCHBLOCK (1024*1024)  /* Bytes read at a time              */
+#define PREFETCHALIGN 4096
+
+typedef struct
+{
+   char   *data;
+   size_t length;         /* Bytes read into data (0 at end of file)    */
+   off_t  start;          /* File offset of data[0]                     */
+}  BLOCK;
+
+typedef struct
+{
+   int             fd;
+   BOOL            seekable,      /* A regular file rather than a pipe  */
+                   running,       /* The I/O thread has been started    */
+                   stop,          /* Asks the I/O thread to finish      */
+                   eof,           /* Set by the I/O thread: the last    */
+                   failed;        /*    block has been read / an error  */
+                                  /*    (both atomic)                   */
+   BLOCK           blocks[NPREFETCH];
+   ULONG           head,          /* Blocks filled (I/O thread only)    */
+                   tail;          /* Blocks emptied (reader only)       */
+   size_t          used;          /* Bytes taken from block tail        */
+   off_t           next,          /* Where the I/O thread reads next    */
+                   pos;           /* Where the reader has got to        */
+   pthread_t       thread;
+   pthread_mutex_t lock;          /* Only for sleeping and stop         */
+   pthread_cond_t  changed;
+}  PREFETCH;
+
+/***********************************************************************/
+/* Globals
+ */
+/* Read text trajectories through a PREFETCH                           */
+BOOL gPrefetch = FALSE;
+
+#ifdef __GLIBC__
+
+/***********************************************************************/
+/* Prototypes
+ */
+static void    *IOThread(void *arg);
+static void    Wake(PREFETCH *pf);
+static BOOL    StartIO(PREFETCH *pf, off_t offset);
+static void    StopIO(PREFETCH *pf);
+static ssize_t PrefetchRead(void *cookie, char *buf, size_t size);
+static int     PrefetchSeek(void *cookie, off64_t *offset, int whence);
+static int     PrefetchClose(void *cookie);
+
+
+/***********************************************************************/
+/*>static void *IOThread(void *arg)
+   --------------------------------
+*//**
+   \param[in,out] *arg         the PREFETCH
+
+   Fills the ring until the end of the file, an error or a stop
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 failed is set atomically
+*/
+static void *IOThread(void *arg)
+{
+   PREFETCH *pf = (PREFETCH *)arg;
+
+   for(;;)
+   {
+      BLOCK   *block;
+      ssize_t nRead;
+      ULONG   head = pf->head;
+
+      /* Wait for a free block                                          */
+      if(head - __atomic_load_n(&(pf->tail), __ATOMIC_ACQUIRE) ==
+         NPREFETCH)
+      {
+         pthread_mutex_lock(&(pf->lock));
+         while(!pf->stop &&
+               (head - __atomic_load_n(&(pf->tail), __ATOMIC_ACQUIRE) ==
+                NPREFETCH))
+            pthread_cond_wait(&(pf->changed), &(pf->lock));
+         pthread_mutex_unlock(&(pf->lock));
+      }
+      if(__atomic_load_n(&(pf->stop), __ATOMIC_ACQUIRE))
+         break;
+
+      block = &(pf->blocks[head % NPREFETCH]);
+      do
+      {
+         nRead = (pf->seekable ?
+                  pread(pf->fd, block->data, PREFETCHBLOCK, pf->next) :
+                  read(pf->fd, block->data, PREFETCHBLOCK));
+      }  while((nRead < 0) && (errno == EINTR));
+
+      /* Published to the reader by the store of head                 */
+      block->start  = pf->next;
+      block->length = (nRead > 0) ? (size_t)nRead : 0;
+      pf->next     += block->length;
+      if(nRead <= 0)
+      {
+         if(nRead < 0)
+            __atomic_store_n(&(pf->failed), TRUE, __ATOMIC_RELEASE);
+         __atomic_store_n(&(pf->eof), TRUE, __ATOMIC_RELEASE);
+         Wake(pf);
+         break;
+      }
+
+      __atomic_store_n(&(pf->head), head+1, __ATOMIC_RELEASE);
+      Wake(pf);
+   }
+   return(NULL);
+}
+
+
+/***********************************************************************/
+/*>static void Wake(PREFETCH *pf)
+   ------------------------------
+*//**
+   \param[in,out] *pf          a PREFETCH
+
+   Wakes the other side if it is sleeping. Taking the lock means a
+   change can't be missed between its test and its wait.
+
+-  14.10.26 Original   By: ACRM
+*/
+static void Wake(PREFETCH *pf)
+{
+   pthread_mutex_lock(&(pf->lock));
+   pthread_cond_signal(&(pf->changed));
+   pthread_mutex_unlock(&(pf->lock));
+}
+
+
+/***********************************************************************/
+/*>static BOOL StartIO(PREFETCH *pf, off_t offset)
+   -----------------------------------------------
+*//**
+   \param[in,out] *pf          a PREFETCH with no I/O thread running
+   \param[in]     offset       where to start reading
+   \return                     Was the thread started?
+
+   Empties the ring and starts the I/O thread reading from offset
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Sets the reader's position
+*/
+static BOOL StartIO(PREFETCH *pf, off_t offset)
+{
+   pf->head   = 0;
+   pf->tail   = 0;
+   pf->used   = 0;
+   pf->next   = offset;
+   pf->pos    = offset;
+   pf->stop   = FALSE;
+   pf->eof    = FALSE;
+   pf->failed = FALSE;
+
+   pf->running = (pthread_create(&(pf->thread), NULL, IOThread, pf) == 0);
+   return(pf->running);
+}
+
+
+/***********************************************************************/
+/*>static void StopIO(PREFETCH *pf)
+   --------------------------------
+*//**
+   \param[in,out] *pf          a PREFETCH
+
+   Stops the I/O thread and waits for it
+
+-  14.10.26 Original   By: ACRM
+*/
+static void StopIO(PREFETCH *pf)
+{
+   if(pf->running)
+   {
+      pthread_mutex_lock(&(pf->lock));
+      __atomic_store_n(&(pf->stop), TRUE, __ATOMIC_RELEASE);
+      pthread_cond_signal(&(pf->changed));
+      pthread_mutex_unlock(&(pf->lock));
+      pthread_join(pf->thread, NULL);
+      pf->running = FALSE;
+   }
+}
+
+
+/***********************************************************************/
+/*>static ssize_t PrefetchRead(void *cookie, char *buf, size_t size)
+   -----------------------------------------------------------------
+*//**
+   \param[in,out] *cookie      the PREFETCH
+   \param[out]    *buf         buffer to fill
+   \param[in]     size         size of buf
+   \return                     bytes copied (0 at end of file, -1 on
+                               error)
+
+   The fopencookie() read function. Copies from the oldest block,
+   waiting for the I/O thread if there is none ready.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Keeps the reader's position. Reads failed atomically
+*/
+static ssize_t PrefetchRead(void *cookie, char *buf, size_t size)
+{
+   PREFETCH *pf = (PREFETCH *)cookie;
+   BLOCK    *block;
+   size_t   nCopy;
+
+   if(!pf->running)
+      return(-1);
+
+   /* Wait for a block                                                  */
+   if(__atomic_load_n(&(pf->head), __ATOMIC_ACQUIRE) == pf->tail)
+   {
+      pthread_mutex_lock(&(pf->lock));
+      while((__atomic_load_n(&(pf->head), __ATOMIC_ACQUIRE) == pf->tail)
+            && !__atomic_load_n(&(pf->eof), __ATOMIC_ACQUIRE))
+         pthread_cond_wait(&(pf->changed), &(pf->lock));
+      pthread_mutex_unlock(&(pf->lock));
+
+      if(__atomic_load_n(&(pf->head), __ATOMIC_ACQUIRE) == pf->tail)
+         return(__atomic_load_n(&(pf->failed), __ATOMIC_ACQUIRE) ?
+                -1 : 0);
+   }
+
+   block = &(pf->blocks[pf->tail % NPREFETCH]);
+   nCopy = block->length - pf->used;
+   if(nCopy > size)
+      nCopy = size;
+   memcpy(buf, block->data + pf->used, nCopy);
+   pf->pos += (off_t)nCopy;
+
+   /* Hand the block back once it is used up                            */
+   if((pf->used += nCopy) == block->length)
+   {
+      pf->used = 0;
+      __atomic_store_n(&(pf->tail), pf->tail+1, __ATOMIC_RELEASE);
+      Wake(pf);
+   }
+   return((ssize_t)nCopy);
+}
+
+
+/***********************************************************************/
+/*>static int PrefetchSeek(void *cookie, off64_t *offset, int whence)
+   ------------------------------------------------------------------
+*//**
+   \param[in,out] *cookie      the PREFETCH
+   \param[in,out] *offset      offset to seek to; set to the new
+                               position
+   \param[in]     whence       SEEK_SET, SEEK_CUR or SEEK_END
+   \return                     0 for success, -1 on failure
+
+   The fopencookie() seek function. stdio asks for the position with a
+   seek of 0 from SEEK_CUR, which costs nothing. A seek within the
+   blocks already read moves along the ring; otherwise reading starts
+   again from the new position.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 The position is the reader's own, not the I/O thread's
+*/
+static int PrefetchSeek(void *cookie, off64_t *offset, int whence)
+{
+   PREFETCH *pf = (PREFETCH *)cookie;
+   off_t    pos,
+            target;
+   ULONG    head,
+            n;
+
+   /* The position the reader has reached. The blocks up to head may
+      be looked at once it has been loaded
+   */
+   head = __atomic_load_n(&(pf->head), __ATOMIC_ACQUIRE);
+   pos  = pf->pos;
+
+   switch(whence)
+   {
+   case SEEK_SET:
+      target = *offset;
+      break;
+   case SEEK_CUR:
+      target = pos + *offset;
+      break;
+   case SEEK_END:
+   {
+      struct stat st;
+      if(fstat(pf->fd, &st) < 0)
+         return(-1);
+      target = st.st_size + *offset;
+      break;
+   }
+   default:
+      return(-1);
+   }
+
+   if(target == pos)
+   {
+      *offset = pos;
+      return(0);
+   }
+   if(!pf->seekable || (target < 0))
+      return(-1);
+
+   /* Move along the blocks already read                                */
+   for(n=pf->tail; n<head; n++)
+   {
+      BLOCK *block = &(pf->blocks[n % NPREFETCH]);
+
+      if((target >= block->start) &&
+         (target <  block->start + (off_t)block->length))
+      {
+         pf->used = (size_t)(target - block->start);
+         pf->pos  = target;
+         if(n != pf->tail)
+         {
+            __atomic_store_n(&(pf->tail), n, __ATOMIC_RELEASE);
+            Wake(pf);
+         }
+         *offset = target;
+         return(0);
+      }
+   }
+
+   StopIO(pf);
+   if(!StartIO(pf, target))
+      return(-1);
+   *offset = target;
+   return(0);
+}
+
+
+/***********************************************************************/
+/*>static int PrefetchClose(void *cookie)
+   --------------------------------------
+*//**
+   \param[in,out] *cookie      the PREFETCH
+   \return                     0 for success, -1 on failure
+
+   The fopencookie() close function. Stops the I/O thread and frees
+   everything.
+
+-  14.10.26 Original   By: ACRM
+*/
+static int PrefetchClose(void *cookie)
+{
+   PREFETCH *pf = (PREFETCH *)cookie;
+   int      i,
+            ret;
+
+   StopIO(pf);
+   ret = close(pf->fd);
+   for(i=0; i<NPREFETCH; i++)
+      free(pf->blocks[i].data);
+   pthread_mutex_destroy(&(pf->lock));
+   pthread_cond_destroy(&(pf->changed));
+   free(pf);
+   return(ret);
+}
+#endif
+
+
+/***********************************************************************/
+/*>FILE *OpenPrefetch(int fd)
+   --------------------------
+*//**
+   \param[in]  fd              a file or pipe open for reading
+   \return                     a FILE reading fd through an I/O thread
+                               (NULL on failure, in which case fd is
+                               closed)
+
+   Starts reading ahead from the current offset of fd. Closing the FILE
+   closes fd.
+
+-  14.10.26 Original   By: ACRM
+*/
+FILE *OpenPrefetch(int fd)
+{
+#ifdef __GLIBC__
+   static cookie_io_functions_t functions =
+   {
+      PrefetchRead, NULL, PrefetchSeek, PrefetchClose
+   };
+   PREFETCH    *pf;
+   FILE        *fp;
+   struct stat st;
+   off_t       offset;
+   int         i;
+
+   if((pf = (PREFETCH *)CountedCalloc(1, sizeof(PREFETCH)))==NULL)
+   {
+      close(fd);
+      return(NULL);
+   }
+   pf->fd       = fd;
+   pf->seekable = ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode));
+   pthread_mutex_init(&(pf->lock), NULL);
+   pthread_cond_init(&(pf->changed), NULL);
+
+   for(i=0; i<NPREFETCH; i++)
+   {
+      void *data;
+      if(posix_memalign(&data, PREFETCHALIGN, PREFETCHBLOCK) != 0)
+      {
+         PrefetchClose(pf);
+         return(NULL);
+      }
+      pf->blocks[i].data = (char *)data;
+   }
+
+   if(pf->seekable)
+   {
+      posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+      offset = lseek(fd, 0, SEEK_CUR);
+   }
+   else
+   {
+      offset = 0;
+   }
+
+   if(!StartIO(pf, offset) ||
+      ((fp = fopencookie(pf, "r", functions))==NULL))
+   {
+      PrefetchClose(pf);
+      return(NULL);
+   }
+   return(fp);
+#else
+   FILE *fp;
+
+   if((fp = fdopen(fd, "r"))==NULL)
+      close(fd);
+   return(fp);
+#endif
+}
@@ -0,0 +1,265 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       rmsf.c
+
+   Version:    V1.25
+   Date:       14.10.26
+   Function:   Per-atom RMS fluctuations
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   The RMS fluctuation of atom i is
+
+      RMSF(i) = sqrt(<|r(i)|^2> - |<r(i)>|^2)
+
+   The mean passes add each frame's squared coordinates, summed over x,
+   y and z, into an RMSF as they add the frame into the mean, so the
+   fluctuations come out of the same reading of the file. With --fit,
+   the last refinement cycle does the same with the fitted frames so
+   rigid-body motion is removed.
+
+   The threaded mean keeps an RMSF for each chunk and adds them
+   together in chunk order.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.17  14.10.26 Original
+   V1.23  14.10.26 Uses the mean's full-precision sums where it has them
+   V1.25  14.10.26 The RMSF being gathered is held by the TRAJ rather
+                   than gRMSF. Uses the frame's kernels
+
+*************************************************************************/
+/* Includes
+*/
+#include "flexcalc.h"
+
+/***********************************************************************/
+/* Prototypes
+ */
+static BOOL SizeRMSF(RMSF *rmsf, ULONG nAtoms);
+
+
+/***********************************************************************/
+/*>RMSF *AllocRMSF(void)
+   ---------------------
+*//**
+   \return                     an empty RMSF (NULL if no memory)
+
+-  14.10.26 Original   By: ACRM
+*/
+RMSF *AllocRMSF(void)
+{
+   RMSF *rmsf;
+
+   if((rmsf = (RMSF *)CountedMalloc(sizeof(RMSF)))!=NULL)
+   {
+      rmsf->sumSq    = NULL;
+      rmsf->nAtoms   = 0;
+      rmsf->maxAtoms = 0;
+      rmsf->nFrames  = 0;
+   }
+   return(rmsf);
+}
+
+
+/***********************************************************************/
+/*>void FreeRMSF(RMSF *rmsf)
+   -------------------------
+*//**
+   \param[in]  *rmsf           an RMSF (may be NULL)
+
+-  14.10.26 Original   By: ACRM
+*/
+void FreeRMSF(RMSF *rmsf)
+{
+   if(rmsf != NULL)
+   {
+      free(rmsf->sumSq);
+      free(rmsf);
+   }
+}
+
+
+/***********************************************************************/
+/*>void ResetRMSF(RMSF *rmsf)
+   --------------------------
+*//**
+   \param[in,out] *rmsf        an RMSF
+
+   Empties an RMSF at the start of a pass. It is sized again from the
+   next frame added.
+
+-  14.10.26 Original   By: ACRM
+*/
+void ResetRMSF(RMSF *rmsf)
+{
+   rmsf->nAtoms  = 0;
+   rmsf->nFrames = 0;
+}
+
+
+/***********************************************************************/
+/*>static BOOL SizeRMSF(RMSF *rmsf, ULONG nAtoms)
+   ----------------------------------------------
+*//**
+   \param[in,out] *rmsf        an RMSF
+   \param[in]     nAtoms       number of atoms
+   \return                     FALSE if no memory
+
+   Sizes the sums for nAtoms atoms and zeroes them
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL SizeRMSF(RMSF *rmsf, ULONG nAtoms)
+{
+   if(nAtoms > rmsf->maxAtoms)
+   {
+      REAL *sumSq;
+
+      if((sumSq = (REAL *)CountedRealloc(rmsf->sumSq,
+                                         nAtoms * sizeof(REAL)))==NULL)
+         return(FALSE);
+      rmsf->sumSq    = sumSq;
+      rmsf->maxAtoms = nAtoms;
+   }
+   rmsf->nAtoms = nAtoms;
+   memset(rmsf->sumSq, 0, nAtoms * sizeof(REAL));
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>BOOL AddSquares(RMSF *rmsf, COORDS *frame)
+   ------------------------------------------
+*//**
+   \param[in,out] *rmsf        an RMSF
+   \param[in]     *frame       a frame already added to the mean
+   \return                     FALSE if no memory or the number of
+                               atoms does not match
+
+   Adds a frame's squared coordinates
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Uses the frame's kernels
+*/
+BOOL AddSquares(RMSF *rmsf, COORDS *frame)
+{
+   if(rmsf->nFrames == 0)
+   {
+      if(!SizeRMSF(rmsf, frame->nAtoms))
+         return(FALSE);
+   }
+   else if(frame->nAtoms != rmsf->nAtoms)
+   {
+      return(FALSE);
+   }
+
+   frame->kernels->addSquares(rmsf->sumSq, frame->x, frame->y, frame->z,
+                              rmsf->nAtoms);
+   rmsf->nFrames++;
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>BOOL MergeRMSF(RMSF *rmsf, RMSF *part)
+   --------------------------------------
+*//**
+   \param[in,out] *rmsf        an RMSF
+   \param[in]     *part        another for later frames of the same
+                               trajectory
+   \return                     FALSE if no memory or the number of
+                               atoms does not match
+
+   Adds the squares gathered in part into rmsf
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL MergeRMSF(RMSF *rmsf, RMSF *part)
+{
+   ULONG i;
+
+   if(part->nFrames == 0)
+      return(TRUE);
+   if(rmsf->nFrames == 0)
+   {
+      if(!SizeRMSF(rmsf, part->nAtoms))
+         return(FALSE);
+   }
+   else if(part->nAtoms != rmsf->nAtoms)
+   {
+      return(FALSE);
+   }
+
+   for(i=0; i<rmsf->nAtoms; i++)
+      rmsf->sumSq[i] += part->sumSq[i];
+   rmsf->nFrames += part->nFrames;
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>BOOL WriteRMSF(char *filename, RMSF *rmsf, COORDS *meanFrame,
+                  SELECTION *select)
+   -------------------------------------------------------------
+*//**
+   \param[in]  *filename       file to write
+   \param[in]  *rmsf           squares gathered with the mean
+   \param[in]  *meanFrame      the mean they were gathered with
+   \param[in]  *select         the atom selection (NULL for all)
+   \return                     Was the file written?
+
+   Writes one line for each atom used, giving its number from 1 in the
+   trajectory's frames and its RMSF. The squared mean is subtracted from
+   the mean square, so the mean is taken from its sums, which are REAL
+   even with SINGLE_COORDS.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Uses the mean's sums
+*/
+BOOL WriteRMSF(char *filename, RMSF *rmsf, COORDS *meanFrame,
+               SELECTION *select)
+{
+   FILE  *fp;
+   ULONG i,
+         atom = 0;
+   BOOL  ok;
+
+   if((rmsf->nAtoms != meanFrame->nAtoms) || (rmsf->nFrames == 0) ||
+      ((fp = fopen(filename, "w"))==NULL))
+      return(FALSE);
+
+   for(i=0; i<rmsf->nAtoms; i++)
+   {
+      REAL x   = HASSUMS(meanFrame) ? SUMX(meanFrame)[i] : meanFrame->x[i],
+           y   = HASSUMS(meanFrame) ? SUMY(meanFrame)[i] : meanFrame->y[i],
+           z   = HASSUMS(meanFrame) ? SUMZ(meanFrame)[i] : meanFrame->z[i],
+           msf = rmsf->sumSq[i] / rmsf->nFrames - (x*x + y*y + z*z);
+
+      /* The number of this atom in the frame                          */
+      while(!SELECTED(select, atom))
+         atom++;
+      atom++;
+
+      /* Rounding can make a fixed atom's fluctuation slightly negative */
+      fprintf(fp, "%lu %.4f\n", atom, ((msf > 0.0) ? sqrt(msf) : 0.0));
+   }
+
+   ok = !ferror(fp);
+   if(fclose(fp) != 0)
+      ok = FALSE;
+   return(ok);
+}
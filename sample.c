@@ -0,0 +1,227 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       sample.c
+
+   Version:    V1.30
+   Date:       14.10.26
+   Function:   Random samples of frames and bootstrap intervals
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   With --sample n, SampleTrajFrames() picks n of the frames in the
+   window at random and puts them in the TRAJ, where they replace the
+   window (trajio.c). Every pass then reads only those frames, seeking
+   to each through the index, so a run costs about the same however
+   long the trajectory is. The frames are chosen with Knuth's selection
+   sampling (Algorithm S), which takes each frame in turn with the
+   probability that keeps exactly n and gives them in order without
+   storing anything else. This only needs the frame count, not the
+   frames.
+
+   The score is then the mean RMSD of the sampled frames from the
+   sampled frame closest to their mean. BootstrapInterval() estimates
+   how far that is from the score for the whole trajectory by
+   resampling the sample's RMSDs, with replacement, NBOOTSTRAP times
+   and taking the 2.5% and 97.5% points of the resampled means. It
+   ignores the uncertainty in the mean and closest frame themselves,
+   so is a little narrow for very small samples.
+
+   The random numbers come from SplitMix64, seeded with --seed, so a
+   run is repeatable and a batch run gives the same results whichever
+   thread takes each trajectory.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.30  14.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdint.h>
+#include "flexcalc.h"
+
+/***********************************************************************/
+/* Prototypes
+ */
+static uint64_t NextRandom(uint64_t *state);
+static REAL RandomReal(uint64_t *state);
+static int CompareReal(const void *value1, const void *value2);
+
+
+/***********************************************************************/
+/*>BOOL SampleTrajFrames(TRAJ *traj, FRAMEINDEX *index, ULONG nSample,
+                         ULONG seed)
+   -------------------------------------------------------------------
+*//**
+   \param[in,out] *traj        an open trajectory with its window set
+                               (and any frames left out by
+                               SkipBadFrames())
+   \param[in]     *index       its frame index
+   \param[in]     nSample      number of frames to choose
+   \param[in]     seed         seed for the random numbers
+   \return                     FALSE if no memory
+
+   Chooses nSample of the frames in the window at random (all of them
+   if there are no more) and puts them in traj->sample, so that
+   ReadTrajFrame() and the window functions use only them. The caller
+   frees traj->sample.
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL SampleTrajFrames(TRAJ *traj, FRAMEINDEX *index, ULONG nSample,
+                      ULONG seed)
+{
+   uint64_t state  = (uint64_t)seed;
+   ULONG    *sample,
+            nFrames,
+            nChosen = 0,
+            p;
+
+   traj->sample  = NULL;
+   traj->nSample = 0;
+   if((nFrames = WindowFrameCount(traj, index->nFrames)) < nSample)
+      nSample = nFrames;
+   if(nSample == 0)
+      return(TRUE);
+
+   if((sample = (ULONG *)CountedMalloc(nSample * sizeof(ULONG)))==NULL)
+      return(FALSE);
+
+   /* Take window position p with probability (still needed) / (still
+      left). traj->sample is only set at the end as it changes
+      WindowFrameNum()
+   */
+   for(p=0; (p<nFrames) && (nChosen<nSample); p++)
+   {
+      if((nFrames - p) * RandomReal(&state) < (REAL)(nSample - nChosen))
+         sample[nChosen++] = WindowFrameNum(traj, p);
+   }
+   traj->sample  = sample;
+   traj->nSample = nChosen;
+
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>BOOL BootstrapInterval(REAL *rmsds, ULONG nFrames, ULONG seed,
+                          REAL *interval)
+   --------------------------------------------------------------
+*//**
+   \param[in]  *rmsds          the RMSD of each sampled frame
+   \param[in]  nFrames         number of frames sampled
+   \param[in]  seed            seed for the random numbers
+   \param[out] *interval       the lower and upper ends of the 95%
+                               interval of their mean
+   \return                     FALSE if no memory
+
+   Finds the percentile bootstrap interval of the mean RMSD from
+   NBOOTSTRAP resamples of the frames
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL BootstrapInterval(REAL *rmsds, ULONG nFrames, ULONG seed,
+                       REAL *interval)
+{
+   uint64_t state = ~(uint64_t)seed;   /* Not the sample's numbers      */
+   REAL     *means;
+   ULONG    i,
+            j,
+            k;
+
+   interval[0] = interval[1] = -1.0;
+   if(nFrames == 0)
+      return(TRUE);
+   if((means = (REAL *)CountedMalloc(NBOOTSTRAP * sizeof(REAL)))==NULL)
+      return(FALSE);
+
+   for(i=0; i<NBOOTSTRAP; i++)
+   {
+      REAL sum = 0.0;
+
+      for(j=0; j<nFrames; j++)
+      {
+         if((k = (ULONG)(RandomReal(&state) * nFrames)) >= nFrames)
+            k = nFrames - 1;
+         sum += rmsds[k];
+      }
+      means[i] = sum / nFrames;
+   }
+
+   qsort(means, NBOOTSTRAP, sizeof(REAL), CompareReal);
+   interval[0] = means[NBOOTSTRAP / 40];
+   interval[1] = means[NBOOTSTRAP - 1 - NBOOTSTRAP / 40];
+   free(means);
+
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>static uint64_t NextRandom(uint64_t *state)
+   -------------------------------------------
+*//**
+   \param[in,out] *state       the generator's state
+   \return                     the next 64-bit random number
+
+   SplitMix64 (Steele, Lea and Flood, 2014)
+
+-  14.10.26 Original   By: ACRM
+*/
+static uint64_t NextRandom(uint64_t *state)
+{
+   uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+
+   z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+   z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+   return(z ^ (z >> 31));
+}
+
+
+/***********************************************************************/
+/*>static REAL RandomReal(uint64_t *state)
+   ---------------------------------------
+*//**
+   \param[in,out] *state       the generator's state
+   \return                     a random number in [0, 1)
+
+   Uses the top 53 bits, which a double holds exactly
+
+-  14.10.26 Original   By: ACRM
+*/
+static REAL RandomReal(uint64_t *state)
+{
+   return((REAL)(NextRandom(state) >> 11) * (1.0 / 9007199254740992.0));
+}
+
+
+/***********************************************************************/
+/*>static int CompareReal(const void *value1, const void *value2)
+   --------------------------------------------------------------
+*//**
+   \param[in]  *value1         pointer to a REAL
+   \param[in]  *value2         pointer to a REAL
+   \return                     qsort() comparison for ascending order
+
+-  14.10.26 Original   By: ACRM
+*/
+static int CompareReal(const void *value1, const void *value2)
+{
+   REAL v1 = *(const REAL *)value1,
+        v2 = *(const REAL *)value2;
+
+   return((v1 < v2) ? -1 : ((v1 > v2) ? 1 : 0));
+}
@@ -0,0 +1,255 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       select.c
+
+   Version:    V1.13
+   Date:       14.10.26
+   Function:   Atom selections for flexcalc
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   A SELECTION is given by --atoms as a list of atom numbers and ranges
+   (counting from 1 within each frame) such as "1-100,205,300-". A
+   range with no end runs to the end of the frame. With --atoms-file
+   the same list is read from a file, where the items may also be
+   separated by white space or newlines and '#' starts a comment.
+
+   The selection is held as a mask of the atoms up to the last listed
+   one plus the start of any open-ended range. The readers test each
+   coordinate line against it with SELECTED() and skip unselected
+   lines without parsing them, so only the selected atoms are stored.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.13  14.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <ctype.h>
+#include "flexcalc.h"
+
+/***********************************************************************/
+/* Prototypes
+ */
+static BOOL SelectRange(SELECTION *select, ULONG first, ULONG last);
+
+
+/***********************************************************************/
+/*>SELECTION *AllocSelection(void)
+   -------------------------------
+*//**
+   \return                     an empty selection (or NULL if no
+                               memory)
+
+-  14.10.26 Original   By: ACRM
+*/
+SELECTION *AllocSelection(void)
+{
+   SELECTION *select;
+
+   if((select = (SELECTION *)CountedMalloc(sizeof(SELECTION)))!=NULL)
+   {
+      select->mask    = NULL;
+      select->nMask   = 0;
+      select->allFrom = ULONG_MAX;
+   }
+   return(select);
+}
+
+
+/***********************************************************************/
+/*>void FreeSelection(SELECTION *select)
+   -------------------------------------
+*//**
+   \param[in]  *select         a selection (may be NULL)
+
+-  14.10.26 Original   By: ACRM
+*/
+void FreeSelection(SELECTION *select)
+{
+   if(select != NULL)
+   {
+      free(select->mask);
+      free(select);
+   }
+}
+
+
+/***********************************************************************/
+/*>static BOOL SelectRange(SELECTION *select, ULONG first, ULONG last)
+   -------------------------------------------------------------------
+*//**
+   \param[in,out] *select      the selection
+   \param[in]     first        first atom to select (from 0)
+   \param[in]     last         last atom to select (ULONG_MAX for the
+                               end of the frame)
+   \return                     FALSE if memory allocation failed
+
+   Adds a range of atoms to the mask, growing it to cover them
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL SelectRange(SELECTION *select, ULONG first, ULONG last)
+{
+   ULONG i;
+
+   if(last == ULONG_MAX)
+   {
+      if(first < select->allFrom)
+         select->allFrom = first;
+      return(TRUE);
+   }
+
+   if(last >= select->nMask)
+   {
+      char *mask;
+
+      if((mask = (char *)CountedRealloc(select->mask, last+1))==NULL)
+         return(FALSE);
+      memset(mask + select->nMask, 0, last+1 - select->nMask);
+      select->mask  = mask;
+      select->nMask = last+1;
+   }
+
+   for(i=first; i<=last; i++)
+      select->mask[i] = 1;
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>BOOL ParseSelection(SELECTION *select, char *spec)
+   --------------------------------------------------
+*//**
+   \param[in,out] *select      the selection to add to
+   \param[in]     *spec        atom numbers and ranges from 1, e.g.
+                               "1-100,205,300-", separated by commas
+                               or white space
+   \return                     Was the list valid?
+
+   Adds a list of atoms to a selection
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL ParseSelection(SELECTION *select, char *spec)
+{
+   char *p = spec;
+
+   while(*p)
+   {
+      ULONG first, last;
+      char  *end;
+
+      if((*p == ',') || isspace((unsigned char)*p))
+      {
+         p++;
+         continue;
+      }
+      if(!isdigit((unsigned char)*p))
+         return(FALSE);
+
+      first = last = strtoul(p, &end, 10);
+      p     = end;
+      if(*p == '-')
+      {
+         p++;
+         if(isdigit((unsigned char)*p))
+         {
+            last = strtoul(p, &end, 10);
+            p    = end;
+         }
+         else
+         {
+            last = ULONG_MAX;
+         }
+      }
+
+      if((first < 1) || (last < first) ||
+         ((*p != '\0') && (*p != ',') && !isspace((unsigned char)*p)))
+         return(FALSE);
+      if(!SelectRange(select, first-1,
+                      (last == ULONG_MAX) ? ULONG_MAX : last-1))
+      {
+         Msg(MSG_NOMEM, " (atom selection)");
+         return(FALSE);
+      }
+   }
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>BOOL ReadSelectionFile(SELECTION *select, char *filename)
+   ---------------------------------------------------------
+*//**
+   \param[in,out] *select      the selection to add to
+   \param[in]     *filename    file of atom numbers and ranges
+   \return                     Was the file read and valid?
+
+   Adds the atoms listed in a file to a selection. Each line is as for
+   ParseSelection() with anything after a '#' ignored.
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL ReadSelectionFile(SELECTION *select, char *filename)
+{
+   FILE *fp;
+   char buffer[MAXBUFF],
+        *hash;
+   BOOL ok = TRUE;
+
+   if((fp = fopen(filename, "r"))==NULL)
+      return(FALSE);
+
+   while(ok && fgets(buffer, MAXBUFF, fp))
+   {
+      if((hash = strchr(buffer, '#')) != NULL)
+         *hash = '\0';
+      ok = ParseSelection(select, buffer);
+   }
+   fclose(fp);
+
+   return(ok);
+}
+
+
+
+/***********************************************************************/
+/*>ULONG CountSelected(SELECTION *select, ULONG nAtoms)
+   ----------------------------------------------------
+*//**
+   \param[in]  *select         a selection (NULL for all atoms)
+   \param[in]  nAtoms          atoms in a frame
+   \return                     the number of those atoms selected
+
+-  14.10.26 Original   By: ACRM
+*/
+ULONG CountSelected(SELECTION *select, ULONG nAtoms)
+{
+   ULONG i,
+         count = 0;
+
+   if(select == NULL)
+      return(nAtoms);
+
+   for(i=0; i<nAtoms; i++)
+   {
+      if(SELECTED(select, i))
+         count++;
+   }
+   return(count);
+}
@@ -0,0 +1,260 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       series.c
+
+   Version:    V1.25
+   Date:       14.10.26
+   Function:   Per-frame RMSD series output
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   Writes the RMSD of every frame from the frame closest to the mean as
+   it is calculated in the last pass, so the series is never held in
+   memory. Output goes through a large stdio buffer.
+
+   The text form has one line per frame:
+
+      frame rmsd header
+
+   where frame counts from 1 in the trajectory (so reflects --start and
+   --stride) and header is the frame header without its '>'.
+
+   The binary form, in native byte order, is:
+
+      char     magic[8]     "FCRMSDS1"
+
+   followed by a record for each frame:
+
+      uint64_t frame
+      double   rmsd
+      uint32_t length       length of the header
+      char     header[length]  (not NUL-terminated, no '>')
+
+   With threads, each chunk writes its records to its own temporary
+   part file and the parts are appended to the output in chunk order
+   at the end of the pass, so the series is in frame order.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.16  14.10.26 Original
+   V1.25  14.10.26 The series being written is held by the TRAJ rather
+                   than gSeries
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdint.h>
+#include <unistd.h>
+#include "flexcalc.h"
+
+/***********************************************************************/
+/* Defines and macros
+ */
+#define SERIES_MAGIC    "FCRMSDS1"
+#define SERIES_MAGICLEN 8
+#define SERIESBUFF      (1024*1024)  /* stdio buffer for each file      */
+#define COPYBUFF        65536        /* Block size to append parts      */
+#define PARTNAME        "flexcalcXXXXXX"
+
+/***********************************************************************/
+/* Prototypes
+ */
+static SERIES *NewSeries(FILE *fp, BOOL binary);
+
+
+/***********************************************************************/
+/*>static SERIES *NewSeries(FILE *fp, BOOL binary)
+   -----------------------------------------------
+*//**
+   \param[in]  *fp             the open file
+   \param[in]  binary          write binary records
+   \return                     the series (NULL if no memory, in which
+                               case fp is closed)
+
+   Wraps a file as a SERIES and gives it a large buffer
+
+-  14.10.26 Original   By: ACRM
+*/
+static SERIES *NewSeries(FILE *fp, BOOL binary)
+{
+   SERIES *series;
+
+   if(((series = (SERIES *)CountedMalloc(sizeof(SERIES)))==NULL) ||
+      ((series->buffer = (char *)CountedMalloc(SERIESBUFF))==NULL))
+   {
+      free(series);
+      fclose(fp);
+      return(NULL);
+   }
+   series->fp     = fp;
+   series->binary = binary;
+   setvbuf(fp, series->buffer, _IOFBF, SERIESBUFF);
+   return(series);
+}
+
+
+/***********************************************************************/
+/*>SERIES *OpenSeries(char *filename, BOOL binary)
+   -----------------------------------------------
+*//**
+   \param[in]  *filename       file to write
+   \param[in]  binary          write binary records
+   \return                     the series (NULL on failure)
+
+   Creates a series file
+
+-  14.10.26 Original   By: ACRM
+*/
+SERIES *OpenSeries(char *filename, BOOL binary)
+{
+   FILE   *fp;
+   SERIES *series;
+
+   if((fp = fopen(filename, (binary ? "wb" : "w")))==NULL)
+      return(NULL);
+   if((series = NewSeries(fp, binary))==NULL)
+      return(NULL);
+   if(binary)
+      fwrite(SERIES_MAGIC, 1, SERIES_MAGICLEN, fp);
+   return(series);
+}
+
+
+/***********************************************************************/
+/*>SERIES *OpenSeriesPart(SERIES *series)
+   --------------------------------------
+*//**
+   \param[in]  *series         the series the part belongs to
+   \return                     an empty part (NULL on failure)
+
+   Creates a temporary part file, in $TMPDIR, for one chunk's records.
+   It is deleted when it is closed.
+
+-  14.10.26 Original   By: ACRM
+*/
+SERIES *OpenSeriesPart(SERIES *series)
+{
+   char partFile[MAXFNM],
+        *tmpDir;
+   int  fd;
+   FILE *fp;
+
+   if(((tmpDir = getenv("TMPDIR"))==NULL) || (tmpDir[0] == '\0'))
+      tmpDir = "/tmp";
+   snprintf(partFile, MAXFNM, "%s/%s", tmpDir, PARTNAME);
+   if((fd = mkstemp(partFile)) < 0)
+      return(NULL);
+   unlink(partFile);
+
+   if((fp = fdopen(fd, "w+b"))==NULL)
+   {
+      close(fd);
+      return(NULL);
+   }
+   return(NewSeries(fp, series->binary));
+}
+
+
+/***********************************************************************/
+/*>void WriteSeries(SERIES *series, ULONG frameNum, char *header,
+                    REAL rmsd)
+   --------------------------------------------------------------
+*//**
+   \param[in,out] *series      the series
+   \param[in]     frameNum     frame number (from 1)
+   \param[in]     *header      the frame header
+   \param[in]     rmsd         its RMSD
+
+   Writes the record for one frame. Errors are reported by
+   CloseSeries().
+
+-  14.10.26 Original   By: ACRM
+*/
+void WriteSeries(SERIES *series, ULONG frameNum, char *header, REAL rmsd)
+{
+   if(header[0] == '>')
+      header++;
+
+   if(series->binary)
+   {
+      uint64_t frame  = frameNum;
+      double   value  = rmsd;
+      uint32_t length = strlen(header);
+
+      fwrite(&frame,  sizeof(frame),  1, series->fp);
+      fwrite(&value,  sizeof(value),  1, series->fp);
+      fwrite(&length, sizeof(length), 1, series->fp);
+      fwrite(header,  1, length, series->fp);
+   }
+   else
+   {
+      fprintf(series->fp, "%lu %.4f %s\n", frameNum, rmsd, header);
+   }
+}
+
+
+/***********************************************************************/
+/*>BOOL AppendSeries(SERIES *series, SERIES *part)
+   -----------------------------------------------
+*//**
+   \param[in,out] *series      the series
+   \param[in]     *part        a part from OpenSeriesPart()
+   \return                     Were the records copied?
+
+   Appends a part's records to the series
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL AppendSeries(SERIES *series, SERIES *part)
+{
+   char   buffer[COPYBUFF];
+   size_t nRead;
+
+   if((fflush(part->fp) != 0) || (fseek(part->fp, 0, SEEK_SET) != 0))
+      return(FALSE);
+
+   while((nRead = fread(buffer, 1, COPYBUFF, part->fp)) > 0)
+   {
+      if(fwrite(buffer, 1, nRead, series->fp) != nRead)
+         return(FALSE);
+   }
+   return(!ferror(part->fp));
+}
+
+
+/***********************************************************************/
+/*>BOOL CloseSeries(SERIES *series)
+   --------------------------------
+*//**
+   \param[in]  *series         a series or part (may be NULL)
+   \return                     Was everything written?
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL CloseSeries(SERIES *series)
+{
+   BOOL ok;
+
+   if(series == NULL)
+      return(TRUE);
+
+   ok = !ferror(series->fp);
+   if(fclose(series->fp) != 0)
+      ok = FALSE;
+   free(series->buffer);
+   free(series);
+   return(ok);
+}
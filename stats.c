@@ -0,0 +1,480 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       stats.c
+
+   Version:    V1.11
+   Date:       14.10.26
+   Function:   Per-pass timing and counters
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   Counts the bytes and lines read, frames read and memory allocations,
+   and records these with the wall and CPU time and peak resident set
+   size at the end of each pass. The readers add their counts once per
+   frame (with relaxed atomic adds, since several threads may be
+   reading) and allocations go through CountedMalloc() etc., so the
+   statistics are always collected and --stats, --stats-json and
+   --timing only decide whether they are printed.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.11  14.10.26 Original - replaces ReportTime() in flexcalc.c
+
+*************************************************************************/
+/* Includes
+*/
+#include <sys/resource.h>
+#include "flexcalc.h"
+
+/***********************************************************************/
+/* Defines and macros
+ */
+#define MAXPASSES 16
+#define ATOMICADD(var, n) __atomic_fetch_add(&(var), (n), __ATOMIC_RELAXED)
+#define ATOMICGET(var)    __atomic_load_n(&(var), __ATOMIC_RELAXED)
+
+/* Running totals                                                       */
+typedef struct
+{
+   ULONG bytes,
+         lines,
+         frames,
+         allocs;
+}  COUNTERS;
+
+/* The statistics for one pass                                          */
+typedef struct
+{
+   char     *name;
+   REAL     wallTime,
+            cpuTime;
+   COUNTERS counts;
+   long     peakRSS;      /* kB                                         */
+}  PASSSTATS;
+
+/***********************************************************************/
+/* Globals
+ */
+static COUNTERS  sCounters    = {0, 0, 0, 0};
+static COUNTERS  sPassCounts  = {0, 0, 0, 0};
+static PASSSTATS sPasses[MAXPASSES];
+static int       sNPasses     = 0;
+static REAL      sStartWall   = 0.0,
+                 sStartCPU    = 0.0,
+                 sPassWall    = 0.0,
+                 sPassCPU     = 0.0;
+
+/***********************************************************************/
+/* Prototypes
+ */
+static REAL CPUTime(void);
+static long PeakRSS(void);
+static void Snapshot(COUNTERS *counts);
+static void PrintStatsLine(FILE *out, PASSSTATS *pass);
+static void PrintJSONString(FILE *out, char *string);
+static void PrintJSONPass(FILE *out, PASSSTATS *pass);
+static void TotalStats(PASSSTATS *total);
+
+
+/***********************************************************************/
+/*>REAL WallTime(void)
+   --------------------
+*//**
+   \return                     elapsed (monotonic) time in seconds
+
+-  14.10.26 Original   By: ACRM
+*/
+REAL WallTime(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return((REAL)ts.tv_sec + (REAL)ts.tv_nsec / 1e9);
+}
+
+
+/***********************************************************************/
+/*>static REAL CPUTime(void)
+   -------------------------
+*//**
+   \return                     CPU time used by all threads in seconds
+
+-  14.10.26 Original   By: ACRM
+*/
+static REAL CPUTime(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+   return((REAL)ts.tv_sec + (REAL)ts.tv_nsec / 1e9);
+}
+
+
+/***********************************************************************/
+/*>static long PeakRSS(void)
+   -------------------------
+*//**
+   \return                     peak resident set size so far in kB
+
+-  14.10.26 Original   By: ACRM
+*/
+static long PeakRSS(void)
+{
+   struct rusage usage;
+
+   if(getrusage(RUSAGE_SELF, &usage) < 0)
+      return(0);
+   return(usage.ru_maxrss);
+}
+
+
+/***********************************************************************/
+/*>static void Snapshot(COUNTERS *counts)
+   --------------------------------------
+*//**
+   \param[out] *counts         the current totals
+
+-  14.10.26 Original   By: ACRM
+*/
+static void Snapshot(COUNTERS *counts)
+{
+   counts->bytes  = ATOMICGET(sCounters.bytes);
+   counts->lines  = ATOMICGET(sCounters.lines);
+   counts->frames = ATOMICGET(sCounters.frames);
+   counts->allocs = ATOMICGET(sCounters.allocs);
+}
+
+
+/***********************************************************************/
+/*>void StartStats(void)
+   ---------------------
+*//**
+   Starts the clocks. Called at the start of main().
+
+-  14.10.26 Original   By: ACRM
+*/
+void StartStats(void)
+{
+   sStartWall = sPassWall = WallTime();
+   sStartCPU  = sPassCPU  = CPUTime();
+   Snapshot(&sPassCounts);
+   sNPasses = 0;
+}
+
+
+/***********************************************************************/
+/*>void EndPass(char *name)
+   ------------------------
+*//**
+   \param[in]  *name           name of the pass (a constant string)
+
+   Records the statistics for the pass that has just finished and
+   starts the next
+
+-  14.10.26 Original   By: ACRM
+*/
+void EndPass(char *name)
+{
+   COUNTERS  now;
+   PASSSTATS *pass;
+   REAL      wall = WallTime(),
+             cpu  = CPUTime();
+
+   Snapshot(&now);
+   if(sNPasses < MAXPASSES)
+   {
+      pass                = &(sPasses[sNPasses++]);
+      pass->name          = name;
+      pass->wallTime      = wall - sPassWall;
+      pass->cpuTime       = cpu  - sPassCPU;
+      pass->counts.bytes  = now.bytes  - sPassCounts.bytes;
+      pass->counts.lines  = now.lines  - sPassCounts.lines;
+      pass->counts.frames = now.frames - sPassCounts.frames;
+      pass->counts.allocs = now.allocs - sPassCounts.allocs;
+      pass->peakRSS       = PeakRSS();
+   }
+
+   sPassWall   = wall;
+   sPassCPU    = cpu;
+   sPassCounts = now;
+}
+
+
+/***********************************************************************/
+/*>void CountRead(ULONG bytes, ULONG lines, ULONG frames)
+   ------------------------------------------------------
+*//**
+   \param[in]  bytes           bytes read
+   \param[in]  lines           coordinate lines parsed
+   \param[in]  frames          frames read
+
+   Called by the readers once per frame (or once per counting pass).
+   Safe to call from several threads.
+
+-  14.10.26 Original   By: ACRM
+*/
+void CountRead(ULONG bytes, ULONG lines, ULONG frames)
+{
+   ATOMICADD(sCounters.bytes,  bytes);
+   ATOMICADD(sCounters.lines,  lines);
+   ATOMICADD(sCounters.frames, frames);
+}
+
+
+/***********************************************************************/
+/*>void *CountedMalloc(size_t size)
+   --------------------------------
+*//**
+   \param[in]  size            bytes to allocate
+   \return                     as malloc()
+
+   malloc() which counts the allocation
+
+-  14.10.26 Original   By: ACRM
+*/
+void *CountedMalloc(size_t size)
+{
+   ATOMICADD(sCounters.allocs, 1);
+   return(malloc(size));
+}
+
+
+/***********************************************************************/
+/*>void *CountedCalloc(size_t n, size_t size)
+   ------------------------------------------
+*//**
+   \param[in]  n               number of items
+   \param[in]  size            size of each item
+   \return                     as calloc()
+
+   calloc() which counts the allocation
+
+-  14.10.26 Original   By: ACRM
+*/
+void *CountedCalloc(size_t n, size_t size)
+{
+   ATOMICADD(sCounters.allocs, 1);
+   return(calloc(n, size));
+}
+
+
+/***********************************************************************/
+/*>void *CountedRealloc(void *ptr, size_t size)
+   --------------------------------------------
+*//**
+   \param[in]  *ptr            memory to resize (or NULL)
+   \param[in]  size            new size
+   \return                     as realloc()
+
+   realloc() which counts the allocation
+
+-  14.10.26 Original   By: ACRM
+*/
+void *CountedRealloc(void *ptr, size_t size)
+{
+   ATOMICADD(sCounters.allocs, 1);
+   return(realloc(ptr, size));
+}
+
+
+/***********************************************************************/
+/*>static void TotalStats(PASSSTATS *total)
+   ----------------------------------------
+*//**
+   \param[out] *total          statistics for the whole run
+
+-  14.10.26 Original   By: ACRM
+*/
+static void TotalStats(PASSSTATS *total)
+{
+   total->name     = "total";
+   total->wallTime = sPassWall - sStartWall;
+   total->cpuTime  = sPassCPU  - sStartCPU;
+   total->peakRSS  = PeakRSS();
+   Snapshot(&(total->counts));
+}
+
+
+/***********************************************************************/
+/*>void PrintTiming(FILE *out, ULONG nFrames)
+   ------------------------------------------
+*//**
+   \param[in]  *out            output file
+   \param[in]  nFrames         frames in the trajectory
+
+   Prints the wall time for each pass as "timing <pass> <seconds>"
+   lines (as read by t/bench.sh)
+
+-  14.10.26 Original   By: ACRM
+*/
+void PrintTiming(FILE *out, ULONG nFrames)
+{
+   PASSSTATS total;
+   int       i;
+
+   for(i=0; i<sNPasses; i++)
+      fprintf(out, "timing %s %.6f\n", sPasses[i].name,
+              sPasses[i].wallTime);
+   TotalStats(&total);
+   fprintf(out, "timing total %.6f\n", total.wallTime);
+   fprintf(out, "timing frames %lu\n", nFrames);
+}
+
+
+/***********************************************************************/
+/*>static void PrintStatsLine(FILE *out, PASSSTATS *pass)
+   ------------------------------------------------------
+*//**
+   \param[in]  *out            output file
+   \param[in]  *pass           statistics for a pass
+
+-  14.10.26 Original   By: ACRM
+*/
+static void PrintStatsLine(FILE *out, PASSSTATS *pass)
+{
+   fprintf(out, "%-8s %9.3f %9.3f %13lu %11lu %9lu %7lu %10ld\n",
+           pass->name, pass->wallTime, pass->cpuTime, pass->counts.bytes,
+           pass->counts.lines, pass->counts.frames, pass->counts.allocs,
+           pass->peakRSS);
+}
+
+
+/***********************************************************************/
+/*>void PrintStats(FILE *out)
+   --------------------------
+*//**
+   \param[in]  *out            output file
+
+   Prints a table of the statistics for each pass and the total
+
+-  14.10.26 Original   By: ACRM
+*/
+void PrintStats(FILE *out)
+{
+   PASSSTATS total;
+   int       i;
+
+   fprintf(out, "%-8s %9s %9s %13s %11s %9s %7s %10s\n",
+           "pass", "wall(s)", "cpu(s)", "bytes", "lines", "frames",
+           "allocs", "peakRSS(kB)");
+   for(i=0; i<sNPasses; i++)
+      PrintStatsLine(out, &(sPasses[i]));
+   TotalStats(&total);
+   PrintStatsLine(out, &total);
+}
+
+
+/***********************************************************************/
+/*>static void PrintJSONString(FILE *out, char *string)
+   ----------------------------------------------------
+*//**
+   \param[in]  *out            output file
+   \param[in]  *string         string to print as a quoted JSON string
+
+-  14.10.26 Original   By: ACRM
+*/
+static void PrintJSONString(FILE *out, char *string)
+{
+   unsigned char *c;
+
+   fputc('"', out);
+   for(c=(unsigned char *)string; *c; c++)
+   {
+      if((*c == '"') || (*c == '\\'))
+         fprintf(out, "\\%c", *c);
+      else if(*c < 0x20)
+         fprintf(out, "\\u%04x", *c);
+      else
+         fputc(*c, out);
+   }
+   fputc('"', out);
+}
+
+
+/***********************************************************************/
+/*>static void PrintJSONPass(FILE *out, PASSSTATS *pass)
+   -----------------------------------------------------
+*//**
+   \param[in]  *out            output file
+   \param[in]  *pass           statistics for a pass
+
+-  14.10.26 Original   By: ACRM
+*/
+static void PrintJSONPass(FILE *out, PASSSTATS *pass)
+{
+   fprintf(out, "{\"name\": ");
+   PrintJSONString(out, pass->name);
+   fprintf(out, ", \"wall_s\": %.6f, \"cpu_s\": %.6f, \"bytes\": %lu, \
+\"lines\": %lu, \"frames\": %lu, \"allocs\": %lu, \"peak_rss_kb\": %ld}",
+           pass->wallTime, pass->cpuTime, pass->counts.bytes,
+           pass->counts.lines, pass->counts.frames, pass->counts.allocs,
+           pass->peakRSS);
+}
+
+
+/***********************************************************************/
+/*>BOOL WriteStatsJSON(char *jsonFile, OPTIONS *options, ULONG nFrames,
+                       REAL result)
+   --------------------------------------------------------------------
+*//**
+   \param[in]  *jsonFile       file to write
+   \param[in]  *options        the options for the run
+   \param[in]  nFrames         frames in the trajectory
+   \param[in]  result          the mean RMSD
+   \return                     Was the file written?
+
+   Writes the statistics as a JSON report
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL WriteStatsJSON(char *jsonFile, OPTIONS *options, ULONG nFrames,
+                    REAL result)
+{
+   FILE      *out;
+   PASSSTATS total;
+   int       i;
+   BOOL      ok;
+
+   if((out = fopen(jsonFile, "w"))==NULL)
+      return(FALSE);
+
+   fprintf(out, "{\n  \"program\": \"%s\",\n  \"trajectory\": ", PROGNAME);
+   PrintJSONString(out, options->inFile);
+   fprintf(out, ",\n  \"passes\": %d,\n  \"threads\": %d,\n",
+           options->nPasses, options->nThreads);
+   fprintf(out, "  \"mmap\": %s,\n  \"kernel\": ",
+           (options->useMmap ? "true" : "false"));
+   PrintJSONString(out, gKernels.name);
+   fprintf(out, ",\n  \"frames\": %lu,\n  \"mean_rmsd\": %.6f,\n",
+           nFrames, result);
+
+   fprintf(out, "  \"pass_stats\": [\n");
+   for(i=0; i<sNPasses; i++)
+   {
+      fprintf(out, "    ");
+      PrintJSONPass(out, &(sPasses[i]));
+      fprintf(out, "%s\n", ((i < sNPasses-1) ? "," : ""));
+   }
+   TotalStats(&total);
+   fprintf(out, "  ],\n  \"total\": ");
+   PrintJSONPass(out, &total);
+   fprintf(out, "\n}\n");
+
+   ok = !ferror(out);
+   if(fclose(out) != 0)
+      ok = FALSE;
+   return(ok);
+}
@@ -0,0 +1,125 @@
+#!/bin/sh
+#*************************************************************************
+#
+#   Program:    bench.sh
+#   File:       bench.sh
+#
+#   Version:    V1.0
+#   Date:       14.10.26
+#   Function:   Benchmark flexcalc over its reader, kernel and thread
+#               configurations
+#
+#   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+#   Author:     Prof. Andrew C. R. Martin
+#   EMail:      andrew@bioinf.org.uk
+#
+#*************************************************************************
+#
+#   Licensed under the GPL V3.0. See the LICENCE file.
+#
+#*************************************************************************
+#
+#   Description:
+#   ============
+#   Generates a trajectory with maketraj (unless one is given), converts
+#   it to the binary format and runs flexcalc --timing for each
+#   configuration. Each configuration is run REPEATS times and the
+#   fastest run is reported, as one line per configuration with the
+#   time for each pass, the total, MB/s (size of the file read divided
+#   by the total time) and frames/s. The RMSD is shown so that changes
+#   in the results are seen too.
+#
+#   Environment variables:
+#      FLEXCALC  flexcalc executable       (default ./flexcalc)
+#      MAKETRAJ  maketraj executable       (default ./t/maketraj)
+#      FRAMES    frames to generate        (default 10000)
+#      ATOMS     atoms to generate         (default 250)
+#      THREADS   thread counts to try      (default "1 <ncpus>")
+#      REPEATS   runs of each config       (default 3)
+#      BENCHDIR  scratch directory         (default /tmp)
+#
+#   Usage:
+#   ======
+#   bench.sh [trajectory]
+#
+#*************************************************************************
+#
+#   Revision History:
+#   =================
+#   V1.0   14.10.26 Original
+#
+#*************************************************************************
+FLEXCALC=${FLEXCALC:-./flexcalc}
+MAKETRAJ=${MAKETRAJ:-./t/maketraj}
+FRAMES=${FRAMES:-10000}
+ATOMS=${ATOMS:-250}
+REPEATS=${REPEATS:-3}
+BENCHDIR=${BENCHDIR:-/tmp}
+NCPU=`getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1`
+if [ "$NCPU" -gt 1 ]; then
+    THREADS=${THREADS:-"1 $NCPU"}
+else
+    THREADS=${THREADS:-1}
+fi
+
+if [ $# -gt 0 ]; then
+    TEXT=$1
+else
+    TEXT=$BENCHDIR/flexcalc_bench_${FRAMES}x${ATOMS}.dat
+    if [ ! -f $TEXT ]; then
+        $MAKETRAJ -f $FRAMES -a $ATOMS $TEXT || exit 1
+    fi
+fi
+BINARY=$BENCHDIR/flexcalc_bench_$$.fcb
+trap 'rm -f $BINARY' 0 1 2 15
+$FLEXCALC convert $TEXT $BINARY || exit 1
+
+# Runs one configuration and prints the fastest run
+# $1 = label, $2 = trajectory, remaining arguments are flexcalc options
+Run()
+{
+    label=$1
+    file=$2
+    shift 2
+    bytes=`wc -c < $file`
+    best=""
+    besttotal=""
+    i=0
+    while [ $i -lt $REPEATS ]; do
+        out=`$FLEXCALC --timing "$@" $file 2>&1` || { echo "$label FAILED"; return; }
+        total=`echo "$out" | awk '$1=="timing" && $2=="total" {print $3}'`
+        if [ -z "$besttotal" ] || \
+           awk "BEGIN {exit !($total < $besttotal)}"; then
+            best=$out
+            besttotal=$total
+        fi
+        i=`expr $i + 1`
+    done
+    echo "$best" | awk -v label="$label" -v bytes=$bytes '
+        $1=="timing" { t[$2] = $3; next }
+        { rmsd = $1 }
+        END {
+            printf("%-26s %8.3f %8.3f %8.3f %8.3f %8.3f %9.1f %10.0f %s\n",
+                   label, t["count"]+t["index"], t["mean"], t["closest"],
+                   t["rmsd"], t["total"], bytes/1e6/t["total"],
+                   t["frames"]/t["total"], rmsd)
+        }'
+}
+
+echo "flexcalc benchmark: $TEXT (best of $REPEATS)"
+printf "%-26s %8s %8s %8s %8s %8s %9s %10s %s\n" \
+       "config" "count" "mean" "closest" "rmsd" "total" "MB/s" "frames/s" \
+       "result"
+
+for kernel in scalar auto; do
+    Run "stdio k=$kernel"         $TEXT   -k $kernel
+    Run "mmap k=$kernel"          $TEXT   -m -k $kernel
+    Run "binary k=$kernel"        $BINARY -k $kernel
+    Run "binary-mmap k=$kernel"   $BINARY -m -k $kernel
+    Run "mmap k=$kernel p=3"      $TEXT   -m -p 3 -k $kernel
+    Run "mmap k=$kernel p=2"      $TEXT   -m -p 2 -k $kernel
+    for t in $THREADS; do
+        Run "mmap k=$kernel t=$t"        $TEXT   -m -t $t -k $kernel
+        Run "binary-mmap k=$kernel t=$t" $BINARY -m -t $t -k $kernel
+    done
+done
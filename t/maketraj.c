@@ -0,0 +1,409 @@
+/*************************************************************************
+
+   Program:    maketraj
+   File:       maketraj.c
+
+   Version:    V1.0
+   Date:       14.10.26
+   Function:   Generate synthetic trajectories for testing flexcalc
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   A faster and more flexible replacement for maketest.pl. Writes a
+   trajectory with a given number of frames and atoms and a given
+   number of decimal places.
+
+   In uniform mode every coordinate is random in a box, as with
+   maketest.pl. In Brownian mode (the default) the atoms form a chain
+   with 3.8A steps, like a protein's C-alpha atoms. Each atom then
+   fluctuates about its position with an Ornstein-Uhlenbeck process
+   (so the motion is correlated from frame to frame with a given
+   RMS fluctuation) and the whole chain drifts by a random walk.
+
+   A self-contained random number generator is used so the same seed
+   gives the same trajectory on any machine.
+
+**************************************************************************
+
+   Usage:
+   ======
+   maketraj [-f frames] [-a atoms] [-d decimals] [-s seed] [-u]
+            [-b box] [-r rms] [-c correlation] [-w walk] [outfile]
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   14.10.26 Original
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/***********************************************************************/
+/* Defines and macros
+ */
+#define CHAINSTEP 3.8     /* C-alpha to C-alpha distance                */
+#define TWOPI     6.283185307179586
+
+typedef struct
+{
+   unsigned long frames,
+                 atoms,
+                 seed;
+   int           decimals;
+   int           uniform;
+   double        box,     /* Box size for uniform coordinates           */
+                 rms,     /* RMS fluctuation of each atom               */
+                 corr,    /* Frame to frame correlation (0-1)           */
+                 walk;    /* RMS step of the whole chain per frame      */
+}  GENOPTIONS;
+
+/***********************************************************************/
+/* Globals
+ */
+static unsigned long long sRandState = 1;
+
+/***********************************************************************/
+/* Prototypes
+ */
+int main(int argc, char **argv);
+static int ParseCmdLine(int argc, char **argv, GENOPTIONS *options,
+                        char *outFile);
+static double Uniform(void);
+static double Gaussian(void);
+static void WriteUniform(FILE *out, GENOPTIONS *options);
+static void WriteBrownian(FILE *out, GENOPTIONS *options);
+static void Usage(void);
+
+
+/***********************************************************************/
+/*>int main(int argc, char **argv)
+   -------------------------------
+*//**
+   Main program
+
+-  14.10.26 Original   By: ACRM
+*/
+int main(int argc, char **argv)
+{
+   GENOPTIONS options;
+   char       outFile[BUFSIZ];
+   FILE       *out = stdout;
+
+   if(!ParseCmdLine(argc, argv, &options, outFile))
+   {
+      Usage();
+      return(0);
+   }
+
+   if(outFile[0] && ((out = fopen(outFile, "w"))==NULL))
+   {
+      fprintf(stderr, "maketraj error: Unable to write %s\n", outFile);
+      return(1);
+   }
+
+   sRandState = options.seed ? options.seed : 1;
+   if(options.uniform)
+      WriteUniform(out, &options);
+   else
+      WriteBrownian(out, &options);
+
+   if((out != stdout) ? (fclose(out) != 0) : (fflush(out) != 0))
+   {
+      fprintf(stderr, "maketraj error: Write failed\n");
+      return(1);
+   }
+   return(0);
+}
+
+
+/***********************************************************************/
+/*>static int ParseCmdLine(int argc, char **argv, GENOPTIONS *options,
+                           char *outFile)
+   -------------------------------------------------------------------
+*//**
+   \param[in]  argc            Argument count
+   \param[in]  argv            Argument array
+   \param[out] *options        Options
+   \param[out] *outFile        Output file (blank for stdout)
+   \return                     Command line OK?
+
+-  14.10.26 Original   By: ACRM
+*/
+static int ParseCmdLine(int argc, char **argv, GENOPTIONS *options,
+                        char *outFile)
+{
+   argc--; argv++;
+
+   options->frames   = 10000;
+   options->atoms    = 250;
+   options->seed     = 1;
+   options->decimals = 3;
+   options->uniform  = 0;
+   options->box      = 50.0;
+   options->rms      = 1.0;
+   options->corr     = 0.95;
+   options->walk     = 0.05;
+   outFile[0]        = '\0';
+
+   while(argc)
+   {
+      if((argv[0][0] == '-') && (argv[0][1] != '\0'))
+      {
+         char opt = argv[0][1];
+
+         if(opt == 'u')
+         {
+            options->uniform = 1;
+            argc--; argv++;
+            continue;
+         }
+
+         /* All the other options take a value                         */
+         argc--; argv++;
+         if(!argc)
+            return(0);
+         switch(opt)
+         {
+         case 'f':
+            options->frames   = strtoul(argv[0], NULL, 10);
+            break;
+         case 'a':
+            options->atoms    = strtoul(argv[0], NULL, 10);
+            break;
+         case 's':
+            options->seed     = strtoul(argv[0], NULL, 10);
+            break;
+         case 'd':
+            options->decimals = atoi(argv[0]);
+            break;
+         case 'b':
+            options->box      = atof(argv[0]);
+            break;
+         case 'r':
+            options->rms      = atof(argv[0]);
+            break;
+         case 'c':
+            options->corr     = atof(argv[0]);
+            break;
+         case 'w':
+            options->walk     = atof(argv[0]);
+            break;
+         default:
+            return(0);
+         }
+      }
+      else
+      {
+         if(argc > 1)
+            return(0);
+         strncpy(outFile, argv[0], BUFSIZ-1);
+         outFile[BUFSIZ-1] = '\0';
+      }
+      argc--; argv++;
+   }
+
+   return((options->frames > 0) && (options->atoms > 0) &&
+          (options->decimals >= 0) && (options->decimals <= 15) &&
+          (options->corr >= 0.0) && (options->corr < 1.0));
+}
+
+
+/***********************************************************************/
+/*>static double Uniform(void)
+   ---------------------------
+*//**
+   \return                     a random number in [0,1)
+
+   xorshift64* generator
+
+-  14.10.26 Original   By: ACRM
+*/
+static double Uniform(void)
+{
+   sRandState ^= sRandState >> 12;
+   sRandState ^= sRandState << 25;
+   sRandState ^= sRandState >> 27;
+   return((double)((sRandState * 2685821657736338717ULL) >> 11) /
+          9007199254740992.0);
+}
+
+
+/***********************************************************************/
+/*>static double Gaussian(void)
+   ----------------------------
+*//**
+   \return                     a normally distributed random number
+                               (mean 0, SD 1)
+
+   Box-Muller transform
+
+-  14.10.26 Original   By: ACRM
+*/
+static double Gaussian(void)
+{
+   double u = 1.0 - Uniform(),             /* (0,1] so log() is safe    */
+          v = Uniform();
+
+   return(sqrt(-2.0 * log(u)) * cos(TWOPI * v));
+}
+
+
+/***********************************************************************/
+/*>static void WriteUniform(FILE *out, GENOPTIONS *options)
+   --------------------------------------------------------
+*//**
+   \param[in]  *out            output file
+   \param[in]  *options        options
+
+   Writes frames of uniformly random coordinates (as maketest.pl)
+
+-  14.10.26 Original   By: ACRM
+*/
+static void WriteUniform(FILE *out, GENOPTIONS *options)
+{
+   unsigned long frame, atom;
+   int           d = options->decimals;
+
+   for(frame=0; frame<options->frames; frame++)
+   {
+      fprintf(out, ">%lu\n", frame);
+      for(atom=0; atom<options->atoms; atom++)
+      {
+         double x = options->box * Uniform(),
+                y = options->box * Uniform(),
+                z = options->box * Uniform();
+         fprintf(out, "%.*f %.*f %.*f\n", d, x, d, y, d, z);
+      }
+   }
+}
+
+
+/***********************************************************************/
+/*>static void WriteBrownian(FILE *out, GENOPTIONS *options)
+   ---------------------------------------------------------
+*//**
+   \param[in]  *out            output file
+   \param[in]  *options        options
+
+   Writes frames of a chain fluctuating about its starting positions
+   and drifting as a whole
+
+-  14.10.26 Original   By: ACRM
+*/
+static void WriteBrownian(FILE *out, GENOPTIONS *options)
+{
+   unsigned long frame, atom,
+                 n = 3 * options->atoms,
+                 i;
+   double        *base, *dev,
+                 shift[3] = {0.0, 0.0, 0.0},
+                 noise    = options->rms *
+                            sqrt(1.0 - options->corr * options->corr),
+                 walk     = options->walk / sqrt(3.0);
+   int           d = options->decimals;
+
+   if(((base = (double *)malloc(n * sizeof(double)))==NULL) ||
+      ((dev  = (double *)malloc(n * sizeof(double)))==NULL))
+   {
+      fprintf(stderr, "maketraj error: No memory\n");
+      exit(1);
+   }
+
+   /* A random chain starting at the origin                            */
+   for(atom=0; atom<options->atoms; atom++)
+   {
+      double step[3], len;
+
+      do
+      {
+         for(i=0; i<3; i++)
+            step[i] = Gaussian();
+         len = sqrt(step[0]*step[0] + step[1]*step[1] + step[2]*step[2]);
+      }  while(len < 1e-6);
+
+      for(i=0; i<3; i++)
+      {
+         base[3*atom+i] = (atom ? base[3*(atom-1)+i] : 0.0) +
+                          CHAINSTEP * step[i] / len;
+         dev[3*atom+i]  = options->rms * Gaussian();
+      }
+   }
+
+   for(frame=0; frame<options->frames; frame++)
+   {
+      fprintf(out, ">frame %lu\n", frame);
+      for(i=0; i<3; i++)
+         shift[i] += walk * Gaussian();
+
+      for(atom=0; atom<options->atoms; atom++)
+      {
+         double *b = base + 3*atom,
+                *v = dev  + 3*atom;
+
+         for(i=0; i<3; i++)
+            v[i] = options->corr * v[i] + noise * Gaussian();
+         fprintf(out, "%.*f %.*f %.*f\n",
+                 d, b[0] + v[0] + shift[0],
+                 d, b[1] + v[1] + shift[1],
+                 d, b[2] + v[2] + shift[2]);
+      }
+   }
+
+   free(base);
+   free(dev);
+}
+
+
+/***********************************************************************/
+/*>static void Usage(void)
+   -----------------------
+*//**
+   Print usage message
+
+-  14.10.26 Original   By: ACRM
+*/
+static void Usage(void)
+{
+   printf("\nmaketraj V1.0 (c) Andrew C.R. Martin, abYinformatics\n");
+
+   printf("\nUsage: maketraj [-f frames] [-a atoms] [-d decimals] \
+[-s seed] [-u]\n");
+   printf("                [-b box] [-r rms] [-c correlation] [-w walk] \
+[outfile]\n");
+   printf("       -f  Number of frames (default 10000)\n");
+   printf("       -a  Number of atoms (default 250)\n");
+   printf("       -d  Decimal places (default 3)\n");
+   printf("       -s  Random number seed (default 1)\n");
+   printf("       -u  Uniformly random coordinates in a box rather than \
+a Brownian\n");
+   printf("           chain\n");
+   printf("       -b  Box size for -u (default 50)\n");
+   printf("       -r  RMS fluctuation of each atom (default 1.0)\n");
+   printf("       -c  Correlation of each atom's fluctuation from one \
+frame to\n");
+   printf("           the next (0-1, default 0.95)\n");
+   printf("       -w  RMS step of the whole chain per frame (default \
+0.05)\n");
+
+   printf("\nWrites a synthetic trajectory for testing and \
+benchmarking flexcalc\n");
+   printf("to outfile or standard output. The same seed always gives \
+the same\n");
+   printf("trajectory.\n\n");
+}
@@ -0,0 +1,110 @@
+#!/bin/sh
+#*************************************************************************
+#
+#   Program:    precision.sh
+#   File:       precision.sh
+#
+#   Version:    V1.0
+#   Date:       14.10.26
+#   Function:   Check the SINGLE_COORDS build against the double build
+#
+#   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+#   Author:     Prof. Andrew C. R. Martin
+#   EMail:      andrew@bioinf.org.uk
+#
+#*************************************************************************
+#
+#   Licensed under the GPL V3.0. See the LICENCE file.
+#
+#*************************************************************************
+#
+#   Description:
+#   ============
+#   Generates trajectories with maketraj and runs both builds on each
+#   with each set of options in CONFIGS. The scores are taken from
+#   --stats-json, which gives them to 6 decimal places, and each pair
+#   must agree to within BOUND (1.1e-4A, the bound on the change in an
+#   RMSD from rounding coordinates below 512A to float). One line is
+#   printed for each run with the difference, and the exit status is 1
+#   if any is out of bounds or fails.
+#
+#   The trajectories are a Brownian chain, one with larger
+#   fluctuations, a uniform box near the 512A limit and one with 1
+#   decimal place.
+#
+#   Environment variables:
+#      FLEXCALC        double build          (default ./flexcalc)
+#      FLEXCALCSINGLE  SINGLE_COORDS build   (default ./flexcalc-single)
+#      MAKETRAJ        maketraj executable   (default ./t/maketraj)
+#      FRAMES          frames to generate    (default 1000)
+#      ATOMS           atoms to generate     (default 203)
+#      BOUND           allowed difference    (default 1.1e-4)
+#      TESTDIR         scratch directory     (default /tmp)
+#
+#   Usage:
+#   ======
+#   precision.sh
+#
+#*************************************************************************
+#
+#   Revision History:
+#   =================
+#   V1.0   14.10.26 Original
+#
+#*************************************************************************
+FLEXCALC=${FLEXCALC:-./flexcalc}
+FLEXCALCSINGLE=${FLEXCALCSINGLE:-./flexcalc-single}
+MAKETRAJ=${MAKETRAJ:-./t/maketraj}
+FRAMES=${FRAMES:-1000}
+ATOMS=${ATOMS:-203}
+BOUND=${BOUND:-1.1e-4}
+TESTDIR=${TESTDIR:-/tmp}
+CONFIGS="-k_scalar -m -p_2 -p_3 -t_4 --fit --stride_3"
+
+WORK=$TESTDIR/flexcalc_precision_$$
+trap 'rm -rf $WORK' 0 1 2 15
+mkdir -p $WORK || exit 1
+
+$MAKETRAJ -f $FRAMES -a $ATOMS -s 1 $WORK/chain.traj                 || exit 1
+$MAKETRAJ -f $FRAMES -a $ATOMS -s 2 -r 3.0 -w 0.5 $WORK/loose.traj  || exit 1
+$MAKETRAJ -f $FRAMES -a $ATOMS -s 3 -u -b 500 $WORK/box.traj        || exit 1
+$MAKETRAJ -f $FRAMES -a $ATOMS -s 4 -d 1 $WORK/coarse.traj          || exit 1
+
+# Prints the score from --stats-json
+# $1 = executable, $2 = trajectory, remaining arguments are options
+Score()
+{
+    exe=$1
+    file=$2
+    shift 2
+    $exe --stats-json $WORK/stats.json "$@" $file > /dev/null || return 1
+    sed -n 's/.*"mean_rmsd": *\([-0-9.e]*\).*/\1/p' $WORK/stats.json
+}
+
+status=0
+printf "%-12s %-10s %10s %10s %10s\n" \
+       "trajectory" "options" "double" "single" "difference"
+for traj in chain loose box coarse; do
+    for config in $CONFIGS; do
+        options=`echo $config | tr '_' ' '`
+        double=`Score $FLEXCALC $WORK/$traj.traj $options`
+        single=`Score $FLEXCALCSINGLE $WORK/$traj.traj $options`
+        if [ -z "$double" ] || [ -z "$single" ]; then
+            echo "$traj $options FAILED"
+            status=1
+            continue
+        fi
+        awk -v t=$traj -v o="$options" -v d=$double -v s=$single \
+            -v b=$BOUND 'BEGIN {
+                diff = (d > s) ? d - s : s - d
+                printf("%-12s %-10s %10.6f %10.6f %10.6f%s\n", t, o,
+                       d, s, diff, (diff > b) ? "  OUT OF BOUNDS" : "")
+                exit(diff > b)
+            }' || status=1
+    done
+done
+
+if [ $status -eq 0 ]; then
+    echo "All scores within $BOUND"
+fi
+exit $status
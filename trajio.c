@@ -0,0 +1,1837 @@
+/*************************************************************************
+
+   Program:    flexcalc
+   File:       trajio.c
+
+   Version:    V1.30
+   Date:       14.10.26
+   Function:   Trajectory input for flexcalc
+
+   Copyright:  (c) Prof. Andrew C. R. Martin, abYinformatics, 2025
+   Author:     Prof. Andrew C. R. Martin
+   EMail:      andrew@bioinf.org.uk
+
+**************************************************************************
+
+   Licensed under the GPL V3.0. See the LICENCE file.
+
+**************************************************************************
+
+   Description:
+   ============
+   Opens a trajectory either for reading with stdio (using ReadFrame()
+   and CountFrames() in flexcalc.c) or by memory mapping the whole
+   file. Each TRAJ holds all of its reading state, so any number may be
+   read at once, from one thread each.
+
+   The memory-mapped reader scans the mapping directly for '>' headers
+   and newlines and parses the coordinates in place with ParseReal(),
+   so no coordinate line is ever copied and rewinding the file between
+   passes costs nothing - the page cache does the buffering.
+
+   Standard input ("-") and gzip or zstd compressed files can't be
+   rewound, so they are read once by SpillTraj() and written to a
+   temporary binary trajectory (fcbio.c) which is used for all the
+   passes. Compressed files are read through a gzip or zstd process.
+
+   With --skip-bad, SkipBadFrames() finds the frames in the window
+   whose atom count differs from the rest and the window functions
+   leave them out, so every pass and every thread sees the same
+   frames. An empty frame, or the lines before the first header, are
+   counted with no atoms so they are left out too. The index only
+   counts the coordinate lines, so the readers check the lines of the
+   selected atoms with ParseCoords() and SkipBadFrames() reads every
+   frame once to find those with one that can't be read.
+   MsgBadFrame() reports a bad frame with its byte offset and why it
+   is bad.
+   With --sample the window is replaced by a list of the frames chosen
+   by SampleTrajFrames() (sample.c) in the same way.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.3   14.10.26 Original
+   V1.4   14.10.26 Counting can fill in a FRAMEINDEX. Added SeekTraj()
+   V1.5   14.10.26 Added DupTraj() and ReadIndexedFrame() so threads
+                   can each read their own part of a trajectory
+   V1.8   14.10.26 Binary trajectories (fcbio.c) are recognised when
+                   opened and read through the same functions
+   V1.9   14.10.26 Added streamed input from stdin and compressed
+                   files (OpenStreamTraj() and SpillTraj())
+   V1.11  14.10.26 The readers count the bytes and lines read for
+                   --stats
+   V1.13  14.10.26 The readers only parse the atoms in the TRAJ's
+                   SELECTION
+   V1.14  14.10.26 ReadTrajFrame() only returns the frames in the
+                   TRAJ's window, seeking over the others with the
+                   index where there is one
+   V1.20  14.10.26 The stdio reader's state is held in the TRAJ, so
+                   each TRAJ, including a DupTraj() copy, is an
+                   independent reader
+   V1.21  14.10.26 stdio trajectories can be read ahead by an I/O
+                   thread (prefetch.c)
+   V1.23  14.10.26 Coordinates are parsed as REAL and stored as COORD
+   V1.24  14.10.26 Frames read get the kernels for the trajectory's
+                   atom count
+   V1.25  14.10.26 Trajectories in memory (memtraj.c) are read through
+                   the same functions. A TRAJ carries the kernels, fit
+                   option, RMSFs and series of its calculation
+   V1.29  14.10.26 Frames that don't match can be left out of the
+                   window (SkipBadFrames()). Text readers record the
+                   offset of each frame for MsgBadFrame(). Every
+                   selected line must have three numbers, and a
+                   stream is spilled with just the selected atoms
+   V1.30  14.10.26 The window can be replaced by a sample of frames
+
+*************************************************************************/
+/* Includes
+*/
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "flexcalc.h"
+
+/***********************************************************************/
+/* Defines and macros
+ */
+#define ISDIGIT(c) ((unsigned)((c) - '0') < 10)
+#define MAXDIGITS  15     /* Any integer with this many digits is held
+                             exactly in a double                        */
+#define MAXNUMBUFF 64
+#define MAXMAGIC   4
+#define SPILLNAME  "flexcalcXXXXXX"
+
+/***********************************************************************/
+/* Globals
+ */
+/* Every power of ten up to 1e22 is exactly representable in a double  */
+static const REAL sPowersOf10[] =
+{
+   1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+   1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21,
+   1e22
+};
+
+/***********************************************************************/
+/* Prototypes
+ */
+static BOOL ReadNextFrame(TRAJ *traj, char *header, COORDS *frame);
+static BOOL SkipTrajFrames(TRAJ *traj, ULONG frameNum, COORDS *frame);
+static BOOL IsSkipped(TRAJ *traj, ULONG n);
+static BOOL SetFrameKernels(TRAJ *traj, COORDS *frame);
+
+
+/***********************************************************************/
+/*>TRAJ *OpenTraj(char *filename, BOOL useMmap)
+   --------------------------------------------
+*//**
+   \param[in]  *filename       the trajectory file
+   \param[in]  useMmap         memory map the file rather than using
+                               stdio
+   \return                     the open trajectory, or NULL on failure
+
+   Opens a trajectory file. With gPrefetch set, a file read with stdio
+   is read ahead by an I/O thread.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Recognises binary trajectories
+-  14.10.26 Reads ahead with gPrefetch
+*/
+TRAJ *OpenTraj(char *filename, BOOL useMmap)
+{
+   TRAJ *traj;
+
+   if((traj = (TRAJ *)CountedMalloc(sizeof(TRAJ)))==NULL)
+      return(NULL);
+
+   traj->fp           = NULL;
+   traj->data         = NULL;
+   traj->size         = 0;
+   traj->pos          = 0;
+   traj->mapped       = useMmap;
+   traj->shared       = FALSE;
+   traj->binary       = FALSE;
+   traj->memory       = FALSE;
+   traj->frames       = NULL;
+   traj->maxFrames    = 0;
+   traj->buffer       = NULL;
+   traj->headers      = NULL;
+   traj->frameOffset  = NULL;
+   traj->headerOffset = NULL;
+   traj->nFrames      = 0;
+   traj->stream       = FALSE;
+   traj->pid          = 0;
+   traj->select       = NULL;
+   traj->kept         = NULL;
+   traj->frameStart   = -1;
+   traj->skipBad      = FALSE;
+   traj->badFrame     = FRAME_OK;
+   traj->skip         = NULL;
+   traj->nSkip        = 0;
+   traj->sample       = NULL;
+   traj->nSample      = 0;
+   traj->frameNum     = 0;
+   traj->index        = NULL;
+   traj->kernelSet    = NULL;
+   traj->kernels      = NULL;
+   traj->kernelAtoms  = 0;
+   traj->fit          = FALSE;
+   traj->rmsf         = NULL;
+   traj->series       = NULL;
+   traj->firstEntry   = TRUE;
+   traj->lineLength   = 0;
+   SetTrajWindow(traj, 0, ULONG_MAX, 1);
+   strncpy(traj->filename, filename, MAXFNM-1);
+   traj->filename[MAXFNM-1] = '\0';
+
+   if(useMmap)
+   {
+      struct stat st;
+      int         fd;
+
+      if((fd = open(filename, O_RDONLY)) < 0)
+      {
+         free(traj);
+         return(NULL);
+      }
+      if(fstat(fd, &st) < 0)
+      {
+         close(fd);
+         free(traj);
+         return(NULL);
+      }
+
+      /* An empty file can't be mapped, but simply has no frames       */
+      if((traj->size = (size_t)st.st_size) > 0)
+      {
+         void *data;
+         if((data = mmap(NULL, traj->size, PROT_READ, MAP_PRIVATE,
+                         fd, 0)) == MAP_FAILED)
+         {
+            close(fd);
+            free(traj);
+            return(NULL);
+         }
+         traj->data = (char *)data;
+         madvise(data, traj->size, MADV_SEQUENTIAL);
+      }
+
+      /* The mapping stays valid once the file is closed               */
+      close(fd);
+   }
+   else if(gPrefetch)
+   {
+      int fd;
+
+      if(((fd = open(filename, O_RDONLY)) < 0) ||
+         ((traj->fp = OpenPrefetch(fd))==NULL))
+      {
+         free(traj);
+         return(NULL);
+      }
+   }
+   else if((traj->fp = fopen(filename, "r"))==NULL)
+   {
+      free(traj);
+      return(NULL);
+   }
+
+   /* Binary trajectories are recognised from their magic number       */
+   if(IsFcbTraj(traj) && !OpenFcb(traj))
+   {
+      CloseTraj(traj);
+      return(NULL);
+   }
+
+   return(traj);
+}
+
+
+/***********************************************************************/
+/*>void CloseTraj(TRAJ *traj)
+   --------------------------
+*//**
+   \param[in]  *traj           an open trajectory
+
+   Closes a trajectory file and frees the TRAJ structure
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Handles binary trajectories
+-  14.10.26 Handles streams
+-  14.10.26 Resets the TRAJ's reading state
+-  14.10.26 Handles trajectories in memory
+*/
+void CloseTraj(TRAJ *traj)
+{
+   if(traj != NULL)
+   {
+      if(traj->binary)
+         CloseFcb(traj);
+      if(traj->memory)
+         CloseMemoryTraj(traj);
+      if(traj->stream)
+         FinishStream(traj);
+      if(traj->fp != NULL)
+         fclose(traj->fp);
+      if((traj->data != NULL) && !traj->shared)
+         munmap(traj->data, traj->size);
+      free(traj);
+   }
+}
+
+
+/***********************************************************************/
+/*>void RewindTraj(TRAJ *traj)
+   ---------------------------
+*//**
+   \param[in]  *traj           an open trajectory
+
+   Goes back to the start of the trajectory and resets the frame
+   reading
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Handles binary trajectories
+-  14.10.26 Handles streams
+-  14.10.26 Handles trajectories in memory
+-  14.10.26 Resets the stdio offset
+*/
+void RewindTraj(TRAJ *traj)
+{
+   traj->frameNum = 0;
+   if(traj->binary || traj->memory)
+   {
+      return;
+   }
+   else if(traj->mapped)
+   {
+      traj->pos = 0;
+   }
+   else
+   {
+      /* A stream can't be rewound but may be read once from the start */
+      if(!traj->stream)
+         rewind(traj->fp);
+      traj->pos        = 0;
+      traj->firstEntry = TRUE;
+   }
+}
+
+
+/***********************************************************************/
+/*>static char *Decompressor(char *filename)
+   -----------------------------------------
+*//**
+   \param[in]  *filename       a trajectory file or "-"
+   \return                     the program to decompress it, or NULL if
+                               it isn't compressed (or can't be read)
+
+   Recognises gzip and zstd files from their magic numbers. Only the
+   first byte of standard input can be put back, but a text trajectory
+   always starts with '>' so that is enough.
+
+-  14.10.26 Original   By: ACRM
+*/
+static char *Decompressor(char *filename)
+{
+   unsigned char magic[MAXMAGIC];
+   FILE          *fp;
+   size_t        nRead;
+
+   if(!strcmp(filename, "-"))
+   {
+      int c;
+      if((c = getc(stdin)) == EOF)
+         return(NULL);
+      ungetc(c, stdin);
+      if(c == 0x1f)
+         return("gzip");
+      if(c == 0x28)
+         return("zstd");
+      return(NULL);
+   }
+
+   if((fp = fopen(filename, "rb"))==NULL)
+      return(NULL);
+   nRead = fread(magic, 1, MAXMAGIC, fp);
+   fclose(fp);
+
+   if((nRead >= 2) && (magic[0] == 0x1f) && (magic[1] == 0x8b))
+      return("gzip");
+   if((nRead >= 4) && (magic[0] == 0x28) && (magic[1] == 0xb5) &&
+      (magic[2] == 0x2f) && (magic[3] == 0xfd))
+      return("zstd");
+   return(NULL);
+}
+
+
+/***********************************************************************/
+/*>static void FeedStdin(void)
+   ---------------------------
+*//**
+   Called in the decompressor process before it starts. Standard input
+   has already been read into stdio's buffer, so a further process is
+   forked to copy it (and the rest of standard input) to a pipe which
+   becomes the decompressor's standard input.
+
+-  14.10.26 Original   By: ACRM
+*/
+static void FeedStdin(void)
+{
+   int   fds[2];
+   pid_t pid;
+
+   if((pipe(fds) < 0) || ((pid = fork()) < 0))
+      _exit(1);
+
+   if(pid == 0)
+   {
+      char   buffer[BUFSIZ];
+      size_t nRead;
+
+      close(fds[0]);
+      while((nRead = fread(buffer, 1, BUFSIZ, stdin)) > 0)
+      {
+         if(write(fds[1], buffer, nRead) != (ssize_t)nRead)
+            _exit(1);
+      }
+      _exit(0);
+   }
+
+   close(fds[1]);
+   if(dup2(fds[0], STDIN_FILENO) < 0)
+      _exit(1);
+   close(fds[0]);
+}
+
+
+/***********************************************************************/
+/*>BOOL IsStreamTraj(char *filename)
+   ---------------------------------
+*//**
+   \param[in]  *filename       a trajectory file
+   \return                     Must the trajectory be read as a
+                               stream?
+
+   Standard input ("-") and compressed files can only be read once
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL IsStreamTraj(char *filename)
+{
+   return(!strcmp(filename, "-") || (Decompressor(filename) != NULL));
+}
+
+
+/***********************************************************************/
+/*>TRAJ *OpenStreamTraj(char *filename)
+   ------------------------------------
+*//**
+   \param[in]  *filename       "-" or a compressed trajectory file
+   \return                     the open trajectory, or NULL on failure
+
+   Opens standard input or starts a gzip or zstd process to decompress
+   a file (or compressed standard input). The result can be read once
+   with ReadTrajFrame(). The decompressor is run directly rather than
+   through a shell so the filename needs no quoting. With gPrefetch
+   set the decompressor's output is read ahead by an I/O thread.
+   Uncompressed standard input is always read directly since
+   Decompressor() has already buffered its start in stdin.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Reads ahead with gPrefetch
+*/
+TRAJ *OpenStreamTraj(char *filename)
+{
+   TRAJ *traj;
+   char *program;
+   BOOL useStdin = !strcmp(filename, "-");
+   int  fds[2];
+
+   if(((program = Decompressor(filename))==NULL) && !useStdin)
+      return(NULL);
+
+   if((traj = (TRAJ *)CountedMalloc(sizeof(TRAJ)))==NULL)
+      return(NULL);
+   memset(traj, 0, sizeof(TRAJ));
+   traj->firstEntry = TRUE;
+   SetTrajWindow(traj, 0, ULONG_MAX, 1);
+   traj->stream = TRUE;
+   strncpy(traj->filename, filename, MAXFNM-1);
+   traj->filename[MAXFNM-1] = '\0';
+
+   if(program == NULL)
+   {
+      traj->fp = stdin;
+      return(traj);
+   }
+
+   if(pipe(fds) < 0)
+   {
+      free(traj);
+      return(NULL);
+   }
+   if((traj->pid = fork()) < 0)
+   {
+      close(fds[0]);
+      close(fds[1]);
+      free(traj);
+      return(NULL);
+   }
+   if(traj->pid == 0)
+   {
+      /* The child process                                             */
+      close(fds[0]);
+      if(dup2(fds[1], STDOUT_FILENO) < 0)
+         _exit(1);
+      close(fds[1]);
+      if(useStdin)
+      {
+         FeedStdin();
+         execlp(program, program, "-dc", (char *)NULL);
+      }
+      else
+      {
+         execlp(program, program, "-dc", filename, (char *)NULL);
+      }
+      _exit(1);
+   }
+
+   close(fds[1]);
+   if(gPrefetch)
+   {
+      if((traj->fp = OpenPrefetch(fds[0]))==NULL)
+      {
+         FinishStream(traj);
+         free(traj);
+         return(NULL);
+      }
+   }
+   else if((traj->fp = fdopen(fds[0], "r"))==NULL)
+   {
+      close(fds[0]);
+      FinishStream(traj);
+      free(traj);
+      return(NULL);
+   }
+   return(traj);
+}
+
+
+/***********************************************************************/
+/*>BOOL FinishStream(TRAJ *traj)
+   -----------------------------
+*//**
+   \param[in,out] *traj        a trajectory opened by OpenStreamTraj()
+   \return                     Was the whole stream read without error?
+
+   Closes the stream and waits for any decompressor to finish
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL FinishStream(TRAJ *traj)
+{
+   BOOL ok = TRUE;
+
+   if(traj->fp != NULL)
+   {
+      if(ferror(traj->fp))
+         ok = FALSE;
+      if(traj->fp != stdin)
+         fclose(traj->fp);
+      traj->fp = NULL;
+   }
+
+   if(traj->pid > 0)
+   {
+      int status;
+
+      if((waitpid(traj->pid, &status, 0) != traj->pid) ||
+         !WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+         ok = FALSE;
+      traj->pid = 0;
+   }
+   return(ok);
+}
+
+
+/***********************************************************************/
+/*>TRAJ *SpillTraj(char *filename, SELECTION *select, BOOL skipBad)
+   ----------------------------------------------------------------
+*//**
+   \param[in]  *filename       "-" or a compressed trajectory file
+   \param[in]  *select         atoms to keep (NULL for all)
+   \param[in]  skipBad         leave out frames that don't match the
+                               first
+   \return                     the open trajectory, or NULL on failure
+
+   Reads a stream once, writing it to a temporary binary trajectory in
+   $TMPDIR (or /tmp), and opens that in its place. The temporary file
+   is memory mapped and removed straight away so nothing is left behind
+   however the program ends.
+
+   The coordinates are held exactly, as doubles (or as floats in a
+   SINGLE_COORDS build), so the results are the same as for the
+   uncompressed file whatever the number of decimal places.
+
+   Frames left out with skipBad are not in the temporary file, so any
+   window counts only the frames kept.
+
+   Only the selected atoms are read and kept, as for a text file, so
+   the trajectory returned is not given the selection again. Its kept
+   field is set to the selection instead.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Added skipBad
+-  14.10.26 Added select
+-  14.10.26 Spills the coordinates exactly
+*/
+TRAJ *SpillTraj(char *filename, SELECTION *select, BOOL skipBad)
+{
+   TRAJ *stream,
+        *traj   = NULL;
+   char spillFile[MAXFNM],
+        *tmpDir;
+   int  fd;
+   BOOL ok;
+
+   if((stream = OpenStreamTraj(filename))==NULL)
+      return(NULL);
+
+   if(((tmpDir = getenv("TMPDIR"))==NULL) || (tmpDir[0] == '\0'))
+      tmpDir = "/tmp";
+   snprintf(spillFile, MAXFNM, "%s/%s", tmpDir, SPILLNAME);
+   if((fd = mkstemp(spillFile)) < 0)
+   {
+      CloseTraj(stream);
+      return(NULL);
+   }
+   close(fd);
+
+   stream->select  = select;
+   stream->skipBad = skipBad;
+   ok = ConvertTraj(stream, spillFile,
+                    (sizeof(COORD) == sizeof(float)) ? FCB_FLOAT32 :
+                                                       FCB_FLOAT64);
+   if(!FinishStream(stream))
+   {
+      Msg("Error reading trajectory: ", filename);
+      ok = FALSE;
+   }
+   CloseTraj(stream);
+
+   if(ok && ((traj = OpenTraj(spillFile, TRUE)) != NULL))
+   {
+      strncpy(traj->filename, filename, MAXFNM-1);
+      traj->filename[MAXFNM-1] = '\0';
+      traj->kept = select;
+   }
+   remove(spillFile);
+
+   return(traj);
+}
+
+
+/***********************************************************************/
+/*>BOOL ReadTrajFrame(TRAJ *traj, char *header, COORDS *frame)
+   -----------------------------------------------------------
+*//**
+   \param[in]  *traj           an open trajectory
+   \param[out] *header         the frame header
+   \param[out] *frame          the frame to read into
+   \return                     Was a frame read?
+
+   Reads the next frame in the trajectory's window, or in its sample.
+
+   A text frame which is bad (no header, or a coordinate line that
+   can't be read - see ReadMappedFrame()) is reported with
+   MsgBadFrame(). With traj->skipBad it is left out and the next frame
+   read. Otherwise FALSE is returned with traj->badFrame giving the
+   reason, so the caller must check this at the end of the frames.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Handles binary trajectories
+-  14.10.26 Skips frames outside the window
+-  14.10.26 Handles trajectories in memory
+-  14.10.26 Skips the frames left out by SkipBadFrames()
+-  14.10.26 Reads the sample in place of the window
+-  14.10.26 Sets the frame's kernels
+-  14.10.26 Reports bad frames, skipping them with skipBad
+*/
+BOOL ReadTrajFrame(TRAJ *traj, char *header, COORDS *frame)
+{
+   while(ReadNextFrame(traj, header, frame))
+   {
+      if(traj->badFrame == FRAME_OK)
+         return(TRUE);
+
+      MsgBadFrame(traj, traj->frameNum-1, header, traj->skipBad);
+      if(!traj->skipBad)
+         return(FALSE);
+   }
+   traj->badFrame = FRAME_OK;
+   return(FALSE);
+}
+
+
+/***********************************************************************/
+/*>static BOOL ReadNextFrame(TRAJ *traj, char *header, COORDS *frame)
+   ------------------------------------------------------------------
+*//**
+   \param[in]  *traj           an open trajectory
+   \param[out] *header         the frame header
+   \param[out] *frame          the frame to read into
+   \return                     Was a frame read?
+
+   Reads the next frame in the trajectory's window, or in its sample,
+   for ReadTrajFrame(). A bad frame is returned with traj->badFrame
+   set.
+
+-  14.10.26 Original - split out of ReadTrajFrame()   By: ACRM
+*/
+static BOOL ReadNextFrame(TRAJ *traj, char *header, COORDS *frame)
+{
+   ULONG want = traj->firstFrame;
+   BOOL  ok;
+
+   traj->badFrame = FRAME_OK;
+
+   /* The next frame in the sample or the window                        */
+   if(traj->sample != NULL)
+   {
+      ULONG low  = 0,
+            high = traj->nSample,
+            mid;
+
+      while(low < high)
+      {
+         mid = low + (high - low) / 2;
+         if(traj->sample[mid] < traj->frameNum)
+            low = mid + 1;
+         else
+            high = mid;
+      }
+      if(low == traj->nSample)
+         return(FALSE);
+      want = traj->sample[low];
+   }
+   else if(traj->frameNum > want)
+   {
+      want += ((traj->frameNum - want + traj->stride - 1) / traj->stride)
+              * traj->stride;
+   }
+   while((traj->sample == NULL) && (traj->nSkip != 0) &&
+         (want <= traj->lastFrame) &&
+         IsSkipped(traj, (want - traj->firstFrame) / traj->stride))
+      want += traj->stride;
+   if(want > traj->lastFrame)
+      return(FALSE);
+   if((want != traj->frameNum) && !SkipTrajFrames(traj, want, frame))
+      return(FALSE);
+
+   /* ReadFcbFrame() and ReadMemoryFrame() keep their own frame number */
+   if(traj->binary)
+      return(ReadFcbFrame(traj, header, frame) &&
+             SetFrameKernels(traj, frame));
+   if(traj->memory)
+      return(ReadMemoryFrame(traj, header, frame) &&
+             SetFrameKernels(traj, frame));
+
+   if(traj->mapped)
+      ok = ReadMappedFrame(traj, header, frame);
+   else
+      ok = ReadFrame(traj, header, frame, traj->select);
+   if(ok)
+      traj->frameNum++;
+   return(ok && SetFrameKernels(traj, frame));
+}
+
+
+/***********************************************************************/
+/*>static BOOL SetFrameKernels(TRAJ *traj, COORDS *frame)
+   ------------------------------------------------------
+*//**
+   \param[in,out] *traj        an open trajectory
+   \param[in,out] *frame       a frame just read from it
+   \return                     TRUE
+
+   Gives the frame the kernels for its number of atoms from the
+   trajectory's set (gKernels if it has none). They are chosen for the
+   first frame read and only chosen again if a frame has a different
+   number of atoms, so a trajectory normally makes the choice once.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Uses the trajectory's set
+*/
+static BOOL SetFrameKernels(TRAJ *traj, COORDS *frame)
+{
+   if((traj->kernels == NULL) || (frame->nAtoms != traj->kernelAtoms))
+   {
+      traj->kernels     = KernelsForAtoms((traj->kernelSet != NULL) ?
+                                          traj->kernelSet : &gKernels,
+                                          frame->nAtoms);
+      traj->kernelAtoms = frame->nAtoms;
+   }
+   frame->kernels = traj->kernels;
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>static BOOL SkipTrajFrames(TRAJ *traj, ULONG frameNum,
+                              COORDS *frame)
+   -------------------------------------------------------
+*//**
+   \param[in]  *traj           an open trajectory
+   \param[in]  frameNum        the frame to move to (from 0)
+   \param[in]  *frame          a frame buffer which may be used while
+                               skipping
+   \return                     Is there such a frame?
+
+   Moves forward to a frame. A binary trajectory or one in memory, or
+   a text one with an index, simply seeks to it. Otherwise the frames in between are read
+   with no atoms selected, so none of their lines are parsed (and the
+   memory-mapped reader skips straight to each header).
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Handles trajectories in memory
+*/
+static BOOL SkipTrajFrames(TRAJ *traj, ULONG frameNum, COORDS *frame)
+{
+   static SELECTION sNoAtoms = {NULL, 0, ULONG_MAX};
+   SELECTION *select = traj->select;
+   char      header[MAXBUFF];
+   BOOL      ok      = TRUE;
+
+   if(traj->binary || traj->memory)
+   {
+      if(frameNum >= traj->nFrames)
+         return(FALSE);
+      traj->frameNum = frameNum;
+      return(TRUE);
+   }
+
+   if(traj->index != NULL)
+   {
+      if((frameNum >= traj->index->nFrames) ||
+         !SeekTraj(traj, traj->index->offset[frameNum]))
+         return(FALSE);
+      traj->frameNum = frameNum;
+      return(TRUE);
+   }
+
+   traj->select = &sNoAtoms;
+   while(ok && (traj->frameNum < frameNum))
+   {
+      if(traj->mapped)
+         ok = ReadMappedFrame(traj, header, frame);
+      else
+         ok = ReadFrame(traj, header, frame, &sNoAtoms);
+      if(ok)
+         traj->frameNum++;
+   }
+   traj->select = select;
+
+   return(ok);
+}
+
+
+/***********************************************************************/
+/*>void SetTrajWindow(TRAJ *traj, ULONG firstFrame, ULONG lastFrame,
+                      ULONG stride)
+   -----------------------------------------------------------------
+*//**
+   \param[in,out] *traj        an open trajectory
+   \param[in]     firstFrame   first frame to read (from 0)
+   \param[in]     lastFrame    last frame to read (ULONG_MAX for the
+                               end)
+   \param[in]     stride       read every stride'th frame
+
+   Sets the window of frames returned by ReadTrajFrame()
+
+-  14.10.26 Original   By: ACRM
+*/
+void SetTrajWindow(TRAJ *traj, ULONG firstFrame, ULONG lastFrame,
+                   ULONG stride)
+{
+   traj->firstFrame = firstFrame;
+   traj->lastFrame  = lastFrame;
+   traj->stride     = (stride > 0) ? stride : 1;
+}
+
+
+/***********************************************************************/
+/*>ULONG WindowFrameCount(TRAJ *traj, ULONG nFrames)
+   -------------------------------------------------
+*//**
+   \param[in]  *traj           an open trajectory
+   \param[in]  nFrames         number of frames in the file
+   \return                     number of those frames in the window, or
+                               in the sample
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Leaves out the frames in traj->skip
+-  14.10.26 Counts the sample
+*/
+ULONG WindowFrameCount(TRAJ *traj, ULONG nFrames)
+{
+   ULONG last,
+         count,
+         i;
+
+   if(traj->sample != NULL)
+      return(traj->nSample);
+   if(nFrames == 0)
+      return(0);
+   last = (traj->lastFrame < nFrames) ? traj->lastFrame : nFrames-1;
+   if(traj->firstFrame > last)
+      return(0);
+   count = (last - traj->firstFrame) / traj->stride + 1;
+
+   for(i=0; (i<traj->nSkip) && (traj->skip[i] < count); i++);
+   return(count - i);
+}
+
+
+/***********************************************************************/
+/*>ULONG WindowFrameNum(TRAJ *traj, ULONG n)
+   -----------------------------------------
+*//**
+   \param[in]  *traj           an open trajectory
+   \param[in]  n               a frame in the window, or the sample
+                               (from 0)
+   \return                     its number in the file (from 0)
+
+   With frames left out, the n'th frame kept is at window position n+j
+   where j of the skipped positions come before it. skip[k]-k counts
+   the frames kept before skip[k], so j is the number of k with
+   skip[k]-k <= n, found by a binary search.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Leaves out the frames in traj->skip
+-  14.10.26 Numbers the sample
+*/
+ULONG WindowFrameNum(TRAJ *traj, ULONG n)
+{
+   ULONG low  = 0,
+         high = traj->nSkip,
+         mid;
+
+   if(traj->sample != NULL)
+      return(traj->sample[n]);
+
+   while(low < high)
+   {
+      mid = low + (high - low) / 2;
+      if(traj->skip[mid] - mid <= n)
+         low = mid + 1;
+      else
+         high = mid;
+   }
+   return(traj->firstFrame + (n + low) * traj->stride);
+}
+
+
+/***********************************************************************/
+/*>static BOOL IsSkipped(TRAJ *traj, ULONG n)
+   ------------------------------------------
+*//**
+   \param[in]  *traj           an open trajectory
+   \param[in]  n               a window position (from 0)
+   \return                     Was the frame left out by
+                               SkipBadFrames()?
+
+-  14.10.26 Original   By: ACRM
+*/
+static BOOL IsSkipped(TRAJ *traj, ULONG n)
+{
+   ULONG low  = 0,
+         high = traj->nSkip,
+         mid;
+
+   while(low < high)
+   {
+      mid = low + (high - low) / 2;
+      if(traj->skip[mid] == n)
+         return(TRUE);
+      if(traj->skip[mid] < n)
+         low = mid + 1;
+      else
+         high = mid;
+   }
+   return(FALSE);
+}
+
+
+/***********************************************************************/
+/*>BOOL SeekTraj(TRAJ *traj, off_t offset)
+   ----------------------------------------
+*//**
+   \param[in]  *traj           an open trajectory
+   \param[in]  offset          byte offset of a frame's header line
+                               (from a FRAMEINDEX), or the frame
+                               number for a trajectory in memory
+   \return                     Was the seek successful?
+
+   Moves to the start of a frame and resets the frame reading so that
+   the next ReadTrajFrame() reads that frame
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Handles binary trajectories
+-  14.10.26 Resets the TRAJ's reading state
+-  14.10.26 Handles trajectories in memory
+*/
+BOOL SeekTraj(TRAJ *traj, off_t offset)
+{
+   if(traj->binary)
+   {
+      return(SeekFcb(traj, offset));
+   }
+   else if(traj->memory)
+   {
+      if((offset < 0) || ((ULONG)offset > traj->nFrames))
+         return(FALSE);
+      traj->frameNum = (ULONG)offset;
+   }
+   else if(traj->mapped)
+   {
+      if((offset < 0) || ((size_t)offset > traj->size))
+         return(FALSE);
+      traj->pos = (size_t)offset;
+   }
+   else
+   {
+      if(fseeko(traj->fp, offset, SEEK_SET) != 0)
+         return(FALSE);
+      traj->pos        = (size_t)offset;
+      traj->firstEntry = TRUE;
+   }
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>TRAJ *DupTraj(TRAJ *traj)
+   -------------------------
+*//**
+   \param[in]  *traj           an open trajectory
+   \return                     an independent reader for the same
+                               trajectory (NULL on failure)
+
+   Creates a second reader for a trajectory so that another thread can
+   read it at the same time. A memory-mapped trajectory shares the
+   mapping, and one in memory its frames (either must outlive the
+   copy); otherwise the file is opened again. Either way the copy has its own position and reading state.
+   It uses the same atom selection, index, frame window, kernels and
+   fit option, and leaves out the same frames or reads the same
+   sample. It doesn't gather the RMSFs or write the series, which
+   threads keep separately.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Copies the atom selection
+-  14.10.26 Copies the index and frame window
+-  14.10.26 A stdio copy may be read with ReadTrajFrame()
+-  14.10.26 Handles trajectories in memory
+-  14.10.26 Copies the frames left out
+-  14.10.26 Copies the sample
+-  14.10.26 Copies the kernels and fit option
+*/
+TRAJ *DupTraj(TRAJ *traj)
+{
+   TRAJ *copy;
+
+   if(!traj->mapped && !traj->memory)
+   {
+      if((copy = OpenTraj(traj->filename, FALSE))!=NULL)
+      {
+         copy->select    = traj->select;
+         copy->index     = traj->index;
+         copy->skipBad   = traj->skipBad;
+         copy->skip      = traj->skip;
+         copy->nSkip     = traj->nSkip;
+         copy->sample    = traj->sample;
+         copy->nSample   = traj->nSample;
+         copy->kernelSet = traj->kernelSet;
+         copy->fit       = traj->fit;
+         SetTrajWindow(copy, traj->firstFrame, traj->lastFrame,
+                       traj->stride);
+      }
+      return(copy);
+   }
+
+   if((copy = (TRAJ *)CountedMalloc(sizeof(TRAJ)))!=NULL)
+   {
+      *copy        = *traj;
+      copy->pos      = 0;
+      copy->frameNum = 0;
+      copy->shared   = TRUE;
+      copy->rmsf     = NULL;
+      copy->series   = NULL;
+   }
+   return(copy);
+}
+
+
+/***********************************************************************/
+/*>BOOL ReadIndexedFrame(TRAJ *traj, FRAMEINDEX *index, ULONG frameNum,
+                         char *header, COORDS *frame)
+   --------------------------------------------------------------------
+*//**
+   \param[in]  *traj           an open trajectory
+   \param[in]  *index          frame index for the trajectory
+   \param[in]  frameNum        the frame to read (from 0)
+   \param[out] *header         the frame header
+   \param[out] *frame          the frame to read into
+   \return                     Was the frame read?
+
+   Reads a given frame using the index. ReadTrajFrame() may be used
+   afterwards to carry on from the next frame.
+
+   For stdio the file is only repositioned if it isn't already at the
+   frame, so reading consecutive frames does not discard the stdio
+   buffer. The number of lines read comes from the index.
+
+   A bad frame (see ReadMappedFrame()) is not read, and traj->badFrame
+   gives the reason.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Handles binary trajectories
+-  14.10.26 Added atom selection
+-  14.10.26 Resets the TRAJ's reading state
+-  14.10.26 Parses into REAL before storing
+-  14.10.26 Handles trajectories in memory
+-  14.10.26 Records the offset of the frame
+-  14.10.26 Sets the frame's kernels
+-  14.10.26 Checks the selected lines. Fails for a bad frame
+-  14.10.26 Reads whole lines with ReadTrajLine()
+*/
+BOOL ReadIndexedFrame(TRAJ *traj, FRAMEINDEX *index, ULONG frameNum,
+                      char *header, COORDS *frame)
+{
+   char  buffer[MAXBUFF];
+   ULONG i,
+         nLines,
+         nAtoms   = 0,
+         nBytes;
+   BOOL  readable = TRUE;
+
+   traj->badFrame = FRAME_OK;
+   if(frameNum >= index->nFrames)
+      return(FALSE);
+
+   if(traj->binary)
+   {
+      return(SeekFcb(traj, index->offset[frameNum]) &&
+             ReadFcbFrame(traj, header, frame) &&
+             SetFrameKernels(traj, frame));
+   }
+
+   if(traj->memory)
+   {
+      traj->frameNum = (ULONG)index->offset[frameNum];
+      return(ReadMemoryFrame(traj, header, frame) &&
+             SetFrameKernels(traj, frame));
+   }
+
+   if(traj->mapped)
+   {
+      traj->pos = (size_t)index->offset[frameNum];
+      return(ReadMappedFrame(traj, header, frame) &&
+             (traj->badFrame == FRAME_OK) &&
+             SetFrameKernels(traj, frame));
+   }
+
+   if((ftello(traj->fp) != index->offset[frameNum]) &&
+      (fseeko(traj->fp, index->offset[frameNum], SEEK_SET) != 0))
+      return(FALSE);
+   traj->firstEntry = TRUE;
+
+   /* The header                                                        */
+   if((nBytes = ReadTrajLine(traj->fp, buffer)) == 0)
+      return(FALSE);
+   TERMINATE(buffer);
+   traj->frameStart = index->offset[frameNum];
+   if(buffer[0] != '>')
+   {
+      header[0]      = '\0';
+      frame->nAtoms  = 0;
+      traj->badFrame = FRAME_NOHEADER;
+      return(FALSE);
+   }
+   strcpy(header, buffer);
+
+   /* And the coordinates of the selected atoms                         */
+   nLines = index->nAtoms[frameNum];
+   for(i=0; i<nLines; i++)
+   {
+      size_t len;
+
+      if((len = ReadTrajLine(traj->fp, buffer)) == 0)
+         return(FALSE);
+      nBytes += len;
+      if(SELECTED(traj->select, i))
+      {
+         char *p = buffer;
+         REAL x, y, z;
+
+         if(!ParseCoords(&p, buffer + strlen(buffer), &x, &y, &z))
+         {
+            readable = FALSE;
+         }
+         else if(readable)
+         {
+            if((nAtoms == frame->maxAtoms) &&
+               !GrowCoords(frame, 2 * frame->maxAtoms))
+               return(FALSE);
+            frame->x[nAtoms] = x;
+            frame->y[nAtoms] = y;
+            frame->z[nAtoms] = z;
+            nAtoms++;
+         }
+      }
+   }
+   if(!readable || (nLines == 0))
+   {
+      nAtoms         = 0;
+      traj->badFrame = FRAME_NOCOORDS;
+   }
+   frame->nAtoms    = nAtoms;
+   traj->pos        = (size_t)index->offset[frameNum] + nBytes;
+   CountRead(nBytes, nAtoms, 1);
+
+   return((traj->badFrame == FRAME_OK) && SetFrameKernels(traj, frame));
+}
+
+
+/***********************************************************************/
+/*>ULONG CountTrajFrames(TRAJ *traj, FRAMEINDEX *index)
+   ----------------------------------------------------
+*//**
+   \param[in]  *traj           an open trajectory
+   \param[out] *index          if not NULL, an empty frame index to
+                               fill in
+   \return                     the number of frames in the file
+
+   Counts the frames in a trajectory and goes back to the start
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Added index
+-  14.10.26 Handles binary trajectories
+-  14.10.26 Handles trajectories in memory
+*/
+ULONG CountTrajFrames(TRAJ *traj, FRAMEINDEX *index)
+{
+   traj->frameNum = 0;
+   if(traj->binary)
+      return(CountFcbFrames(traj, index));
+   if(traj->memory)
+      return(CountMemoryFrames(traj, index));
+   if(traj->mapped)
+      return(CountMappedFrames(traj, index));
+   return(CountFrames(traj->fp, index));
+}
+
+
+/***********************************************************************/
+/*>BOOL ReadMappedFrame(TRAJ *traj, char *header, COORDS *frame)
+   -------------------------------------------------------------
+*//**
+   \param[in]  *traj           a memory-mapped trajectory
+   \param[out] *header         the frame header
+   \param[out] *frame          the frame to read into
+   \return                     Was a frame read?
+
+   Reads the next frame directly from the mapped file. Only the header
+   is copied; the coordinates are parsed in place.
+
+   Unselected lines are skipped by memchr(). Once past the last
+   selected atom, memchr() goes straight to the next header.
+
+   A selected line must start with three numbers. A frame with one
+   that doesn't, or with no coordinate lines, is returned with no
+   atoms and traj->badFrame set to FRAME_NOCOORDS; lines before the
+   first header are returned as a frame with an empty header and
+   FRAME_NOHEADER.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Added atom selection
+-  14.10.26 Records the offset of the frame
+-  14.10.26 Checks the selected lines and returns bad, empty and
+            headerless frames with traj->badFrame set
+*/
+BOOL ReadMappedFrame(TRAJ *traj, char *header, COORDS *frame)
+{
+   char      *p       = traj->data + traj->pos,
+             *end     = traj->data + traj->size,
+             *eol;
+   SELECTION *select  = traj->select;
+   ULONG     nAtoms   = 0,
+             nLines   = 0,
+             lastLine = LASTLINE(select);
+   BOOL      readable = TRUE;
+
+   traj->frameStart = (off_t)traj->pos;
+   traj->badFrame   = FRAME_OK;
+   if(p >= end)
+   {
+      frame->nAtoms = 0;
+      return(FALSE);
+   }
+
+   /* The header line                                                   */
+   if(*p == '>')
+   {
+      size_t len;
+
+      if((eol = (char *)memchr(p, '\n', end - p))==NULL)
+         eol = end;
+      if((len = eol - p) > MAXBUFF-2)
+         len = MAXBUFF-2;
+      memcpy(header, p, len);
+      header[len] = '\0';
+      p = (eol < end) ? eol+1 : end;
+   }
+   else
+   {
+      header[0]      = '\0';
+      traj->badFrame = FRAME_NOHEADER;
+   }
+
+   /* Coordinate lines up to the next header                            */
+   while((p < end) && (*p != '>'))
+   {
+      if(nLines == lastLine)
+      {
+         /* Nothing more is selected, so find the next header. A '>'
+            can only start a line
+         */
+         while(((p = (char *)memchr(p, '>', end - p)) != NULL) &&
+               (p[-1] != '\n'))
+            p++;
+         if(p == NULL)
+            p = end;
+         nLines++;
+         break;
+      }
+
+      if(SELECTED(select, nLines))
+      {
+         REAL x, y, z;
+
+         if(!ParseCoords(&p, end, &x, &y, &z))
+         {
+            readable = FALSE;
+         }
+         else if(readable)
+         {
+            if((nAtoms == frame->maxAtoms) &&
+               !GrowCoords(frame, 2 * frame->maxAtoms))
+            {
+               frame->nAtoms = 0;
+               return(FALSE);
+            }
+            frame->x[nAtoms] = x;
+            frame->y[nAtoms] = y;
+            frame->z[nAtoms] = z;
+            nAtoms++;
+         }
+      }
+      nLines++;
+
+      /* Skip to the start of the next line                             */
+      if((eol = (char *)memchr(p, '\n', end - p))==NULL)
+         p = end;
+      else
+         p = eol+1;
+   }
+
+   if((!readable || (nLines == 0)) && (traj->badFrame == FRAME_OK))
+      traj->badFrame = FRAME_NOCOORDS;
+   if(traj->badFrame != FRAME_OK)
+      nAtoms = 0;
+
+   CountRead((ULONG)((p - traj->data) - traj->pos), nAtoms, 1);
+   traj->pos     = p - traj->data;
+   frame->nAtoms = nAtoms;
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>ULONG CountMappedFrames(TRAJ *traj, FRAMEINDEX *index)
+   -------------------------------------------------------
+*//**
+   \param[in]  *traj           a memory-mapped trajectory
+   \param[out] *index          if not NULL, an empty frame index to
+                               fill in
+   \return                     the number of frames in the file
+
+   Counts the lines starting with a '>', and any lines before the
+   first of them as a frame without a header, which is given no atoms
+   in the index. Without an index, only the '>' characters are
+   searched for, so the coordinate lines are skipped by memchr(). With
+   an index, every line must be visited to count the atoms in each
+   frame, but none is parsed.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Added index
+-  14.10.26 Counts the frames for --stats
+-  14.10.26 Counts lines before the first header as a frame
+*/
+ULONG CountMappedFrames(TRAJ *traj, FRAMEINDEX *index)
+{
+   char  *p   = traj->data,
+         *end = traj->data + traj->size;
+   ULONG frameCount = 0;
+   BOOL  counting   = TRUE;
+
+   traj->pos = 0;
+
+   if(index == NULL)
+   {
+      if((p < end) && (*p != '>'))
+         frameCount++;
+      while((p < end) && ((p = (char *)memchr(p, '>', end - p)) != NULL))
+      {
+         if((p == traj->data) || (p[-1] == '\n'))
+            frameCount++;
+         p++;
+      }
+   }
+   else
+   {
+      /* The lines before the first header are a frame which is bad   */
+      if((p < end) && (*p != '>'))
+      {
+         frameCount++;
+         if(AddIndexFrame(index, 0))
+            index->noHeader = TRUE;
+         else
+            p = end;
+         counting = FALSE;
+      }
+
+      while(p < end)
+      {
+         if(*p == '>')
+         {
+            frameCount++;
+            if(!AddIndexFrame(index, (off_t)(p - traj->data)))
+               break;
+            counting = TRUE;
+         }
+         else if(counting)
+         {
+            index->nAtoms[index->nFrames-1]++;
+         }
+
+         if((p = (char *)memchr(p, '\n', end - p))==NULL)
+            break;
+         p++;
+      }
+   }
+
+   CountRead((ULONG)traj->size, 0, frameCount);
+   return(frameCount);
+}
+
+
+/***********************************************************************/
+/*>REAL ParseReal(char **ptr, char *end)
+   -------------------------------------
+*//**
+   \param[in,out] **ptr        pointer into the text - updated to point
+                               after the number (left alone if there
+                               isn't one)
+   \param[in]     *end         end of the text
+   \return                     the number (0.0 if there isn't one)
+
+   A specialised replacement for sscanf("%lf") for the fixed-precision
+   numbers found in trajectories (e.g. "-12.345"). The digits are
+   collected into an integer which is then divided by a power of ten.
+   Since both are exact in a double and IEEE division is correctly
+   rounded, the result is identical to strtod(). Exponents, very long
+   numbers and anything else unusual are passed to strtod().
+
+   Spaces and tabs are skipped, but not newlines, so parsing never
+   moves on to the next line.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Leaves *ptr alone if there is no number
+*/
+REAL ParseReal(char **ptr, char *end)
+{
+   char               *p         = *ptr,
+                      *start;
+   unsigned long long mantissa   = 0;
+   int                nDigits    = 0,
+                      nDecimals  = 0;
+   BOOL               negative   = FALSE;
+   REAL               value;
+
+   while((p < end) && ((*p == ' ') || (*p == '\t')))
+      p++;
+   start = p;
+
+   if((p < end) && ((*p == '-') || (*p == '+')))
+   {
+      negative = (*p == '-');
+      p++;
+   }
+   while((p < end) && ISDIGIT(*p))
+   {
+      mantissa = 10 * mantissa + (*p++ - '0');
+      nDigits++;
+   }
+   if((p < end) && (*p == '.'))
+   {
+      p++;
+      while((p < end) && ISDIGIT(*p))
+      {
+         mantissa = 10 * mantissa + (*p++ - '0');
+         nDigits++;
+         nDecimals++;
+      }
+   }
+
+   /* Fall back to strtod() for anything we can't do exactly           */
+   if((nDigits == 0) || (nDigits > MAXDIGITS) ||
+      ((p < end) && ((*p == 'e') || (*p == 'E'))))
+   {
+      char buffer[MAXNUMBUFF],
+           *numEnd;
+      int  len = 0;
+
+      p = start;
+      while((p < end) && (len < MAXNUMBUFF-1) &&
+            (*p != ' ') && (*p != '\t') && (*p != '\n') && (*p != '\r'))
+      {
+         buffer[len++] = *p++;
+      }
+      buffer[len] = '\0';
+      value = (REAL)strtod(buffer, &numEnd);
+      if(numEnd != buffer)
+         *ptr = start + (numEnd - buffer);
+      return(value);
+   }
+
+   value = (REAL)mantissa;
+   if(nDecimals)
+      value /= sPowersOf10[nDecimals];
+
+   *ptr = p;
+   return(negative ? -value : value);
+}
+
+
+/***********************************************************************/
+/*>BOOL ParseCoords(char **ptr, char *end, REAL *x, REAL *y, REAL *z)
+   -------------------------------------------------------------------
+*//**
+   \param[in,out] **ptr        pointer to a coordinate line - updated to
+                               point after the coordinates
+   \param[in]     *end         end of the text
+   \param[out]    *x           the coordinates
+   \param[out]    *y
+   \param[out]    *z
+   \return                     Were there three numbers?
+
+   Parses a coordinate line with ParseReal(). Anything after the three
+   numbers is ignored. Every text reader uses this for the selected
+   lines, so they all agree on which lines can be read.
+
+-  14.10.26 Original   By: ACRM
+*/
+BOOL ParseCoords(char **ptr, char *end, REAL *x, REAL *y, REAL *z)
+{
+   char *start = *ptr;
+
+   *x = ParseReal(ptr, end);
+   if(*ptr == start)
+      return(FALSE);
+   start = *ptr;
+   *y = ParseReal(ptr, end);
+   if(*ptr == start)
+      return(FALSE);
+   start = *ptr;
+   *z = ParseReal(ptr, end);
+   return(*ptr != start);
+}
+
+
+/***********************************************************************/
+/*>size_t ReadTrajLine(FILE *fp, char *buffer)
+   -------------------------------------------
+*//**
+   \param[in]  *fp             a text trajectory read with stdio
+   \param[out] *buffer         a MAXBUFF buffer for the line
+   \return                     the number of bytes in the line (0 at
+                               the end of the file)
+
+   Reads a line with fgets(), keeping its first MAXBUFF-2 characters
+   and then its newline (if it has one). The rest of a longer line is
+   read and thrown away, so each call reads one whole line whatever
+   its length. The memory-mapped reader truncates long headers in the
+   same way, so the readers agree on the frames.
+
+-  14.10.26 Original   By: ACRM
+*/
+size_t ReadTrajLine(FILE *fp, char *buffer)
+{
+   size_t len;
+   int    c;
+
+   if(!fgets(buffer, MAXBUFF-1, fp))
+   {
+      buffer[0] = '\0';
+      return(0);
+   }
+
+   if(((len = strlen(buffer)) == MAXBUFF-2) && (buffer[len-1] != '\n'))
+   {
+      while(((c = getc(fp)) != EOF) && (c != '\n'))
+         len++;
+      if(c == '\n')
+      {
+         buffer[MAXBUFF-2] = '\n';
+         buffer[MAXBUFF-1] = '\0';
+         len++;
+      }
+   }
+   return(len);
+}
+
+
+/***********************************************************************/
+/*>BOOL SkipBadFrames(TRAJ *traj, FRAMEINDEX *index)
+   -------------------------------------------------
+*//**
+   \param[in,out] *traj        an open trajectory with its window set
+   \param[in]     *index       its frame index
+   \return                     FALSE (with a message) if no memory or
+                               a frame couldn't be read
+
+   Finds the frames in the window which have no atoms (so are empty or
+   are the lines before the first header), whose atom count differs
+   from that of most of the others (or, if no count is shared by more
+   than half of them, from the first of them), or which have a
+   selected line that can't be read. Each is reported and its window
+   position put in traj->skip, so that the window functions leave it
+   out. The caller frees traj->skip.
+
+   The index gives every frame's atom count and the majority is found
+   with the Boyer-Moore vote. As the index doesn't parse the lines,
+   the selected lines of the other frames of a text trajectory are
+   then read, so every pass, thread and engine sees the same frames.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Frames with no atoms don't vote
+-  14.10.26 Reads the frames to find those with a selected line that
+            can't be read
+*/
+BOOL SkipBadFrames(TRAJ *traj, FRAMEINDEX *index)
+{
+   COORDS *frame   = NULL;
+   char   header[MAXBUFF];
+   BOOL   check    = !(traj->binary || traj->memory),
+          bad,
+          ok       = TRUE;
+   ULONG  *skip    = NULL,
+          nFrames,
+          nVoters  = 0,
+          nAtoms   = 0,
+          first    = 0,
+          votes    = 0,
+          nBad     = 0,
+          maxBad   = 0,
+          n,
+          p,
+          f;
+
+   traj->skip  = NULL;
+   traj->nSkip = 0;
+   nFrames     = WindowFrameCount(traj, index->nFrames);
+
+   for(p=0; p<nFrames; p++)
+   {
+      f = WindowFrameNum(traj, p);
+      if(index->nAtoms[f] == 0)
+         continue;
+      if(votes == 0)
+      {
+         nAtoms = index->nAtoms[f];
+         votes  = 1;
+      }
+      else if(index->nAtoms[f] == nAtoms)
+      {
+         votes++;
+      }
+      else
+      {
+         votes--;
+      }
+   }
+
+   /* The vote only finds a count held by more than half of the frames
+      with atoms
+   */
+   for(p=0, votes=0; p<nFrames; p++)
+   {
+      if((n = index->nAtoms[WindowFrameNum(traj, p)]) != 0)
+      {
+         if(nVoters++ == 0)
+            first = n;
+         if(n == nAtoms)
+            votes++;
+      }
+   }
+   if(2 * votes <= nVoters)
+      nAtoms = first;
+
+   if(check && (nAtoms != 0) &&
+      ((frame = AllocCoords(CountSelected(traj->select, nAtoms)))==NULL))
+   {
+      Msg(MSG_NOMEM, "");
+      return(FALSE);
+   }
+
+   /* traj->nSkip is only set once the list is complete as it changes
+      WindowFrameNum()
+   */
+   for(p=0; ok && (p<nFrames); p++)
+   {
+      f   = WindowFrameNum(traj, p);
+      bad = ((index->nAtoms[f] != nAtoms) || (index->nAtoms[f] == 0));
+      if(bad)
+      {
+         MsgBadFrame(traj, f, NULL, TRUE);
+      }
+      else if(check && !ReadIndexedFrame(traj, index, f, header, frame))
+      {
+         /* Otherwise the file has changed since it was indexed        */
+         bad = (traj->badFrame != FRAME_OK);
+         MsgBadFrame(traj, f, NULL, bad);
+         ok  = bad;
+      }
+
+      if(bad && (nBad == maxBad))
+      {
+         ULONG *more;
+
+         maxBad = (maxBad == 0) ? 16 : 2 * maxBad;
+         if((more = (ULONG *)CountedRealloc(skip, maxBad * sizeof(ULONG)))
+            ==NULL)
+         {
+            Msg(MSG_NOMEM, "");
+            ok = FALSE;
+         }
+         else
+         {
+            skip = more;
+         }
+      }
+      if(ok && bad)
+         skip[nBad++] = p;
+   }
+   traj->badFrame = FRAME_OK;
+   FreeCoords(frame);
+
+   if(!ok || (nBad == 0))
+   {
+      free(skip);
+      return(ok);
+   }
+   traj->skip  = skip;
+   traj->nSkip = nBad;
+
+   return(TRUE);
+}
+
+
+/***********************************************************************/
+/*>void MsgBadFrame(TRAJ *traj, ULONG frameNum, char *header,
+                    BOOL skipped)
+   ----------------------------------------------------------
+*//**
+   \param[in]  *traj           the trajectory
+   \param[in]  frameNum        the bad frame (from 0)
+   \param[in]  *header         its header (NULL if it wasn't read)
+   \param[in]  skipped         it is being left out, so only warn
+
+   Reports a bad frame, giving its number and, where it is known, the
+   byte offset of its header. This comes from a binary trajectory's
+   frame table or the index. Otherwise it is the last frame read by
+   the text readers, which is the bad one whenever this is called just
+   after reading it.
+
+   The frame has no header (the lines before the first one), no
+   readable coordinates or an atom count that doesn't match. The index
+   says which for the frames it holds. Otherwise traj->badFrame, from
+   the read, does and a frame it doesn't mark is one that doesn't
+   match.
+
+-  14.10.26 Original   By: ACRM
+-  14.10.26 Reports frames with no header or no readable coordinates
+*/
+void MsgBadFrame(TRAJ *traj, ULONG frameNum, char *header,
+                 BOOL skipped)
+{
+   char  where[MAXBUFF];
+   off_t offset = -1;
+   int   why    = traj->badFrame;
+
+   if((traj->index != NULL) && (frameNum < traj->index->nFrames))
+   {
+      if((frameNum == 0) && traj->index->noHeader)
+         why = FRAME_NOHEADER;
+      else if(traj->index->nAtoms[frameNum] == 0)
+         why = FRAME_NOCOORDS;
+   }
+
+   /* A trajectory in memory has no offsets                            */
+   if(traj->binary)
+   {
+      if(frameNum < traj->nFrames)
+         offset = traj->frameOffset[frameNum];
+   }
+   else if((traj->index != NULL) && !traj->memory)
+   {
+      if(frameNum < traj->index->nFrames)
+         offset = traj->index->offset[frameNum];
+   }
+   else if(!traj->memory)
+   {
+      offset = traj->frameStart;
+   }
+
+   if(offset >= 0)
+      snprintf(where, MAXBUFF, "frame %lu of %s, byte offset %lld",
+               frameNum+1, traj->filename, (long long)offset);
+   else
+      snprintf(where, MAXBUFF, "frame %lu of %s", frameNum+1,
+               traj->filename);
+
+   if(skipped)
+   {
+      fprintf(stderr, "%s warning: Skipping %s (%s)\n", PROGNAME, where,
+              ((why == FRAME_NOHEADER) ? "no header" :
+               ((why == FRAME_NOCOORDS) ? "no readable coordinates" :
+                "number of coordinates doesn't match")));
+   }
+   else
+   {
+      if(why == FRAME_NOHEADER)
+         Msg("Coordinates before the first frame header", "");
+      else if(why == FRAME_NOCOORDS)
+         Msg("Frame has no coordinates or a line that can't be read",
+             "");
+      else if(header != NULL)
+         Msg(MSG_ATOMMISMATCH, header);
+      else
+         Msg("Number of coordinates in frame doesn't match first frame",
+             "");
+      fprintf(stderr, "  At %s\n", where);
+   }
+}